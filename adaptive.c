@@ -0,0 +1,301 @@
+/*
+ * Feedback-driven adaptive reservations.  See adaptive.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* Local includes. */
+#include "adaptive.h"
+
+static AdaptiveTask_t *pxAdaptiveTasks = NULL;
+static uint32_t ulAdaptiveCount = 0;
+static double dTarget = 0.01;
+
+/*-----------------------------------------------------------*/
+
+void vAdaptiveQuantileInit(AdaptiveQuantile_t *pxQuantile, double dP)
+{
+    memset(pxQuantile, 0, sizeof(*pxQuantile));
+    pxQuantile->dP = dP;
+
+    pxQuantile->dDesired[1] = 2.0 * dP;
+    pxQuantile->dDesired[2] = 4.0 * dP;
+    pxQuantile->dDesired[3] = 2.0 + 2.0 * dP;
+    pxQuantile->dDesired[4] = 4.0;
+
+    pxQuantile->dIncrements[1] = dP / 2.0;
+    pxQuantile->dIncrements[2] = dP;
+    pxQuantile->dIncrements[3] = (1.0 + dP) / 2.0;
+    pxQuantile->dIncrements[4] = 1.0;
+}
+
+static void prvSort(double *pdValues, uint32_t ulCount)
+{
+    for (uint32_t i = 1; i < ulCount; i++)
+    {
+        double dValue = pdValues[i];
+        uint32_t j = i;
+
+        while ((j > 0) && (pdValues[j - 1] > dValue))
+        {
+            pdValues[j] = pdValues[j - 1];
+            j--;
+        }
+
+        pdValues[j] = dValue;
+    }
+}
+
+void vAdaptiveQuantileAdd(AdaptiveQuantile_t *pxQuantile, double dSample)
+{
+    double *pdH = pxQuantile->dHeights;
+    double *pdN = pxQuantile->dPositions;
+    uint32_t k;
+
+    // The first five samples are the markers
+    if (pxQuantile->ulCount < 5)
+    {
+        pdH[pxQuantile->ulCount++] = dSample;
+
+        if (pxQuantile->ulCount == 5)
+        {
+            prvSort(pdH, 5);
+
+            for (uint32_t i = 0; i < 5; i++)
+            {
+                pdN[i] = (double)i;
+            }
+        }
+
+        return;
+    }
+
+    // Cell of the sample, stretching the extreme markers if needed
+    if (dSample < pdH[0])
+    {
+        pdH[0] = dSample;
+        k = 0;
+    }
+    else if (dSample >= pdH[4])
+    {
+        pdH[4] = dSample;
+        k = 3;
+    }
+    else
+    {
+        k = 0;
+
+        while (dSample >= pdH[k + 1])
+        {
+            k++;
+        }
+    }
+
+    for (uint32_t i = k + 1; i < 5; i++)
+    {
+        pdN[i] += 1.0;
+    }
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        pxQuantile->dDesired[i] += pxQuantile->dIncrements[i];
+    }
+
+    // Move the middle markers towards their desired positions
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        double dOffset = pxQuantile->dDesired[i] - pdN[i];
+
+        if (((dOffset >= 1.0) && (pdN[i + 1] - pdN[i] > 1.0)) || ((dOffset <= -1.0) && (pdN[i - 1] - pdN[i] < -1.0)))
+        {
+            double dSign = (dOffset > 0.0) ? 1.0 : -1.0;
+            double dParabolic = pdH[i] + dSign / (pdN[i + 1] - pdN[i - 1]) *
+                                ((pdN[i] - pdN[i - 1] + dSign) * (pdH[i + 1] - pdH[i]) / (pdN[i + 1] - pdN[i]) +
+                                 (pdN[i + 1] - pdN[i] - dSign) * (pdH[i] - pdH[i - 1]) / (pdN[i] - pdN[i - 1]));
+
+            if ((pdH[i - 1] < dParabolic) && (dParabolic < pdH[i + 1]))
+            {
+                pdH[i] = dParabolic;
+            }
+            else
+            {
+                // Linear step when the parabola leaves the neighbours
+                uint32_t ulNext = (dSign > 0.0) ? i + 1 : i - 1;
+
+                pdH[i] += dSign * (pdH[ulNext] - pdH[i]) / (pdN[ulNext] - pdN[i]);
+            }
+
+            pdN[i] += dSign;
+        }
+    }
+
+    pxQuantile->ulCount++;
+}
+
+double dAdaptiveQuantile(const AdaptiveQuantile_t *pxQuantile)
+{
+    double dSorted[5];
+    uint32_t ulIndex;
+
+    if (pxQuantile->ulCount == 0)
+    {
+        return 0.0;
+    }
+
+    if (pxQuantile->ulCount >= 5)
+    {
+        return pxQuantile->dHeights[2];
+    }
+
+    memcpy(dSorted, pxQuantile->dHeights, sizeof(dSorted));
+    prvSort(dSorted, pxQuantile->ulCount);
+    ulIndex = (uint32_t)ceil(pxQuantile->dP * pxQuantile->ulCount);
+
+    return dSorted[(ulIndex > 0) ? ulIndex - 1 : 0];
+}
+
+/*-----------------------------------------------------------*/
+
+void vAdaptiveInit(AdaptiveTask_t *pxTasks, uint32_t ulCount, double dTargetOverrunRatio)
+{
+    pxAdaptiveTasks = pxTasks;
+    ulAdaptiveCount = ulCount;
+    dTarget = dTargetOverrunRatio;
+
+    for (uint32_t i = 0; i < ulCount; i++)
+    {
+        AdaptiveTask_t *pxTask = &pxTasks[i];
+
+        pxTask->ullBudgetNs = pxTask->ullStaticBudgetNs;
+        pxTask->ullPreviousBudgetNs = pxTask->ullStaticBudgetNs;
+        pxTask->dMargin = adaptiveMARGIN_INITIAL;
+        pxTask->dQuantileNs = 0.0;
+        vAdaptiveQuantileInit(&pxTask->xEstimator, 1.0 - dTargetOverrunRatio);
+    }
+}
+
+/* One controller step over the last adaptiveCONTROL_JOBS jobs. */
+static int prvControl(AdaptiveTask_t *pxTask)
+{
+    double dRatio = (double)pxTask->ulWindowLate / (double)pxTask->ulWindowJobs;
+    double dBudget;
+    uint64_t ullBudget;
+    uint64_t ullMax = (uint64_t)((double)pxTask->ullPeriodNs * adaptiveMAX_SHARE);
+
+    pxTask->ulWindowJobs = 0;
+    pxTask->ulWindowLate = 0;
+
+    // The previous window's estimate stands in until this one has settled
+    if (pxTask->xEstimator.ulCount >= adaptiveMIN_SAMPLES)
+    {
+        pxTask->dQuantileNs = dAdaptiveQuantile(&pxTask->xEstimator);
+    }
+
+    if (pxTask->dQuantileNs <= 0.0)
+    {
+        return 0;
+    }
+
+    pxTask->dMargin += adaptiveMARGIN_GAIN * (dRatio - dTarget);
+    pxTask->dMargin = fmax(adaptiveMARGIN_MIN, fmin(adaptiveMARGIN_MAX, pxTask->dMargin));
+
+    dBudget = pxTask->dQuantileNs * (1.0 + pxTask->dMargin);
+    ullBudget = (uint64_t)dBudget;
+    ullBudget = (ullBudget < adaptiveMIN_BUDGET_NS) ? adaptiveMIN_BUDGET_NS : ullBudget;
+    ullBudget = (ullBudget > ullMax) ? ullMax : ullBudget;
+
+    pxTask->ulUpdates++;
+
+    if (fabs((double)ullBudget - (double)pxTask->ullBudgetNs) > adaptiveSETTLE_BAND * (double)pxTask->ullBudgetNs)
+    {
+        pxTask->ulSettledAt = pxTask->ulUpdates;
+    }
+
+    pxTask->dBudgetShareSum += (double)ullBudget / (double)pxTask->ullPeriodNs;
+
+    if (ullBudget == pxTask->ullBudgetNs)
+    {
+        return 0;
+    }
+
+    pxTask->ullPreviousBudgetNs = pxTask->ullBudgetNs;
+    pxTask->ullBudgetNs = ullBudget;
+
+    return 1;
+}
+
+int xAdaptiveJobEnd(AdaptiveTask_t *pxTask, uint64_t ullExecNs, uint64_t ullResponseNs)
+{
+    int iOverrun = (ullExecNs > pxTask->ullBudgetNs);
+    int iMiss = (ullResponseNs > pxTask->ullPeriodNs);
+
+    pxTask->ulJobs++;
+    pxTask->ulOverruns += (uint32_t)iOverrun;
+    pxTask->ulMisses += (uint32_t)iMiss;
+    pxTask->ulWindowJobs++;
+    pxTask->ulWindowLate += (uint32_t)(iOverrun || iMiss);
+
+    if (ullExecNs > pxTask->ullMaxExecNs)
+    {
+        pxTask->ullMaxExecNs = ullExecNs;
+    }
+
+    // Restart the estimator so that old jobs stop weighing on the quantile
+    if (pxTask->xEstimator.ulCount >= adaptiveWINDOW_JOBS)
+    {
+        pxTask->dQuantileNs = dAdaptiveQuantile(&pxTask->xEstimator);
+        vAdaptiveQuantileInit(&pxTask->xEstimator, pxTask->xEstimator.dP);
+    }
+
+    vAdaptiveQuantileAdd(&pxTask->xEstimator, (double)ullExecNs);
+
+    if (pxTask->ulWindowJobs < adaptiveCONTROL_JOBS)
+    {
+        return 0;
+    }
+
+    return prvControl(pxTask);
+}
+
+void vAdaptiveReject(AdaptiveTask_t *pxTask)
+{
+    pxTask->ullBudgetNs = pxTask->ullPreviousBudgetNs;
+    pxTask->ulRejected++;
+}
+
+void vAdaptiveReport(void)
+{
+    double dWcet = 0.0;
+    double dStatic = 0.0;
+    double dFinal = 0.0;
+    double dMean = 0.0;
+
+    fprintf(stderr, "%-10s %10s %10s %10s %10s %7s %9s %9s %11s %8s\n", "task", "WCET", "static Q", "adaptive Q",
+            "quantile", "margin", "overruns", "misses", "settled", "rejected");
+
+    for (uint32_t i = 0; i < ulAdaptiveCount; i++)
+    {
+        AdaptiveTask_t *pxTask = &pxAdaptiveTasks[i];
+        double dJobs = (pxTask->ulJobs > 0) ? (double)pxTask->ulJobs : 1.0;
+        double dPeriod = (double)pxTask->ullPeriodNs;
+
+        fprintf(stderr, "%-10s %8.1fus %8.1fus %8.1fus %8.1fus %7.2f %8.2f%% %8.2f%% %5u/%-5u %8u\n", pxTask->pcName,
+                (double)pxTask->ullWcetNs / 1000.0, (double)pxTask->ullStaticBudgetNs / 1000.0, (double)pxTask->ullBudgetNs / 1000.0,
+                pxTask->dQuantileNs / 1000.0, pxTask->dMargin, 100.0 * pxTask->ulOverruns / dJobs,
+                100.0 * pxTask->ulMisses / dJobs, (unsigned)pxTask->ulSettledAt, (unsigned)pxTask->ulUpdates,
+                (unsigned)pxTask->ulRejected);
+
+        dWcet += (double)pxTask->ullWcetNs / dPeriod;
+        dStatic += (double)pxTask->ullStaticBudgetNs / dPeriod;
+        dFinal += (double)pxTask->ullBudgetNs / dPeriod;
+        dMean += (pxTask->ulUpdates > 0) ? pxTask->dBudgetShareSum / pxTask->ulUpdates
+                                         : (double)pxTask->ullStaticBudgetNs / dPeriod;
+    }
+
+    // Negative when a period really costs more than the declared WCET
+    fprintf(stderr, "Adaptive: target late=%.2f%% reserved U wcet=%.5f static=%.5f mean=%.5f final=%.5f "
+            "reclaimed=%.5f of the WCET budget\n",
+            100.0 * dTarget, dWcet, dStatic, dMean, dFinal, dWcet - dMean);
+}
@@ -0,0 +1,119 @@
+/*
+ * Feedback-driven adaptive reservations (Abeni and Buttazzo's adaptive
+ * bandwidth reservations, with the budget set from a quantile of the
+ * measured execution times instead of a declared WCET).
+ *
+ * Each task measures the CPU time of every period: the job and everything
+ * the reservation pays for around it, clock reads, this module, the
+ * sched_setattr() of a new budget and the yield.  A P² estimator (Jain
+ * and Chlamtac, CACM 1985) tracks its 1 - target quantile online in constant
+ * space; the estimator restarts every adaptiveWINDOW_JOBS jobs so that the
+ * budget follows a drifting workload, keeping the previous estimate until
+ * the new one has adaptiveMIN_SAMPLES samples.
+ *
+ * Every adaptiveCONTROL_JOBS jobs a controller sets the budget to
+ *
+ *     Q = q̂ · (1 + m)
+ *
+ * where m is a safety margin driven by an integral term on the late ratio
+ * of the last window: a period is late when it needed more than the budget
+ * or when its job was seen to miss its deadline, which also catches a
+ * reservation throttled for a reason the CPU time does not show.  Above the
+ * target the margin grows, below it the margin shrinks and the bandwidth
+ * goes back to the system.  The budget stays
+ * within [adaptiveMIN_BUDGET_NS, adaptiveMAX_SHARE · period].
+ *
+ * The module only computes budgets: xAdaptiveJobEnd() says when the budget
+ * changed and the caller applies it (linux_sched.c --adaptive updates the
+ * SCHED_DEADLINE runtime of the task), calling vAdaptiveReject() if the
+ * system refused it.  A task's state is only touched by the task itself.
+ */
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <stdint.h>
+
+#define adaptiveCONTROL_JOBS      ( 16 )
+#define adaptiveWINDOW_JOBS       ( 512 )
+#define adaptiveMIN_SAMPLES       ( 32 )
+#define adaptiveMIN_BUDGET_NS     ( 20000ULL )
+#define adaptiveMAX_SHARE         ( 0.5 )
+
+/* Integral gain of the margin controller and its limits. */
+#define adaptiveMARGIN_GAIN       ( 4.0 )
+#define adaptiveMARGIN_MIN        ( 0.05 )
+#define adaptiveMARGIN_MAX        ( 4.0 )
+#define adaptiveMARGIN_INITIAL    ( 0.5 )
+
+/* The budget is settled once updates stay within this relative band. */
+#define adaptiveSETTLE_BAND       ( 0.05 )
+
+/* P² estimate of one quantile. */
+typedef struct AdaptiveQuantile
+{
+    double dP;
+    double dHeights[5];
+    double dPositions[5];
+    double dDesired[5];
+    double dIncrements[5];
+    uint32_t ulCount;
+} AdaptiveQuantile_t;
+
+typedef struct AdaptiveTask
+{
+    const char *pcName;
+    uint64_t ullPeriodNs;
+    uint64_t ullStaticBudgetNs;      /* Budget without adaptation, and the first one. */
+    uint64_t ullWcetNs;              /* Declared WCET, reclamation is measured against it. */
+
+    /* Controller state. */
+    uint64_t ullBudgetNs;            /* Budget in force. */
+    uint64_t ullPreviousBudgetNs;    /* Restored by vAdaptiveReject(). */
+    double dMargin;
+    AdaptiveQuantile_t xEstimator;
+    double dQuantileNs;              /* Estimate the budget is built on. */
+    uint32_t ulWindowJobs;
+    uint32_t ulWindowLate;           /* Overruns and misses of the window. */
+
+    /* Statistics. */
+    uint32_t ulJobs;
+    uint32_t ulOverruns;             /* Periods that needed more than the budget. */
+    uint32_t ulMisses;               /* Responses longer than the period. */
+    uint32_t ulUpdates;              /* Controller steps. */
+    uint32_t ulSettledAt;            /* Step after which the budget stayed in the band. */
+    uint32_t ulRejected;
+    uint64_t ullMaxExecNs;
+    double dBudgetShareSum;          /* Q / T summed over the steps. */
+} AdaptiveTask_t;
+
+void vAdaptiveQuantileInit(AdaptiveQuantile_t *pxQuantile, double dP);
+void vAdaptiveQuantileAdd(AdaptiveQuantile_t *pxQuantile, double dSample);
+
+/* Exact below five samples, 0 without any. */
+double dAdaptiveQuantile(const AdaptiveQuantile_t *pxQuantile);
+
+/*
+ * Set up the tasks with their period and static budget already filled in.
+ * The budget starts at the static one.  dTargetOverrunRatio is the share of
+ * jobs allowed to overrun, e.g. 0.01.
+ */
+void vAdaptiveInit(AdaptiveTask_t *pxTasks, uint32_t ulCount, double dTargetOverrunRatio);
+
+/*
+ * Account a completed period: ullExecNs is all the CPU time the task used in
+ * it, ullResponseNs the response time of its job.  Returns 1 when the budget
+ * changed, in which case the caller applies pxTask->ullBudgetNs.
+ */
+int xAdaptiveJobEnd(AdaptiveTask_t *pxTask, uint64_t ullExecNs, uint64_t ullResponseNs);
+
+/* The new budget could not be applied: go back to the previous one. */
+void vAdaptiveReject(AdaptiveTask_t *pxTask);
+
+/* Per task budget, miss and overrun ratios, settling, and the bandwidth
+ * reclaimed against the declared WCETs, on stderr.  A static budget padded
+ * beyond the WCET would make any adaptation look like a saving, so it is
+ * shown but not used as the reference. */
+void vAdaptiveReport(void);
+
+#endif /* ADAPTIVE_H */
@@ -0,0 +1,150 @@
+/*
+ * Binary logging with format strings extracted at build time.  See binlog.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Local includes. */
+#include "binlog.h"
+#include "output.h"
+
+/* Bounds of the format string section, provided by the linker. */
+extern const char __start_binlog[] __attribute__((weak));
+extern const char __stop_binlog[] __attribute__((weak));
+
+static OutputStream_t *pxBinlogStream = NULL;
+static uint64_t ullStartNs = 0;
+static uint64_t ullRecords = 0;
+static uint64_t ullBytes = 0;
+static uint64_t ullOverflows = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+/* Record time stamp: the TSC where there is one, a few times cheaper. */
+static inline uint64_t prvStamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return prvNowNs();
+#endif
+}
+
+/*-----------------------------------------------------------*/
+
+int xBinlogInit(const char *pcPath)
+{
+    const struct timespec xCalibration = { 0, binlogCALIBRATION_NS };
+    uint8_t ucHeader[binlogFILE_HEADER_SIZE];
+    uint32_t ulSectionSize = (uint32_t)(__stop_binlog - __start_binlog);
+    uint64_t ullStamp, ullNs;
+    double dStampsPerNs;
+    int iFd;
+
+    iFd = open(pcPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (iFd < 0)
+    {
+        return -1;
+    }
+
+    pxBinlogStream = pxOutputOpen(iFd);
+
+    if (pxBinlogStream == NULL)
+    {
+        close(iFd);
+        return -1;
+    }
+
+    // Rate of the record time stamps against CLOCK_MONOTONIC
+    ullStamp = prvStamp();
+    ullNs = prvNowNs();
+    nanosleep(&xCalibration, NULL);
+    dStampsPerNs = (double)(prvStamp() - ullStamp) / (double)(prvNowNs() - ullNs);
+
+    // The section size lets the decoder tell a dictionary of another build
+    memcpy(ucHeader, binlogFILE_MAGIC, 8);
+    memcpy(ucHeader + 8, &ulSectionSize, sizeof(ulSectionSize));
+    memcpy(ucHeader + 12, &ullStamp, sizeof(ullStamp));
+    memcpy(ucHeader + 20, &ullNs, sizeof(ullNs));
+    memcpy(ucHeader + 28, &dStampsPerNs, sizeof(dStampsPerNs));
+    vOutputWrite(pxBinlogStream, (const char *)ucHeader, sizeof(ucHeader));
+
+    ullStartNs = prvNowNs();
+
+    return 0;
+}
+
+int xBinlogBegin(BinlogRecord_t *pxRecord, const char *pcFormat)
+{
+    uint32_t ulId;
+    uint64_t ullNow;
+
+    if (pxBinlogStream == NULL)
+    {
+        return 0;
+    }
+
+    // Only the address of the format is used, never its contents
+    ulId = (uint32_t)(pcFormat - __start_binlog);
+    ullNow = prvStamp();
+
+    pxRecord->ucData[0] = binlogMAGIC;
+    memcpy(&pxRecord->ucData[2], &ulId, sizeof(ulId));
+    memcpy(&pxRecord->ucData[6], &ullNow, sizeof(ullNow));
+    pxRecord->xLength = binlogHEADER_SIZE;
+    pxRecord->iOverflow = 0;
+
+    return 1;
+}
+
+void vBinlogEnd(BinlogRecord_t *pxRecord)
+{
+    if (pxRecord->iOverflow)
+    {
+        __atomic_fetch_add(&ullOverflows, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    pxRecord->ucData[1] = (uint8_t)pxRecord->xLength;
+    vOutputWrite(pxBinlogStream, (const char *)pxRecord->ucData, pxRecord->xLength);
+
+    __atomic_fetch_add(&ullRecords, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ullBytes, pxRecord->xLength, __ATOMIC_RELAXED);
+}
+
+void vBinlogGetStats(BinlogStats_t *pxStats)
+{
+    pxStats->ullRecords = __atomic_load_n(&ullRecords, __ATOMIC_RELAXED);
+    pxStats->ullBytes = __atomic_load_n(&ullBytes, __ATOMIC_RELAXED);
+    pxStats->ullOverflows = __atomic_load_n(&ullOverflows, __ATOMIC_RELAXED);
+    pxStats->dElapsedSeconds = (ullStartNs != 0) ? (double)(prvNowNs() - ullStartNs) / 1e9 : 0.0;
+}
+
+void vBinlogReport(void)
+{
+    BinlogStats_t xStats;
+    double dSeconds;
+
+    vBinlogGetStats(&xStats);
+    dSeconds = (xStats.dElapsedSeconds > 0.0) ? xStats.dElapsedSeconds : 1.0;
+
+    printf("Binlog: %s records=%llu bytes=%llu (%.1f B/s, %.1f B/record) overflows=%llu\n",
+           (pxBinlogStream != NULL) ? "on" : "off", (unsigned long long)xStats.ullRecords,
+           (unsigned long long)xStats.ullBytes, (double)xStats.ullBytes / dSeconds,
+           (xStats.ullRecords > 0) ? (double)xStats.ullBytes / (double)xStats.ullRecords : 0.0,
+           (unsigned long long)xStats.ullOverflows);
+}
@@ -0,0 +1,175 @@
+/*
+ * Binary logging with format strings extracted at build time.
+ *
+ * binlogPRINT("Result: %ld\n", result) never looks at its format string at
+ * run time.  The string is placed in the "binlog" section of the binary and
+ * its offset in that section is the message id.  A call only stores the id,
+ * a time stamp and the raw bytes of the arguments (selected by type with
+ * _Generic) into a record, and hands the record to the output backend of
+ * output.h.
+ *
+ * The text is rebuilt offline:
+ *     python3 binlog_extract.py task2 > binlog_dict.json
+ *     python3 binlog_decode.py binlog_dict.json ipsa_log.bin
+ *
+ * Record layout, little endian:
+ *     u8 binlogMAGIC, u8 record length, u32 id, u64 time stamp (TSC on x86,
+ *     CLOCK_MONOTONIC ns elsewhere; the file header gives the conversion),
+ *     then each argument: 4 bytes for int sized integers, 8 for long,
+ *     long long and pointers, 8 for float and double (as double), and
+ *     u8 length plus the bytes for strings.
+ *
+ * binlogPRINT() evaluates to 1 when the record was logged and to 0 when no
+ * log is open, so callers can fall back to text output.  At most
+ * binlogMAX_ARGS arguments are supported.  GCC or Clang is required for the
+ * statement expression and the section attribute.
+ */
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define binlogFILE_NAME      "ipsa_log.bin"
+#define binlogMAGIC          ( 0xB7 )
+#define binlogMAX_RECORD     ( 128 )
+#define binlogMAX_ARGS       ( 4 )
+#define binlogMAX_STRING     ( 64 )
+#define binlogHEADER_SIZE    ( 14 )
+
+/* A log file starts with this, the u32 size of the section, and the u64
+ * time stamp, u64 CLOCK_MONOTONIC ns and f64 stamps per ns at calibration. */
+#define binlogFILE_MAGIC         "IPSABLG1"
+#define binlogFILE_HEADER_SIZE   ( 36 )
+#define binlogCALIBRATION_NS     ( 10000000 )
+
+typedef struct BinlogRecord
+{
+    uint8_t ucData[binlogMAX_RECORD];
+    size_t xLength;
+    int iOverflow;
+} BinlogRecord_t;
+
+typedef struct BinlogStats
+{
+    uint64_t ullRecords;
+    uint64_t ullBytes;
+    uint64_t ullOverflows;           /* Records dropped for being too long. */
+    double dElapsedSeconds;
+} BinlogStats_t;
+
+/*
+ * Open the log file on the asynchronous output backend, which must already
+ * be running (see xOutputInit()).  Returns 0 on success; on failure
+ * binlogPRINT() keeps returning 0.
+ */
+int xBinlogInit(const char *pcPath);
+
+int xBinlogBegin(BinlogRecord_t *pxRecord, const char *pcFormat);
+void vBinlogEnd(BinlogRecord_t *pxRecord);
+
+void vBinlogGetStats(BinlogStats_t *pxStats);
+void vBinlogReport(void);
+
+/*-----------------------------------------------------------*/
+
+static inline void vBinlogPutBytes(BinlogRecord_t *pxRecord, const void *pvData, size_t xSize)
+{
+    if (pxRecord->xLength + xSize > binlogMAX_RECORD)
+    {
+        pxRecord->iOverflow = 1;
+        return;
+    }
+
+    memcpy(&pxRecord->ucData[pxRecord->xLength], pvData, xSize);
+    pxRecord->xLength += xSize;
+}
+
+static inline void vBinlogPutInt(BinlogRecord_t *pxRecord, int32_t lValue)
+{
+    vBinlogPutBytes(pxRecord, &lValue, sizeof(lValue));
+}
+
+static inline void vBinlogPutUnsigned(BinlogRecord_t *pxRecord, uint32_t ulValue)
+{
+    vBinlogPutBytes(pxRecord, &ulValue, sizeof(ulValue));
+}
+
+static inline void vBinlogPutLong(BinlogRecord_t *pxRecord, int64_t llValue)
+{
+    vBinlogPutBytes(pxRecord, &llValue, sizeof(llValue));
+}
+
+static inline void vBinlogPutUnsignedLong(BinlogRecord_t *pxRecord, uint64_t ullValue)
+{
+    vBinlogPutBytes(pxRecord, &ullValue, sizeof(ullValue));
+}
+
+static inline void vBinlogPutDouble(BinlogRecord_t *pxRecord, double dValue)
+{
+    vBinlogPutBytes(pxRecord, &dValue, sizeof(dValue));
+}
+
+static inline void vBinlogPutPointer(BinlogRecord_t *pxRecord, const void *pvValue)
+{
+    uint64_t ullValue = (uint64_t)(uintptr_t)pvValue;
+
+    vBinlogPutBytes(pxRecord, &ullValue, sizeof(ullValue));
+}
+
+static inline void vBinlogPutString(BinlogRecord_t *pxRecord, const char *pcValue)
+{
+    size_t xSize = strnlen(pcValue, binlogMAX_STRING);
+    uint8_t ucSize = (uint8_t)xSize;
+
+    vBinlogPutBytes(pxRecord, &ucSize, sizeof(ucSize));
+    vBinlogPutBytes(pxRecord, pcValue, xSize);
+}
+
+#define binlogPUT(pxRecord, xArg)                        \
+    _Generic((xArg),                                     \
+             char: vBinlogPutInt,                        \
+             signed char: vBinlogPutInt,                 \
+             unsigned char: vBinlogPutUnsigned,          \
+             short: vBinlogPutInt,                       \
+             unsigned short: vBinlogPutUnsigned,         \
+             int: vBinlogPutInt,                         \
+             unsigned int: vBinlogPutUnsigned,           \
+             long: vBinlogPutLong,                       \
+             unsigned long: vBinlogPutUnsignedLong,      \
+             long long: vBinlogPutLong,                  \
+             unsigned long long: vBinlogPutUnsignedLong, \
+             float: vBinlogPutDouble,                    \
+             double: vBinlogPutDouble,                   \
+             char *: vBinlogPutString,                   \
+             const char *: vBinlogPutString,             \
+             default: vBinlogPutPointer)((pxRecord), (xArg))
+
+#define binlogPUT_0(r)
+#define binlogPUT_1(r, a)             binlogPUT(r, a)
+#define binlogPUT_2(r, a, b)          binlogPUT(r, a); binlogPUT(r, b)
+#define binlogPUT_3(r, a, b, c)       binlogPUT(r, a); binlogPUT(r, b); binlogPUT(r, c)
+#define binlogPUT_4(r, a, b, c, d)    binlogPUT(r, a); binlogPUT(r, b); binlogPUT(r, c); binlogPUT(r, d)
+
+#define binlogCOUNT_(_0, _1, _2, _3, _4, N, ...)    N
+#define binlogCOUNT(...)                            binlogCOUNT_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define binlogCONCAT_(a, b)                         a##b
+#define binlogCONCAT(a, b)                          binlogCONCAT_(a, b)
+
+#define binlogPRINT(pcFormat, ...)                                                               \
+    ({                                                                                           \
+        static const char cBinlogFormat[] __attribute__((section("binlog"), aligned(1), used)) = \
+            pcFormat;                                                                            \
+        BinlogRecord_t xBinlogRecord;                                                            \
+        int iBinlogLogged = xBinlogBegin(&xBinlogRecord, cBinlogFormat);                         \
+        if (iBinlogLogged)                                                                       \
+        {                                                                                        \
+            binlogCONCAT(binlogPUT_, binlogCOUNT(__VA_ARGS__))(&xBinlogRecord, ##__VA_ARGS__);   \
+            vBinlogEnd(&xBinlogRecord);                                                          \
+        }                                                                                        \
+        iBinlogLogged;                                                                           \
+    })
+
+#endif /* BINLOG_H */
@@ -0,0 +1,180 @@
+/*
+ * Per-call cost and log volume of binlogPRINT() against printf().
+ *
+ * Emits the messages of the ipsa_sched jobs, alternately with binlogPRINT()
+ * into a binary log and with fprintf() into a fully buffered stdio stream,
+ * both going to /dev/null so that only the producer side is measured.  The
+ * report gives cycles per call (median, p99, max) and bytes per call, and
+ * from the latter the bytes per second the task set of ipsa_tasks.h would
+ * log with either.
+ *
+ * Host tool, not part of the FreeRTOS build:
+ *     gcc -O2 -pthread binlog_bench.c binlog.c output.c -o binlog_bench
+ *     ./binlog_bench [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Local includes. */
+#include "binlog.h"
+#include "output.h"
+#include "ipsa_tasks.h"
+
+#define benchDEFAULT_SAMPLES    ( 200000 )
+#define benchMESSAGES           ( 4 )
+
+typedef struct BenchMessage
+{
+    const char *pcName;
+    uint32_t ulPeriodMs;
+    uint64_t *pullBinlog;
+    uint64_t *pullPrintf;
+    size_t xBinlogBytes;
+    size_t xPrintfBytes;
+} BenchMessage_t;
+
+static BenchMessage_t xMessages[benchMESSAGES] =
+{
+    { .pcName = "TX1 heartbeat", .ulPeriodMs = TASK1_PERIOD_MS },
+    { .pcName = "TX2 temperature", .ulPeriodMs = TASK2_PERIOD_MS },
+    { .pcName = "TX3 result", .ulPeriodMs = TASK3_PERIOD_MS },
+    { .pcName = "TX4 search", .ulPeriodMs = TASK4_PERIOD_MS },
+};
+
+/*-----------------------------------------------------------*/
+
+static inline uint64_t prvStamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+#endif
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+/* The same statement once per message kind, so both paths see equal work. */
+static int prvEmit(int iMessage, int iBinary, FILE *pxText, float fValue, long lValue)
+{
+    switch (iMessage)
+    {
+        case 0:
+            return iBinary ? binlogPRINT("Working 1\n") : fprintf(pxText, "Working 1\n");
+
+        case 1:
+            return iBinary ? binlogPRINT("Fahrenheit: %f, Celsius: %f\n", fValue, (fValue - 32.0f) * 5.0f / 9.0f)
+                           : fprintf(pxText, "Fahrenheit: %f, Celsius: %f\n", fValue, (fValue - 32.0f) * 5.0f / 9.0f);
+
+        case 2:
+            return iBinary ? binlogPRINT("Result: %ld\n", lValue) : fprintf(pxText, "Result: %ld\n", lValue);
+
+        default:
+            return iBinary ? binlogPRINT("Element found\n") : fprintf(pxText, "Element found\n");
+    }
+}
+
+static void prvReport(const char *pcName, uint64_t *pullTimes, size_t xCount)
+{
+    qsort(pullTimes, xCount, sizeof(pullTimes[0]), prvCompare);
+    printf("    %-8s median=%6llu p99=%6llu max=%8llu\n", pcName, (unsigned long long)pullTimes[xCount / 2],
+           (unsigned long long)pullTimes[xCount * 99 / 100], (unsigned long long)pullTimes[xCount - 1]);
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    size_t xSamples = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : benchDEFAULT_SAMPLES;
+    FILE *pxText = fopen("/dev/null", "w");
+    double dBinlogRate = 0.0;
+    double dPrintfRate = 0.0;
+
+    if ((xSamples == 0) || (pxText == NULL) || (xOutputInit() != 0) || (xBinlogInit("/dev/null") != 0))
+    {
+        fprintf(stderr, "binlog_bench: cannot set up the outputs\n");
+        return 1;
+    }
+
+    setvbuf(pxText, NULL, _IOFBF, outputBUFFER_SIZE);
+
+    for (int m = 0; m < benchMESSAGES; m++)
+    {
+        BenchMessage_t *pxMessage = &xMessages[m];
+        BinlogStats_t xBefore, xAfter;
+        uint64_t ullPrintfBytes = 0;
+
+        pxMessage->pullBinlog = malloc(xSamples * sizeof(uint64_t));
+        pxMessage->pullPrintf = malloc(xSamples * sizeof(uint64_t));
+
+        if ((pxMessage->pullBinlog == NULL) || (pxMessage->pullPrintf == NULL))
+        {
+            return 1;
+        }
+
+        vBinlogGetStats(&xBefore);
+
+        for (size_t i = 0; i < xSamples; i++)
+        {
+            float fValue = 100.0f + (float)(i % 1000) / 10.0f;
+            long lValue = (long)i * 1234567890L;
+            uint64_t ullStart;
+
+            ullStart = prvStamp();
+            (void)prvEmit(m, 1, pxText, fValue, lValue);
+            pxMessage->pullBinlog[i] = prvStamp() - ullStart;
+
+            ullStart = prvStamp();
+            ullPrintfBytes += (uint64_t)prvEmit(m, 0, pxText, fValue, lValue);
+            pxMessage->pullPrintf[i] = prvStamp() - ullStart;
+        }
+
+        vBinlogGetStats(&xAfter);
+        pxMessage->xBinlogBytes = (size_t)((xAfter.ullBytes - xBefore.ullBytes) / xSamples);
+        pxMessage->xPrintfBytes = (size_t)(ullPrintfBytes / xSamples);
+
+        dBinlogRate += (double)pxMessage->xBinlogBytes * 1000.0 / pxMessage->ulPeriodMs;
+        dPrintfRate += (double)pxMessage->xPrintfBytes * 1000.0 / pxMessage->ulPeriodMs;
+    }
+
+    vOutputDrain();
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("Cycles per call (TSC), %zu samples each\n", xSamples);
+#else
+    printf("Nanoseconds per call, %zu samples each\n", xSamples);
+#endif
+
+    for (int m = 0; m < benchMESSAGES; m++)
+    {
+        BenchMessage_t *pxMessage = &xMessages[m];
+
+        printf("  %s: binlog %zu B/call, printf %zu B/call\n", pxMessage->pcName, pxMessage->xBinlogBytes,
+               pxMessage->xPrintfBytes);
+        prvReport("binlog", pxMessage->pullBinlog, xSamples);
+        prvReport("printf", pxMessage->pullPrintf, xSamples);
+        free(pxMessage->pullBinlog);
+        free(pxMessage->pullPrintf);
+    }
+
+    printf("Task set log volume: binlog %.0f B/s, printf %.0f B/s\n", dBinlogRate, dPrintfRate);
+    vBinlogReport();
+    vOutputReport();
+    fclose(pxText);
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+"""Rebuild the text of a binary log written by binlog.c.
+
+The dictionary comes from binlog_extract.py run on the same binary.  The
+argument sizes of each record are derived from the conversion specifiers of
+its format string, following the encoding described in binlog.h.  A record
+that does not parse (bytes dropped by the output backend under overload) is
+skipped by scanning for the next record header.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+FILE_MAGIC = b"IPSABLG1"
+RECORD_MAGIC = 0xB7
+HEADER_SIZE = 14
+
+SPECIFIER = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t|L)?([diouxXeEfFgGcsp%])")
+
+
+def compile_format(text):
+    """Python format string and argument kinds of a C format string."""
+    kinds = []
+    pieces = []
+    last = 0
+
+    for match in SPECIFIER.finditer(text):
+        flags, length, conversion = match.groups()
+        pieces.append(text[last:match.start()].replace("%", "%%"))
+        last = match.end()
+
+        if conversion == "%":
+            pieces.append("%%")
+            continue
+
+        if conversion in "eEfFgG":
+            kinds.append("double")
+        elif conversion == "s":
+            kinds.append("string")
+        elif conversion == "p":
+            kinds.append("pointer")
+            conversion = "x"
+            flags = "#" + flags
+        elif length in ("l", "ll", "z", "j", "t"):
+            kinds.append("signed64" if conversion in "di" else "unsigned64")
+        else:
+            kinds.append("signed32" if conversion in "dic" else "unsigned32")
+
+        pieces.append("%" + flags + conversion)
+
+    pieces.append(text[last:].replace("%", "%%"))
+    return "".join(pieces), kinds
+
+
+def unpack_arguments(record, kinds):
+    values = []
+    offset = HEADER_SIZE
+    for kind in kinds:
+        if kind == "string":
+            size = record[offset]
+            values.append(record[offset + 1:offset + 1 + size].decode("utf-8", "replace"))
+            offset += 1 + size
+        else:
+            code = {"double": "<d", "pointer": "<Q", "signed64": "<q", "unsigned64": "<Q",
+                    "signed32": "<i", "unsigned32": "<I"}[kind]
+            values.append(struct.unpack_from(code, record, offset)[0])
+            offset += struct.calcsize(code)
+    if offset != len(record):
+        raise ValueError("argument bytes do not match the format")
+    return tuple(values)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dictionary", help="output of binlog_extract.py")
+    parser.add_argument("log", nargs="?", default="ipsa_log.bin")
+    parser.add_argument("--time", action="store_true", help="prefix every line with its time stamp in ns")
+    args = parser.parse_args()
+
+    with open(args.dictionary) as dictionary_file:
+        dictionary = json.load(dictionary_file)
+    formats = {int(key): compile_format(text) for key, text in dictionary["formats"].items()}
+
+    with open(args.log, "rb") as log_file:
+        data = log_file.read()
+
+    if data[:len(FILE_MAGIC)] != FILE_MAGIC:
+        raise SystemExit(f"{args.log} is not a binlog file")
+    section_size, stamp0, ns0, stamps_per_ns = struct.unpack_from("<IQQd", data, len(FILE_MAGIC))
+    if section_size != dictionary["section_size"]:
+        print("warning: the dictionary was extracted from another build", file=sys.stderr)
+
+    offset = len(FILE_MAGIC) + 28
+    skipped = 0
+    while offset + HEADER_SIZE <= len(data):
+        length = data[offset + 1]
+        record = data[offset:offset + length]
+        try:
+            if data[offset] != RECORD_MAGIC or length < HEADER_SIZE or len(record) != length:
+                raise ValueError("no record header")
+            identifier, stamp = struct.unpack_from("<IQ", record, 2)
+            template, kinds = formats[identifier]
+            text = template % unpack_arguments(record, kinds)
+        except (KeyError, ValueError, struct.error, IndexError):
+            # Resynchronise on the next byte
+            offset += 1
+            skipped += 1
+            continue
+
+        if args.time:
+            # Back to CLOCK_MONOTONIC, as in the trace of trace.h
+            time_ns = ns0 + int((stamp - stamp0) / stamps_per_ns)
+            sys.stdout.write(f"{time_ns} {text}")
+        else:
+            sys.stdout.write(text)
+        offset += length
+
+    if skipped:
+        print(f"warning: skipped {skipped} bytes that were not a record", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+"""Extract the binlog format dictionary from a binary.
+
+Every binlogPRINT() call (see binlog.h) places its format string in the
+"binlog" section, and its offset in that section is the message id.  This
+reads the section from the ELF file and writes the id to format mapping as
+JSON, for binlog_decode.py.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+
+def read_section(path, wanted):
+    with open(path, "rb") as binary:
+        data = binary.read()
+
+    if data[:4] != b"\x7fELF":
+        raise SystemExit(f"{path} is not an ELF file")
+    if data[4] != 2 or data[5] != 1:
+        raise SystemExit(f"{path}: only 64-bit little-endian ELF is supported")
+
+    section_offset, = struct.unpack_from("<Q", data, 0x28)
+    entry_size, count, names_index = struct.unpack_from("<HHH", data, 0x3A)
+
+    def header(index):
+        # sh_name, sh_type, sh_flags, sh_addr, sh_offset, sh_size
+        return struct.unpack_from("<IIQQQQ", data, section_offset + index * entry_size)
+
+    names = header(names_index)
+    for index in range(count):
+        name_offset, kind, _, _, offset, size = header(index)
+        start = names[4] + name_offset
+        name = data[start:data.index(b"\0", start)].decode()
+        if name == wanted:
+            # SHT_NOBITS would have no contents in the file
+            return data[offset:offset + size] if kind != 8 else b""
+
+    raise SystemExit(f"{path} has no {wanted} section: no binlogPRINT() was linked in")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("binary", help="executable built with binlog.c")
+    parser.add_argument("--section", default="binlog")
+    args = parser.parse_args()
+
+    section = read_section(args.binary, args.section)
+    formats = {}
+    offset = 0
+    while offset < len(section):
+        end = section.index(b"\0", offset)
+        formats[str(offset)] = section[offset:end].decode("utf-8", "replace")
+        offset = end + 1
+
+    json.dump({"section_size": len(section), "formats": formats}, sys.stdout, indent=2)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+"""Generate ipsa_budgets.h, the measured WCET budgets of the task set.
+
+Reads the per-task distributions written by trace_jobs.py and writes, for
+every task found there, its WCET budget in microseconds: the largest net
+execution time observed, times a safety margin, rounded up.  ipsa_tasks.h
+includes the header when it exists, in place of the declared budgets, and
+ipsa_check.h then verifies at compile time that the set is still
+schedulable with them.
+"""
+
+import argparse
+import json
+import math
+
+MACROS = {
+    "TX1": "TASK1_WCET_US",
+    "TX2": "TASK2_WCET_US",
+    "TX3": "TASK3_WCET_US",
+    "TX4": "TASK4_WCET_US",
+    "Aperiodic": "APERIODIC_TASK_WCET_US",
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("insitu", help="insitu_wcet.json from trace_jobs.py")
+    parser.add_argument("--margin", type=float, default=1.2, help="factor applied to the observed maximum")
+    parser.add_argument("--output", default="ipsa_budgets.h")
+    args = parser.parse_args()
+
+    with open(args.insitu) as insitu_file:
+        insitu = json.load(insitu_file)
+
+    lines = [
+        "/*",
+        f" * Generated by budget_gen.py from {args.insitu}, margin {args.margin:g}.",
+        " * Do not edit: regenerate, or delete the file to use the budgets declared",
+        " * in ipsa_tasks.h.",
+        " */",
+        "",
+        "#ifndef IPSA_BUDGETS_H",
+        "#define IPSA_BUDGETS_H",
+        "",
+    ]
+
+    for task, macro in MACROS.items():
+        if task not in insitu:
+            print(f"{task}: not in {args.insitu}, keeps its declared budget")
+            continue
+        observed = insitu[task]["net_us"]["max"]
+        budget = max(1, math.ceil(observed * args.margin))
+        lines.append(f"#define {macro:<26} ({budget})")
+        print(f"{task}: observed {observed:,.1f} us over {insitu[task]['jobs']} jobs, budget {budget} us")
+
+    lines += ["", "#endif /* IPSA_BUDGETS_H */", ""]
+
+    with open(args.output, "w") as output:
+        output.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,344 @@
+/*
+ * Cache hierarchy and TLB simulator.  See cachesim.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Local includes. */
+#include "cachesim.h"
+
+/*-----------------------------------------------------------*/
+
+/* A size with an optional K or M suffix. */
+static int prvParseSize(const char *pcText, uint32_t *pulSize)
+{
+    char *pcEnd;
+    unsigned long ulValue = strtoul(pcText, &pcEnd, 10);
+
+    if (pcEnd == pcText)
+    {
+        return -1;
+    }
+
+    if ((*pcEnd == 'K') || (*pcEnd == 'k'))
+    {
+        ulValue *= 1024;
+    }
+    else if ((*pcEnd == 'M') || (*pcEnd == 'm'))
+    {
+        ulValue *= 1024 * 1024;
+    }
+
+    *pulSize = (uint32_t)ulValue;
+
+    return (ulValue > 0) ? 0 : -1;
+}
+
+static int prvSetUp(CacheLevel_t *pxLevel)
+{
+    if ((pxLevel->ulWays == 0) || (pxLevel->ulLine == 0) ||
+        ((pxLevel->ulLine & (pxLevel->ulLine - 1)) != 0))
+    {
+        return -1;
+    }
+
+    pxLevel->ulSets = pxLevel->ulSize / (pxLevel->ulWays * pxLevel->ulLine);
+
+    if ((pxLevel->ulSets == 0) || (pxLevel->ulSets * pxLevel->ulWays * pxLevel->ulLine != pxLevel->ulSize))
+    {
+        return -1;
+    }
+
+    pxLevel->pullTags = calloc((size_t)pxLevel->ulSets * pxLevel->ulWays, sizeof(uint64_t));
+    pxLevel->pullAge = calloc((size_t)pxLevel->ulSets * pxLevel->ulWays, sizeof(uint64_t));
+
+    return ((pxLevel->pullTags != NULL) && (pxLevel->pullAge != NULL)) ? 0 : -1;
+}
+
+/* size:ways:line:policy:latency */
+static int prvParseLevel(CacheLevel_t *pxLevel, const char *pcName, char *pcFields)
+{
+    char *pcField[5];
+    uint32_t ulFields = 0;
+
+    for (char *pcToken = strtok(pcFields, ":"); (pcToken != NULL) && (ulFields < 5); pcToken = strtok(NULL, ":"))
+    {
+        pcField[ulFields++] = pcToken;
+    }
+
+    if (ulFields != 5)
+    {
+        return -1;
+    }
+
+    snprintf(pxLevel->cName, sizeof(pxLevel->cName), "%s", pcName);
+
+    if ((prvParseSize(pcField[0], &pxLevel->ulSize) != 0) || (prvParseSize(pcField[2], &pxLevel->ulLine) != 0))
+    {
+        return -1;
+    }
+
+    pxLevel->ulWays = (uint32_t)strtoul(pcField[1], NULL, 10);
+    pxLevel->ulLatency = (uint32_t)strtoul(pcField[4], NULL, 10);
+
+    if (strcasecmp(pcField[3], "lru") == 0)
+    {
+        pxLevel->ePolicy = eCacheLru;
+    }
+    else if (strcasecmp(pcField[3], "plru") == 0)
+    {
+        pxLevel->ePolicy = eCachePlru;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return prvSetUp(pxLevel);
+}
+
+/* entries:ways:page:penalty, an LRU cache of pages. */
+static int prvParseTlb(CacheLevel_t *pxTlb, char *pcFields)
+{
+    char *pcField[4];
+    uint32_t ulFields = 0;
+    uint32_t ulEntries;
+
+    for (char *pcToken = strtok(pcFields, ":"); (pcToken != NULL) && (ulFields < 4); pcToken = strtok(NULL, ":"))
+    {
+        pcField[ulFields++] = pcToken;
+    }
+
+    if ((ulFields != 4) || (prvParseSize(pcField[0], &ulEntries) != 0) ||
+        (prvParseSize(pcField[2], &pxTlb->ulLine) != 0))
+    {
+        return -1;
+    }
+
+    snprintf(pxTlb->cName, sizeof(pxTlb->cName), "TLB");
+    pxTlb->ulWays = (uint32_t)strtoul(pcField[1], NULL, 10);
+    pxTlb->ulLatency = (uint32_t)strtoul(pcField[3], NULL, 10);
+    pxTlb->ulSize = ulEntries * pxTlb->ulLine;
+    pxTlb->ePolicy = eCacheLru;
+
+    return prvSetUp(pxTlb);
+}
+
+/* 1 on a hit.  A miss replaces the victim of the set with the block. */
+static int prvLookup(CacheSim_t *pxSim, CacheLevel_t *pxLevel, uint64_t ullBlock)
+{
+    uint32_t ulSet = (uint32_t)(ullBlock % pxLevel->ulSets);
+    uint64_t *pullTags = &pxLevel->pullTags[(size_t)ulSet * pxLevel->ulWays];
+    uint64_t *pullAge = &pxLevel->pullAge[(size_t)ulSet * pxLevel->ulWays];
+    uint64_t ullTag = ullBlock + 1;
+    uint32_t ulWay = pxLevel->ulWays;
+    uint32_t ulVictim = 0;
+    int iHit;
+
+    for (uint32_t w = 0; w < pxLevel->ulWays; w++)
+    {
+        if (pullTags[w] == ullTag)
+        {
+            ulWay = w;
+            break;
+        }
+    }
+
+    iHit = (ulWay < pxLevel->ulWays);
+
+    if (!iHit)
+    {
+        // Invalid ways first, then the least recently used (or first MRU bit clear)
+        for (uint32_t w = 0; w < pxLevel->ulWays; w++)
+        {
+            if (pullTags[w] == 0)
+            {
+                ulVictim = w;
+                break;
+            }
+
+            if ((pxLevel->ePolicy == eCachePlru) ? (pullAge[w] == 0) : (pullAge[w] < pullAge[ulVictim]))
+            {
+                ulVictim = w;
+
+                if (pxLevel->ePolicy == eCachePlru)
+                {
+                    break;
+                }
+            }
+        }
+
+        ulWay = ulVictim;
+        pullTags[ulWay] = ullTag;
+        pxLevel->ullMisses++;
+    }
+    else
+    {
+        pxLevel->ullHits++;
+    }
+
+    if (pxLevel->ePolicy == eCacheLru)
+    {
+        pullAge[ulWay] = ++pxSim->ullStamp;
+    }
+    else
+    {
+        uint32_t ulSet = 0;
+
+        pullAge[ulWay] = 1;
+
+        for (uint32_t w = 0; w < pxLevel->ulWays; w++)
+        {
+            ulSet += (pullAge[w] != 0);
+        }
+
+        // All bits set: start a new round with only this way marked
+        if (ulSet == pxLevel->ulWays)
+        {
+            memset(pullAge, 0, sizeof(uint64_t) * pxLevel->ulWays);
+            pullAge[ulWay] = 1;
+        }
+    }
+
+    return iHit;
+}
+
+/*-----------------------------------------------------------*/
+
+int xCacheSimParse(CacheSim_t *pxSim, const char *pcSpec)
+{
+    char *pcCopy = strdup(pcSpec);
+    char *pcSave = NULL;
+    char *pcItem;
+    int iResult = 0;
+
+    memset(pxSim, 0, sizeof(*pxSim));
+
+    if (pcCopy == NULL)
+    {
+        return -1;
+    }
+
+    pcItem = strtok_r(pcCopy, ",", &pcSave);
+    snprintf(pxSim->cName, sizeof(pxSim->cName), "%s", (pcItem != NULL) ? pcItem : "");
+
+    while ((iResult == 0) && ((pcItem = strtok_r(NULL, ",", &pcSave)) != NULL))
+    {
+        char *pcValue = strchr(pcItem, '=');
+
+        if (pcValue == NULL)
+        {
+            iResult = -1;
+            break;
+        }
+
+        *pcValue++ = '\0';
+
+        if (strcasecmp(pcItem, "MEM") == 0)
+        {
+            pxSim->ulMemoryLatency = (uint32_t)strtoul(pcValue, NULL, 10);
+        }
+        else if (strcasecmp(pcItem, "TLB") == 0)
+        {
+            iResult = prvParseTlb(&pxSim->xTlb, pcValue);
+            pxSim->iHasTlb = 1;
+        }
+        else if ((pcItem[0] == 'L') && (pxSim->ulLevels < cachesimMAX_LEVELS))
+        {
+            iResult = prvParseLevel(&pxSim->xLevels[pxSim->ulLevels++], pcItem, pcValue);
+        }
+        else
+        {
+            iResult = -1;
+        }
+    }
+
+    free(pcCopy);
+
+    if ((iResult != 0) || (pxSim->ulLevels == 0))
+    {
+        vCacheSimFree(pxSim);
+        return -1;
+    }
+
+    return 0;
+}
+
+void vCacheSimFree(CacheSim_t *pxSim)
+{
+    for (uint32_t i = 0; i < cachesimMAX_LEVELS; i++)
+    {
+        free(pxSim->xLevels[i].pullTags);
+        free(pxSim->xLevels[i].pullAge);
+    }
+
+    free(pxSim->xTlb.pullTags);
+    free(pxSim->xTlb.pullAge);
+    memset(pxSim, 0, sizeof(*pxSim));
+}
+
+void vCacheSimFlush(CacheSim_t *pxSim)
+{
+    for (uint32_t i = 0; i < pxSim->ulLevels; i++)
+    {
+        CacheLevel_t *pxLevel = &pxSim->xLevels[i];
+
+        memset(pxLevel->pullTags, 0, sizeof(uint64_t) * pxLevel->ulSets * pxLevel->ulWays);
+        memset(pxLevel->pullAge, 0, sizeof(uint64_t) * pxLevel->ulSets * pxLevel->ulWays);
+    }
+
+    if (pxSim->iHasTlb)
+    {
+        memset(pxSim->xTlb.pullTags, 0, sizeof(uint64_t) * pxSim->xTlb.ulSets * pxSim->xTlb.ulWays);
+        memset(pxSim->xTlb.pullAge, 0, sizeof(uint64_t) * pxSim->xTlb.ulSets * pxSim->xTlb.ulWays);
+    }
+}
+
+void vCacheSimClearStats(CacheSim_t *pxSim)
+{
+    for (uint32_t i = 0; i < pxSim->ulLevels; i++)
+    {
+        pxSim->xLevels[i].ullHits = 0;
+        pxSim->xLevels[i].ullMisses = 0;
+    }
+
+    pxSim->xTlb.ullHits = 0;
+    pxSim->xTlb.ullMisses = 0;
+    pxSim->ullAccesses = 0;
+    pxSim->ullCycles = 0;
+}
+
+void vCacheSimAccess(CacheSim_t *pxSim, uintptr_t uxAddress, uint32_t ulSize)
+{
+    uint32_t ulLine = pxSim->xLevels[0].ulLine;
+    uintptr_t uxLast = uxAddress + ((ulSize > 0) ? ulSize - 1 : 0);
+
+    for (uintptr_t uxLine = uxAddress & ~(uintptr_t)(ulLine - 1); uxLine <= uxLast; uxLine += ulLine)
+    {
+        uint32_t ulCycles = pxSim->ulMemoryLatency;
+
+        pxSim->ullAccesses++;
+
+        if (pxSim->iHasTlb && !prvLookup(pxSim, &pxSim->xTlb, uxLine / pxSim->xTlb.ulLine))
+        {
+            pxSim->ullCycles += pxSim->xTlb.ulLatency;
+        }
+
+        // The first level that hits serves the access; those above it are filled
+        for (uint32_t i = 0; i < pxSim->ulLevels; i++)
+        {
+            CacheLevel_t *pxLevel = &pxSim->xLevels[i];
+
+            if (prvLookup(pxSim, pxLevel, uxLine / pxLevel->ulLine))
+            {
+                ulCycles = pxLevel->ulLatency;
+                break;
+            }
+        }
+
+        pxSim->ullCycles += ulCycles;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Set-associative cache hierarchy and TLB simulator, driven by an address
+ * trace (see wcet_cache.c).
+ *
+ * A configuration is a list of cache levels, from L1 down, an optional TLB
+ * and the memory latency, e.g.
+ *
+ *     a53,L1=32K:4:64:lru:3,L2=512K:16:64:plru:15,TLB=512:4:4K:20,MEM=150
+ *
+ * A level is size:ways:line:policy:latency, a TLB entries:ways:page:penalty,
+ * all latencies in cycles.  Policies are lru and plru, the MRU-bit pseudo
+ * LRU that works with any number of ways.  Levels are non-exclusive and
+ * write-allocate: a miss fills every level it went through, and stores are
+ * looked up like loads.  An access costs the latency of the level it hits
+ * (the memory latency if it misses everywhere) plus the TLB penalty on a TLB
+ * miss; an access that spans lines is one access per line.
+ */
+
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stdint.h>
+
+#define cachesimMAX_LEVELS     ( 4 )
+#define cachesimNAME_LENGTH    ( 32 )
+
+typedef enum
+{
+    eCacheLru,
+    eCachePlru
+} CachePolicy_t;
+
+typedef struct CacheLevel
+{
+    char cName[8];
+    uint32_t ulSize;
+    uint32_t ulWays;
+    uint32_t ulLine;                 /* Page size for a TLB. */
+    CachePolicy_t ePolicy;
+    uint32_t ulLatency;              /* Hit latency, miss penalty for a TLB. */
+
+    uint32_t ulSets;
+    uint64_t *pullTags;              /* sets x ways, 0 is invalid. */
+    uint64_t *pullAge;               /* LRU stamp, or MRU bit for plru. */
+    uint64_t ullHits;
+    uint64_t ullMisses;
+} CacheLevel_t;
+
+typedef struct CacheSim
+{
+    char cName[cachesimNAME_LENGTH];
+    CacheLevel_t xLevels[cachesimMAX_LEVELS];
+    uint32_t ulLevels;
+    CacheLevel_t xTlb;
+    int iHasTlb;
+    uint32_t ulMemoryLatency;
+
+    uint64_t ullStamp;
+    uint64_t ullAccesses;
+    uint64_t ullCycles;
+} CacheSim_t;
+
+/* Parse a configuration and allocate its state.  0, or -1 if it is malformed. */
+int xCacheSimParse(CacheSim_t *pxSim, const char *pcSpec);
+void vCacheSimFree(CacheSim_t *pxSim);
+
+/* Invalidate every level and the TLB, e.g. for a job released cold. */
+void vCacheSimFlush(CacheSim_t *pxSim);
+void vCacheSimClearStats(CacheSim_t *pxSim);
+
+void vCacheSimAccess(CacheSim_t *pxSim, uintptr_t uxAddress, uint32_t ulSize);
+
+#endif /* CACHESIM_H */
@@ -0,0 +1,322 @@
+/*
+ * Precomputed hyperperiod release calendar.  See calendar.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Local includes. */
+#include "calendar.h"
+
+/* Next release of one task, in the merge heap. */
+typedef struct CalendarRelease
+{
+    uint64_t ullTime;
+    uint32_t ulTask;
+} CalendarRelease_t;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGcd(uint64_t ullA, uint64_t ullB)
+{
+    while (ullB != 0)
+    {
+        uint64_t ullRest = ullA % ullB;
+
+        ullA = ullB;
+        ullB = ullRest;
+    }
+
+    return ullA;
+}
+
+uint32_t ulCalendarHyperperiod(const uint32_t *pulPeriods, uint32_t ulTasks)
+{
+    uint64_t ullLcm = 1;
+
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        if (pulPeriods[i] == 0)
+        {
+            return 0;
+        }
+
+        ullLcm = ullLcm / prvGcd(ullLcm, pulPeriods[i]) * pulPeriods[i];
+
+        if (ullLcm > UINT32_MAX)
+        {
+            return 0;
+        }
+    }
+
+    return (uint32_t)ullLcm;
+}
+
+int xCalendarIsHarmonic(const uint32_t *pulPeriods, uint32_t ulTasks)
+{
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        for (uint32_t j = 0; j < ulTasks; j++)
+        {
+            if ((pulPeriods[i] <= pulPeriods[j]) && (pulPeriods[j] % pulPeriods[i] != 0))
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* Binary min-heap on (time, task): equal times come out in task order. */
+static int prvBefore(const CalendarRelease_t *pxA, const CalendarRelease_t *pxB)
+{
+    return (pxA->ullTime < pxB->ullTime) || ((pxA->ullTime == pxB->ullTime) && (pxA->ulTask < pxB->ulTask));
+}
+
+static void prvSiftDown(CalendarRelease_t *pxHeap, uint32_t ulCount, uint32_t ulIndex)
+{
+    for (;;)
+    {
+        uint32_t ulLeft = 2 * ulIndex + 1;
+        uint32_t ulSmallest = ulIndex;
+        CalendarRelease_t xSwap;
+
+        if ((ulLeft < ulCount) && prvBefore(&pxHeap[ulLeft], &pxHeap[ulSmallest]))
+        {
+            ulSmallest = ulLeft;
+        }
+
+        if ((ulLeft + 1 < ulCount) && prvBefore(&pxHeap[ulLeft + 1], &pxHeap[ulSmallest]))
+        {
+            ulSmallest = ulLeft + 1;
+        }
+
+        if (ulSmallest == ulIndex)
+        {
+            return;
+        }
+
+        xSwap = pxHeap[ulIndex];
+        pxHeap[ulIndex] = pxHeap[ulSmallest];
+        pxHeap[ulSmallest] = xSwap;
+        ulIndex = ulSmallest;
+    }
+}
+
+int xCalendarBuild(Calendar_t *pxCalendar, const uint32_t *pulPeriods, const uint32_t *pulOffsets, uint32_t ulTasks)
+{
+    uint32_t ulHyperperiod = ulCalendarHyperperiod(pulPeriods, ulTasks);
+    uint32_t ulWords = (ulTasks + 31) / 32;
+    uint64_t ullReleases = 0;
+    CalendarRelease_t *pxHeap;
+    uint32_t *pulMasks;
+    CalendarHeader_t *pxHeader;
+    CalendarEntry_t *pxEntries;
+    uint32_t ulEntries = 0;
+    void *pvShrunk;
+
+    memset(pxCalendar, 0, sizeof(*pxCalendar));
+
+    if ((ulTasks == 0) || (ulTasks > calendarMAX_TASKS))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ulHyperperiod == 0)
+    {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        if ((pulOffsets != NULL) && (pulOffsets[i] >= pulPeriods[i]))
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        ullReleases += ulHyperperiod / pulPeriods[i];
+    }
+
+    // Every release instant takes at most one entry per released task
+    if (ullReleases > UINT32_MAX)
+    {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    pxHeap = malloc(sizeof(CalendarRelease_t) * ulTasks);
+    pulMasks = calloc(ulWords, sizeof(uint32_t));
+    pxHeader = malloc(sizeof(CalendarHeader_t) + sizeof(CalendarEntry_t) * (size_t)ullReleases);
+
+    if ((pxHeap == NULL) || (pulMasks == NULL) || (pxHeader == NULL))
+    {
+        free(pxHeap);
+        free(pulMasks);
+        free(pxHeader);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pxEntries = (CalendarEntry_t *)(pxHeader + 1);
+
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        pxHeap[i].ullTime = (pulOffsets != NULL) ? pulOffsets[i] : 0;
+        pxHeap[i].ulTask = i;
+    }
+
+    for (uint32_t i = ulTasks / 2; i-- > 0;)
+    {
+        prvSiftDown(pxHeap, ulTasks, i);
+    }
+
+    // Merge the task streams: all releases at one instant become its entries
+    while (pxHeap[0].ullTime < ulHyperperiod)
+    {
+        uint32_t ulTime = (uint32_t)pxHeap[0].ullTime;
+
+        while (pxHeap[0].ullTime == ulTime)
+        {
+            uint32_t ulTask = pxHeap[0].ulTask;
+
+            pulMasks[ulTask / 32] |= 1UL << (ulTask % 32);
+            pxHeap[0].ullTime += pulPeriods[ulTask];
+            prvSiftDown(pxHeap, ulTasks, 0);
+        }
+
+        for (uint32_t w = 0; w < ulWords; w++)
+        {
+            if (pulMasks[w] != 0)
+            {
+                pxEntries[ulEntries].ulTime = ulTime;
+                pxEntries[ulEntries].usWord = (uint16_t)w;
+                pxEntries[ulEntries].usSpare = 0;
+                pxEntries[ulEntries].ulMask = pulMasks[w];
+                ulEntries++;
+                pulMasks[w] = 0;
+            }
+        }
+    }
+
+    free(pxHeap);
+    free(pulMasks);
+
+    pxHeader->ulMagic = calendarMAGIC;
+    pxHeader->usVersion = calendarVERSION;
+    pxHeader->usWords = (uint16_t)ulWords;
+    pxHeader->ulTasks = ulTasks;
+    pxHeader->ulHyperperiod = ulHyperperiod;
+    pxHeader->ulEntries = ulEntries;
+    pxHeader->ulReleases = (uint32_t)ullReleases;
+
+    pxCalendar->xSize = sizeof(CalendarHeader_t) + sizeof(CalendarEntry_t) * ulEntries;
+    pvShrunk = realloc(pxHeader, pxCalendar->xSize);
+    pxHeader = (pvShrunk != NULL) ? pvShrunk : pxHeader;
+
+    pxCalendar->pvStorage = pxHeader;
+    pxCalendar->pxHeader = pxHeader;
+    pxCalendar->pxEntries = (const CalendarEntry_t *)(pxHeader + 1);
+    pxCalendar->iMapped = 0;
+
+    return 0;
+}
+
+int xCalendarWrite(const Calendar_t *pxCalendar, const char *pcPath)
+{
+    FILE *pxFile = fopen(pcPath, "wb");
+    size_t xWritten;
+
+    if (pxFile == NULL)
+    {
+        return -1;
+    }
+
+    xWritten = fwrite(pxCalendar->pvStorage, 1, pxCalendar->xSize, pxFile);
+
+    if ((fclose(pxFile) != 0) || (xWritten != pxCalendar->xSize))
+    {
+        errno = (errno != 0) ? errno : EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+int xCalendarMap(Calendar_t *pxCalendar, const char *pcPath)
+{
+    struct stat xStat;
+    const CalendarHeader_t *pxHeader;
+    void *pvMap;
+    int iFd = open(pcPath, O_RDONLY | O_CLOEXEC);
+
+    memset(pxCalendar, 0, sizeof(*pxCalendar));
+
+    if (iFd < 0)
+    {
+        return -1;
+    }
+
+    if ((fstat(iFd, &xStat) != 0) || ((size_t)xStat.st_size < sizeof(CalendarHeader_t)))
+    {
+        close(iFd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    pvMap = mmap(NULL, (size_t)xStat.st_size, PROT_READ, MAP_SHARED, iFd, 0);
+    close(iFd);
+
+    if (pvMap == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    pxHeader = (const CalendarHeader_t *)pvMap;
+
+    // A file from another build or truncated is refused, not walked
+    if ((pxHeader->ulMagic != calendarMAGIC) || (pxHeader->usVersion != calendarVERSION) ||
+        (pxHeader->ulEntries == 0) || ((size_t)xStat.st_size != sizeof(CalendarHeader_t) +
+                                       sizeof(CalendarEntry_t) * (size_t)pxHeader->ulEntries))
+    {
+        munmap(pvMap, (size_t)xStat.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    pxCalendar->pvStorage = pvMap;
+    pxCalendar->pxHeader = pxHeader;
+    pxCalendar->pxEntries = (const CalendarEntry_t *)(pxHeader + 1);
+    pxCalendar->xSize = (size_t)xStat.st_size;
+    pxCalendar->iMapped = 1;
+
+    return 0;
+}
+
+void vCalendarFree(Calendar_t *pxCalendar)
+{
+    if (pxCalendar->pvStorage == NULL)
+    {
+        return;
+    }
+
+    if (pxCalendar->iMapped)
+    {
+        munmap(pxCalendar->pvStorage, pxCalendar->xSize);
+    }
+    else
+    {
+        free(pxCalendar->pvStorage);
+    }
+
+    memset(pxCalendar, 0, sizeof(*pxCalendar));
+}
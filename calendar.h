@@ -0,0 +1,109 @@
+/*
+ * Precomputed release calendar of a periodic task set over its hyperperiod.
+ *
+ * The calendar is a sorted array of (time, task mask) entries: every instant
+ * at which at least one task is released, with one bit per released task.
+ * Task i is bit i % 32 of the entry whose word is i / 32, so sets of more
+ * than 32 tasks take one entry per non-empty word at an instant.  A single
+ * dispatcher walks the array with one timer and wraps around at the end of
+ * the hyperperiod: finding the next release is O(1), where per-task timers
+ * pay a sorted insertion for every job.
+ *
+ * The calendar is built at startup (xCalendarBuild) or once at build time
+ * and written to a file (xCalendarWrite) that is then mmap'd read-only
+ * (xCalendarMap), header and entries as laid out below, in host byte order.
+ * Its size is the number of distinct release instants in the hyperperiod:
+ * small when the periods are harmonic (the hyperperiod is the longest
+ * period), large when they are not, see calendar_bench.c.
+ */
+
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define calendarMAGIC        ( 0x52444C43UL )  /* "CLDR" */
+#define calendarVERSION      ( 1 )
+#define calendarMAX_TASKS    ( 65536 )
+
+typedef struct CalendarHeader
+{
+    uint32_t ulMagic;
+    uint16_t usVersion;
+    uint16_t usWords;                /* Mask words per instant, (tasks + 31) / 32. */
+    uint32_t ulTasks;
+    uint32_t ulHyperperiod;          /* In the unit of the periods, e.g. ticks. */
+    uint32_t ulEntries;
+    uint32_t ulReleases;             /* Jobs released per hyperperiod. */
+} CalendarHeader_t;
+
+typedef struct CalendarEntry
+{
+    uint32_t ulTime;                 /* Offset in the hyperperiod. */
+    uint16_t usWord;
+    uint16_t usSpare;
+    uint32_t ulMask;
+} CalendarEntry_t;
+
+typedef struct Calendar
+{
+    const CalendarHeader_t *pxHeader;
+    const CalendarEntry_t *pxEntries;
+    void *pvStorage;
+    size_t xSize;
+    int iMapped;
+} Calendar_t;
+
+/* Position of a dispatcher in the calendar. */
+typedef struct CalendarCursor
+{
+    const Calendar_t *pxCalendar;
+    uint32_t ulIndex;
+    uint64_t ullBase;                /* Start of the current hyperperiod. */
+} CalendarCursor_t;
+
+/* Least common multiple of the periods, 0 if it does not fit in 32 bits. */
+uint32_t ulCalendarHyperperiod(const uint32_t *pulPeriods, uint32_t ulTasks);
+
+/* 1 if every period divides every longer one. */
+int xCalendarIsHarmonic(const uint32_t *pulPeriods, uint32_t ulTasks);
+
+/*
+ * Build the calendar of the tasks, released first at their offset (NULL for
+ * all at 0, an offset must be below the period).  Returns 0, or -1 with
+ * errno EOVERFLOW if the hyperperiod does not fit, EINVAL or ENOMEM.
+ */
+int xCalendarBuild(Calendar_t *pxCalendar, const uint32_t *pulPeriods, const uint32_t *pulOffsets, uint32_t ulTasks);
+
+/* Save a calendar, and map a saved one read-only.  0 or -1 with errno. */
+int xCalendarWrite(const Calendar_t *pxCalendar, const char *pcPath);
+int xCalendarMap(Calendar_t *pxCalendar, const char *pcPath);
+
+void vCalendarFree(Calendar_t *pxCalendar);
+
+static inline void vCalendarStart(CalendarCursor_t *pxCursor, const Calendar_t *pxCalendar, uint64_t ullBase)
+{
+    pxCursor->pxCalendar = pxCalendar;
+    pxCursor->ulIndex = 0;
+    pxCursor->ullBase = ullBase;
+}
+
+/* The next entry and its absolute time; wraps at the end of the hyperperiod. */
+static inline const CalendarEntry_t *pxCalendarNext(CalendarCursor_t *pxCursor, uint64_t *pullTime)
+{
+    const CalendarHeader_t *pxHeader = pxCursor->pxCalendar->pxHeader;
+    const CalendarEntry_t *pxEntry = &pxCursor->pxCalendar->pxEntries[pxCursor->ulIndex];
+
+    *pullTime = pxCursor->ullBase + pxEntry->ulTime;
+
+    if (++pxCursor->ulIndex == pxHeader->ulEntries)
+    {
+        pxCursor->ulIndex = 0;
+        pxCursor->ullBase += pxHeader->ulHyperperiod;
+    }
+
+    return pxEntry;
+}
+
+#endif /* CALENDAR_H */
@@ -0,0 +1,262 @@
+/*
+ * Tick-time cost of releasing jobs from the release calendar (calendar.h)
+ * against per-task timers.
+ *
+ * Both models are driven tick by tick over the same span:
+ *
+ *   timers    each task sits in a delayed list sorted by wake time, as the
+ *             FreeRTOS delayed list is: the tick pops the tasks that are due
+ *             and every released task is inserted back at its next release,
+ *             walking the list from the head;
+ *   calendar  the tick compares the time of the next calendar entry and, if
+ *             it is due, walks its mask.
+ *
+ * Three task sets are measured: the ipsa_sched set of ipsa_tasks.h, and
+ * --tasks N synthetic tasks with harmonic and with non-harmonic periods.
+ * The report gives the calendar size, the cost per tick and per release of
+ * each model, and checks that both released the same jobs.  --write saves
+ * the ipsa_sched calendar, --map walks a saved one instead of building it.
+ *
+ *     gcc -O2 calendar_bench.c calendar.c -o calendar_bench
+ *     ./calendar_bench --tasks 256 --write ipsa_calendar.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* Local includes. */
+#include "ipsa_tasks.h"
+#include "calendar.h"
+
+#define calendarbenchTICKS          ( 20000000ULL )
+#define calendarbenchDEFAULT_TASKS  ( 256 )
+
+/* Delayed list node of one task. */
+typedef struct BenchTimer
+{
+    struct BenchTimer *pxNext;
+    uint64_t ullWake;
+    uint32_t ulPeriod;
+} BenchTimer_t;
+
+typedef struct BenchResult
+{
+    uint64_t ullNs;
+    uint64_t ullReleases;
+    uint64_t ullChecksum;
+} BenchResult_t;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvInsert(BenchTimer_t **ppxHead, BenchTimer_t *pxTimer)
+{
+    BenchTimer_t **ppxLink = ppxHead;
+
+    // Equal wake times keep their insertion order, as vListInsert() does
+    while ((*ppxLink != NULL) && ((*ppxLink)->ullWake <= pxTimer->ullWake))
+    {
+        ppxLink = &(*ppxLink)->pxNext;
+    }
+
+    pxTimer->pxNext = *ppxLink;
+    *ppxLink = pxTimer;
+}
+
+static BenchResult_t prvRunTimers(const uint32_t *pulPeriods, uint32_t ulTasks, uint64_t ullTicks)
+{
+    BenchTimer_t *pxTimers = calloc(ulTasks, sizeof(BenchTimer_t));
+    BenchTimer_t *pxHead = NULL;
+    BenchResult_t xResult = { 0 };
+    uint64_t ullStart;
+
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        pxTimers[i].ulPeriod = pulPeriods[i];
+        prvInsert(&pxHead, &pxTimers[i]);
+    }
+
+    ullStart = prvNowNs();
+
+    for (uint64_t t = 0; t < ullTicks; t++)
+    {
+        while ((pxHead != NULL) && (pxHead->ullWake <= t))
+        {
+            BenchTimer_t *pxTimer = pxHead;
+
+            pxHead = pxTimer->pxNext;
+            xResult.ullReleases++;
+            xResult.ullChecksum += (uint64_t)(pxTimer - pxTimers) * t;
+
+            pxTimer->ullWake += pxTimer->ulPeriod;
+            prvInsert(&pxHead, pxTimer);
+        }
+    }
+
+    xResult.ullNs = prvNowNs() - ullStart;
+    free(pxTimers);
+
+    return xResult;
+}
+
+static BenchResult_t prvRunCalendar(const Calendar_t *pxCalendar, uint64_t ullTicks)
+{
+    CalendarCursor_t xCursor;
+    BenchResult_t xResult = { 0 };
+    uint64_t ullNext;
+    const CalendarEntry_t *pxEntry;
+    uint64_t ullStart;
+
+    vCalendarStart(&xCursor, pxCalendar, 0);
+    pxEntry = pxCalendarNext(&xCursor, &ullNext);
+    ullStart = prvNowNs();
+
+    for (uint64_t t = 0; t < ullTicks; t++)
+    {
+        while (ullNext <= t)
+        {
+            uint32_t ulMask = pxEntry->ulMask;
+
+            while (ulMask != 0)
+            {
+                uint32_t ulTask = (uint32_t)pxEntry->usWord * 32 + (uint32_t)__builtin_ctz(ulMask);
+
+                ulMask &= ulMask - 1;
+                xResult.ullReleases++;
+                xResult.ullChecksum += (uint64_t)ulTask * t;
+            }
+
+            pxEntry = pxCalendarNext(&xCursor, &ullNext);
+        }
+    }
+
+    xResult.ullNs = prvNowNs() - ullStart;
+
+    return xResult;
+}
+
+static void prvCompare(const char *pcName, const uint32_t *pulPeriods, uint32_t ulTasks, const char *pcMap,
+                       const char *pcWrite)
+{
+    Calendar_t xCalendar;
+    BenchResult_t xTimers, xCalendarResult;
+    uint64_t ullTicks = calendarbenchTICKS;
+    int iResult;
+
+    if (pcMap != NULL)
+    {
+        iResult = xCalendarMap(&xCalendar, pcMap);
+
+        if ((iResult == 0) && (xCalendar.pxHeader->ulTasks != ulTasks))
+        {
+            vCalendarFree(&xCalendar);
+            errno = EINVAL;
+            iResult = -1;
+        }
+    }
+    else
+    {
+        iResult = xCalendarBuild(&xCalendar, pulPeriods, NULL, ulTasks);
+    }
+
+    if (iResult != 0)
+    {
+        printf("%-12s no calendar: %s\n", pcName, strerror(errno));
+        return;
+    }
+
+    if ((pcWrite != NULL) && (xCalendarWrite(&xCalendar, pcWrite) != 0))
+    {
+        printf("%-12s cannot write %s: %s\n", pcName, pcWrite, strerror(errno));
+    }
+
+    xTimers = prvRunTimers(pulPeriods, ulTasks, ullTicks);
+    xCalendarResult = prvRunCalendar(&xCalendar, ullTicks);
+
+    printf("%-12s tasks=%u harmonic=%s hyperperiod=%u entries=%u (%.1f KiB%s)\n", pcName, (unsigned)ulTasks,
+           xCalendarIsHarmonic(pulPeriods, ulTasks) ? "yes" : "no", (unsigned)xCalendar.pxHeader->ulHyperperiod,
+           (unsigned)xCalendar.pxHeader->ulEntries, (double)xCalendar.xSize / 1024.0, xCalendar.iMapped ? ", mapped" : "");
+    printf("%-12s timers   %7.2f ns/tick %8.2f ns/release\n", "", (double)xTimers.ullNs / (double)ullTicks,
+           (double)xTimers.ullNs / (double)(xTimers.ullReleases ? xTimers.ullReleases : 1));
+    printf("%-12s calendar %7.2f ns/tick %8.2f ns/release, %s releases (%llu)\n", "",
+           (double)xCalendarResult.ullNs / (double)ullTicks,
+           (double)xCalendarResult.ullNs / (double)(xCalendarResult.ullReleases ? xCalendarResult.ullReleases : 1),
+           ((xTimers.ullReleases == xCalendarResult.ullReleases) && (xTimers.ullChecksum == xCalendarResult.ullChecksum))
+           ? "same" : "DIFFERENT", (unsigned long long)xCalendarResult.ullReleases);
+
+    vCalendarFree(&xCalendar);
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    const uint32_t ulIpsa[] =
+    {
+        TASK1_PERIOD_MS, TASK2_PERIOD_MS, TASK3_PERIOD_MS, TASK4_PERIOD_MS, APERIODIC_TASK_DELAY_MS
+    };
+    uint32_t ulTasks = calendarbenchDEFAULT_TASKS;
+    const char *pcMap = NULL;
+    const char *pcWrite = NULL;
+    uint32_t *pulPeriods;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--tasks") == 0)
+        {
+            ulTasks = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--map") == 0)
+        {
+            pcMap = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--write") == 0)
+        {
+            pcWrite = argv[i + 1];
+        }
+    }
+
+    pulPeriods = calloc(ulTasks, sizeof(uint32_t));
+
+    if ((pulPeriods == NULL) || (ulTasks == 0))
+    {
+        fprintf(stderr, "calendar_bench: bad task count\n");
+        return 1;
+    }
+
+    prvCompare("ipsa_sched", ulIpsa, sizeof(ulIpsa) / sizeof(ulIpsa[0]), pcMap, pcWrite);
+
+    // Harmonic: 10 ticks times a power of two up to 1280
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        pulPeriods[i] = 10U << (i % 8);
+    }
+
+    prvCompare("harmonic", pulPeriods, ulTasks, NULL, NULL);
+
+    // Non-harmonic, with a hyperperiod that still fits: divisors of 55440
+    for (uint32_t i = 0; i < ulTasks; i++)
+    {
+        static const uint32_t ulDivisors[] = { 40, 45, 56, 63, 70, 72, 77, 80, 84, 88, 90, 99, 105, 110, 112, 120 };
+
+        pulPeriods[i] = ulDivisors[i % (sizeof(ulDivisors) / sizeof(ulDivisors[0]))];
+    }
+
+    prvCompare("non-harmonic", pulPeriods, ulTasks, NULL, NULL);
+
+    free(pulPeriods);
+
+    return 0;
+}
@@ -0,0 +1,490 @@
+/*
+ * Simulated CAN bus in shared memory.  See can_bus.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* Local includes. */
+#include "can_bus.h"
+
+/* CRC-15/CAN generator polynomial. */
+#define canCRC_POLYNOMIAL    ( 0x4599 )
+
+/*-----------------------------------------------------------*/
+
+uint64_t ullCanBusNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvLock(CanBus_t *pxBus)
+{
+    // The previous owner died inside a critical section: the state it
+    // left is at worst one frame off, keep going
+    if (pthread_mutex_lock(&pxBus->xLock) == EOWNERDEAD)
+    {
+        pthread_mutex_consistent(&pxBus->xLock);
+    }
+}
+
+static void prvUnlock(CanBus_t *pxBus)
+{
+    pthread_mutex_unlock(&pxBus->xLock);
+}
+
+/*-----------------------------------------------------------*/
+
+CanBus_t *pxCanBusCreate(const char *pcName, uint32_t ulBitrate, uint32_t ulNodes)
+{
+    pthread_mutexattr_t xMutexAttr;
+    pthread_condattr_t xCondAttr;
+    CanBus_t *pxBus;
+    int iFd;
+
+    if ((ulNodes == 0) || (ulNodes > canMAX_NODES) || (ulBitrate == 0))
+    {
+        return NULL;
+    }
+
+    (void)shm_unlink(pcName);
+    iFd = shm_open(pcName, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (iFd < 0)
+    {
+        return NULL;
+    }
+
+    if (ftruncate(iFd, sizeof(CanBus_t)) != 0)
+    {
+        close(iFd);
+        shm_unlink(pcName);
+        return NULL;
+    }
+
+    pxBus = mmap(NULL, sizeof(CanBus_t), PROT_READ | PROT_WRITE, MAP_SHARED, iFd, 0);
+    close(iFd);
+
+    if (pxBus == MAP_FAILED)
+    {
+        shm_unlink(pcName);
+        return NULL;
+    }
+
+    memset(pxBus, 0, sizeof(*pxBus));
+
+    pthread_mutexattr_init(&xMutexAttr);
+    pthread_mutexattr_setpshared(&xMutexAttr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&xMutexAttr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&pxBus->xLock, &xMutexAttr);
+    pthread_mutexattr_destroy(&xMutexAttr);
+
+    pthread_condattr_init(&xCondAttr);
+    pthread_condattr_setpshared(&xCondAttr, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&xCondAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pxBus->xPending, &xCondAttr);
+    pthread_condattr_destroy(&xCondAttr);
+
+    pxBus->ulBitrate = ulBitrate;
+    pxBus->ulNodes = ulNodes;
+    pxBus->ullStartNs = ullCanBusNowNs();
+
+    // Published last: a node attaching early sees no magic and fails
+    __atomic_store_n(&pxBus->ulMagic, canMAGIC, __ATOMIC_RELEASE);
+
+    return pxBus;
+}
+
+CanBus_t *pxCanBusAttach(const char *pcName)
+{
+    CanBus_t *pxBus;
+    int iFd = shm_open(pcName, O_RDWR, 0);
+
+    if (iFd < 0)
+    {
+        return NULL;
+    }
+
+    pxBus = mmap(NULL, sizeof(CanBus_t), PROT_READ | PROT_WRITE, MAP_SHARED, iFd, 0);
+    close(iFd);
+
+    if (pxBus == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    if (__atomic_load_n(&pxBus->ulMagic, __ATOMIC_ACQUIRE) != canMAGIC)
+    {
+        munmap(pxBus, sizeof(CanBus_t));
+        return NULL;
+    }
+
+    return pxBus;
+}
+
+void vCanBusDestroy(CanBus_t *pxBus, const char *pcName)
+{
+    munmap(pxBus, sizeof(CanBus_t));
+
+    if (pcName != NULL)
+    {
+        shm_unlink(pcName);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int xCanBusSend(CanBus_t *pxBus, uint32_t ulNode, const CanFrame_t *pxFrame)
+{
+    CanNodeState_t *pxNode = &pxBus->xNodes[ulNode];
+    int iResult = -1;
+
+    prvLock(pxBus);
+
+    for (uint32_t i = 0; i < canTX_MAILBOXES; i++)
+    {
+        if (pxNode->ucMailboxUsed[i] == 0)
+        {
+            pxNode->xMailbox[i] = *pxFrame;
+            pxNode->xMailbox[i].ucSender = (uint8_t)ulNode;
+            pxNode->xMailbox[i].ullQueuedNs = ullCanBusNowNs();
+            pxNode->ucMailboxUsed[i] = 1;
+            pthread_cond_signal(&pxBus->xPending);
+            iResult = 0;
+            break;
+        }
+    }
+
+    if (iResult != 0)
+    {
+        pxNode->ulTxRejected++;
+    }
+
+    prvUnlock(pxBus);
+
+    return iResult;
+}
+
+int xCanBusReceive(CanBus_t *pxBus, uint32_t ulNode, CanFrame_t *pxFrame)
+{
+    CanNodeState_t *pxNode = &pxBus->xNodes[ulNode];
+    int iReceived = 0;
+
+    prvLock(pxBus);
+
+    if (pxNode->ulRxTail != pxNode->ulRxHead)
+    {
+        *pxFrame = pxNode->xRx[pxNode->ulRxTail % canRX_SLOTS];
+        pxNode->ulRxTail++;
+        iReceived = 1;
+    }
+
+    prvUnlock(pxBus);
+
+    return iReceived;
+}
+
+void vCanBusRecordEndToEnd(CanBus_t *pxBus, uint32_t ulTask, uint64_t ullLatencyNs)
+{
+    CanTaskStats_t *pxStats;
+
+    if (ulTask >= canMAX_TASKS)
+    {
+        return;
+    }
+
+    pxStats = &pxBus->xTasks[ulTask];
+
+    prvLock(pxBus);
+
+    pxStats->ulJobs++;
+    pxStats->ullSumEndToEndNs += ullLatencyNs;
+
+    if (ullLatencyNs > pxStats->ullMaxEndToEndNs)
+    {
+        pxStats->ullMaxEndToEndNs = ullLatencyNs;
+    }
+
+    prvUnlock(pxBus);
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulCanFrameBits(const CanFrame_t *pxFrame)
+{
+    uint8_t ucBits[19 + 8 * canMAX_DATA + 15];
+    uint32_t ulCount = 0;
+    uint32_t ulCrc = 0;
+    uint32_t ulStuffed;
+    uint32_t ulRun;
+    uint8_t ucLast;
+    uint32_t ulLength = (pxFrame->ucLength > canMAX_DATA) ? canMAX_DATA : pxFrame->ucLength;
+
+    // SOF, identifier, RTR, IDE, r0, DLC and data, most significant bit first
+    ucBits[ulCount++] = 0;
+
+    for (int i = 10; i >= 0; i--)
+    {
+        ucBits[ulCount++] = (pxFrame->ulId >> i) & 1;
+    }
+
+    ucBits[ulCount++] = 0;
+    ucBits[ulCount++] = 0;
+    ucBits[ulCount++] = 0;
+
+    for (int i = 3; i >= 0; i--)
+    {
+        ucBits[ulCount++] = (ulLength >> i) & 1;
+    }
+
+    for (uint32_t ulByte = 0; ulByte < ulLength; ulByte++)
+    {
+        for (int i = 7; i >= 0; i--)
+        {
+            ucBits[ulCount++] = (pxFrame->ucData[ulByte] >> i) & 1;
+        }
+    }
+
+    // CRC-15 over everything so far, then appended
+    for (uint32_t i = 0; i < ulCount; i++)
+    {
+        uint32_t ulNext = ucBits[i] ^ ((ulCrc >> 14) & 1);
+
+        ulCrc = (ulCrc << 1) & 0x7fff;
+
+        if (ulNext != 0)
+        {
+            ulCrc ^= canCRC_POLYNOMIAL;
+        }
+    }
+
+    for (int i = 14; i >= 0; i--)
+    {
+        ucBits[ulCount++] = (ulCrc >> i) & 1;
+    }
+
+    // After five equal bits the transmitter inserts a complement bit, which
+    // itself starts the next run
+    ulStuffed = 0;
+    ulRun = 1;
+    ucLast = ucBits[0];
+
+    for (uint32_t i = 1; i < ulCount; i++)
+    {
+        if (ucBits[i] == ucLast)
+        {
+            ulRun++;
+        }
+        else
+        {
+            ucLast = ucBits[i];
+            ulRun = 1;
+        }
+
+        if (ulRun == 5)
+        {
+            ulStuffed++;
+            ucLast ^= 1;
+            ulRun = 1;
+        }
+    }
+
+    return ulCount + ulStuffed + canTRAILER_BITS;
+}
+
+/*-----------------------------------------------------------*/
+
+static CanMessageStats_t *prvMessageStats(CanBus_t *pxBus, uint32_t ulId)
+{
+    for (uint32_t i = 0; i < canMAX_MESSAGES; i++)
+    {
+        CanMessageStats_t *pxStats = &pxBus->xMessages[i];
+
+        if ((pxStats->ulFrames == 0) && (pxStats->ulId == 0))
+        {
+            pxStats->ulId = ulId;
+            return pxStats;
+        }
+
+        if (pxStats->ulId == ulId)
+        {
+            return pxStats;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Highest priority frame pending at the next arbitration, under the lock.
+ * The bus arbitrates at ullBusFree, or when the first frame arrives if it is
+ * idle; only the frames queued by then take part, even when the arbiter runs
+ * later than that, so the order on the bus does not depend on how late the
+ * host woke this process.
+ */
+static int prvArbitrate(CanBus_t *pxBus, uint64_t ullBusFree, CanFrame_t *pxWinner)
+{
+    CanNodeState_t *pxBest = NULL;
+    uint32_t ulBestSlot = 0;
+    uint64_t ullInstant = UINT64_MAX;
+
+    for (uint32_t ulNode = 0; ulNode < pxBus->ulNodes; ulNode++)
+    {
+        CanNodeState_t *pxNode = &pxBus->xNodes[ulNode];
+
+        for (uint32_t i = 0; i < canTX_MAILBOXES; i++)
+        {
+            if ((pxNode->ucMailboxUsed[i] != 0) && (pxNode->xMailbox[i].ullQueuedNs < ullInstant))
+            {
+                ullInstant = pxNode->xMailbox[i].ullQueuedNs;
+            }
+        }
+    }
+
+    if (ullInstant == UINT64_MAX)
+    {
+        return 0;
+    }
+
+    if (ullInstant < ullBusFree)
+    {
+        ullInstant = ullBusFree;
+    }
+
+    for (uint32_t ulNode = 0; ulNode < pxBus->ulNodes; ulNode++)
+    {
+        CanNodeState_t *pxNode = &pxBus->xNodes[ulNode];
+
+        for (uint32_t i = 0; i < canTX_MAILBOXES; i++)
+        {
+            if ((pxNode->ucMailboxUsed[i] != 0) && (pxNode->xMailbox[i].ullQueuedNs <= ullInstant) &&
+                ((pxBest == NULL) || (pxNode->xMailbox[i].ulId < pxBest->xMailbox[ulBestSlot].ulId)))
+            {
+                pxBest = pxNode;
+                ulBestSlot = i;
+            }
+        }
+    }
+
+    *pxWinner = pxBest->xMailbox[ulBestSlot];
+    pxBest->ucMailboxUsed[ulBestSlot] = 0;
+
+    return 1;
+}
+
+void vCanBusArbitrate(CanBus_t *pxBus, uint64_t ullUntilNs)
+{
+    struct timespec xWake;
+    CanFrame_t xFrame;
+    uint64_t ullStart;
+    uint64_t ullEnd;
+    uint64_t ullWoken;
+    uint64_t ullBusFree = 0;
+    uint32_t ulBits;
+
+    for (;;)
+    {
+        prvLock(pxBus);
+
+        // Bus idle: wait for a send, but not past the end of the run
+        while (prvArbitrate(pxBus, ullBusFree, &xFrame) == 0)
+        {
+            if (ullCanBusNowNs() >= ullUntilNs)
+            {
+                prvUnlock(pxBus);
+                return;
+            }
+
+            xWake.tv_sec = (time_t)(ullUntilNs / 1000000000ULL);
+            xWake.tv_nsec = (long)(ullUntilNs % 1000000000ULL);
+
+            if (pthread_cond_timedwait(&pxBus->xPending, &pxBus->xLock, &xWake) == EOWNERDEAD)
+            {
+                pthread_mutex_consistent(&pxBus->xLock);
+            }
+        }
+
+        prvUnlock(pxBus);
+
+        // The winner holds the bus for its whole length.  Bus time runs
+        // from the arbitration instant, not from when the arbiter got to
+        // run, so a late wake-up of this process does not stretch it
+        ulBits = ulCanFrameBits(&xFrame);
+        ullStart = (xFrame.ullQueuedNs > ullBusFree) ? xFrame.ullQueuedNs : ullBusFree;
+        ullEnd = ullStart + (uint64_t)ulBits * 1000000000ULL / pxBus->ulBitrate;
+        ullBusFree = ullEnd;
+        xWake.tv_sec = (time_t)(ullEnd / 1000000000ULL);
+        xWake.tv_nsec = (long)(ullEnd % 1000000000ULL);
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xWake, NULL) == EINTR)
+        {
+        }
+
+        ullWoken = ullCanBusNowNs();
+
+        prvLock(pxBus);
+
+        for (uint32_t ulNode = 0; ulNode < pxBus->ulNodes; ulNode++)
+        {
+            CanNodeState_t *pxNode = &pxBus->xNodes[ulNode];
+
+            if (ulNode == xFrame.ucSender)
+            {
+                continue;
+            }
+
+            if (pxNode->ulRxHead - pxNode->ulRxTail >= canRX_SLOTS)
+            {
+                pxNode->ulRxOverruns++;
+                continue;
+            }
+
+            pxNode->xRx[pxNode->ulRxHead % canRX_SLOTS] = xFrame;
+            pxNode->ulRxHead++;
+        }
+
+        CanMessageStats_t *pxStats = prvMessageStats(pxBus, xFrame.ulId);
+
+        if (pxStats != NULL)
+        {
+            uint64_t ullLatency = ullEnd - xFrame.ullQueuedNs;
+
+            pxStats->ulFrames++;
+            pxStats->ulBits = ulBits;
+            pxStats->ullSumLatencyNs += ullLatency;
+
+            if (ulBits > pxStats->ulMaxBits)
+            {
+                pxStats->ulMaxBits = ulBits;
+            }
+
+            if (ullLatency > pxStats->ullMaxLatencyNs)
+            {
+                pxStats->ullMaxLatencyNs = ullLatency;
+            }
+        }
+
+        pxBus->ullFrames++;
+        pxBus->ullBits += ulBits;
+        pxBus->ullBusyNs += ullEnd - ullStart;
+
+        if (ullWoken - ullEnd > pxBus->ullMaxOverrunNs)
+        {
+            pxBus->ullMaxOverrunNs = ullWoken - ullEnd;
+        }
+
+        prvUnlock(pxBus);
+    }
+}
@@ -0,0 +1,136 @@
+/*
+ * Simulated CAN bus shared by several FreeRTOS node processes.
+ *
+ * The bus is a POSIX shared memory segment.  Every node has canTX_MAILBOXES
+ * transmit mailboxes and a receive ring in the segment; one arbiter process
+ * (can_sim.c) moves frames from the mailboxes to the rings the way a CAN
+ * controller would:
+ *
+ *   - arbitration: whenever the bus goes idle the pending frame with the
+ *     lowest identifier, over all nodes, wins, and a frame on the wire is
+ *     never preempted;
+ *   - bit time: a frame occupies the bus for its length in bits, bit stuffing
+ *     included (computed from the actual identifier, data and CRC), times
+ *     1 / bitrate, and is delivered to every other node at its end.
+ *
+ * Time is CLOCK_MONOTONIC, the same in every process, so a frame carries the
+ * time it was queued and the release time of the job that started its chain
+ * (ullOriginNs); the receivers measure end-to-end latencies against that.
+ * These fields travel beside the frame and take no bits on the bus.
+ *
+ * All state is under one process-shared robust mutex: a node killed while
+ * holding it does not hang the others.  A FreeRTOS task must not take it
+ * unless no other task of its node does: the Posix port can suspend a task
+ * thread inside the mutex, and a higher priority task blocking on it would
+ * then never let the holder run again.  In can_node.c only the driver task
+ * calls into the bus.
+ */
+
+#ifndef CAN_BUS_H
+#define CAN_BUS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define canBUS_NAME           "/ipsa_can"
+#define canMAGIC              ( 0x43414e31UL )
+#define canMAX_NODES          ( 8 )
+#define canTX_MAILBOXES       ( 4 )
+#define canRX_SLOTS           ( 32 )
+#define canMAX_MESSAGES       ( 32 )
+#define canMAX_TASKS          ( 32 )
+#define canMAX_DATA           ( 8 )
+
+/* Bits of a standard frame outside the stuffed region: CRC delimiter, ACK
+ * slot and delimiter, end of frame and interframe space. */
+#define canTRAILER_BITS       ( 13 )
+
+typedef struct CanFrame
+{
+    uint32_t ulId;                   /* 11-bit identifier, lower wins. */
+    uint8_t ucLength;
+    uint8_t ucSender;
+    uint8_t ucData[canMAX_DATA];
+    uint64_t ullQueuedNs;            /* Set by xCanBusSend(). */
+    uint64_t ullOriginNs;            /* Release of the job that started the chain. */
+} CanFrame_t;
+
+typedef struct CanNodeState
+{
+    CanFrame_t xMailbox[canTX_MAILBOXES];
+    uint8_t ucMailboxUsed[canTX_MAILBOXES];
+    CanFrame_t xRx[canRX_SLOTS];
+    uint32_t ulRxHead;
+    uint32_t ulRxTail;
+    uint32_t ulRxOverruns;
+    uint32_t ulTxRejected;           /* Sends with every mailbox busy. */
+} CanNodeState_t;
+
+typedef struct CanMessageStats
+{
+    uint32_t ulId;
+    uint32_t ulFrames;
+    uint32_t ulBits;                 /* Stuffed length of the last frame. */
+    uint32_t ulMaxBits;
+    uint64_t ullMaxLatencyNs;        /* Queued to delivered. */
+    uint64_t ullSumLatencyNs;
+} CanMessageStats_t;
+
+typedef struct CanTaskStats
+{
+    uint32_t ulJobs;
+    uint64_t ullMaxEndToEndNs;       /* Chain origin to job completion. */
+    uint64_t ullSumEndToEndNs;
+} CanTaskStats_t;
+
+typedef struct CanBus
+{
+    uint32_t ulMagic;
+    uint32_t ulBitrate;
+    uint32_t ulNodes;
+    pthread_mutex_t xLock;
+    pthread_cond_t xPending;         /* Signalled on every send. */
+
+    uint64_t ullStartNs;
+    uint64_t ullBusyNs;
+    uint64_t ullFrames;
+    uint64_t ullBits;
+    uint64_t ullMaxOverrunNs;        /* Worst delivery after the end of a frame. */
+
+    CanNodeState_t xNodes[canMAX_NODES];
+    CanMessageStats_t xMessages[canMAX_MESSAGES];
+    CanTaskStats_t xTasks[canMAX_TASKS];
+} CanBus_t;
+
+/*
+ * Create the segment for ulNodes nodes (arbiter side), replacing a stale one
+ * of the same name.  Returns NULL on failure.
+ */
+CanBus_t *pxCanBusCreate(const char *pcName, uint32_t ulBitrate, uint32_t ulNodes);
+
+/* Map an existing segment (node side).  Returns NULL on failure. */
+CanBus_t *pxCanBusAttach(const char *pcName);
+
+void vCanBusDestroy(CanBus_t *pxBus, const char *pcName);
+
+/*
+ * Queue a frame in a free transmit mailbox of ulNode.  Returns 0, or -1 when
+ * every mailbox is still waiting for the bus.  Never blocks on the bus.
+ */
+int xCanBusSend(CanBus_t *pxBus, uint32_t ulNode, const CanFrame_t *pxFrame);
+
+/* Take the oldest received frame of ulNode.  Returns 1 if there was one. */
+int xCanBusReceive(CanBus_t *pxBus, uint32_t ulNode, CanFrame_t *pxFrame);
+
+/* Account one end-to-end latency to the task at ulTask in can_system.h. */
+void vCanBusRecordEndToEnd(CanBus_t *pxBus, uint32_t ulTask, uint64_t ullLatencyNs);
+
+/* Run the arbiter until ullUntilNs (CLOCK_MONOTONIC). */
+void vCanBusArbitrate(CanBus_t *pxBus, uint64_t ullUntilNs);
+
+/* Length on the wire of a standard data frame, stuff bits included. */
+uint32_t ulCanFrameBits(const CanFrame_t *pxFrame);
+
+uint64_t ullCanBusNowNs(void);
+
+#endif /* CAN_BUS_H */
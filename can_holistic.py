@@ -0,0 +1,239 @@
+"""Holistic end-to-end analysis of the multi-node task set of can_system.h.
+
+Tasks on every node are analysed with fixed-priority response-time analysis,
+the CAN messages with the revised non-preemptive CAN analysis of Davis,
+Burns, Bril and Lukkien (2007): every instance of a message in its level-m
+busy period is checked, since a message whose transmission pushes into the
+next instance's window can make a later instance the worst one.  The two are coupled as in Tindell and Clark's
+holistic analysis: a message inherits the response time of its sender as
+release jitter, and a message released task inherits the response time of
+its message, plus the driver polling delay, as release jitter.  Jitter
+changes the interference on the other tasks of the node and the other
+messages on the bus, so the whole system is iterated to a fixed point.
+
+All response times of a chain are measured from the release of the
+periodic task at its head, so the response time of the last task of the
+chain is its end-to-end latency bound.
+
+With --measured, the bounds are compared with the latencies measured by
+can_sim (can_latency.json): per message from queueing to delivery, per chain
+from the start of the head job to the completion of the last one.
+"""
+
+import argparse
+import json
+import math
+import re
+
+NO_MESSAGE = -1
+
+
+def read_system(path):
+    source = open(path).read()
+
+    def value(name):
+        match = re.search(r"#define\s+" + name + r"\s+\((.*)\)", source)
+        if match is None:
+            raise SystemExit(f"{name} not found in {path}")
+        return int(match.group(1), 0)
+
+    def entries(table):
+        body = re.search(r"#define\s+" + table + r"\(X\)(.*?)\n\s*\n", source, re.S)
+        if body is None:
+            raise SystemExit(f"{table} not found in {path}")
+        return [[field.strip() for field in entry.split(",")]
+                for entry in re.findall(r"X\(([^)]*)\)", body.group(1))]
+
+    def message(field):
+        return NO_MESSAGE if field == "canNO_MESSAGE" else int(field, 0)
+
+    tasks = []
+    for name, node, period, wcet, priority, input_id, output_id in entries("CAN_SYSTEM_TASKS"):
+        tasks.append({
+            "name": name,
+            "node": int(node),
+            "period_us": int(period) * 1000,
+            "wcet_us": int(wcet),
+            "priority": int(priority),
+            "input": message(input_id),
+            "output": message(output_id),
+        })
+
+    messages = []
+    for identifier, length in entries("CAN_SYSTEM_MESSAGES"):
+        messages.append({"id": int(identifier, 0), "length": int(length)})
+
+    for item in messages:
+        senders = [task for task in tasks if task["output"] == item["id"]]
+        if len(senders) != 1:
+            raise SystemExit(f"message 0x{item['id']:03x} needs exactly one sender")
+        item["sender"] = senders[0]
+
+    # A message released task runs at the rate of the head of its chain
+    by_id = {item["id"]: item for item in messages}
+
+    def period(task, depth=0):
+        if task["period_us"] > 0:
+            return task["period_us"]
+        if depth > len(tasks) or task["input"] not in by_id:
+            raise SystemExit(f"{task['name']} has no periodic task at the head of its chain")
+        return period(by_id[task["input"]]["sender"], depth + 1)
+
+    for task in tasks:
+        task["period_us"] = period(task)
+    for item in messages:
+        item["period_us"] = item["sender"]["period_us"]
+
+    return value("canSYSTEM_BITRATE"), tasks, messages
+
+
+def fixed_point(base, interference, limit, start=None):
+    """Smallest w = base + interference(w) from start (base by default), or math.inf past limit."""
+    window = base if start is None else start
+    while True:
+        updated = base + interference(window)
+        if updated == window:
+            return window
+        if updated > limit:
+            return math.inf
+        window = updated
+
+
+def holistic(bitrate, tasks, messages, tick_us, driver_us):
+    bit_us = 1e6 / bitrate
+    for item in messages:
+        # Worst-case stuffing for an 11-bit identifier
+        item["bits"] = 55 + 10 * item["length"]
+        item["cost_us"] = item["bits"] * bit_us
+
+    by_id = {item["id"]: item for item in messages}
+    for task in tasks:
+        task["jitter_us"] = 0.0
+        task["response_us"] = task["wcet_us"]
+    for item in messages:
+        item["jitter_us"] = 0.0
+        item["response_us"] = item["cost_us"]
+
+    for _ in range(100):
+        changed = False
+
+        for item in messages:
+            jitter = item["sender"]["response_us"]
+            higher = [other for other in messages if other["id"] < item["id"]]
+            lower = [other for other in messages if other["id"] > item["id"]]
+            # A lower priority frame already on the bus, or the previous
+            # instance of this one pushing through into the busy period
+            blocking = max(max((other["cost_us"] for other in lower), default=0.0), item["cost_us"])
+            limit = 10 * item["period_us"]
+
+            # Level-m busy period, this message included with its own jitter
+            busy = fixed_point(
+                blocking,
+                lambda t: sum(math.ceil((t + other["jitter_us"]) / other["period_us"]) * other["cost_us"]
+                              for other in higher + [item]),
+                limit, start=item["cost_us"])
+
+            if math.isinf(busy):
+                queueing = math.inf
+            else:
+                # Worst over the instances q released in the busy period,
+                # each measured from its own queueing
+                queueing = 0.0
+                for q in range(math.ceil((busy + jitter) / item["period_us"])):
+                    window = fixed_point(
+                        blocking + q * item["cost_us"],
+                        lambda w: sum(math.ceil((w + other["jitter_us"] + bit_us) / other["period_us"])
+                                      * other["cost_us"] for other in higher),
+                        limit)
+                    queueing = max(queueing, window - q * item["period_us"])
+            response = jitter + queueing + item["cost_us"]
+            item["queueing_us"] = queueing
+            if (response, jitter) != (item["response_us"], item["jitter_us"]):
+                item["response_us"], item["jitter_us"] = response, jitter
+                changed = True
+
+        for task in tasks:
+            if task["input"] == NO_MESSAGE:
+                jitter = 0.0
+            else:
+                # Delivered at most one tick before the driver polls
+                jitter = by_id[task["input"]]["response_us"] + tick_us + driver_us
+            higher = [other for other in tasks
+                      if other["node"] == task["node"] and other["priority"] > task["priority"]]
+
+            window = fixed_point(
+                task["wcet_us"],
+                lambda w: sum(math.ceil((w + other["jitter_us"]) / other["period_us"]) * other["wcet_us"]
+                              for other in higher) + math.ceil(w / tick_us) * driver_us,
+                10 * task["period_us"])
+            response = jitter + window
+            if (response, jitter) != (task["response_us"], task["jitter_us"]):
+                task["response_us"], task["jitter_us"] = response, jitter
+                changed = True
+
+        if not changed:
+            return True
+
+    return False
+
+
+def chain(task, messages):
+    by_id = {item["id"]: item for item in messages}
+    path = [task["name"]]
+    while task["input"] != NO_MESSAGE:
+        item = by_id[task["input"]]
+        task = item["sender"]
+        path[:0] = [task["name"], f"0x{item['id']:03x}"]
+    return " -> ".join(path)
+
+
+def ratio(bound, seen):
+    if seen is None:
+        return f"{'-':>10} {'-':>7}"
+    return f"{seen:>10.0f} {bound / max(seen, 1e-9):>7.2f}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--source", default="can_system.h")
+    parser.add_argument("--measured", help="can_latency.json from can_sim")
+    parser.add_argument("--tick-us", type=float, default=1000.0, help="driver polling period (one tick)")
+    parser.add_argument("--driver-us", type=float, default=20.0, help="cost of one driver poll")
+    args = parser.parse_args()
+
+    bitrate, tasks, messages = read_system(args.source)
+    converged = holistic(bitrate, tasks, messages, args.tick_us, args.driver_us)
+
+    measured = {"messages": {}, "tasks": {}}
+    if args.measured:
+        with open(args.measured) as measured_file:
+            measured = json.load(measured_file)
+
+    utilisation = sum(item["cost_us"] / item["period_us"] for item in messages)
+    print(f"Bus: {bitrate} bit/s, worst-case utilisation {100 * utilisation:.1f}%")
+    if not converged:
+        print("warning: the jitter did not converge, the bounds below are not final")
+
+    print(f"{'message':>10} {'C':>8} {'jitter':>8} {'bound':>10} {'observed':>10} {'ratio':>7}  queued to delivered")
+    for item in messages:
+        bound = item["queueing_us"] + item["cost_us"]
+        seen = measured["messages"].get(f"0x{item['id']:03x}", {}).get("max_latency_us")
+        print(f"{'0x%03x' % item['id']:>10} {item['cost_us']:>8.0f} {item['jitter_us']:>8.0f} {bound:>10.0f} "
+              f"{ratio(bound, seen)}")
+        if seen is not None and seen > bound:
+            print(f"{'':>10} observed above the bound: check the arbiter delivery delay and host load")
+
+    print(f"{'task':>10} {'node':>8} {'jitter':>8} {'bound':>10} {'observed':>10} {'ratio':>7}  chain")
+    for task in sorted(tasks, key=lambda task: (task["node"], -task["priority"])):
+        seen = measured["tasks"].get(task["name"], {}).get("max_end_to_end_us")
+        print(f"{task['name']:>10} {task['node']:>8} {task['jitter_us']:>8.0f} {task['response_us']:>10.0f} "
+              f"{ratio(task['response_us'], seen)}  {chain(task, messages)}")
+
+        if seen is not None and seen > task["response_us"]:
+            print(f"{task['name']:>10} observed above the bound: check the arbiter delivery delay and host load")
+        if task["response_us"] > task["period_us"]:
+            print(f"{task['name']:>10} bound exceeds the period of {task['period_us']}us")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,278 @@
+/*
+ * One node of the multi-node simulation: a FreeRTOS instance that runs its
+ * share of the task set of can_system.h and talks to the other nodes over
+ * the simulated CAN bus of can_bus.h.
+ *
+ * The node is a normal FreeRTOS program: call can_node() from main() in
+ * place of ipsa_sched().  It is not started by hand but by can_sim, which
+ * creates the bus, starts one process per node with CAN_NODE set to its
+ * number (and CAN_BUS to the segment name), and arbitrates the bus:
+ *
+ *     gcc -O2 -pthread can_sim.c can_bus.c -o can_sim -lrt
+ *     ./can_sim ./posix_demo 20
+ *     python3 can_holistic.py --measured can_latency.json
+ *
+ * A periodic task stamps the time at the start of its job as the origin of
+ * the chain; a message released task forwards the origin it received, and
+ * one without an output message records origin-to-completion as the
+ * end-to-end latency of its chain.  Received frames are polled by a driver
+ * task at the highest priority every tick, the analogue of a receive
+ * interrupt deferred to a task, and handed to the task that consumes the
+ * identifier through a queue.
+ *
+ * The driver task is also the only task that touches the bus: the bus state
+ * is under a process-shared mutex, and a node task preempted on a tick while
+ * holding it would leave the driver, which never yields to it, blocked in
+ * the kernel for good.  Node tasks post their frames and end-to-end
+ * latencies to the driver's outbox instead and notify it, so a frame still
+ * reaches its mailbox as soon as the sending job is done.
+ *
+ * Execution times are burnt on CLOCK_THREAD_CPUTIME_ID, which only advances
+ * while the task runs, so preemption by the other tasks of the node is not
+ * counted as progress (each task is a thread on the Posix port).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* Local includes. */
+#include "can_bus.h"
+#include "can_system.h"
+
+#define canDRIVER_PRIORITY      ( configMAX_PRIORITIES - 1 )
+#define canINBOX_LENGTH         ( 8 )
+#define canOUTBOX_LENGTH        ( 16 )
+
+typedef struct CanNodeTask
+{
+    const char *pcName;
+    uint32_t ulNode;
+    uint32_t ulPeriodMs;
+    uint32_t ulWcetUs;
+    UBaseType_t uxPriority;
+    int32_t lInput;
+    int32_t lOutput;
+    QueueHandle_t xInbox;
+} CanNodeTask_t;
+
+#define canTASK_ENTRY(name, node, period, wcet, priority, input, output) \
+    { #name, node, period, wcet, tskIDLE_PRIORITY + (priority), input, output, NULL },
+
+static CanNodeTask_t xNodeTasks[] = { CAN_SYSTEM_TASKS(canTASK_ENTRY) };
+
+#define canNODE_TASKS    ( sizeof(xNodeTasks) / sizeof(xNodeTasks[0]) )
+
+#define canMESSAGE_ENTRY(id, length)    { id, length },
+
+static const struct
+{
+    uint32_t ulId;
+    uint8_t ucLength;
+} xMessages[] = { CAN_SYSTEM_MESSAGES(canMESSAGE_ENTRY) };
+
+/* A frame to send, or (xFrame unused) an end-to-end latency to record. */
+typedef struct CanNodeRequest
+{
+    uint32_t ulTask;
+    BaseType_t xSend;
+    CanFrame_t xFrame;
+    uint64_t ullEndToEndNs;
+} CanNodeRequest_t;
+
+static CanBus_t *pxBus = NULL;
+static uint32_t ulThisNode = 0;
+static QueueHandle_t xOutbox = NULL;
+static TaskHandle_t xDriver = NULL;
+
+static void prvNodeTask(void *params);
+static void prvDriverTask(void *params);
+
+/*-----------------------------------------------------------*/
+
+static uint8_t prvMessageLength(uint32_t ulId)
+{
+    for (uint32_t i = 0; i < sizeof(xMessages) / sizeof(xMessages[0]); i++)
+    {
+        if (xMessages[i].ulId == ulId)
+        {
+            return xMessages[i].ucLength;
+        }
+    }
+
+    return canMAX_DATA;
+}
+
+static void prvBurn(uint32_t ulMicroseconds)
+{
+    struct timespec xStart;
+    struct timespec xNow;
+    uint64_t ullElapsed;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &xStart);
+
+    do
+    {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &xNow);
+        ullElapsed = (uint64_t)(xNow.tv_sec - xStart.tv_sec) * 1000000000ULL + (uint64_t)xNow.tv_nsec -
+                     (uint64_t)xStart.tv_nsec;
+    } while (ullElapsed < (uint64_t)ulMicroseconds * 1000ULL);
+}
+
+/*-----------------------------------------------------------*/
+
+void can_node(void)
+{
+    const char *pcNode = getenv("CAN_NODE");
+    const char *pcBus = getenv("CAN_BUS");
+
+    ulThisNode = (pcNode != NULL) ? (uint32_t)strtoul(pcNode, NULL, 10) : 0;
+    pxBus = pxCanBusAttach((pcBus != NULL) ? pcBus : canBUS_NAME);
+
+    if ((pxBus == NULL) || (ulThisNode >= pxBus->ulNodes))
+    {
+        printf("CAN node %lu: no bus, start the nodes with can_sim\n", (unsigned long)ulThisNode);
+        exit(1);
+    }
+
+    xOutbox = xQueueCreate(canOUTBOX_LENGTH, sizeof(CanNodeRequest_t));
+
+    if (xOutbox == NULL)
+    {
+        printf("CAN node %lu: cannot create the outbox\n", (unsigned long)ulThisNode);
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < canNODE_TASKS; i++)
+    {
+        CanNodeTask_t *pxTask = &xNodeTasks[i];
+
+        if (pxTask->ulNode != ulThisNode)
+        {
+            continue;
+        }
+
+        if (pxTask->lInput != canNO_MESSAGE)
+        {
+            pxTask->xInbox = xQueueCreate(canINBOX_LENGTH, sizeof(CanFrame_t));
+        }
+
+        xTaskCreate(prvNodeTask, pxTask->pcName, configMINIMAL_STACK_SIZE * 2, pxTask, pxTask->uxPriority, NULL);
+    }
+
+    xTaskCreate(prvDriverTask, "CANdrv", configMINIMAL_STACK_SIZE * 2, NULL, canDRIVER_PRIORITY, &xDriver);
+
+    /* Start the scheduler. */
+    vTaskStartScheduler();
+
+    for (;;)
+    {
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Hand a request to the driver task, which preempts the caller to serve it. */
+static void prvPost(const CanNodeRequest_t *pxRequest)
+{
+    if (xQueueSend(xOutbox, pxRequest, 0) != pdPASS)
+    {
+        printf("%s: driver outbox full, request lost\n", xNodeTasks[pxRequest->ulTask].pcName);
+        return;
+    }
+
+    xTaskNotifyGive(xDriver);
+}
+
+static void prvNodeTask(void *params)
+{
+    CanNodeTask_t *pxTask = (CanNodeTask_t *)params;
+    uint32_t ulIndex = (uint32_t)(pxTask - xNodeTasks);
+    TickType_t xLastWake = xTaskGetTickCount();
+    CanFrame_t xFrame;
+    CanNodeRequest_t xRequest = { .ulTask = ulIndex };
+    uint32_t ulSequence = 0;
+
+    for (;;)
+    {
+        memset(&xFrame, 0, sizeof(xFrame));
+
+        if (pxTask->xInbox != NULL)
+        {
+            (void)xQueueReceive(pxTask->xInbox, &xFrame, portMAX_DELAY);
+        }
+        else
+        {
+            vTaskDelayUntil(&xLastWake, pdMS_TO_TICKS(pxTask->ulPeriodMs));
+            xFrame.ullOriginNs = ullCanBusNowNs();
+        }
+
+        prvBurn(pxTask->ulWcetUs);
+
+        if (pxTask->lOutput != canNO_MESSAGE)
+        {
+            uint64_t ullOrigin = xFrame.ullOriginNs;
+
+            memset(&xFrame, 0, sizeof(xFrame));
+            xFrame.ulId = (uint32_t)pxTask->lOutput;
+            xFrame.ullOriginNs = ullOrigin;
+            xFrame.ucLength = prvMessageLength(xFrame.ulId);
+            memcpy(xFrame.ucData, &ulSequence, sizeof(ulSequence));
+            ulSequence++;
+
+            xRequest.xSend = pdTRUE;
+            xRequest.xFrame = xFrame;
+        }
+        else
+        {
+            xRequest.xSend = pdFALSE;
+            xRequest.ullEndToEndNs = ullCanBusNowNs() - xFrame.ullOriginNs;
+        }
+
+        prvPost(&xRequest);
+    }
+}
+
+static void prvDriverTask(void *params)
+{
+    CanNodeRequest_t xRequest;
+    CanFrame_t xFrame;
+
+    for (;;)
+    {
+        // Woken by a node task's request, and at least every tick to poll
+        (void)ulTaskNotifyTake(pdTRUE, 1);
+
+        while (xQueueReceive(xOutbox, &xRequest, 0) == pdPASS)
+        {
+            if (xRequest.xSend == pdFALSE)
+            {
+                vCanBusRecordEndToEnd(pxBus, xRequest.ulTask, xRequest.ullEndToEndNs);
+            }
+            else if (xCanBusSend(pxBus, ulThisNode, &xRequest.xFrame) != 0)
+            {
+                printf("%s: all transmit mailboxes busy, frame 0x%03lx lost\n", xNodeTasks[xRequest.ulTask].pcName,
+                       (unsigned long)xRequest.xFrame.ulId);
+            }
+        }
+
+        while (xCanBusReceive(pxBus, ulThisNode, &xFrame) != 0)
+        {
+            // Acceptance filtering: frames nobody here consumes are dropped
+            for (uint32_t i = 0; i < canNODE_TASKS; i++)
+            {
+                if ((xNodeTasks[i].xInbox != NULL) && (xNodeTasks[i].lInput == (int32_t)xFrame.ulId))
+                {
+                    (void)xQueueSend(xNodeTasks[i].xInbox, &xFrame, 0);
+                }
+            }
+        }
+    }
+}
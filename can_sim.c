@@ -0,0 +1,214 @@
+/*
+ * Launcher and bus arbiter of the multi-node simulation.
+ *
+ * Creates the CAN bus of can_bus.h, starts one process per node of
+ * can_system.h running the given FreeRTOS program (built with can_node() as
+ * its entry, see can_node.c) with CAN_NODE and CAN_BUS in its environment,
+ * then arbitrates the bus for the requested number of seconds.  At the end
+ * the nodes are stopped and the measured message latencies and end-to-end
+ * chain latencies are printed and written to canLATENCY_FILE for
+ * can_holistic.py.
+ *
+ *     gcc -O2 -pthread can_sim.c can_bus.c -o can_sim -lrt
+ *     ./can_sim ./posix_demo 20
+ *
+ * The arbiter sleeps while a frame is on the wire and on a condition variable
+ * while the bus is idle.  Bus time is kept from the time stamps of the
+ * frames, so a late wake-up delays the delivery of a frame but not the
+ * arbitration order or the bus time of the next one; run as root for
+ * SCHED_FIFO to keep the delivery delay, reported at the end, small.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+
+/* Local includes. */
+#include "can_bus.h"
+#include "can_system.h"
+
+#define canLATENCY_FILE         "can_latency.json"
+#define canDEFAULT_SECONDS      ( 10 )
+#define canARBITER_PRIORITY     ( 90 )
+
+/* Added to the run time: the nodes need a moment to start their schedulers. */
+#define canSTARTUP_NS           ( 500000000ULL )
+
+#define canTASK_NAME(name, node, period, wcet, priority, input, output)    #name,
+
+static const char *pcTaskNames[] = { CAN_SYSTEM_TASKS(canTASK_NAME) };
+
+#define canTASKS    ( sizeof(pcTaskNames) / sizeof(pcTaskNames[0]) )
+
+/*-----------------------------------------------------------*/
+
+static void prvReport(const CanBus_t *pxBus, uint64_t ullElapsedNs)
+{
+    FILE *pxFile = fopen(canLATENCY_FILE, "w");
+    const char *pcSeparator = "";
+
+    printf("Bus: %llu frames, %llu bits, utilisation %.1f%% at %lu bit/s\n", (unsigned long long)pxBus->ullFrames,
+           (unsigned long long)pxBus->ullBits, 100.0 * (double)pxBus->ullBusyNs / (double)ullElapsedNs,
+           (unsigned long)pxBus->ulBitrate);
+    printf("Arbiter: frames delivered up to %.0fus after their end on the bus (host wake-up latency)\n",
+           (double)pxBus->ullMaxOverrunNs / 1000.0);
+
+    for (uint32_t ulNode = 0; ulNode < pxBus->ulNodes; ulNode++)
+    {
+        const CanNodeState_t *pxNode = &pxBus->xNodes[ulNode];
+
+        if ((pxNode->ulRxOverruns != 0) || (pxNode->ulTxRejected != 0))
+        {
+            printf("Node %lu: %lu receive overruns, %lu sends with no free mailbox\n", (unsigned long)ulNode,
+                   (unsigned long)pxNode->ulRxOverruns, (unsigned long)pxNode->ulTxRejected);
+        }
+    }
+
+    if (pxFile != NULL)
+    {
+        fprintf(pxFile, "{\n  \"bitrate\": %lu,\n  \"elapsed_s\": %.3f,\n  \"messages\": {", (unsigned long)pxBus->ulBitrate,
+                (double)ullElapsedNs / 1e9);
+    }
+
+    for (uint32_t i = 0; i < canMAX_MESSAGES; i++)
+    {
+        const CanMessageStats_t *pxStats = &pxBus->xMessages[i];
+
+        if (pxStats->ulFrames == 0)
+        {
+            continue;
+        }
+
+        printf("Message 0x%03lx: %lu frames, %lu bits, latency mean=%.0fus max=%.0fus\n", (unsigned long)pxStats->ulId,
+               (unsigned long)pxStats->ulFrames, (unsigned long)pxStats->ulMaxBits,
+               (double)pxStats->ullSumLatencyNs / 1000.0 / (double)pxStats->ulFrames,
+               (double)pxStats->ullMaxLatencyNs / 1000.0);
+
+        if (pxFile != NULL)
+        {
+            fprintf(pxFile, "%s\n    \"0x%03lx\": {\"frames\": %lu, \"max_bits\": %lu, \"mean_latency_us\": %.1f, "
+                    "\"max_latency_us\": %.1f}", pcSeparator, (unsigned long)pxStats->ulId,
+                    (unsigned long)pxStats->ulFrames, (unsigned long)pxStats->ulMaxBits,
+                    (double)pxStats->ullSumLatencyNs / 1000.0 / (double)pxStats->ulFrames,
+                    (double)pxStats->ullMaxLatencyNs / 1000.0);
+            pcSeparator = ",";
+        }
+    }
+
+    if (pxFile != NULL)
+    {
+        fprintf(pxFile, "\n  },\n  \"tasks\": {");
+    }
+
+    pcSeparator = "";
+
+    for (uint32_t i = 0; i < canTASKS; i++)
+    {
+        const CanTaskStats_t *pxStats = &pxBus->xTasks[i];
+
+        if (pxStats->ulJobs == 0)
+        {
+            continue;
+        }
+
+        printf("Chain to %s: %lu jobs, end-to-end mean=%.0fus max=%.0fus\n", pcTaskNames[i],
+               (unsigned long)pxStats->ulJobs, (double)pxStats->ullSumEndToEndNs / 1000.0 / (double)pxStats->ulJobs,
+               (double)pxStats->ullMaxEndToEndNs / 1000.0);
+
+        if (pxFile != NULL)
+        {
+            fprintf(pxFile, "%s\n    \"%s\": {\"jobs\": %lu, \"mean_end_to_end_us\": %.1f, \"max_end_to_end_us\": %.1f}",
+                    pcSeparator, pcTaskNames[i], (unsigned long)pxStats->ulJobs,
+                    (double)pxStats->ullSumEndToEndNs / 1000.0 / (double)pxStats->ulJobs,
+                    (double)pxStats->ullMaxEndToEndNs / 1000.0);
+            pcSeparator = ",";
+        }
+    }
+
+    if (pxFile != NULL)
+    {
+        fprintf(pxFile, "\n  }\n}\n");
+        fclose(pxFile);
+        printf("Measured latencies written to %s\n", canLATENCY_FILE);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    struct sched_param xParam = { .sched_priority = canARBITER_PRIORITY };
+    pid_t xNodes[canSYSTEM_NODES];
+    uint64_t ullStart;
+    int iSeconds = canDEFAULT_SECONDS;
+    CanBus_t *pxBus;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <node program> [seconds]\n", argv[0]);
+        return 2;
+    }
+
+    if (argc > 2)
+    {
+        iSeconds = atoi(argv[2]);
+    }
+
+    pxBus = pxCanBusCreate(canBUS_NAME, canSYSTEM_BITRATE, canSYSTEM_NODES);
+
+    if (pxBus == NULL)
+    {
+        perror("can_sim: bus");
+        return 1;
+    }
+
+    if (sched_setscheduler(0, SCHED_FIFO, &xParam) != 0)
+    {
+        printf("Arbiter: SCHED_FIFO unavailable, bus timing follows SCHED_OTHER wake-ups\n");
+    }
+
+    for (uint32_t ulNode = 0; ulNode < canSYSTEM_NODES; ulNode++)
+    {
+        xNodes[ulNode] = fork();
+
+        if (xNodes[ulNode] == 0)
+        {
+            char cNode[12];
+
+            // The nodes are ordinary processes, whatever the arbiter runs at
+            xParam.sched_priority = 0;
+            (void)sched_setscheduler(0, SCHED_OTHER, &xParam);
+
+            snprintf(cNode, sizeof(cNode), "%lu", (unsigned long)ulNode);
+            setenv("CAN_NODE", cNode, 1);
+            setenv("CAN_BUS", canBUS_NAME, 1);
+            execl(argv[1], argv[1], (char *)NULL);
+            perror("can_sim: exec");
+            _exit(127);
+        }
+    }
+
+    ullStart = ullCanBusNowNs() + canSTARTUP_NS;
+    vCanBusArbitrate(pxBus, ullStart + (uint64_t)iSeconds * 1000000000ULL);
+
+    for (uint32_t ulNode = 0; ulNode < canSYSTEM_NODES; ulNode++)
+    {
+        if (xNodes[ulNode] > 0)
+        {
+            kill(xNodes[ulNode], SIGTERM);
+            (void)waitpid(xNodes[ulNode], NULL, 0);
+        }
+    }
+
+    prvReport(pxBus, ullCanBusNowNs() - pxBus->ullStartNs);
+    vCanBusDestroy(pxBus, canBUS_NAME);
+
+    return 0;
+}
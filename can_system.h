@@ -0,0 +1,43 @@
+/*
+ * Distributed task set of the multi-node simulation: which tasks run on
+ * which node and the CAN messages that connect them.  Shared by the node
+ * program (can_node.c), the arbiter (can_sim.c) and the holistic analysis
+ * (can_holistic.py), which parses the X() entries below.
+ *
+ * A task is X(name, node, period_ms, wcet_us, priority, input_id, output_id).
+ * A task with period 0 is released by its input message; canNO_MESSAGE marks
+ * no input or no output.  A task that sends a message forwards the origin of
+ * the job that released it, so Sensor -> 0x120 -> Control -> 0x210 -> Actuate
+ * is one chain and Actuate measures its end-to-end latency from the release
+ * of Sensor.
+ *
+ * A message is X(id, length): the identifier is the bus priority, lower wins.
+ */
+
+#ifndef CAN_SYSTEM_H
+#define CAN_SYSTEM_H
+
+#define canNO_MESSAGE           ( -1 )
+
+#define canSYSTEM_NODES         ( 3 )
+#define canSYSTEM_BITRATE       ( 125000 )
+
+#define CAN_SYSTEM_TASKS(X)                                              \
+    X(Sensor,    0,  20,  300, 3, canNO_MESSAGE, 0x120)                  \
+    X(Status,    0,  50,  400, 2, canNO_MESSAGE, 0x300)                  \
+    X(Watchdog,  0,   0,  100, 4, 0x080,         canNO_MESSAGE)          \
+    X(Heartbeat, 1,  10,  100, 4, canNO_MESSAGE, 0x080)                  \
+    X(Control,   1,   0,  800, 3, 0x120,         0x210)                  \
+    X(Diagnose,  1, 100, 2000, 1, canNO_MESSAGE, 0x400)                  \
+    X(Actuate,   2,   0,  200, 3, 0x210,         canNO_MESSAGE)          \
+    X(Logger,    2,   0,  600, 2, 0x300,         canNO_MESSAGE)          \
+    X(Recorder,  2,   0,  500, 1, 0x400,         canNO_MESSAGE)
+
+#define CAN_SYSTEM_MESSAGES(X)                                           \
+    X(0x080, 2)                                                          \
+    X(0x120, 4)                                                          \
+    X(0x210, 8)                                                          \
+    X(0x300, 8)                                                          \
+    X(0x400, 8)
+
+#endif /* CAN_SYSTEM_H */
@@ -0,0 +1,590 @@
+/*
+ * DAG tasks on a work-stealing pool.  See dag.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/* Local includes. */
+#include "dag.h"
+
+#define dagDEQUE_MASK        ( dagMAX_NODES - 1 )
+#define dagCACHE_LINE        ( 64 )
+
+/* Failed steals before an idle worker yields the core to the host. */
+#define dagSPINS_BEFORE_YIELD    ( 256 )
+
+_Static_assert((dagMAX_NODES & (dagMAX_NODES - 1)) == 0, "dagMAX_NODES must be a power of two");
+_Static_assert(dagMAX_NODES <= 256, "successors are stored as uint8_t");
+
+typedef struct DagDeque
+{
+    int64_t llTop __attribute__((aligned(dagCACHE_LINE)));
+    int64_t llBottom __attribute__((aligned(dagCACHE_LINE)));
+    DagNode_t *pxSlots[dagMAX_NODES];
+} DagDeque_t;
+
+typedef struct DagWorker
+{
+    DagDeque_t xDeque;
+    DagPool_t *pxPool;
+    uint32_t ulIndex;
+    uint32_t ulSeed;
+    int iCpu;
+    pthread_t xThread;
+    uint64_t ullNodes;
+    uint64_t ullSteals;
+} __attribute__((aligned(dagCACHE_LINE))) DagWorker_t;
+
+struct DagPool
+{
+    DagTask_t *pxTask;
+    uint32_t ulWorkers;
+    int iPriority;
+
+    /* Bumped at every release; helpers sleep on it. */
+    uint32_t ulEpoch __attribute__((aligned(dagCACHE_LINE)));
+    uint32_t ulRemaining __attribute__((aligned(dagCACHE_LINE)));
+    uint32_t ulStop;
+
+    uint64_t ullJobs;
+    DagWorker_t xWorkers[dagMAX_WORKERS];
+};
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvFutexWait(uint32_t *pulAddress, uint32_t ulExpected)
+{
+    (void)syscall(SYS_futex, pulAddress, FUTEX_WAIT_PRIVATE, ulExpected, NULL, NULL, 0);
+}
+
+static void prvFutexWakeAll(uint32_t *pulAddress)
+{
+    (void)syscall(SYS_futex, pulAddress, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulDagAddNode(DagTask_t *pxTask, const char *pcName, DagFunction_t pxFunction, void *pvContext)
+{
+    DagNode_t *pxNode;
+
+    if (pxTask->ulNodeCount >= dagMAX_NODES)
+    {
+        return UINT32_MAX;
+    }
+
+    pxNode = &pxTask->xNodes[pxTask->ulNodeCount];
+    memset(pxNode, 0, sizeof(*pxNode));
+    pxNode->pcName = pcName;
+    pxNode->pxFunction = pxFunction;
+    pxNode->pvContext = pvContext;
+
+    return pxTask->ulNodeCount++;
+}
+
+int xDagAddEdge(DagTask_t *pxTask, uint32_t ulFrom, uint32_t ulTo)
+{
+    DagNode_t *pxFrom;
+
+    // Edges only point forward, so the node order is a topological order
+    if ((ulFrom >= ulTo) || (ulTo >= pxTask->ulNodeCount))
+    {
+        return -1;
+    }
+
+    pxFrom = &pxTask->xNodes[ulFrom];
+
+    if (pxFrom->ulSuccessorCount >= dagMAX_SUCCESSORS)
+    {
+        return -1;
+    }
+
+    pxFrom->ucSuccessors[pxFrom->ulSuccessorCount++] = (uint8_t)ulTo;
+    pxTask->xNodes[ulTo].ulPredecessorCount++;
+
+    return 0;
+}
+
+uint32_t ulDagAddParallel(DagTask_t *pxTask, const char *pcName, DagFunction_t pxBody, void *pvContext,
+                          uint32_t ulCount, uint32_t ulFork, DagFunction_t pxJoin)
+{
+    uint32_t ulFirst = pxTask->ulNodeCount;
+    uint32_t ulJoin;
+
+    if ((ulCount == 0) || (ulCount > dagMAX_SUCCESSORS) || (pxTask->ulNodeCount + ulCount + 1 > dagMAX_NODES))
+    {
+        return UINT32_MAX;
+    }
+
+    for (uint32_t i = 0; i < ulCount; i++)
+    {
+        uint32_t ulBranch = ulFirst + i;
+
+        (void)ulDagAddNode(pxTask, pcName, pxBody, pvContext);
+        pxTask->xNodes[ulBranch].ulIndex = i;
+
+        if (ulFork != UINT32_MAX)
+        {
+            (void)xDagAddEdge(pxTask, ulFork, ulBranch);
+        }
+    }
+
+    ulJoin = ulDagAddNode(pxTask, pcName, pxJoin, pvContext);
+
+    for (uint32_t i = 0; i < ulCount; i++)
+    {
+        (void)xDagAddEdge(pxTask, ulFirst + i, ulJoin);
+    }
+
+    return ulJoin;
+}
+
+/*-----------------------------------------------------------*/
+
+uint64_t ullDagVolume(const DagTask_t *pxTask)
+{
+    uint64_t ullVolume = 0;
+
+    for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+    {
+        ullVolume += pxTask->xNodes[i].ullWcetNs;
+    }
+
+    return ullVolume;
+}
+
+uint64_t ullDagCriticalPath(const DagTask_t *pxTask)
+{
+    uint64_t ullFinish[dagMAX_NODES] = { 0 };
+    uint64_t ullLongest = 0;
+
+    // Node order is topological: longest path to each node in one pass
+    for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+    {
+        const DagNode_t *pxNode = &pxTask->xNodes[i];
+
+        ullFinish[i] += pxNode->ullWcetNs;
+
+        if (ullFinish[i] > ullLongest)
+        {
+            ullLongest = ullFinish[i];
+        }
+
+        for (uint32_t j = 0; j < pxNode->ulSuccessorCount; j++)
+        {
+            uint32_t ulNext = pxNode->ucSuccessors[j];
+
+            if (ullFinish[i] > ullFinish[ulNext])
+            {
+                ullFinish[ulNext] = ullFinish[i];
+            }
+        }
+    }
+
+    return ullLongest;
+}
+
+uint32_t ulDagFederatedCores(const DagTask_t *pxTask)
+{
+    uint64_t ullVolume = ullDagVolume(pxTask);
+    uint64_t ullPath = ullDagCriticalPath(pxTask);
+
+    if (ullVolume <= pxTask->ullDeadlineNs)
+    {
+        return 0;
+    }
+
+    if (ullPath >= pxTask->ullDeadlineNs)
+    {
+        return UINT32_MAX;
+    }
+
+    return (uint32_t)((ullVolume - ullPath + (pxTask->ullDeadlineNs - ullPath) - 1) / (pxTask->ullDeadlineNs - ullPath));
+}
+
+uint64_t ullDagGrahamBound(const DagTask_t *pxTask, uint32_t ulCores)
+{
+    uint64_t ullVolume = ullDagVolume(pxTask);
+    uint64_t ullPath = ullDagCriticalPath(pxTask);
+
+    if (ulCores == 0)
+    {
+        ulCores = 1;
+    }
+
+    return ullPath + (ullVolume - ullPath) / ulCores;
+}
+
+/*-----------------------------------------------------------*/
+
+void vDagRunSequential(DagTask_t *pxTask)
+{
+    for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+    {
+        DagNode_t *pxNode = &pxTask->xNodes[i];
+
+        if (pxNode->pxFunction != NULL)
+        {
+            pxNode->pxFunction(pxNode->pvContext, pxNode->ulIndex);
+        }
+    }
+}
+
+void vDagCalibrate(DagTask_t *pxTask, uint32_t ulRuns)
+{
+    for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+    {
+        pxTask->xNodes[i].ullWcetNs = 0;
+    }
+
+    for (uint32_t ulRun = 0; ulRun < ulRuns; ulRun++)
+    {
+        for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+        {
+            DagNode_t *pxNode = &pxTask->xNodes[i];
+            uint64_t ullStart = prvNowNs();
+            uint64_t ullElapsed;
+
+            if (pxNode->pxFunction != NULL)
+            {
+                pxNode->pxFunction(pxNode->pvContext, pxNode->ulIndex);
+            }
+
+            ullElapsed = prvNowNs() - ullStart;
+
+            if (ullElapsed > pxNode->ullWcetNs)
+            {
+                pxNode->ullWcetNs = ullElapsed;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Owner only. */
+static void prvDequePush(DagDeque_t *pxDeque, DagNode_t *pxNode)
+{
+    int64_t llBottom = __atomic_load_n(&pxDeque->llBottom, __ATOMIC_RELAXED);
+
+    pxDeque->pxSlots[llBottom & dagDEQUE_MASK] = pxNode;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&pxDeque->llBottom, llBottom + 1, __ATOMIC_RELAXED);
+}
+
+/* Owner only: newest node first. */
+static DagNode_t *prvDequePop(DagDeque_t *pxDeque)
+{
+    int64_t llBottom = __atomic_load_n(&pxDeque->llBottom, __ATOMIC_RELAXED) - 1;
+    int64_t llTop;
+    DagNode_t *pxNode = NULL;
+
+    __atomic_store_n(&pxDeque->llBottom, llBottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    llTop = __atomic_load_n(&pxDeque->llTop, __ATOMIC_RELAXED);
+
+    if (llTop <= llBottom)
+    {
+        pxNode = pxDeque->pxSlots[llBottom & dagDEQUE_MASK];
+
+        if (llTop == llBottom)
+        {
+            // Last node: race the thieves for it
+            if (!__atomic_compare_exchange_n(&pxDeque->llTop, &llTop, llTop + 1, 0, __ATOMIC_SEQ_CST,
+                                             __ATOMIC_RELAXED))
+            {
+                pxNode = NULL;
+            }
+
+            __atomic_store_n(&pxDeque->llBottom, llBottom + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+    {
+        __atomic_store_n(&pxDeque->llBottom, llBottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return pxNode;
+}
+
+/* Any thread: oldest node first. */
+static DagNode_t *prvDequeSteal(DagDeque_t *pxDeque)
+{
+    int64_t llTop = __atomic_load_n(&pxDeque->llTop, __ATOMIC_ACQUIRE);
+    int64_t llBottom;
+    DagNode_t *pxNode;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    llBottom = __atomic_load_n(&pxDeque->llBottom, __ATOMIC_ACQUIRE);
+
+    if (llTop >= llBottom)
+    {
+        return NULL;
+    }
+
+    pxNode = pxDeque->pxSlots[llTop & dagDEQUE_MASK];
+
+    if (!__atomic_compare_exchange_n(&pxDeque->llTop, &llTop, llTop + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        return NULL;
+    }
+
+    return pxNode;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvPin(int iCpu)
+{
+    cpu_set_t xSet;
+
+    if (iCpu < 0)
+    {
+        return;
+    }
+
+    CPU_ZERO(&xSet);
+    CPU_SET(iCpu, &xSet);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(xSet), &xSet);
+}
+
+static DagNode_t *prvFindWork(DagWorker_t *pxWorker)
+{
+    DagPool_t *pxPool = pxWorker->pxPool;
+    DagNode_t *pxNode = prvDequePop(&pxWorker->xDeque);
+
+    if ((pxNode != NULL) || (pxPool->ulWorkers == 1))
+    {
+        return pxNode;
+    }
+
+    // Random victim, then the others in turn
+    pxWorker->ulSeed = pxWorker->ulSeed * 1103515245u + 12345u;
+
+    for (uint32_t i = 0; i < pxPool->ulWorkers; i++)
+    {
+        uint32_t ulVictim = (pxWorker->ulSeed + i) % pxPool->ulWorkers;
+
+        if (ulVictim == pxWorker->ulIndex)
+        {
+            continue;
+        }
+
+        pxNode = prvDequeSteal(&pxPool->xWorkers[ulVictim].xDeque);
+
+        if (pxNode != NULL)
+        {
+            pxWorker->ullSteals++;
+            return pxNode;
+        }
+    }
+
+    return NULL;
+}
+
+/* Work on the current job until every node of it has run. */
+static void prvWork(DagWorker_t *pxWorker)
+{
+    DagPool_t *pxPool = pxWorker->pxPool;
+    DagTask_t *pxTask = pxPool->pxTask;
+    uint32_t ulIdle = 0;
+
+    while (__atomic_load_n(&pxPool->ulRemaining, __ATOMIC_ACQUIRE) != 0)
+    {
+        DagNode_t *pxNode = prvFindWork(pxWorker);
+
+        if (pxNode == NULL)
+        {
+            if (++ulIdle >= dagSPINS_BEFORE_YIELD)
+            {
+                ulIdle = 0;
+                sched_yield();
+            }
+
+            continue;
+        }
+
+        ulIdle = 0;
+
+        if (pxNode->pxFunction != NULL)
+        {
+            pxNode->pxFunction(pxNode->pvContext, pxNode->ulIndex);
+        }
+
+        pxWorker->ullNodes++;
+
+        // Successors made ready here stay here, until someone steals them
+        for (uint32_t i = 0; i < pxNode->ulSuccessorCount; i++)
+        {
+            DagNode_t *pxNext = &pxTask->xNodes[pxNode->ucSuccessors[i]];
+
+            if (__atomic_sub_fetch(&pxNext->ulPending, 1, __ATOMIC_ACQ_REL) == 0)
+            {
+                prvDequePush(&pxWorker->xDeque, pxNext);
+            }
+        }
+
+        __atomic_sub_fetch(&pxPool->ulRemaining, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+static void *prvHelperThread(void *pvWorker)
+{
+    DagWorker_t *pxWorker = (DagWorker_t *)pvWorker;
+    DagPool_t *pxPool = pxWorker->pxPool;
+    uint32_t ulSeen = 0;
+
+    prvPin(pxWorker->iCpu);
+
+    if (pxPool->iPriority > 0)
+    {
+        struct sched_param xParam = { .sched_priority = pxPool->iPriority };
+
+        (void)pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam);
+    }
+
+    for (;;)
+    {
+        uint32_t ulEpoch = __atomic_load_n(&pxPool->ulEpoch, __ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&pxPool->ulStop, __ATOMIC_ACQUIRE) != 0)
+        {
+            break;
+        }
+
+        if (ulEpoch == ulSeen)
+        {
+            prvFutexWait(&pxPool->ulEpoch, ulEpoch);
+            continue;
+        }
+
+        ulSeen = ulEpoch;
+        prvWork(pxWorker);
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+DagPool_t *pxDagPoolCreate(DagTask_t *pxTask, const int *piCpus, uint32_t ulWorkers, int iPriority)
+{
+    DagPool_t *pxPool;
+
+    if ((ulWorkers == 0) || (ulWorkers > dagMAX_WORKERS))
+    {
+        return NULL;
+    }
+
+    pxPool = aligned_alloc(dagCACHE_LINE, sizeof(DagPool_t));
+
+    if (pxPool == NULL)
+    {
+        return NULL;
+    }
+
+    memset(pxPool, 0, sizeof(*pxPool));
+    pxPool->pxTask = pxTask;
+    pxPool->ulWorkers = ulWorkers;
+    pxPool->iPriority = iPriority;
+
+    for (uint32_t i = 0; i < ulWorkers; i++)
+    {
+        DagWorker_t *pxWorker = &pxPool->xWorkers[i];
+
+        pxWorker->pxPool = pxPool;
+        pxWorker->ulIndex = i;
+        pxWorker->ulSeed = 0x9e3779b9u * (i + 1);
+        pxWorker->iCpu = (piCpus != NULL) ? piCpus[i] : -1;
+    }
+
+    for (uint32_t i = 1; i < ulWorkers; i++)
+    {
+        if (pthread_create(&pxPool->xWorkers[i].xThread, NULL, prvHelperThread, &pxPool->xWorkers[i]) != 0)
+        {
+            pxPool->ulWorkers = i;
+            break;
+        }
+    }
+
+    return pxPool;
+}
+
+void vDagPoolDestroy(DagPool_t *pxPool)
+{
+    __atomic_store_n(&pxPool->ulStop, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&pxPool->ulEpoch, 1, __ATOMIC_RELEASE);
+    prvFutexWakeAll(&pxPool->ulEpoch);
+
+    for (uint32_t i = 1; i < pxPool->ulWorkers; i++)
+    {
+        pthread_join(pxPool->xWorkers[i].xThread, NULL);
+    }
+
+    free(pxPool);
+}
+
+void vDagRunJob(DagPool_t *pxPool)
+{
+    DagTask_t *pxTask = pxPool->pxTask;
+    DagWorker_t *pxSelf = &pxPool->xWorkers[0];
+
+    // The helpers are idle: the job state can be reset without atomics
+    for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+    {
+        pxTask->xNodes[i].ulPending = pxTask->xNodes[i].ulPredecessorCount;
+    }
+
+    for (uint32_t i = 0; i < pxTask->ulNodeCount; i++)
+    {
+        if (pxTask->xNodes[i].ulPredecessorCount == 0)
+        {
+            prvDequePush(&pxSelf->xDeque, &pxTask->xNodes[i]);
+        }
+    }
+
+    __atomic_store_n(&pxPool->ulRemaining, pxTask->ulNodeCount, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&pxPool->ulEpoch, 1, __ATOMIC_RELEASE);
+
+    if (pxPool->ulWorkers > 1)
+    {
+        prvFutexWakeAll(&pxPool->ulEpoch);
+    }
+
+    prvWork(pxSelf);
+    pxPool->ullJobs++;
+}
+
+void vDagGetStats(const DagPool_t *pxPool, DagStats_t *pxStats)
+{
+    memset(pxStats, 0, sizeof(*pxStats));
+    pxStats->ulWorkers = pxPool->ulWorkers;
+    pxStats->ullJobs = pxPool->ullJobs;
+
+    for (uint32_t i = 0; i < pxPool->ulWorkers; i++)
+    {
+        pxStats->ullNodes += pxPool->xWorkers[i].ullNodes;
+        pxStats->ullSteals += pxPool->xWorkers[i].ullSteals;
+        pxStats->ullNodesPerWorker[i] = pxPool->xWorkers[i].ullNodes;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+ * DAG tasks: jobs made of subjobs that may run in parallel on several cores.
+ *
+ * A DagTask_t is a fixed graph of nodes, each a function with its own
+ * context, and edges meaning "finishes before".  ulDagAddParallel() adds a
+ * fork-join section: one body function run ulCount times with the branch
+ * index, between a fork and a join node.  The graph is built once; every job
+ * of the task runs all of its nodes.
+ *
+ * A job runs on a DagPool_t: the thread that calls vDagRunJob() is worker 0
+ * and the pool adds ulWorkers - 1 helper threads, each pinned to its own
+ * core.  Every worker owns a work-stealing deque (Chase and Lev, in the form
+ * of Le et al., PPoPP 2013): a worker pushes the nodes it makes ready and
+ * pops them back LIFO, so a chain stays on one core with its data in cache,
+ * and an idle worker steals the oldest node of another.  Between jobs the
+ * helpers sleep on a futex.  Deques hold dagMAX_NODES entries, since a node
+ * is pushed once per job, and never grow.
+ *
+ * Federated scheduling (Li et al., ECRTS 2014) gives every heavy task, one
+ * whose volume C exceeds its deadline D, ulDagFederatedCores() dedicated
+ * cores: by Graham's bound a greedy schedule of the graph on m cores ends
+ * within L + (C - L) / m of the release, with L the critical path, so
+ * m = ceil((C - L) / (D - L)) cores meet D.  Light tasks run sequentially on
+ * the cores left over.  C and L come from the node WCETs, which
+ * vDagCalibrate() measures.
+ */
+
+#ifndef DAG_H
+#define DAG_H
+
+#include <stdint.h>
+
+#define dagMAX_NODES         ( 64 )
+#define dagMAX_SUCCESSORS    ( 32 )
+#define dagMAX_WORKERS       ( 64 )
+
+/* A node with ulIndex, its branch in a fork-join section (0 otherwise). */
+typedef void (*DagFunction_t)(void *pvContext, uint32_t ulIndex);
+
+typedef struct DagNode
+{
+    const char *pcName;
+    DagFunction_t pxFunction;
+    void *pvContext;
+    uint32_t ulIndex;
+
+    uint8_t ucSuccessors[dagMAX_SUCCESSORS];
+    uint32_t ulSuccessorCount;
+    uint32_t ulPredecessorCount;
+
+    uint64_t ullWcetNs;
+
+    /* Job state: predecessors still running. */
+    uint32_t ulPending;
+} DagNode_t;
+
+typedef struct DagTask
+{
+    const char *pcName;
+    uint64_t ullPeriodNs;
+    uint64_t ullDeadlineNs;
+
+    DagNode_t xNodes[dagMAX_NODES];
+    uint32_t ulNodeCount;
+} DagTask_t;
+
+typedef struct DagPool DagPool_t;
+
+typedef struct DagStats
+{
+    uint32_t ulWorkers;
+    uint64_t ullJobs;
+    uint64_t ullNodes;
+    uint64_t ullSteals;
+    uint64_t ullNodesPerWorker[dagMAX_WORKERS];
+} DagStats_t;
+
+/*
+ * Graph construction.  Node functions run with no lock held and may run
+ * concurrently with any node they are not ordered with.  Return the index
+ * of the new node, or UINT32_MAX when the graph is full.
+ */
+uint32_t ulDagAddNode(DagTask_t *pxTask, const char *pcName, DagFunction_t pxFunction, void *pvContext);
+int xDagAddEdge(DagTask_t *pxTask, uint32_t ulFrom, uint32_t ulTo);
+
+/* ulCount branches of pxBody after ulFork; returns the join node, which runs
+ * pxJoin (may be NULL) once every branch is done. */
+uint32_t ulDagAddParallel(DagTask_t *pxTask, const char *pcName, DagFunction_t pxBody, void *pvContext,
+                          uint32_t ulCount, uint32_t ulFork, DagFunction_t pxJoin);
+
+/* Analysis, from the node WCETs. */
+uint64_t ullDagVolume(const DagTask_t *pxTask);
+uint64_t ullDagCriticalPath(const DagTask_t *pxTask);
+uint32_t ulDagFederatedCores(const DagTask_t *pxTask);   /* 0 if light, UINT32_MAX if L >= D. */
+uint64_t ullDagGrahamBound(const DagTask_t *pxTask, uint32_t ulCores);
+
+/* Run ulRuns jobs in topological order on the calling thread and keep the
+ * longest execution time of every node as its WCET. */
+void vDagCalibrate(DagTask_t *pxTask, uint32_t ulRuns);
+
+/* One job on the calling thread, nodes in topological order. */
+void vDagRunSequential(DagTask_t *pxTask);
+
+/*
+ * Pool of ulWorkers workers on the cores of piCpus (piCpus[0] is the core of
+ * the caller of vDagRunJob(), which pins itself).  iPriority > 0 runs the
+ * helpers under SCHED_FIFO at that priority when allowed.  Returns NULL on
+ * failure.
+ */
+DagPool_t *pxDagPoolCreate(DagTask_t *pxTask, const int *piCpus, uint32_t ulWorkers, int iPriority);
+void vDagPoolDestroy(DagPool_t *pxPool);
+
+/* One job of the pool's task on all its workers; returns when it is done. */
+void vDagRunJob(DagPool_t *pxPool);
+
+void vDagGetStats(const DagPool_t *pxPool, DagStats_t *pxStats);
+
+#endif /* DAG_H */
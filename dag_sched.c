@@ -0,0 +1,519 @@
+/*
+ * Parallel DAG jobs under federated scheduling, against sequential runs.
+ *
+ * Two parallelisable jobs of the kind the ipsa task set runs sequentially:
+ *
+ *   Frame   a whole sensor frame: capture, then dagFRAME_STRIPES stripes
+ *           filtered (3x3 box filter) and histogrammed in parallel, then the
+ *           histograms merged into an exposure level;
+ *   Search  a large search: the table is split into dagSEARCH_CHUNKS chunks
+ *           scanned in parallel for the entries in a key range, then the
+ *           counts and first positions are reduced.
+ *
+ * The node WCETs are measured first (dag.h, vDagCalibrate()), and each
+ * deadline is set to a share of the measured volume so that both tasks are
+ * heavy on any host and need more than one core.  Federated scheduling
+ * gives each its own cores, numbered from 0.  Both tasks then run for the
+ * requested time twice, each on its first core with the nodes in sequence,
+ * and on its federated cores with the work-stealing pool, and the response
+ * times are compared, with the Graham bound and the deadline.  One core
+ * cannot keep up with the federated period, so the sequential runs are
+ * released every dagSEQUENTIAL_PERIOD_FACTOR times the volume, with the
+ * deadline equal: their response times are execution times, not a backlog,
+ * and their misses are counted against that feasible deadline.
+ *
+ *     gcc -O2 -pthread dag_sched.c dag.c -o dag_sched
+ *     sudo ./dag_sched 10
+ *
+ * SCHED_FIFO needs CAP_SYS_NICE; without it the threads stay SCHED_OTHER and
+ * the report says so.  With fewer online CPUs than the allocation the cores
+ * are reused modulo the CPU count and no speedup can show.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+/* Local includes. */
+#include "dag.h"
+
+#define dagFRAME_WIDTH          ( 1024 )
+#define dagFRAME_HEIGHT         ( 1024 )
+#define dagFRAME_STRIPES        ( 16 )
+#define dagSEARCH_ENTRIES       ( 8 * 1024 * 1024 )
+#define dagSEARCH_CHUNKS        ( 16 )
+
+/* Deadline (and period) as a share of the measured sequential volume. */
+#define dagFRAME_DEADLINE_SHARE     ( 0.5 )
+#define dagSEARCH_DEADLINE_SHARE    ( 0.4 )
+
+/* Period (and deadline) of the sequential baseline, as a multiple of the
+ * volume. */
+#define dagSEQUENTIAL_PERIOD_FACTOR ( 1.5 )
+
+#define dagCALIBRATION_RUNS     ( 5 )
+#define dagFIFO_PRIORITY        ( 50 )
+#define dagTASKS                ( 2 )
+
+typedef struct DagRun
+{
+    DagTask_t *pxTask;
+    DagPool_t *pxPool;               /* NULL: nodes in sequence. */
+    int iCpu;
+    int iPolicyOk;
+    uint64_t ullPeriodNs;
+    uint64_t ullDeadlineNs;
+
+    uint32_t ulJobs;
+    uint32_t ulMisses;               /* Deadlines missed, skipped releases included. */
+    uint64_t ullResponseSumNs;
+    uint64_t ullResponseMaxNs;
+} DagRun_t;
+
+/* Frame. */
+static uint16_t usFrame[dagFRAME_HEIGHT][dagFRAME_WIDTH];
+static uint16_t usFiltered[dagFRAME_HEIGHT][dagFRAME_WIDTH];
+static uint32_t ulHistogram[dagFRAME_STRIPES][256];
+static uint32_t ulFrameCount = 0;
+static volatile uint32_t ulExposure = 0;
+
+/* Search. */
+static int32_t *plTable = NULL;
+static int32_t lLow = 0;
+static int32_t lHigh = 0;
+static uint32_t ulChunkCount[dagSEARCH_CHUNKS];
+static uint32_t ulChunkFirst[dagSEARCH_CHUNKS];
+static volatile uint32_t ulMatches = 0;
+
+static DagTask_t xFrameTask = { .pcName = "Frame" };
+static DagTask_t xSearchTask = { .pcName = "Search" };
+
+static struct timespec xStart;
+static struct timespec xStop;
+
+/*-----------------------------------------------------------*/
+
+static void prvCapture(void *pvContext, uint32_t ulIndex)
+{
+    uint32_t ulSeed = ++ulFrameCount;
+
+    (void)pvContext;
+    (void)ulIndex;
+
+    // A new frame from the "sensor": cheap noise over a gradient
+    for (uint32_t y = 0; y < dagFRAME_HEIGHT; y++)
+    {
+        for (uint32_t x = 0; x < dagFRAME_WIDTH; x++)
+        {
+            ulSeed = ulSeed * 1664525u + 1013904223u;
+            usFrame[y][x] = (uint16_t)((x * 32 + y * 16) + (ulSeed >> 24));
+        }
+    }
+}
+
+static void prvFilterStripe(void *pvContext, uint32_t ulIndex)
+{
+    uint32_t ulFirst = ulIndex * (dagFRAME_HEIGHT / dagFRAME_STRIPES);
+    uint32_t ulLast = ulFirst + (dagFRAME_HEIGHT / dagFRAME_STRIPES);
+    uint32_t *pulHistogram = ulHistogram[ulIndex];
+
+    (void)pvContext;
+
+    memset(pulHistogram, 0, sizeof(ulHistogram[0]));
+
+    for (uint32_t y = ulFirst; y < ulLast; y++)
+    {
+        uint32_t ulAbove = (y > 0) ? y - 1 : y;
+        uint32_t ulBelow = (y + 1 < dagFRAME_HEIGHT) ? y + 1 : y;
+
+        for (uint32_t x = 1; x + 1 < dagFRAME_WIDTH; x++)
+        {
+            uint32_t ulSum = 0;
+
+            for (int32_t dx = -1; dx <= 1; dx++)
+            {
+                ulSum += usFrame[ulAbove][x + dx] + usFrame[y][x + dx] + usFrame[ulBelow][x + dx];
+            }
+
+            usFiltered[y][x] = (uint16_t)(ulSum / 9);
+            pulHistogram[usFiltered[y][x] >> 8]++;
+        }
+    }
+}
+
+static void prvExposure(void *pvContext, uint32_t ulIndex)
+{
+    uint32_t ulTotal[256] = { 0 };
+    uint32_t ulPixels = 0;
+    uint32_t ulHalf;
+    uint32_t ulLevel = 0;
+
+    (void)pvContext;
+    (void)ulIndex;
+
+    for (uint32_t s = 0; s < dagFRAME_STRIPES; s++)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            ulTotal[i] += ulHistogram[s][i];
+            ulPixels += ulHistogram[s][i];
+        }
+    }
+
+    // Median level of the frame
+    ulHalf = ulPixels / 2;
+
+    for (ulPixels = 0; ulLevel < 256; ulLevel++)
+    {
+        ulPixels += ulTotal[ulLevel];
+
+        if (ulPixels >= ulHalf)
+        {
+            break;
+        }
+    }
+
+    ulExposure = ulLevel;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSearchKeys(void *pvContext, uint32_t ulIndex)
+{
+    static uint32_t ulSeed = 1;
+
+    (void)pvContext;
+    (void)ulIndex;
+
+    ulSeed = ulSeed * 1664525u + 1013904223u;
+    lLow = (int32_t)(ulSeed >> 8);
+    lHigh = lLow + (1 << 16);
+}
+
+static void prvSearchChunk(void *pvContext, uint32_t ulIndex)
+{
+    uint32_t ulFirst = ulIndex * (dagSEARCH_ENTRIES / dagSEARCH_CHUNKS);
+    uint32_t ulLast = ulFirst + (dagSEARCH_ENTRIES / dagSEARCH_CHUNKS);
+    uint32_t ulCount = 0;
+    uint32_t ulPosition = UINT32_MAX;
+
+    (void)pvContext;
+
+    for (uint32_t i = ulFirst; i < ulLast; i++)
+    {
+        if ((plTable[i] >= lLow) && (plTable[i] < lHigh))
+        {
+            if (ulCount++ == 0)
+            {
+                ulPosition = i;
+            }
+        }
+    }
+
+    ulChunkCount[ulIndex] = ulCount;
+    ulChunkFirst[ulIndex] = ulPosition;
+}
+
+static void prvSearchReduce(void *pvContext, uint32_t ulIndex)
+{
+    uint32_t ulTotal = 0;
+
+    (void)pvContext;
+    (void)ulIndex;
+
+    for (uint32_t i = 0; i < dagSEARCH_CHUNKS; i++)
+    {
+        ulTotal += ulChunkCount[i];
+    }
+
+    ulMatches = ulTotal;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNs(const struct timespec *pxTime)
+{
+    return (uint64_t)pxTime->tv_sec * 1000000000ULL + (uint64_t)pxTime->tv_nsec;
+}
+
+static void prvAddNs(struct timespec *pxTime, uint64_t ullNs)
+{
+    uint64_t ullTotal = prvNs(pxTime) + ullNs;
+
+    pxTime->tv_sec = (time_t)(ullTotal / 1000000000ULL);
+    pxTime->tv_nsec = (long)(ullTotal % 1000000000ULL);
+}
+
+static void *prvTaskThread(void *pvRun)
+{
+    DagRun_t *pxRun = (DagRun_t *)pvRun;
+    DagTask_t *pxTask = pxRun->pxTask;
+    struct timespec xRelease = xStart;
+    struct sched_param xParam = { .sched_priority = dagFIFO_PRIORITY };
+    cpu_set_t xSet;
+
+    CPU_ZERO(&xSet);
+    CPU_SET(pxRun->iCpu, &xSet);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(xSet), &xSet);
+    pxRun->iPolicyOk = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam) == 0);
+
+    for (;;)
+    {
+        struct timespec xNow;
+        uint64_t ullResponse;
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xRelease, NULL) == EINTR)
+        {
+        }
+
+        if (prvNs(&xRelease) >= prvNs(&xStop))
+        {
+            break;
+        }
+
+        if (pxRun->pxPool != NULL)
+        {
+            vDagRunJob(pxRun->pxPool);
+        }
+        else
+        {
+            vDagRunSequential(pxTask);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &xNow);
+        ullResponse = prvNs(&xNow) - prvNs(&xRelease);
+
+        pxRun->ulJobs++;
+        pxRun->ullResponseSumNs += ullResponse;
+
+        if (ullResponse > pxRun->ullResponseMaxNs)
+        {
+            pxRun->ullResponseMaxNs = ullResponse;
+        }
+
+        if (ullResponse > pxRun->ullDeadlineNs)
+        {
+            pxRun->ulMisses++;
+        }
+
+        // Releases that passed during an overrun are lost, and missed
+        prvAddNs(&xRelease, pxRun->ullPeriodNs);
+
+        while (prvNs(&xRelease) + pxRun->ullPeriodNs <= prvNs(&xNow))
+        {
+            prvAddNs(&xRelease, pxRun->ullPeriodNs);
+            pxRun->ulMisses++;
+        }
+    }
+
+    return NULL;
+}
+
+/* 0, or -1 if a task thread could not be started. */
+static int prvRun(DagRun_t *pxRuns, unsigned uSeconds)
+{
+    pthread_t xThreads[dagTASKS];
+    int iError;
+
+    clock_gettime(CLOCK_MONOTONIC, &xStart);
+    prvAddNs(&xStart, 100000000ULL);
+    xStop = xStart;
+    prvAddNs(&xStop, (uint64_t)uSeconds * 1000000000ULL);
+
+    for (uint32_t i = 0; i < dagTASKS; i++)
+    {
+        iError = pthread_create(&xThreads[i], NULL, prvTaskThread, &pxRuns[i]);
+
+        if (iError != 0)
+        {
+            fprintf(stderr, "dag_sched: cannot start %s: %s\n", pxRuns[i].pxTask->pcName, strerror(iError));
+
+            // The others are still waiting for the first release
+            for (uint32_t j = 0; j < i; j++)
+            {
+                pthread_cancel(xThreads[j]);
+                pthread_join(xThreads[j], NULL);
+            }
+
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < dagTASKS; i++)
+    {
+        pthread_join(xThreads[i], NULL);
+    }
+
+    return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    DagTask_t *pxTasks[dagTASKS] = { &xFrameTask, &xSearchTask };
+    double dShares[dagTASKS] = { dagFRAME_DEADLINE_SHARE, dagSEARCH_DEADLINE_SHARE };
+    DagRun_t xSequential[dagTASKS];
+    DagRun_t xFederated[dagTASKS];
+    int iCpus[dagTASKS][dagMAX_WORKERS];
+    uint32_t ulCores[dagTASKS];
+    long lOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned uSeconds = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 10) : 10;
+    uint32_t ulNext = 0;
+    uint32_t ulFork;
+
+    if (lOnline < 1)
+    {
+        lOnline = 1;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        fprintf(stderr, "dag_sched: mlockall failed, page faults may add jitter\n");
+    }
+
+    plTable = malloc(dagSEARCH_ENTRIES * sizeof(int32_t));
+
+    if (plTable == NULL)
+    {
+        fprintf(stderr, "dag_sched: no memory for the search table\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0, ulSeed = 7; i < dagSEARCH_ENTRIES; i++)
+    {
+        ulSeed = ulSeed * 1664525u + 1013904223u;
+        plTable[i] = (int32_t)(ulSeed >> 8);
+    }
+
+    // Frame: capture -> stripes -> exposure
+    ulFork = ulDagAddNode(&xFrameTask, "capture", prvCapture, NULL);
+    (void)ulDagAddParallel(&xFrameTask, "stripe", prvFilterStripe, NULL, dagFRAME_STRIPES, ulFork, prvExposure);
+
+    // Search: keys -> chunks -> reduce
+    ulFork = ulDagAddNode(&xSearchTask, "keys", prvSearchKeys, NULL);
+    (void)ulDagAddParallel(&xSearchTask, "chunk", prvSearchChunk, NULL, dagSEARCH_CHUNKS, ulFork, prvSearchReduce);
+
+    printf("%-8s %9s %9s %9s %6s %12s %9s\n", "task", "C", "L", "D", "cores", "Graham bound", "seq D");
+
+    for (uint32_t t = 0; t < dagTASKS; t++)
+    {
+        DagTask_t *pxTask = pxTasks[t];
+
+        vDagCalibrate(pxTask, dagCALIBRATION_RUNS);
+        pxTask->ullDeadlineNs = (uint64_t)((double)ullDagVolume(pxTask) * dShares[t]);
+        pxTask->ullPeriodNs = pxTask->ullDeadlineNs;
+
+        ulCores[t] = ulDagFederatedCores(pxTask);
+
+        if (ulCores[t] == UINT32_MAX)
+        {
+            printf("%-8s critical path longer than the deadline, no core count helps\n", pxTask->pcName);
+            return 1;
+        }
+
+        // A light task would share the cores left over; here it gets one
+        if (ulCores[t] == 0)
+        {
+            ulCores[t] = 1;
+        }
+
+        if (ulCores[t] > dagMAX_WORKERS)
+        {
+            ulCores[t] = dagMAX_WORKERS;
+        }
+
+        for (uint32_t i = 0; i < ulCores[t]; i++)
+        {
+            iCpus[t][i] = (int)(ulNext++ % (uint32_t)lOnline);
+        }
+
+        printf("%-8s %7.2fms %7.2fms %7.2fms %6u %10.2fms %7.2fms\n", pxTask->pcName,
+               (double)ullDagVolume(pxTask) / 1e6, (double)ullDagCriticalPath(pxTask) / 1e6,
+               (double)pxTask->ullDeadlineNs / 1e6, (unsigned)ulCores[t],
+               (double)ullDagGrahamBound(pxTask, ulCores[t]) / 1e6,
+               (double)ullDagVolume(pxTask) * dagSEQUENTIAL_PERIOD_FACTOR / 1e6);
+    }
+
+    if (ulNext > (uint32_t)lOnline)
+    {
+        printf("Federated allocation needs %u cores, %ld online: cores are shared, no speedup expected\n",
+               (unsigned)ulNext, lOnline);
+    }
+
+    // Sequential: each task alone on its first core
+    memset(xSequential, 0, sizeof(xSequential));
+
+    for (uint32_t t = 0; t < dagTASKS; t++)
+    {
+        xSequential[t].pxTask = pxTasks[t];
+        xSequential[t].iCpu = iCpus[t][0];
+        xSequential[t].ullPeriodNs = (uint64_t)((double)ullDagVolume(pxTasks[t]) * dagSEQUENTIAL_PERIOD_FACTOR);
+        xSequential[t].ullDeadlineNs = xSequential[t].ullPeriodNs;
+    }
+
+    if (prvRun(xSequential, uSeconds) != 0)
+    {
+        return 1;
+    }
+
+    // Federated: each task on its own cores
+    memset(xFederated, 0, sizeof(xFederated));
+
+    for (uint32_t t = 0; t < dagTASKS; t++)
+    {
+        xFederated[t].pxTask = pxTasks[t];
+        xFederated[t].iCpu = iCpus[t][0];
+        xFederated[t].ullPeriodNs = pxTasks[t]->ullPeriodNs;
+        xFederated[t].ullDeadlineNs = pxTasks[t]->ullDeadlineNs;
+        xFederated[t].pxPool = pxDagPoolCreate(pxTasks[t], iCpus[t], ulCores[t], dagFIFO_PRIORITY);
+
+        if (xFederated[t].pxPool == NULL)
+        {
+            fprintf(stderr, "dag_sched: cannot create the pool of %s\n", pxTasks[t]->pcName);
+            return 1;
+        }
+    }
+
+    if (prvRun(xFederated, uSeconds) != 0)
+    {
+        return 1;
+    }
+
+    printf("%-8s %-6s %6s %13s %13s %7s %7s %8s %7s\n", "task", "policy", "jobs", "seq avg/max", "fed avg/max",
+           "misses", "speedup", "max/bound", "steals");
+
+    for (uint32_t t = 0; t < dagTASKS; t++)
+    {
+        DagRun_t *pxSeq = &xSequential[t];
+        DagRun_t *pxFed = &xFederated[t];
+        double dSeqAvg = (double)pxSeq->ullResponseSumNs / (double)((pxSeq->ulJobs > 0) ? pxSeq->ulJobs : 1) / 1e6;
+        double dFedAvg = (double)pxFed->ullResponseSumNs / (double)((pxFed->ulJobs > 0) ? pxFed->ulJobs : 1) / 1e6;
+        DagStats_t xStats;
+
+        vDagGetStats(pxFed->pxPool, &xStats);
+
+        printf("%-8s %-6s %6u %6.2f/%6.2f %6.2f/%6.2f %3u/%-3u %7.2f %8.2f %7llu\n", pxTasks[t]->pcName,
+               (pxSeq->iPolicyOk && pxFed->iPolicyOk) ? "fifo" : "other", (unsigned)pxFed->ulJobs, dSeqAvg,
+               (double)pxSeq->ullResponseMaxNs / 1e6, dFedAvg, (double)pxFed->ullResponseMaxNs / 1e6,
+               (unsigned)pxSeq->ulMisses, (unsigned)pxFed->ulMisses, (dFedAvg > 0.0) ? dSeqAvg / dFedAvg : 0.0,
+               (double)pxFed->ullResponseMaxNs / (double)ullDagGrahamBound(pxTasks[t], ulCores[t]),
+               (unsigned long long)xStats.ullSteals);
+
+        vDagPoolDestroy(pxFed->pxPool);
+    }
+
+    printf("Checks: exposure level %u, last search %u matches\n", (unsigned)ulExposure, (unsigned)ulMatches);
+    free(plTable);
+
+    return 0;
+}
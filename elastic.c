@@ -0,0 +1,396 @@
+/*
+ * Elastic period compression for the ipsa_sched task set.  See elastic.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "elastic.h"
+
+/* Weight of a new run-time sample in the execution time estimate. */
+#define elasticEXEC_SMOOTHING    ( 0.25f )
+
+static ElasticTask_t *pxElasticTasks[elasticMAX_TASKS];
+static uint32_t ulPreviousRunTime[elasticMAX_TASKS];
+static UBaseType_t uxElasticCount = 0;
+static float fUpper = 0.8f;
+static float fLower = 0.7f;
+static uint32_t ulPreviousTotalRunTime = 0;
+static TickType_t xEpisodeStart = 0;
+static ElasticStats_t xStats;
+
+/*-----------------------------------------------------------*/
+
+static float prvNominalUtilization(void)
+{
+    float fU = 0.0f;
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        fU += pxElasticTasks[i]->fExecTicks / (float)pxElasticTasks[i]->xNominalPeriod;
+    }
+
+    return fU;
+}
+
+static float prvUtilization(const TickType_t *pxPeriods)
+{
+    float fU = 0.0f;
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        fU += pxElasticTasks[i]->fExecTicks / (float)pxPeriods[i];
+    }
+
+    return fU;
+}
+
+/*
+ * Elastic compression (Buttazzo, Lipari, Caccamo, Abeni).  Computes into
+ * pxPeriods the periods that bring the utilization down to fTarget.  Returns
+ * pdFAIL if the target cannot be met even with every period at Tmax, in which
+ * case every elastic task is left at Tmax.
+ */
+static BaseType_t prvCompress(float fTarget, TickType_t *pxPeriods)
+{
+    BaseType_t xFixed[elasticMAX_TASKS];
+    float fMinUtilization = 0.0f;
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        ElasticTask_t *pxTask = pxElasticTasks[i];
+
+        // Rigid tasks keep their nominal period, elastic ones may go up to Tmax
+        xFixed[i] = (pxTask->fElasticity <= 0.0f) ? pdTRUE : pdFALSE;
+        pxPeriods[i] = xFixed[i] ? pxTask->xNominalPeriod : pxTask->xMaxPeriod;
+        fMinUtilization += pxTask->fExecTicks / (float)pxPeriods[i];
+    }
+
+    if (fMinUtilization > fTarget)
+    {
+        return pdFAIL;
+    }
+
+    for (;;)
+    {
+        float fFixedU = 0.0f;
+        float fVariableU = 0.0f;
+        float fVariableE = 0.0f;
+        BaseType_t xDone = pdTRUE;
+
+        for (UBaseType_t i = 0; i < uxElasticCount; i++)
+        {
+            ElasticTask_t *pxTask = pxElasticTasks[i];
+
+            if (xFixed[i])
+            {
+                fFixedU += pxTask->fExecTicks / (float)pxPeriods[i];
+            }
+            else
+            {
+                fVariableU += pxTask->fExecTicks / (float)pxTask->xNominalPeriod;
+                fVariableE += pxTask->fElasticity;
+            }
+        }
+
+        if (fVariableE <= 0.0f)
+        {
+            break;
+        }
+
+        for (UBaseType_t i = 0; i < uxElasticCount; i++)
+        {
+            ElasticTask_t *pxTask = pxElasticTasks[i];
+            float fNominalU, fMinU, fU;
+
+            if (xFixed[i])
+            {
+                continue;
+            }
+
+            fNominalU = pxTask->fExecTicks / (float)pxTask->xNominalPeriod;
+            fMinU = pxTask->fExecTicks / (float)pxTask->xMaxPeriod;
+            fU = fNominalU - (fVariableU - fTarget + fFixedU) * pxTask->fElasticity / fVariableE;
+
+            if (fU <= fMinU)
+            {
+                // Saturated: freeze at Tmax and redistribute the rest
+                xFixed[i] = pdTRUE;
+                pxPeriods[i] = pxTask->xMaxPeriod;
+                xDone = pdFALSE;
+            }
+            else if (fU >= fNominalU)
+            {
+                pxPeriods[i] = pxTask->xNominalPeriod;
+            }
+            else
+            {
+                pxPeriods[i] = (TickType_t)ceilf(pxTask->fExecTicks / fU);
+            }
+        }
+
+        if (xDone)
+        {
+            break;
+        }
+    }
+
+    return pdPASS;
+}
+
+/*
+ * Publish pxPeriods as the pending periods.  Returns the number of tasks whose
+ * period actually changed.
+ */
+static UBaseType_t prvPublish(const TickType_t *pxPeriods)
+{
+    UBaseType_t uxChanged = 0;
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        ElasticTask_t *pxTask = pxElasticTasks[i];
+        TickType_t xCurrent = pxTask->xPendingPeriod;
+        TickType_t xDelta = (pxPeriods[i] > xCurrent) ? (pxPeriods[i] - xCurrent) : (xCurrent - pxPeriods[i]);
+
+        if ((xDelta > elasticPERIOD_DEADBAND) ||
+            ((pxPeriods[i] == pxTask->xNominalPeriod) && (xCurrent != pxTask->xNominalPeriod)))
+        {
+            pxTask->xPendingPeriod = pxPeriods[i];
+            uxChanged++;
+        }
+    }
+
+    return uxChanged;
+}
+
+/*
+ * Apply the hysteresis rule to the current execution time estimates.
+ */
+static void prvRecompute(void)
+{
+    TickType_t xPeriods[elasticMAX_TASKS];
+    float fNominalU = prvNominalUtilization();
+    UBaseType_t uxChanged = 0;
+
+    if (fNominalU > fUpper)
+    {
+        if (xStats.xOverloaded == pdFALSE)
+        {
+            // Start of an overload episode
+            xStats.xOverloaded = pdTRUE;
+            xStats.ulEpisodes++;
+            xStats.ulLastEpisodeUpdates = 0;
+            xStats.xLastSettlingTicks = 0;
+            xEpisodeStart = xTaskGetTickCount();
+        }
+
+#if (elasticUSE_COMPRESSION == 1)
+        (void)prvCompress(fUpper, xPeriods);
+        uxChanged = prvPublish(xPeriods);
+        xStats.ulCompressions += (uxChanged > 0) ? 1U : 0U;
+#endif
+    }
+    else if ((xStats.xOverloaded == pdTRUE) && (fNominalU < fLower))
+    {
+        // Load is back under the lower bound: restore nominal periods
+        for (UBaseType_t i = 0; i < uxElasticCount; i++)
+        {
+            xPeriods[i] = pxElasticTasks[i]->xNominalPeriod;
+        }
+
+        uxChanged = prvPublish(xPeriods);
+        xStats.xOverloaded = pdFALSE;
+        xStats.xOverloadTicks += xTaskGetTickCount() - xEpisodeStart;
+    }
+
+    if ((uxChanged > 0) && (xStats.xOverloaded == pdTRUE))
+    {
+        xStats.ulLastEpisodeUpdates++;
+        xStats.xLastSettlingTicks = xTaskGetTickCount() - xEpisodeStart;
+    }
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        xPeriods[i] = pxElasticTasks[i]->xPendingPeriod;
+    }
+
+    xStats.fNominalUtilization = fNominalU;
+    xStats.fUtilization = prvUtilization(xPeriods);
+}
+
+/*-----------------------------------------------------------*/
+
+void vElasticInit(ElasticTask_t *pxTasks, UBaseType_t uxCount, float fUpperBound, float fLowerBound)
+{
+    configASSERT(uxCount <= elasticMAX_TASKS);
+    configASSERT(fLowerBound <= fUpperBound);
+
+    memset(&xStats, 0, sizeof(xStats));
+    uxElasticCount = 0;
+    fUpper = fUpperBound;
+    fLower = fLowerBound;
+
+    for (UBaseType_t i = 0; i < uxCount; i++)
+    {
+        pxTasks[i].xPeriod = pxTasks[i].xNominalPeriod;
+        pxTasks[i].xPendingPeriod = pxTasks[i].xNominalPeriod;
+        pxTasks[i].xRelease = xTaskGetTickCount();
+        pxElasticTasks[uxElasticCount] = &pxTasks[i];
+        ulPreviousRunTime[uxElasticCount] = 0;
+        uxElasticCount++;
+    }
+
+    // Declared execution times may already overload the set
+    prvRecompute();
+}
+
+BaseType_t xElasticAdmit(ElasticTask_t *pxTask)
+{
+    TickType_t xPeriods[elasticMAX_TASKS];
+    BaseType_t xResult = pdPASS;
+
+    if (uxElasticCount >= elasticMAX_TASKS)
+    {
+        return pdFAIL;
+    }
+
+    vTaskSuspendAll();
+    {
+        pxTask->xPeriod = pxTask->xNominalPeriod;
+        pxTask->xPendingPeriod = pxTask->xNominalPeriod;
+        pxTask->xRelease = xTaskGetTickCount();
+        pxElasticTasks[uxElasticCount] = pxTask;
+        ulPreviousRunTime[uxElasticCount] = 0;
+        uxElasticCount++;
+
+        if (prvNominalUtilization() > fUpper)
+        {
+            // Check the new work fits before committing to it
+            if (prvCompress(fUpper, xPeriods) == pdFAIL)
+            {
+                uxElasticCount--;
+                xResult = pdFAIL;
+            }
+        }
+
+        if (xResult == pdPASS)
+        {
+            prvRecompute();
+        }
+    }
+    (void)xTaskResumeAll();
+
+    return xResult;
+}
+
+void vElasticSampleRunTime(void)
+{
+    TaskStatus_t xStatus[elasticMAX_TASKS + 8];
+    UBaseType_t uxTasks;
+    uint32_t ulTotalRunTime;
+    uint32_t ulElapsed;
+
+    if (uxTaskGetNumberOfTasks() > (elasticMAX_TASKS + 8))
+    {
+        return;
+    }
+
+    uxTasks = uxTaskGetSystemState(xStatus, elasticMAX_TASKS + 8, &ulTotalRunTime);
+    ulElapsed = ulTotalRunTime - ulPreviousTotalRunTime;
+    ulPreviousTotalRunTime = ulTotalRunTime;
+
+    if (ulElapsed == 0)
+    {
+        return;
+    }
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        ElasticTask_t *pxTask = pxElasticTasks[i];
+
+        for (UBaseType_t j = 0; j < uxTasks; j++)
+        {
+            if (strcmp(xStatus[j].pcTaskName, pxTask->pcName) == 0)
+            {
+                uint32_t ulBusy = xStatus[j].ulRunTimeCounter - ulPreviousRunTime[i];
+                float fU = (float)ulBusy / (float)ulElapsed;
+
+                // Utilization times the period in force gives C in ticks
+                float fExec = fU * (float)pxTask->xPeriod;
+
+                ulPreviousRunTime[i] = xStatus[j].ulRunTimeCounter;
+                pxTask->fExecTicks += elasticEXEC_SMOOTHING * (fExec - pxTask->fExecTicks);
+                break;
+            }
+        }
+    }
+
+    prvRecompute();
+}
+
+TickType_t xElasticNextPeriod(ElasticTask_t *pxTask)
+{
+    TickType_t xNow = xTaskGetTickCount();
+
+    if (xStats.xOverloaded == pdTRUE)
+    {
+        xStats.ulOverloadJobs++;
+        xStats.ulOverloadMisses += ((TickType_t)(xNow - pxTask->xRelease) > pxTask->xPeriod) ? 1U : 0U;
+    }
+
+    // vTaskDelay() releases the next job one period from now
+    pxTask->xPeriod = pxTask->xPendingPeriod;
+    pxTask->xRelease = xNow + pxTask->xPeriod;
+
+    return pxTask->xPeriod;
+}
+
+void vElasticGetStats(ElasticStats_t *pxStats)
+{
+    float fRate = 0.0f;
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        fRate += (float)pxElasticTasks[i]->xNominalPeriod / (float)pxElasticTasks[i]->xPendingPeriod;
+    }
+
+    xStats.fRateRetained = (uxElasticCount > 0) ? (fRate / (float)uxElasticCount) : 1.0f;
+
+    *pxStats = xStats;
+
+    // Include the episode still running
+    if (xStats.xOverloaded == pdTRUE)
+    {
+        pxStats->xOverloadTicks += xTaskGetTickCount() - xEpisodeStart;
+    }
+}
+
+void vElasticReport(void)
+{
+    ElasticStats_t xReport;
+
+    vElasticGetStats(&xReport);
+
+    printf("Elastic: U0=%.3f U=%.3f overloaded=%d compression=%s\n", xReport.fNominalUtilization,
+           xReport.fUtilization, (int)xReport.xOverloaded, (elasticUSE_COMPRESSION == 1) ? "on" : "off");
+    printf("Elastic: episodes=%lu compressions=%lu last_updates=%lu settling=%lu ticks\n",
+           (unsigned long)xReport.ulEpisodes, (unsigned long)xReport.ulCompressions,
+           (unsigned long)xReport.ulLastEpisodeUpdates, (unsigned long)xReport.xLastSettlingTicks);
+    printf("Elastic: rate retained=%.3f; in %lu overload ticks %lu jobs completed, %lu missed (%.1f%%)\n",
+           xReport.fRateRetained, (unsigned long)xReport.xOverloadTicks, (unsigned long)xReport.ulOverloadJobs,
+           (unsigned long)xReport.ulOverloadMisses,
+           (xReport.ulOverloadJobs > 0) ? 100.0 * xReport.ulOverloadMisses / xReport.ulOverloadJobs : 0.0);
+
+    for (UBaseType_t i = 0; i < uxElasticCount; i++)
+    {
+        printf("Elastic: %s C=%.2f T0=%lu T=%lu Tmax=%lu\n", pxElasticTasks[i]->pcName,
+               pxElasticTasks[i]->fExecTicks, (unsigned long)pxElasticTasks[i]->xNominalPeriod,
+               (unsigned long)pxElasticTasks[i]->xPendingPeriod, (unsigned long)pxElasticTasks[i]->xMaxPeriod);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Elastic task model for the ipsa_sched task set.
+ *
+ * Each periodic task declares a nominal period T0, a maximum period Tmax and
+ * an elasticity coefficient E.  When the measured utilization of the set goes
+ * above the upper bound, the periods are stretched with Buttazzo's elastic
+ * compression algorithm: tasks give up utilization in proportion to their
+ * elasticity, and a task that reaches Tmax is frozen there while the rest of
+ * the overload is redistributed.  When the load falls below the lower bound
+ * the nominal periods are restored.  The gap between the two bounds is the
+ * hysteresis band that stops the periods from oscillating.
+ *
+ * New periods are never applied in the middle of a job: a task picks up its
+ * pending period at its next release through xElasticNextPeriod().  That call
+ * also counts the jobs completed and the deadlines missed while the set is
+ * overloaded.  With elasticUSE_COMPRESSION set to 0 the overload is detected
+ * and counted but the periods stay nominal, so the same build measures the
+ * baseline that sheds the overload by missing deadlines.
+ */
+
+#ifndef ELASTIC_H
+#define ELASTIC_H
+
+#include "FreeRTOS.h"
+
+#ifndef elasticUSE_COMPRESSION
+    #define elasticUSE_COMPRESSION    1
+#endif
+
+/* Maximum number of tasks the elastic manager can track. */
+#define elasticMAX_TASKS          ( 16 )
+
+/* A recomputed period is only published if it differs from the current one
+ * by more than this many ticks. */
+#define elasticPERIOD_DEADBAND    ( 1 )
+
+typedef struct ElasticTask
+{
+    const char *pcName;              /* Must match the name given to xTaskCreate(). */
+    TickType_t xNominalPeriod;       /* T0: period under nominal load. */
+    TickType_t xMaxPeriod;           /* Tmax: longest period the task tolerates. */
+    float fElasticity;               /* E: 0 makes the task rigid. */
+    float fExecTicks;                /* C: measured (or declared) execution time in ticks. */
+    TickType_t xPeriod;              /* Period used by the current job. */
+    volatile TickType_t xPendingPeriod; /* Period applied at the next release. */
+    TickType_t xRelease;             /* Release of the current job. */
+} ElasticTask_t;
+
+typedef struct ElasticStats
+{
+    float fNominalUtilization;       /* sum(C / T0) at the last sample. */
+    float fUtilization;              /* sum(C / T) with the periods in force. */
+    float fRateRetained;             /* mean(T0 / T): 1.0 means no stretching. */
+    uint32_t ulCompressions;         /* Compressions that changed at least one period. */
+    uint32_t ulEpisodes;             /* Number of overload episodes seen. */
+    uint32_t ulLastEpisodeUpdates;   /* Period changes published during the last episode. */
+    TickType_t xLastSettlingTicks;   /* Ticks from overload onset until the periods stopped changing. */
+    TickType_t xOverloadTicks;       /* Time spent in overload episodes. */
+    uint32_t ulOverloadJobs;         /* Jobs completed during overload episodes. */
+    uint32_t ulOverloadMisses;       /* Of those, jobs that finished after their deadline. */
+    BaseType_t xOverloaded;          /* pdTRUE during an overload episode. */
+} ElasticStats_t;
+
+/*
+ * Register the task set.  fUpperBound is the utilization that triggers a
+ * compression and is also the compression target; fLowerBound is the
+ * utilization below which nominal periods are restored.
+ */
+void vElasticInit(ElasticTask_t *pxTasks, UBaseType_t uxCount, float fUpperBound, float fLowerBound);
+
+/*
+ * Admit a new task at run time.  The set is recompressed straight away if
+ * the new work pushes it over the upper bound.  Returns pdFAIL, leaving the
+ * set untouched, if the work does not fit even with every period at Tmax.
+ */
+BaseType_t xElasticAdmit(ElasticTask_t *pxTask);
+
+/*
+ * Sample the FreeRTOS run-time statistics, refresh each task's execution
+ * time estimate and recompute the periods if needed.  Meant to be called
+ * periodically from a manager task.
+ */
+void vElasticSampleRunTime(void);
+
+/*
+ * Called by a task at the end of each job, just before it waits for its next
+ * release with vTaskDelay(); returns the period to wait.  The deadline of a
+ * job is its release plus the period it started with.
+ */
+TickType_t xElasticNextPeriod(ElasticTask_t *pxTask);
+
+void vElasticGetStats(ElasticStats_t *pxStats);
+void vElasticReport(void);
+
+#endif /* ELASTIC_H */
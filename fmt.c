@@ -0,0 +1,220 @@
+/*
+ * Number formatting for task output.  See fmt.h.
+ */
+
+#include <string.h>
+
+/* Local includes. */
+#include "fmt.h"
+
+#define fmtUINT64_DIGITS    ( 20 )
+#define fmtTEN_POW_19       ( 10000000000000000000ULL )
+
+static const char cDigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint64_t ullPowersOfTen[fmtUINT64_DIGITS] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+/*-----------------------------------------------------------*/
+
+static unsigned prvDigitCount(uint64_t ullValue)
+{
+    // log10 from the bit length (1233 / 4096 ~ log10(2)), then one compare;
+    // or-ing in 1 gives 0 its one digit and moves no other power boundary
+    uint64_t ullOdd = ullValue | 1U;
+    unsigned uBits = 64U - (unsigned)__builtin_clzll(ullOdd);
+    unsigned uGuess = (uBits * 1233U) >> 12;
+
+    return uGuess + 1U - (ullOdd < ullPowersOfTen[uGuess]);
+}
+
+/* Writes exactly uDigits digits of ullValue, zero padded, ending at pcEnd. */
+static void prvWriteDigits(char *pcEnd, uint64_t ullValue, unsigned uDigits)
+{
+    while (uDigits >= 2)
+    {
+        unsigned uPair = (unsigned)(ullValue % 100U) * 2U;
+
+        ullValue /= 100U;
+        pcEnd -= 2;
+        pcEnd[0] = cDigitPairs[uPair];
+        pcEnd[1] = cDigitPairs[uPair + 1];
+        uDigits -= 2;
+    }
+
+    if (uDigits == 1)
+    {
+        *--pcEnd = (char)('0' + ullValue % 10U);
+    }
+}
+
+static size_t prvFmtWide(char *pcBuffer, unsigned __int128 xValue)
+{
+    size_t xLength;
+
+    if ((xValue >> 64) == 0)
+    {
+        return xFmtUnsigned(pcBuffer, (uint64_t)xValue);
+    }
+
+    // At most 39 digits: a head, then 19 digit chunks
+    if (xValue / fmtTEN_POW_19 >= fmtTEN_POW_19)
+    {
+        unsigned __int128 xHigh = xValue / fmtTEN_POW_19;
+
+        xLength = xFmtUnsigned(pcBuffer, (uint64_t)(xHigh / fmtTEN_POW_19));
+        prvWriteDigits(pcBuffer + xLength + 19, (uint64_t)(xHigh % fmtTEN_POW_19), 19);
+        xLength += 19;
+    }
+    else
+    {
+        xLength = xFmtUnsigned(pcBuffer, (uint64_t)(xValue / fmtTEN_POW_19));
+    }
+
+    prvWriteDigits(pcBuffer + xLength + 19, (uint64_t)(xValue % fmtTEN_POW_19), 19);
+    xLength += 19;
+    pcBuffer[xLength] = '\0';
+
+    return xLength;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xFmtUnsigned(char *pcBuffer, uint64_t ullValue)
+{
+    unsigned uDigits = prvDigitCount(ullValue);
+
+    prvWriteDigits(pcBuffer + uDigits, ullValue, uDigits);
+    pcBuffer[uDigits] = '\0';
+
+    return uDigits;
+}
+
+size_t xFmtSigned(char *pcBuffer, int64_t llValue)
+{
+    if (llValue < 0)
+    {
+        // Negate in unsigned arithmetic so INT64_MIN is fine
+        pcBuffer[0] = '-';
+        return 1 + xFmtUnsigned(pcBuffer + 1, 0ULL - (uint64_t)llValue);
+    }
+
+    return xFmtUnsigned(pcBuffer, (uint64_t)llValue);
+}
+
+size_t xFmtFloat(char *pcBuffer, float fValue, unsigned uPrecision)
+{
+    uint32_t ulBits;
+    uint32_t ulMantissa;
+    int iExponent;
+    unsigned __int128 xInteger;
+    uint64_t ullFraction = 0;
+    size_t xLength = 0;
+
+    memcpy(&ulBits, &fValue, sizeof(ulBits));
+    ulMantissa = ulBits & 0x7FFFFFU;
+    iExponent = (int)((ulBits >> 23) & 0xFFU);
+
+    if (uPrecision > fmtMAX_PRECISION)
+    {
+        uPrecision = fmtMAX_PRECISION;
+    }
+
+    if ((ulBits >> 31) != 0)
+    {
+        pcBuffer[xLength++] = '-';
+    }
+
+    if (iExponent == 0xFF)
+    {
+        memcpy(pcBuffer + xLength, (ulMantissa != 0) ? "nan" : "inf", 4);
+        return xLength + 3;
+    }
+
+    // The value is ulMantissa * 2^iExponent exactly
+    if (iExponent == 0)
+    {
+        iExponent = -149;
+    }
+    else
+    {
+        ulMantissa |= 0x800000U;
+        iExponent -= 150;
+    }
+
+    if (iExponent >= 0)
+    {
+        xInteger = (unsigned __int128)ulMantissa << iExponent;
+    }
+    else
+    {
+        unsigned uShift = (unsigned)-iExponent;
+
+        xInteger = (uShift < 32) ? (ulMantissa >> uShift) : 0;
+
+        // Below 2^-55 the scaled fraction is under a quarter: rounds to 0
+        if (uShift <= 55)
+        {
+            uint64_t ullScaled = (uint64_t)ulMantissa & ((1ULL << uShift) - 1ULL);
+            uint64_t ullHalf = 1ULL << (uShift - 1);
+            uint64_t ullRest;
+            uint64_t ullOdd;
+
+            // fraction * 10^p < 2^24 * 10^9, exact in 64 bits
+            ullScaled *= ullPowersOfTen[uPrecision];
+            ullFraction = ullScaled >> uShift;
+            ullRest = ullScaled - (ullFraction << uShift);
+
+            // Ties to even, on the last digit printed
+            ullOdd = (uPrecision == 0) ? (uint64_t)(xInteger & 1U) : (ullFraction & 1U);
+
+            if ((ullRest > ullHalf) || ((ullRest == ullHalf) && (ullOdd != 0)))
+            {
+                ullFraction++;
+
+                if (ullFraction == ullPowersOfTen[uPrecision])
+                {
+                    ullFraction = 0;
+                    xInteger++;
+                }
+            }
+        }
+    }
+
+    xLength += prvFmtWide(pcBuffer + xLength, xInteger);
+
+    if (uPrecision > 0)
+    {
+        pcBuffer[xLength++] = '.';
+        prvWriteDigits(pcBuffer + xLength + uPrecision, ullFraction, uPrecision);
+        xLength += uPrecision;
+    }
+
+    pcBuffer[xLength] = '\0';
+
+    return xLength;
+}
+
+size_t xFmtString(char *pcBuffer, const char *pcString)
+{
+    size_t xLength = strlen(pcString);
+
+    memcpy(pcBuffer, pcString, xLength + 1);
+
+    return xLength;
+}
@@ -0,0 +1,42 @@
+/*
+ * Number formatting for task output.
+ *
+ * Integers and floats are written into a caller-provided buffer without the
+ * general printf() machinery: no format string to parse, no locale, no
+ * allocation and no stdio lock.  The work is bounded by the number of digits
+ * written, so the worst case is fixed by the type.
+ *
+ * Integers are converted two digits at a time from a lookup table, after the
+ * digit count is found from the bit length.  Floats are formatted like "%.*f"
+ * with a precision of at most fmtMAX_PRECISION, with the same rounding as
+ * glibc (the exact binary value, ties to even): a float has a 24-bit
+ * significand, so its scaled fraction fits in 64 bits and the rounding is
+ * exact without big-number arithmetic.
+ *
+ * Every function writes a terminating NUL and returns the length without it.
+ * fmt_bench.c checks the output against snprintf() and compares timings.
+ */
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define fmtMAX_PRECISION    ( 9 )
+
+/* Buffer sizes, terminating NUL included. */
+#define fmtUINT_SIZE        ( 21 )
+#define fmtINT_SIZE         ( 21 )
+#define fmtFLOAT_SIZE       ( 51 )     /* Sign, 39 digits, point, 9 decimals, NUL. */
+
+size_t xFmtUnsigned(char *pcBuffer, uint64_t ullValue);
+size_t xFmtSigned(char *pcBuffer, int64_t llValue);
+
+/* "%.*f" of fValue, the precision being clamped to fmtMAX_PRECISION. */
+size_t xFmtFloat(char *pcBuffer, float fValue, unsigned uPrecision);
+
+/* Copy of a string, for building lines; returns the length copied. */
+size_t xFmtString(char *pcBuffer, const char *pcString);
+
+#endif /* FMT_H */
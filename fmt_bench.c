@@ -0,0 +1,191 @@
+/*
+ * Checks fmt.c against snprintf() and compares their timings.
+ *
+ * Every float format is checked on random bit patterns over the whole float
+ * range and on the temperatures TX2 prints; integers on random values of
+ * every digit count.  Timings are taken per call, with the time stamp
+ * counter where there is one, and reported as median, 99th percentile and
+ * maximum, since the worst case is what matters to the jobs.
+ *
+ * Host tool, not part of the FreeRTOS build:
+ *     gcc -O2 fmt_bench.c fmt.c -o fmt_bench
+ *     ./fmt_bench [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Local includes. */
+#include "fmt.h"
+
+#define benchDEFAULT_SAMPLES    ( 1000000 )
+#define benchPRECISION          ( 6 )
+
+typedef enum
+{
+    eBenchFloat,
+    eBenchTemperature,
+    eBenchInteger
+} BenchKind_t;
+
+static uint64_t ullState = 0x9E3779B97F4A7C15ULL;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvRandom(void)
+{
+    // xorshift64*
+    ullState ^= ullState >> 12;
+    ullState ^= ullState << 25;
+    ullState ^= ullState >> 27;
+
+    return ullState * 0x2545F4914F6CDD1DULL;
+}
+
+static inline uint64_t prvStamp(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+#endif
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+static float prvFloat(BenchKind_t eKind)
+{
+    if (eKind == eBenchTemperature)
+    {
+        // What TX2 prints: a reading around 100F and its conversion
+        return (float)((int64_t)(prvRandom() % 400000) - 200000) / 1000.0f;
+    }
+    else
+    {
+        uint32_t ulBits = (uint32_t)prvRandom();
+        float fValue;
+
+        memcpy(&fValue, &ulBits, sizeof(fValue));
+
+        return fValue;
+    }
+}
+
+static int64_t prvInteger(void)
+{
+    // Uniform over digit counts rather than values
+    int64_t llValue = (int64_t)(prvRandom() >> (prvRandom() % 64));
+
+    return ((prvRandom() & 1) != 0) ? -llValue : llValue;
+}
+
+static void prvReport(const char *pcName, uint64_t *pullTimes, size_t xCount)
+{
+    qsort(pullTimes, xCount, sizeof(pullTimes[0]), prvCompare);
+    printf("  %-9s median=%6llu p99=%6llu p99.99=%7llu max=%8llu\n", pcName,
+           (unsigned long long)pullTimes[xCount / 2], (unsigned long long)pullTimes[xCount * 99 / 100],
+           (unsigned long long)pullTimes[xCount * 9999 / 10000], (unsigned long long)pullTimes[xCount - 1]);
+}
+
+static size_t prvRun(BenchKind_t eKind, size_t xSamples, uint64_t *pullFmt, uint64_t *pullLibc)
+{
+    size_t xMismatches = 0;
+
+    for (size_t i = 0; i < xSamples; i++)
+    {
+        char cFast[fmtFLOAT_SIZE];
+        char cLibc[64];
+        uint64_t ullStart;
+
+        if (eKind == eBenchInteger)
+        {
+            int64_t llValue = prvInteger();
+
+            ullStart = prvStamp();
+            xFmtSigned(cFast, llValue);
+            pullFmt[i] = prvStamp() - ullStart;
+
+            ullStart = prvStamp();
+            snprintf(cLibc, sizeof(cLibc), "%lld", (long long)llValue);
+            pullLibc[i] = prvStamp() - ullStart;
+        }
+        else
+        {
+            float fValue = prvFloat(eKind);
+            unsigned uPrecision = (eKind == eBenchFloat) ? (unsigned)(i % (fmtMAX_PRECISION + 1)) : benchPRECISION;
+
+            ullStart = prvStamp();
+            xFmtFloat(cFast, fValue, uPrecision);
+            pullFmt[i] = prvStamp() - ullStart;
+
+            ullStart = prvStamp();
+            snprintf(cLibc, sizeof(cLibc), "%.*f", (int)uPrecision, (double)fValue);
+            pullLibc[i] = prvStamp() - ullStart;
+        }
+
+        if (strcmp(cFast, cLibc) != 0)
+        {
+            if (xMismatches < 5)
+            {
+                printf("  mismatch: fmt \"%s\" snprintf \"%s\"\n", cFast, cLibc);
+            }
+
+            xMismatches++;
+        }
+    }
+
+    return xMismatches;
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    static const char *pcKinds[] = { "float, all bit patterns, %.0f..%.9f", "TX2 temperature, %.6f", "int64, %lld" };
+    size_t xSamples = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : benchDEFAULT_SAMPLES;
+    uint64_t *pullFmt = malloc(xSamples * sizeof(uint64_t));
+    uint64_t *pullLibc = malloc(xSamples * sizeof(uint64_t));
+    size_t xMismatches = 0;
+
+    if ((xSamples == 0) || (pullFmt == NULL) || (pullLibc == NULL))
+    {
+        fprintf(stderr, "fmt_bench: bad sample count\n");
+        return 1;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("Cycles per call (TSC), %zu samples each\n", xSamples);
+#else
+    printf("Nanoseconds per call, %zu samples each\n", xSamples);
+#endif
+
+    for (int k = eBenchFloat; k <= eBenchInteger; k++)
+    {
+        size_t xKindMismatches;
+
+        printf("%s\n", pcKinds[k]);
+        xKindMismatches = prvRun((BenchKind_t)k, xSamples, pullFmt, pullLibc);
+        prvReport("fmt", pullFmt, xSamples);
+        prvReport("snprintf", pullLibc, xSamples);
+        printf("  mismatches=%zu\n", xKindMismatches);
+        xMismatches += xKindMismatches;
+    }
+
+    free(pullFmt);
+    free(pullLibc);
+
+    return (xMismatches == 0) ? 0 : 1;
+}
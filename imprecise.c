@@ -0,0 +1,140 @@
+/*
+ * Imprecise-computation (anytime) jobs.  See imprecise.h.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "imprecise.h"
+
+#define impreciseTICK_US    ( 1000000ULL / configTICK_RATE_HZ )
+
+static volatile UBaseType_t uxLoadBucket = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000ULL + (uint64_t)xNow.tv_nsec / 1000ULL;
+}
+
+/* The deadline of the job on the microsecond clock, 0 if it has passed. */
+static uint64_t prvDeadlineUs(TickType_t xRelease, TickType_t xDeadline)
+{
+    uint64_t ullNowUs = prvNowUs();
+
+    // Unsigned arithmetic keeps this correct across tick count wrap-around
+    TickType_t xElapsed = xTaskGetTickCount() - xRelease;
+
+    if (xElapsed + 1 >= xDeadline)
+    {
+        return 0;
+    }
+
+    // Take the current tick as already over
+    return ullNowUs + (uint64_t)(xDeadline - xElapsed - 1) * impreciseTICK_US;
+}
+
+/*
+ * Check-and-yield hook run between optional steps.  Gives tasks of the same
+ * priority a chance to run, then reports whether another step still fits
+ * before the deadline.
+ */
+static BaseType_t prvCheckAndYield(const ImpreciseTask_t *pxTask, uint64_t ullDeadlineUs)
+{
+    uint32_t ulStepUs = (pxTask->ulLongestStepUs > pxTask->ulStepBudgetUs) ? pxTask->ulLongestStepUs
+                                                                           : pxTask->ulStepBudgetUs;
+
+    taskYIELD();
+
+    return (prvNowUs() + ulStepUs < ullDeadlineUs) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+UBaseType_t xImpreciseRunJob(ImpreciseTask_t *pxTask, TickType_t xRelease, TickType_t xDeadline)
+{
+    UBaseType_t uxBucket = uxLoadBucket;
+    UBaseType_t uxStep = 0;
+    uint64_t ullDeadlineUs;
+
+    pxTask->vMandatory(pxTask->pvContext);
+    pxTask->ulJobs++;
+
+    if (xTaskGetTickCount() - xRelease > xDeadline)
+    {
+        pxTask->ulMandatoryMisses++;
+    }
+
+    ullDeadlineUs = prvDeadlineUs(xRelease, xDeadline);
+
+    while ((uxStep < pxTask->uxMaxSteps) && (prvCheckAndYield(pxTask, ullDeadlineUs) == pdTRUE))
+    {
+        uint64_t ullStartUs = prvNowUs();
+        BaseType_t xMore = pxTask->xOptionalStep(pxTask->pvContext, uxStep);
+        uint64_t ullLengthUs = prvNowUs() - ullStartUs;
+
+        if (ullLengthUs > pxTask->ulLongestStepUs)
+        {
+            pxTask->ulLongestStepUs = (uint32_t)ullLengthUs;
+        }
+
+        uxStep++;
+
+        if (xMore == pdFALSE)
+        {
+            break;
+        }
+    }
+
+    pxTask->ulStepsDone += uxStep;
+    pxTask->ulStepsOffered += pxTask->uxMaxSteps;
+    pxTask->ulBucketStepsDone[uxBucket] += uxStep;
+    pxTask->ulBucketStepsOffered[uxBucket] += pxTask->uxMaxSteps;
+
+    return uxStep;
+}
+
+void vImpreciseSetLoad(float fLoad)
+{
+    int iBucket = (int)(fLoad * (float)impreciseLOAD_BUCKETS);
+
+    if (iBucket < 0)
+    {
+        iBucket = 0;
+    }
+    else if (iBucket >= impreciseLOAD_BUCKETS)
+    {
+        iBucket = impreciseLOAD_BUCKETS - 1;
+    }
+
+    uxLoadBucket = (UBaseType_t)iBucket;
+}
+
+void vImpreciseReport(const ImpreciseTask_t *pxTask)
+{
+    float fDone = (pxTask->ulStepsOffered > 0) ? ((float)pxTask->ulStepsDone / (float)pxTask->ulStepsOffered) : 0.0f;
+
+    printf("Imprecise: %s jobs=%lu mandatory_misses=%lu optional=%.3f longest_step=%luus\n", pxTask->pcName,
+           (unsigned long)pxTask->ulJobs, (unsigned long)pxTask->ulMandatoryMisses, fDone,
+           (unsigned long)pxTask->ulLongestStepUs);
+
+    for (UBaseType_t i = 0; i < impreciseLOAD_BUCKETS; i++)
+    {
+        if (pxTask->ulBucketStepsOffered[i] > 0)
+        {
+            printf("Imprecise: %s load %3u-%3u%% optional=%.3f\n", pxTask->pcName,
+                   (unsigned)(i * 100 / impreciseLOAD_BUCKETS), (unsigned)((i + 1) * 100 / impreciseLOAD_BUCKETS),
+                   (float)pxTask->ulBucketStepsDone[i] / (float)pxTask->ulBucketStepsOffered[i]);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Imprecise-computation (anytime) jobs.
+ *
+ * A job is split into a mandatory part, which always runs, and a sequence of
+ * optional refinement steps.  After the mandatory part the runtime keeps
+ * running optional steps while the slack left before the job's deadline is
+ * larger than the longest step seen so far, yielding between steps so that
+ * tasks of the same priority are not starved by the refinement.
+ *
+ * Steps are far shorter than a tick, so they are timed in microseconds on
+ * CLOCK_MONOTONIC.  The release and the deadline are in ticks; the slack is
+ * computed as if the current tick were already over, which errs on the side
+ * of one step too few.
+ */
+
+#ifndef IMPRECISE_H
+#define IMPRECISE_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/* Number of load buckets used to report optional work against load. */
+#define impreciseLOAD_BUCKETS    ( 10 )
+
+/* Runs one refinement step.  Returns pdFALSE once there is nothing left to
+ * refine. */
+typedef BaseType_t (*ImpreciseStepFunction_t)(void *pvContext, UBaseType_t uxStep);
+
+typedef struct ImpreciseTask
+{
+    const char *pcName;
+    void (*vMandatory)(void *pvContext);
+    ImpreciseStepFunction_t xOptionalStep;
+    void *pvContext;
+    UBaseType_t uxMaxSteps;          /* Optional steps offered per job. */
+    uint32_t ulStepBudgetUs;         /* Declared worst-case length of one step. */
+
+    /* Statistics, updated by xImpreciseRunJob(). */
+    uint32_t ulLongestStepUs;
+    uint32_t ulJobs;
+    uint32_t ulMandatoryMisses;
+    uint32_t ulStepsDone;
+    uint32_t ulStepsOffered;
+    uint32_t ulBucketStepsDone[impreciseLOAD_BUCKETS];
+    uint32_t ulBucketStepsOffered[impreciseLOAD_BUCKETS];
+} ImpreciseTask_t;
+
+/*
+ * Run one job released at xRelease with relative deadline xDeadline.
+ * Returns the number of optional steps that were completed.
+ */
+UBaseType_t xImpreciseRunJob(ImpreciseTask_t *pxTask, TickType_t xRelease, TickType_t xDeadline);
+
+/*
+ * Set the processor load (0.0 to 1.0) that subsequent jobs are accounted
+ * against, e.g. from the elastic manager's utilization estimate.
+ */
+void vImpreciseSetLoad(float fLoad);
+
+void vImpreciseReport(const ImpreciseTask_t *pxTask);
+
+#endif /* IMPRECISE_H */
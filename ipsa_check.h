@@ -0,0 +1,125 @@
+/*
+ * Compile-time schedulability check of the task table in ipsa_tasks.h.
+ *
+ * Every unit that includes ipsa_tasks.h evaluates, in integer constant
+ * expressions only, so at no run-time cost:
+ *
+ *   - the utilization of the set, which must not exceed 1, next to the Liu
+ *     and Layland bound for information;
+ *   - the exact fixed-priority response time of every task, deadline equal
+ *     to period, with a task of equal priority counted as interference
+ *     since FreeRTOS time slices between them.
+ *
+ * The response-time recurrence R = C + sum ceil(R / Tj) Cj is unrolled into
+ * 24 enumerators per task, each naming the previous one, so the expressions
+ * stay linear in size.  A step that already went past the
+ * deadline is frozen there, which keeps the values within an int.  A task
+ * that misses its deadline, or whose recurrence has not converged within
+ * the steps, fails the build with a message that names it.
+ *
+ * The analysis is the plain one: blocking, release jitter and kernel
+ * overheads are left to rta_validate.py.  Times are in microseconds, the
+ * aperiodic task counts as sporadic with its delay as minimum inter-arrival.
+ */
+
+#ifndef IPSA_CHECK_H
+#define IPSA_CHECK_H
+
+/* X(name, id, wcet_us, period, priority), the period in ticks. */
+#define ipsaCHECK_TASKS(X, i, r)                                                         \
+    X(TX1, 1, TASK1_WCET_US, TASK1_PERIOD_MS, TASK1_PRIORITY, i, r)                        \
+    X(TX2, 2, TASK2_WCET_US, TASK2_PERIOD_MS, TASK2_PRIORITY, i, r)                        \
+    X(TX3, 3, TASK3_WCET_US, TASK3_PERIOD_MS, TASK3_PRIORITY, i, r)                        \
+    X(TX4, 4, TASK4_WCET_US, TASK4_PERIOD_MS, TASK4_PRIORITY, i, r)                        \
+    X(Aperiodic, 5, APERIODIC_TASK_WCET_US, APERIODIC_TASK_DELAY_MS, APERIODIC_TASK_PRIORITY, i, r)
+
+/* The same list again, for the sum over the other tasks inside an expansion
+ * of ipsaCHECK_TASKS: a macro does not expand within itself. */
+#define ipsaCHECK_OTHERS(X, i, r)                                                        \
+    X(TX1, 1, TASK1_WCET_US, TASK1_PERIOD_MS, TASK1_PRIORITY, i, r)                        \
+    X(TX2, 2, TASK2_WCET_US, TASK2_PERIOD_MS, TASK2_PRIORITY, i, r)                        \
+    X(TX3, 3, TASK3_WCET_US, TASK3_PERIOD_MS, TASK3_PRIORITY, i, r)                        \
+    X(TX4, 4, TASK4_WCET_US, TASK4_PERIOD_MS, TASK4_PRIORITY, i, r)                        \
+    X(Aperiodic, 5, APERIODIC_TASK_WCET_US, APERIODIC_TASK_DELAY_MS, APERIODIC_TASK_PRIORITY, i, r)
+
+/* Per task constants: ipsaCHECK_<field>_<name>. */
+#define ipsaCHECK_CONSTANTS(name, id, wcet, period, prio, i, r) \
+    ipsaCHECK_ID_##name = (id),                                  \
+    ipsaCHECK_C_##name = (wcet),                                 \
+    ipsaCHECK_T_##name = (int)((period) * portTICK_PERIOD_MS * 1000),  \
+    ipsaCHECK_P_##name = (int)(prio),
+
+#define ipsaCHECK_CEIL_DIV(a, b)    (((a) + (b) - 1) / (b))
+
+/* Interference of task name on task i over a window r. */
+#define ipsaCHECK_TERM(name, id, wcet, period, prio, i, r)                              \
+    + (((ipsaCHECK_ID_##name != ipsaCHECK_ID_##i) && (ipsaCHECK_P_##name >= ipsaCHECK_P_##i)) \
+       ? ipsaCHECK_CEIL_DIV((r), ipsaCHECK_T_##name) * ipsaCHECK_C_##name : 0)
+
+#define ipsaCHECK_NEXT(i, r) \
+    (((r) > ipsaCHECK_T_##i) ? (r) : (ipsaCHECK_C_##i ipsaCHECK_OTHERS(ipsaCHECK_TERM, i, r)))
+
+#define ipsaCHECK_RTA(name, id, wcet, period, prio, i, r)                                    \
+    ipsaCHECK_R0_##name = ipsaCHECK_C_##name,                                                  \
+    ipsaCHECK_R1_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R0_##name),                           \
+    ipsaCHECK_R2_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R1_##name),                           \
+    ipsaCHECK_R3_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R2_##name),                           \
+    ipsaCHECK_R4_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R3_##name),                           \
+    ipsaCHECK_R5_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R4_##name),                           \
+    ipsaCHECK_R6_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R5_##name),                           \
+    ipsaCHECK_R7_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R6_##name),                           \
+    ipsaCHECK_R8_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R7_##name),                           \
+    ipsaCHECK_R9_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R8_##name),                           \
+    ipsaCHECK_R10_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R9_##name),                          \
+    ipsaCHECK_R11_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R10_##name),                         \
+    ipsaCHECK_R12_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R11_##name),                         \
+    ipsaCHECK_R13_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R12_##name),                         \
+    ipsaCHECK_R14_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R13_##name),                         \
+    ipsaCHECK_R15_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R14_##name),                         \
+    ipsaCHECK_R16_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R15_##name),                         \
+    ipsaCHECK_R17_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R16_##name),                         \
+    ipsaCHECK_R18_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R17_##name),                         \
+    ipsaCHECK_R19_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R18_##name),                         \
+    ipsaCHECK_R20_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R19_##name),                         \
+    ipsaCHECK_R21_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R20_##name),                         \
+    ipsaCHECK_R22_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R21_##name),                         \
+    ipsaCHECK_R23_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R22_##name),                         \
+    ipsaCHECK_R_##name = ipsaCHECK_NEXT(name, ipsaCHECK_R23_##name),                           \
+    ipsaCHECK_CONVERGED_##name = (ipsaCHECK_R_##name == ipsaCHECK_R23_##name),
+
+/* Utilization in parts per million, each term rounded up. */
+#define ipsaCHECK_UTILIZATION(name, id, wcet, period, prio, i, r) \
+    + ipsaCHECK_CEIL_DIV(ipsaCHECK_C_##name * 1000, ipsaCHECK_T_##name / 1000)
+
+#define ipsaCHECK_COUNT(name, id, wcet, period, prio, i, r)    + 1
+
+/* One enumeration, so that the constants compare without casts.  Response
+ * times are ipsaCHECK_R_<name>, in microseconds. */
+enum
+{
+    ipsaCHECK_TASKS(ipsaCHECK_CONSTANTS, 0, 0)
+    ipsaCHECK_TASKS(ipsaCHECK_RTA, 0, 0)
+
+    ipsaCHECK_TASK_COUNT = 0 ipsaCHECK_TASKS(ipsaCHECK_COUNT, 0, 0),
+    ipsaCHECK_U_PPM = 0 ipsaCHECK_TASKS(ipsaCHECK_UTILIZATION, 0, 0),
+
+    /* n (2^(1/n) - 1) for the five tasks, rounded down. */
+    ipsaCHECK_LL_BOUND_PPM = 743491,
+
+    /* Sufficient test only: the response times above are the verdict. */
+    ipsaCHECK_LL_SCHEDULABLE = (ipsaCHECK_U_PPM <= ipsaCHECK_LL_BOUND_PPM)
+};
+
+_Static_assert(ipsaCHECK_TASK_COUNT == 5, "ipsa_check.h: update ipsaCHECK_LL_BOUND_PPM for the new task count");
+_Static_assert(ipsaCHECK_U_PPM <= 1000000, "ipsa_check.h: utilization of the task set is above 1");
+
+#define ipsaCHECK_ASSERT(name, id, wcet, period, prio, i, r)                                          \
+    _Static_assert(ipsaCHECK_C_##name > 0, "ipsa_check.h: " #name " has no WCET budget");               \
+    _Static_assert(ipsaCHECK_CONVERGED_##name || (ipsaCHECK_R_##name > ipsaCHECK_T_##name),            \
+                   "ipsa_check.h: response time of " #name " has not converged, unroll more steps"); \
+    _Static_assert(ipsaCHECK_R_##name <= ipsaCHECK_T_##name,                                           \
+                   "ipsa_check.h: " #name " misses its deadline, its response time exceeds its period");
+
+ipsaCHECK_TASKS(ipsaCHECK_ASSERT, 0, 0)
+
+#endif /* IPSA_CHECK_H */
@@ -0,0 +1,158 @@
+/*
+ * Job bodies of the ipsa_sched tasks.  See ipsa_jobs.h.
+ *
+ * Output goes through output.h, which writes straight to stdout until
+ * xOutputInit() has been called.  Numbers are formatted with fmt.h rather
+ * than printf(), whose cost varies a lot more from call to call.  When a
+ * binary log is open (see binlog.h) the messages go there instead and no
+ * text is formatted at all.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Local includes. */
+#include "ipsa_jobs.h"
+#include "output.h"
+#include "fmt.h"
+#include "binlog.h"
+
+#define ipsaLIST_LENGTH    ( 50 )
+
+static const int list[ipsaLIST_LENGTH] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50};
+
+/*-----------------------------------------------------------*/
+
+void vIpsaJob1(void)
+{
+    // Print the "Working" message
+    if (!binlogPRINT("Working 1\n"))
+    {
+        vOutputPrintf(pxOutputStdout, "Working 1\n");
+    }
+}
+
+float fIpsaCelsius(float fFahrenheit)
+{
+    // Convert Fahrenheit to Celsius
+    return (fFahrenheit - 32.0f) * 5.0f / 9.0f;
+}
+
+void vIpsaPrintTemperature(float fFahrenheit, float fCelsius)
+{
+    char cLine[64];
+    size_t xLength;
+
+    if (binlogPRINT("Fahrenheit: %f, Celsius: %f\n", fFahrenheit, fCelsius))
+    {
+        return;
+    }
+
+    // Print the converted temperature, as "%f" would
+    xLength = xFmtString(cLine, "Fahrenheit: ");
+    xLength += xFmtFloat(cLine + xLength, fFahrenheit, 6);
+    xLength += xFmtString(cLine + xLength, ", Celsius: ");
+    xLength += xFmtFloat(cLine + xLength, fCelsius, 6);
+    xLength += xFmtString(cLine + xLength, "\n");
+    vOutputWrite(pxOutputStdout, cLine, xLength);
+}
+
+long int lIpsaMultiply(void)
+{
+    long int num1 = 9876543210;
+    long int num2 = 1234567890;
+
+    // Multiply the two numbers
+    return num1 * num2;
+}
+
+void vIpsaJob3(void)
+{
+    vIpsaPrintResult(lIpsaMultiply());
+}
+
+void vIpsaPrintResult(long int lResult)
+{
+    char cLine[32];
+    size_t xLength;
+
+    // Print the result
+    if (binlogPRINT("Result: %ld\n", lResult))
+    {
+        return;
+    }
+
+    xLength = xFmtString(cLine, "Result: ");
+    xLength += xFmtSigned(cLine + xLength, lResult);
+    xLength += xFmtString(cLine + xLength, "\n");
+    vOutputWrite(pxOutputStdout, cLine, xLength);
+}
+
+int xIpsaSearch(int iKey, IpsaPointHook_t vPoint, void *pvContext)
+{
+    int low = 0;
+    int high = ipsaLIST_LENGTH - 1;
+    int mid;
+
+    while (low <= high)
+    {
+        // Loop boundary: safe point for a deferred preemption
+        if (vPoint != NULL)
+        {
+            vPoint(pvContext);
+        }
+
+        mid = (low + high) / 2;
+
+        if (list[mid] == iKey)
+        {
+            return 1;
+        }
+        else if (list[mid] < iKey)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return 0;
+}
+
+const void *pvIpsaSearchTable(size_t *pxSize)
+{
+    *pxSize = sizeof(list);
+
+    return list;
+}
+
+void vIpsaPrintSearch(int iFound)
+{
+    if (iFound)
+    {
+        // Print the result
+        if (!binlogPRINT("Element found\n"))
+        {
+            vOutputPrintf(pxOutputStdout, "Element found\n");
+        }
+    }
+    else
+    {
+        // Print the result
+        if (!binlogPRINT("Element not found\n"))
+        {
+            vOutputPrintf(pxOutputStdout, "Element not found\n");
+        }
+    }
+}
+
+void vIpsaJobAperiodic(void)
+{
+    // Print a message to indicate that the task has finished executing
+    if (!binlogPRINT("Aperiodic task 1 finished\n"))
+    {
+        vOutputPrintf(pxOutputStdout, "Aperiodic task 1 finished\n");
+    }
+}
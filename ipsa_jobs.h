@@ -0,0 +1,37 @@
+/*
+ * Job bodies of the ipsa_sched tasks, free of any kernel dependency so that
+ * the FreeRTOS demo and the native Linux backend run exactly the same code.
+ */
+
+#ifndef IPSA_JOBS_H
+#define IPSA_JOBS_H
+
+#include <stddef.h>
+
+/* Called at every safe preemption point of a job. */
+typedef void (*IpsaPointHook_t)(void *pvContext);
+
+/* TX1: heartbeat. */
+void vIpsaJob1(void);
+
+/* TX2: temperature conversion and output. */
+float fIpsaCelsius(float fFahrenheit);
+void vIpsaPrintTemperature(float fFahrenheit, float fCelsius);
+
+/* TX3: multiplication and output, either together or apart. */
+void vIpsaJob3(void);
+long int lIpsaMultiply(void);
+void vIpsaPrintResult(long int lResult);
+
+/* TX4: binary search of the key table.  vPoint, if not NULL, is called at
+ * every loop boundary.  Returns 1 if the key was found. */
+int xIpsaSearch(int iKey, IpsaPointHook_t vPoint, void *pvContext);
+void vIpsaPrintSearch(int iFound);
+
+/* Key table read by xIpsaSearch(), the data working set of TX4. */
+const void *pvIpsaSearchTable(size_t *pxSize);
+
+/* Aperiodic task output. */
+void vIpsaJobAperiodic(void);
+
+#endif /* IPSA_JOBS_H */
@@ -81,7 +81,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <pthread.h>
+#include <time.h>
 
 /* Kernel includes. */
 #include "FreeRTOS.h"
@@ -91,27 +93,364 @@
 
 /* Local includes. */
 #include "console.h"
+#include "elastic.h"
+#include "imprecise.h"
+#include "preempt.h"
+#include "trace.h"
+#include "ipsa_jobs.h"
+#include "ipsa_tasks.h"
+#include "output.h"
+#include "liveness.h"
+#include "binlog.h"
+#include "calendar.h"
+#include "mode.h"
+#include "warm.h"
+#include "prioq.h"
+#include "mpmc.h"
 #include <math.h>
 
+/* Every feature below is off by default, so the stock build is the baseline
+ * demo with its job output on the console; enable the ones an experiment
+ * needs. */
 
-/* Priorities at which the tasks are created. */
+/* Set to 1 to stretch the task periods with the elastic model under overload,
+ * see elastic.h.  Requires configGENERATE_RUN_TIME_STATS.  elasticUSE_COMPRESSION
+ * set to 0 keeps the periods nominal, as the deadline-miss baseline. */
+#define mainUSE_ELASTIC_SCHEDULING    0
+
+/* Set to 1 to run TX2 as an anytime job: the conversion is mandatory and
+ * extra sensor samples are averaged in while slack remains, see imprecise.h. */
+#define mainUSE_IMPRECISE_TASKS       0
+
+/* Set to 1 to run TX3 and TX4 with fixed preemption points, see
+ * preempt.h.  preemptUSE_LIMITED_PREEMPTION selects limited or full
+ * preemption for the comparison. */
+#define mainUSE_PREEMPTION_POINTS     0
+
+/* Set to 1 to record job boundaries and context switches to traceFILE_NAME
+ * for trace_jobs.py, see trace.h. */
+#define mainUSE_TRACE                 0
+
+/* Set to 1 to write job output and the trace through the io_uring backend
+ * instead of blocking stdio calls, see output.h. */
+#define mainUSE_ASYNC_OUTPUT          0
+
+/* Set to 1 to log the job messages in binary to binlogFILE_NAME, decoded
+ * offline by binlog_decode.py, see binlog.h.  Needs mainUSE_ASYNC_OUTPUT. */
+#define mainUSE_BINARY_LOG            0
+
+#if (mainUSE_BINARY_LOG == 1) && (mainUSE_ASYNC_OUTPUT == 0)
+    #error "The binary log is written through the output backend: enable mainUSE_ASYNC_OUTPUT"
+#endif
+
+/* Set to 1 to watch every task for hangs and starvation, see liveness.h. */
+#define mainUSE_LIVENESS_MONITOR      0
+
+/* Set to 1 to release the jobs from a precomputed hyperperiod calendar walked
+ * by a single dispatcher, instead of one vTaskDelay() per task, see
+ * calendar.h.  The calendar is mapped from mainCALENDAR_FILE if it exists
+ * (calendar_bench --write), built at startup otherwise.  Fixed periods only:
+ * excludes mainUSE_ELASTIC_SCHEDULING. */
+#define mainUSE_RELEASE_CALENDAR      0
+#define mainCALENDAR_FILE             "ipsa_calendar.bin"
+
+#if (mainUSE_RELEASE_CALENDAR == 1) && (mainUSE_ELASTIC_SCHEDULING == 1)
+    #error "The release calendar needs fixed periods: disable mainUSE_ELASTIC_SCHEDULING"
+#endif
+
+/* Set to 1 to warm the working set each task registers, cache lines and TLB,
+ * WARM_LEAD_TICKS before its release, see warm.h.  The hook runs in the task
+ * itself, or in the dispatcher with mainUSE_RELEASE_CALENDAR. */
+#define mainUSE_PREFETCH              0
+
+/* Set to 1 to run the task set in operating modes, startup then nominal and
+ * degraded in turn, each with its own task table, switched with the
+ * mainMODE_PROTOCOL transition protocol, see mode.h.  The mode tables replace
+ * the fixed TX1..TX4 tasks, so the features that release or watch those
+ * tasks are left out. */
+#define mainUSE_MODE_CHANGE           0
+#define mainMODE_PROTOCOL             eModeUnchangedContinuation
+
+/* Set to 1 to measure how long urgent messages wait behind bursts of bulk
+ * messages, through a FIFO queue and through priority and deadline ordered
+ * queues side by side, see prioq.h, and through the lock-free FIFO of
+ * mpmc.h. */
+#define mainUSE_MESSAGE_QUEUES        0
+
+#if (mainUSE_MODE_CHANGE == 1) && ((mainUSE_ELASTIC_SCHEDULING == 1) || (mainUSE_RELEASE_CALENDAR == 1))
+    #error "Mode changes set the periods: disable mainUSE_ELASTIC_SCHEDULING and mainUSE_RELEASE_CALENDAR"
+#endif
+
+/* Periods and priorities of the tasks are in ipsa_tasks.h. */
 #define mainQUEUE_LENGTH           (2)
-#define TASK1_PERIOD_MS            (166 / portTICK_PERIOD_MS)
-#define TASK2_PERIOD_MS            (170 / portTICK_PERIOD_MS)
-#define TASK3_PERIOD_MS            (186/ portTICK_PERIOD_MS)
-#define TASK4_PERIOD_MS            (166 / portTICK_PERIOD_MS)
-#define APERIODIC_TASK_DELAY_MS    (50 / portTICK_PERIOD_MS)
+#define TASK4_SEARCH_KEY           (25)
+
+/* Elastic model parameters: longest tolerated period and elasticity. */
+#define TASK1_MAX_PERIOD_MS        (2 * TASK1_PERIOD_MS)
+#define TASK2_MAX_PERIOD_MS        (2 * TASK2_PERIOD_MS)
+#define TASK3_MAX_PERIOD_MS        (3 * TASK3_PERIOD_MS)
+#define TASK4_MAX_PERIOD_MS        (TASK4_PERIOD_MS + TASK4_PERIOD_MS / 2)
+#define TASK1_ELASTICITY           (1.0f)
+#define TASK2_ELASTICITY           (1.0f)
+#define TASK3_ELASTICITY           (2.0f)
+#define TASK4_ELASTICITY           (0.5f)
+
+/* Utilization above which periods are stretched, and below which the nominal
+ * periods come back. */
+#define ELASTIC_UPPER_BOUND        (0.80f)
+#define ELASTIC_LOWER_BOUND        (0.65f)
+#define ELASTIC_MANAGER_PERIOD_MS  (1000 / portTICK_PERIOD_MS)
+#define ELASTIC_MANAGER_PRIORITY   (tskIDLE_PRIORITY + 6)
+
+/* Statistics of the enabled features are printed at this rate. */
+#define REPORT_PERIOD_MS           (10000 / portTICK_PERIOD_MS)
+#define REPORT_TASK_PRIORITY       (tskIDLE_PRIORITY + 1)
+
+/* The liveness monitor must outrank the tasks it watches to see starvation. */
+#define LIVENESS_MONITOR_PRIORITY  (configMAX_PRIORITIES - 1)
+
+/* Releases must not wait behind the jobs they release. */
+#define CALENDAR_DISPATCHER_PRIORITY  (configMAX_PRIORITIES - 1)
+
+/* Working sets are warmed this long before the release. */
+#define WARM_LEAD_TICKS            (1)
+
+/* Mode requests of the demo: nominal after startup, then degraded and
+ * nominal in turn. */
+#define MODE_STARTUP_MS            (2000 / portTICK_PERIOD_MS)
+#define MODE_SWITCH_PERIOD_MS      (5000 / portTICK_PERIOD_MS)
+#define MODE_DRIVER_PRIORITY       (tskIDLE_PRIORITY + 1)
+#define MODE_DISPATCHER_PRIORITY   (configMAX_PRIORITIES - 1)
 
-#define TASK1_PRIORITY             (tskIDLE_PRIORITY + 1)
-#define TASK2_PRIORITY             (tskIDLE_PRIORITY + 2)
-#define TASK3_PRIORITY             (tskIDLE_PRIORITY + 3)
-#define TASK4_PRIORITY             (tskIDLE_PRIORITY + 4)
-#define APERIODIC_TASK_PRIORITY    (tskIDLE_PRIORITY + 5)
+/* Message latency experiment: every period a burst of bulk messages, then
+ * one urgent message, each handled in MESSAGE_COST_US by the receiver. */
+#define MESSAGE_QUEUE_LENGTH       (16)
+#define MESSAGE_PERIOD_MS          (20 / portTICK_PERIOD_MS)
+#define MESSAGE_BURST              (8)
+#define MESSAGE_COST_US            (200)
+#define MESSAGE_URGENT_DEADLINE_MS (2 / portTICK_PERIOD_MS)
+#define MESSAGE_BULK_PRIORITY      (tskIDLE_PRIORITY + 1)
+#define MESSAGE_RECEIVER_PRIORITY  (tskIDLE_PRIORITY + 2)
+#define MESSAGE_URGENT_PRIORITY    (tskIDLE_PRIORITY + 3)
+
+/* Optional refinement steps offered to each TX2 job. */
+#define TASK2_OPTIONAL_STEPS       (16)
+#define TASK2_STEP_BUDGET_US       (50)
+
+/* Half-width of the uniform noise on one TX2 sensor sample, in Fahrenheit. */
+#define TASK2_SENSOR_NOISE_F       (2.0f)
 
 
 /* The queue used by both tasks. */
 static QueueHandle_t xQueue = NULL;
 
+#if (mainUSE_ELASTIC_SCHEDULING == 1)
+
+/* Elastic description of the periodic tasks, indexed as TX1..TX4. */
+static ElasticTask_t xElasticTasks[] =
+{
+    { "TX1", TASK1_PERIOD_MS, TASK1_MAX_PERIOD_MS, TASK1_ELASTICITY, 0.0f, 0, 0 },
+    { "TX2", TASK2_PERIOD_MS, TASK2_MAX_PERIOD_MS, TASK2_ELASTICITY, 0.0f, 0, 0 },
+    { "TX3", TASK3_PERIOD_MS, TASK3_MAX_PERIOD_MS, TASK3_ELASTICITY, 0.0f, 0, 0 },
+    { "TX4", TASK4_PERIOD_MS, TASK4_MAX_PERIOD_MS, TASK4_ELASTICITY, 0.0f, 0, 0 },
+};
+
+    #define mainNEXT_PERIOD(n, xNominal)    xElasticNextPeriod(&xElasticTasks[(n)])
+#else
+    #define mainNEXT_PERIOD(n, xNominal)    (xNominal)
+#endif
+
+#if (mainUSE_IMPRECISE_TASKS == 1)
+
+/* Sensor frame refined by the optional part of TX2: every sample of the
+ * temperature carries noise, and each step averages one more in. */
+typedef struct TemperatureFrame
+{
+    float fFahrenheit;
+    float fSum;
+    UBaseType_t uxSamples;
+    float fCelsius;
+    uint32_t ulNoise;
+} TemperatureFrame_t;
+
+static TemperatureFrame_t xTask2Frame = { .ulNoise = 0x2545F491u };
+
+static void prvTask2Mandatory(void *pvContext);
+static BaseType_t prvTask2Refine(void *pvContext, UBaseType_t uxStep);
+
+static ImpreciseTask_t xTask2Imprecise =
+{
+    .pcName = "TX2",
+    .vMandatory = prvTask2Mandatory,
+    .xOptionalStep = prvTask2Refine,
+    .pvContext = &xTask2Frame,
+    .uxMaxSteps = TASK2_OPTIONAL_STEPS,
+    .ulStepBudgetUs = TASK2_STEP_BUDGET_US,
+};
+#endif
+
+#if (mainUSE_PREEMPTION_POINTS == 1)
+
+/* Preemption point statistics of TX3 and TX4.  TX1 is left out: its job is
+ * all output, which must stay out of a non-preemptive region, so it runs
+ * fully preemptive. */
+static PreemptTask_t xPreemptTasks[] =
+{
+    { .pcName = "TX3" },
+    { .pcName = "TX4" },
+};
+
+static void prvPreemptionPoint(void *pvContext);
+
+    #define mainJOB_START(n)          vPreemptJobStart(&xPreemptTasks[(n)])
+    #define mainPREEMPTION_HOOK       prvPreemptionPoint
+    #define mainPREEMPTION_CONTEXT(n) (&xPreemptTasks[(n)])
+    #define mainJOB_END(n)            vPreemptJobEnd(&xPreemptTasks[(n)])
+#else
+    #define mainJOB_START(n)
+    #define mainPREEMPTION_HOOK       NULL
+    #define mainPREEMPTION_CONTEXT(n) NULL
+    #define mainJOB_END(n)
+#endif
+
+#if (mainUSE_LIVENESS_MONITOR == 1)
+
+/* Progress counters of the tasks, indexed as TX1..TX4 then Aperiodic.  The
+ * deadline covers the longest period the elastic manager may set. */
+static LivenessTask_t xLivenessTasks[] =
+{
+    { .pcName = "TX1", .xPeriod = TASK1_PERIOD_MS, .xDeadline = TASK1_MAX_PERIOD_MS },
+    { .pcName = "TX2", .xPeriod = TASK2_PERIOD_MS, .xDeadline = TASK2_MAX_PERIOD_MS },
+    { .pcName = "TX3", .xPeriod = TASK3_PERIOD_MS, .xDeadline = TASK3_MAX_PERIOD_MS },
+    { .pcName = "TX4", .xPeriod = TASK4_PERIOD_MS, .xDeadline = TASK4_MAX_PERIOD_MS },
+    { .pcName = "Aperiodic", .xPeriod = APERIODIC_TASK_DELAY_MS, .xDeadline = APERIODIC_TASK_DELAY_MS },
+};
+
+    #define mainTASK_HANDLE(n)        (&xLivenessTasks[(n)].xHandle)
+    #define mainLIVENESS_BEAT(n)      vLivenessBeat(&xLivenessTasks[(n)])
+#else
+
+/* Handles of TX1..TX4 then Aperiodic, for the release calendar. */
+static TaskHandle_t xTaskHandles[5];
+
+    #define mainTASK_HANDLE(n)        (&xTaskHandles[(n)])
+    #define mainLIVENESS_BEAT(n)
+#endif
+
+#if (mainUSE_PREFETCH == 1)
+
+/* Working sets of TX1..TX4 then Aperiodic, registered by prvWarmInit(). */
+static WarmSet_t xWarmSets[5];
+
+    #define mainPRE_RELEASE(n)        vWarmTouch(&xWarmSets[(n)])
+#else
+    #define mainPRE_RELEASE(n)
+#endif
+
+#if (mainUSE_RELEASE_CALENDAR == 1)
+
+/* Releases of TX1..TX4 then Aperiodic: bit n of a mask is mainTASK_HANDLE(n). */
+static Calendar_t xCalendar;
+
+    #define mainWAIT_RELEASE(n, xPeriod)    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY)
+#elif (mainUSE_PREFETCH == 1)
+    #define mainWAIT_RELEASE(n, xPeriod)    prvWaitWarm((n), (xPeriod))
+#else
+    #define mainWAIT_RELEASE(n, xPeriod)    vTaskDelay(xPeriod)
+#endif
+
+#if (mainUSE_MODE_CHANGE == 1)
+
+static void prvModeJob2(void);
+static void prvModeJob4(void);
+
+/* Pool of the mode tables: TX1..TX4 then Aperiodic. */
+static ModeTask_t xModeTasks[] =
+{
+    { .pcName = "TX1", .vJob = vIpsaJob1, .uxPriority = TASK1_PRIORITY, .ulWcetUs = TASK1_WCET_US },
+    { .pcName = "TX2", .vJob = prvModeJob2, .uxPriority = TASK2_PRIORITY, .ulWcetUs = TASK2_WCET_US },
+    { .pcName = "TX3", .vJob = vIpsaJob3, .uxPriority = TASK3_PRIORITY, .ulWcetUs = TASK3_WCET_US },
+    { .pcName = "TX4", .vJob = prvModeJob4, .uxPriority = TASK4_PRIORITY, .ulWcetUs = TASK4_WCET_US },
+    { .pcName = "Aperiodic", .vJob = vIpsaJobAperiodic, .uxPriority = APERIODIC_TASK_PRIORITY,
+      .ulWcetUs = APERIODIC_TASK_WCET_US },
+};
+
+/* Startup: heartbeat and a slow temperature reading. */
+static const ModeEntry_t xStartupTasks[] =
+{
+    { 0, TASK1_PERIOD_MS }, { 1, 2 * TASK2_PERIOD_MS },
+};
+
+static const ModeEntry_t xNominalTasks[] =
+{
+    { 0, TASK1_PERIOD_MS }, { 1, TASK2_PERIOD_MS }, { 2, TASK3_PERIOD_MS }, { 3, TASK4_PERIOD_MS },
+    { 4, APERIODIC_TASK_DELAY_MS },
+};
+
+/* Degraded: TX3 and the aperiodic output are shed, TX2 and TX4 slowed down. */
+static const ModeEntry_t xDegradedTasks[] =
+{
+    { 0, TASK1_PERIOD_MS }, { 1, TASK2_MAX_PERIOD_MS }, { 3, TASK4_MAX_PERIOD_MS },
+};
+
+    #define mainMODE_STARTUP          (0)
+    #define mainMODE_NOMINAL          (1)
+    #define mainMODE_DEGRADED         (2)
+
+static const Mode_t xModes[] =
+{
+    { "startup", xStartupTasks, sizeof(xStartupTasks) / sizeof(xStartupTasks[0]) },
+    { "nominal", xNominalTasks, sizeof(xNominalTasks) / sizeof(xNominalTasks[0]) },
+    { "degraded", xDegradedTasks, sizeof(xDegradedTasks) / sizeof(xDegradedTasks[0]) },
+};
+#endif
+
+#if (mainUSE_MESSAGE_QUEUES == 1)
+
+typedef struct IpsaMessage
+{
+    BaseType_t xUrgent;
+    uint64_t ullSentNs;
+} IpsaMessage_t;
+
+/* One sender pair and receiver over one queue; the FIFO channels have no order. */
+typedef struct MessageChannel
+{
+    const char *pcName;
+    BaseType_t xFifo;
+    BaseType_t xLockFree;
+    PrioQueueOrder_t eOrder;
+    QueueHandle_t xFifoQueue;
+    MpmcQueueHandle_t xLockFreeQueue;
+    PrioQueueHandle_t xOrderedQueue;
+    uint32_t ulUrgent;
+    uint32_t ulBulk;
+    uint32_t ulDropped;
+    uint64_t ullUrgentTotalNs;
+    uint64_t ullUrgentMaxNs;
+} MessageChannel_t;
+
+static MessageChannel_t xChannels[] =
+{
+    { .pcName = "fifo", .xFifo = pdTRUE },
+    { .pcName = "lockfree", .xFifo = pdTRUE, .xLockFree = pdTRUE },
+    { .pcName = "priority", .eOrder = ePrioQueueByPriority },
+    { .pcName = "deadline", .eOrder = ePrioQueueByDeadline },
+};
+#endif
+
+#if (mainUSE_TRACE == 1)
+    #define mainTRACE_JOB_START()     vTraceJobStart()
+    #define mainTRACE_JOB_END()       vTraceJobEnd()
+#else
+    #define mainTRACE_JOB_START()
+    #define mainTRACE_JOB_END()
+#endif
+
+void vIpsaTaskSwitchedIn(void);
+void vIpsaTaskSwitchedOut(void);
+void vIpsaTaskReady(void *pvTask);
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -122,22 +461,105 @@ static void vPeriodicTask2(void *params);
 static void vPeriodicTask3(void *params);
 static void vPeriodicTask4(void *params);
 static void aperiodicTask1(void *params);
+#if (mainUSE_ELASTIC_SCHEDULING == 1)
+static void prvElasticManagerTask(void *params);
+#endif
+static void prvReportTask(void *params);
+#if (mainUSE_MODE_CHANGE == 1)
+static void prvModeDriverTask(void *params);
+#endif
+#if (mainUSE_MESSAGE_QUEUES == 1)
+static void prvMessageInit(void);
+static void prvBulkSenderTask(void *params);
+static void prvUrgentSenderTask(void *params);
+static void prvMessageReceiverTask(void *params);
+#endif
+#if (mainUSE_LIVENESS_MONITOR == 1)
+static void prvLivenessMonitorTask(void *params);
+#endif
+#if (mainUSE_RELEASE_CALENDAR == 1)
+static BaseType_t prvCalendarInit(void);
+static void prvCalendarDispatcherTask(void *params);
+#endif
+#if (mainUSE_PREEMPTION_POINTS == 1)
+static void prvAnalysePreemptionPoints(void);
+#endif
+#if (mainUSE_PREFETCH == 1)
+static void prvWarmInit(void);
+#if (mainUSE_RELEASE_CALENDAR == 0)
+static void prvWaitWarm(UBaseType_t uxTask, TickType_t xPeriod);
+#endif
+#endif
 
 /*-----------------------------------------------------------*/
 
 void ipsa_sched(void)
 {
+#if (mainUSE_ASYNC_OUTPUT == 1)
+    /* Before any task exists, see xOutputInit(). */
+    if (xOutputInit() != 0)
+    {
+        printf("Output: asynchronous backend unavailable, using stdio\n");
+    }
+#endif
+#if (mainUSE_BINARY_LOG == 1)
+    if (xBinlogInit(binlogFILE_NAME) != 0)
+    {
+        printf("Binlog: cannot open %s, job messages stay text\n", binlogFILE_NAME);
+    }
+#endif
+
+#if (mainUSE_PREFETCH == 1)
+    prvWarmInit();
+#endif
+
     /* Create the queue. */
     xQueue = xQueueCreate(mainQUEUE_LENGTH, sizeof(uint32_t));
 
     if (xQueue != NULL)
     {
+#if (mainUSE_MODE_CHANGE == 1)
+        if (xModeInit(xModeTasks, sizeof(xModeTasks) / sizeof(xModeTasks[0]), xModes,
+                      sizeof(xModes) / sizeof(xModes[0]), mainMODE_PROTOCOL, mainMODE_STARTUP,
+                      MODE_DISPATCHER_PRIORITY) == pdPASS)
+        {
+            xTaskCreate(prvModeDriverTask, "ModeDriver", configMINIMAL_STACK_SIZE, NULL, MODE_DRIVER_PRIORITY, NULL);
+        }
+#else
         /* Start the tasks as described in the comments at the top of this file. */
-        xTaskCreate(vPeriodicTask1, "TX1", configMINIMAL_STACK_SIZE, NULL, TASK1_PRIORITY, NULL);
-        xTaskCreate(vPeriodicTask2, "TX2", configMINIMAL_STACK_SIZE, NULL, TASK2_PRIORITY, NULL);
-        xTaskCreate(vPeriodicTask3, "TX3", configMINIMAL_STACK_SIZE, NULL, TASK3_PRIORITY, NULL);
-        xTaskCreate(vPeriodicTask4, "TX4", configMINIMAL_STACK_SIZE, NULL, TASK4_PRIORITY, NULL);
-        xTaskCreate(aperiodicTask1, "Aperiodic", configMINIMAL_STACK_SIZE, NULL, APERIODIC_TASK_PRIORITY, NULL);
+        xTaskCreate(vPeriodicTask1, "TX1", configMINIMAL_STACK_SIZE, NULL, TASK1_PRIORITY, mainTASK_HANDLE(0));
+        xTaskCreate(vPeriodicTask2, "TX2", configMINIMAL_STACK_SIZE, NULL, TASK2_PRIORITY, mainTASK_HANDLE(1));
+        xTaskCreate(vPeriodicTask3, "TX3", configMINIMAL_STACK_SIZE, NULL, TASK3_PRIORITY, mainTASK_HANDLE(2));
+        xTaskCreate(vPeriodicTask4, "TX4", configMINIMAL_STACK_SIZE, NULL, TASK4_PRIORITY, mainTASK_HANDLE(3));
+        xTaskCreate(aperiodicTask1, "Aperiodic", configMINIMAL_STACK_SIZE, NULL, APERIODIC_TASK_PRIORITY, mainTASK_HANDLE(4));
+
+#if (mainUSE_ELASTIC_SCHEDULING == 1)
+        vElasticInit(xElasticTasks, sizeof(xElasticTasks) / sizeof(xElasticTasks[0]), ELASTIC_UPPER_BOUND, ELASTIC_LOWER_BOUND);
+        xTaskCreate(prvElasticManagerTask, "Elastic", configMINIMAL_STACK_SIZE * 2, NULL, ELASTIC_MANAGER_PRIORITY, NULL);
+#endif
+
+#if (mainUSE_PREEMPTION_POINTS == 1)
+        prvAnalysePreemptionPoints();
+#endif
+
+#if (mainUSE_RELEASE_CALENDAR == 1)
+        if (prvCalendarInit() == pdPASS)
+        {
+            xTaskCreate(prvCalendarDispatcherTask, "Calendar", configMINIMAL_STACK_SIZE, NULL, CALENDAR_DISPATCHER_PRIORITY, NULL);
+        }
+#endif
+
+#if (mainUSE_LIVENESS_MONITOR == 1)
+        vLivenessInit(xLivenessTasks, sizeof(xLivenessTasks) / sizeof(xLivenessTasks[0]));
+        xTaskCreate(prvLivenessMonitorTask, "Liveness", configMINIMAL_STACK_SIZE, NULL, LIVENESS_MONITOR_PRIORITY, NULL);
+#endif
+#endif /* mainUSE_MODE_CHANGE */
+
+#if (mainUSE_MESSAGE_QUEUES == 1)
+        prvMessageInit();
+#endif
+
+        xTaskCreate(prvReportTask, "Report", configMINIMAL_STACK_SIZE * 2, NULL, REPORT_TASK_PRIORITY, NULL);
 
         /* Start the scheduler. */
         vTaskStartScheduler();
@@ -155,110 +577,623 @@ void ipsa_sched(void)
 
 /*-----------------------------------------------------------*/
 
+/* traceTASK_SWITCHED_IN() and traceTASK_SWITCHED_OUT(), see preempt.h: the
+ * kernel takes one definition of each, so every switch consumer is chained
+ * here. */
+void vIpsaTaskSwitchedIn(void)
+{
+#if (mainUSE_PREEMPTION_POINTS == 1)
+    vPreemptTraceSwitchedIn();
+#endif
+#if (mainUSE_TRACE == 1)
+    vTraceSwitchedIn(xTaskGetCurrentTaskHandle());
+#endif
+}
+
+void vIpsaTaskSwitchedOut(void)
+{
+#if (mainUSE_TRACE == 1)
+    vTraceSwitchedOut(xTaskGetCurrentTaskHandle());
+#endif
+}
+
+/* traceMOVED_TASK_TO_READY_STATE(), see trace.h: the periodic tasks only
+ * block in their release wait, so this is the release of their next job. */
+void vIpsaTaskReady(void *pvTask)
+{
+#if (mainUSE_TRACE == 1)
+    vTraceReleased((TaskHandle_t)pvTask);
+#else
+    (void)pvTask;
+#endif
+}
+
+/*-----------------------------------------------------------*/
+
 void vPeriodicTask1(void *params)
 {
     for (;;)
     {
-        // Print the "Working" message
-        printf("Working 1\n");
+        mainTRACE_JOB_START();
+
+        vIpsaJob1();
+
+        mainTRACE_JOB_END();
+        mainLIVENESS_BEAT(0);
 
         // Wait for the specified period before running again
-        vTaskDelay(TASK1_PERIOD_MS);
+        mainWAIT_RELEASE(0, mainNEXT_PERIOD(0, TASK1_PERIOD_MS));
     }
 }
 
 void vPeriodicTask2(void *params)
 {
     float fahrenheit = 100.0f; // Fixed Fahrenheit temperature value
+#if (mainUSE_IMPRECISE_TASKS == 1)
+    TickType_t xRelease = xTaskGetTickCount();
+    TickType_t xPeriod = mainNEXT_PERIOD(1, TASK2_PERIOD_MS);
+#endif
 
     for (;;)
     {
-        // Convert Fahrenheit to Celsius
-        float celsius = (fahrenheit - 32.0f) * 5.0f / 9.0f;
+        mainTRACE_JOB_START();
+
+#if (mainUSE_IMPRECISE_TASKS == 1)
+        // Mandatory conversion, then average in more samples while slack
+        // remains before the next release
+        xTask2Frame.fFahrenheit = fahrenheit;
+        (void)xImpreciseRunJob(&xTask2Imprecise, xRelease, xPeriod);
+        float celsius = xTask2Frame.fCelsius;
+#else
+        float celsius = fIpsaCelsius(fahrenheit);
+#endif
 
-        // Print the converted temperature
-        printf("Fahrenheit: %f, Celsius: %f\n", fahrenheit, celsius);
+        vIpsaPrintTemperature(fahrenheit, celsius);
+
+        mainTRACE_JOB_END();
+        mainLIVENESS_BEAT(1);
 
         // Wait for the specified period before running again
-        vTaskDelay(TASK2_PERIOD_MS);
+#if (mainUSE_IMPRECISE_TASKS == 1)
+        xPeriod = mainNEXT_PERIOD(1, TASK2_PERIOD_MS);
+        mainWAIT_RELEASE(1, xPeriod);
+        xRelease = xTaskGetTickCount();
+#else
+        mainWAIT_RELEASE(1, mainNEXT_PERIOD(1, TASK2_PERIOD_MS));
+#endif
     }
 }
 
 void vPeriodicTask3(void *params)
 {
-    long int num1 = 9876543210;
-    long int num2 = 1234567890;
-    long int result = 0;
-
     for (;;)
     {
-        // Multiply the two numbers
-        result = num1 * num2;
+        mainTRACE_JOB_START();
+        mainJOB_START(0);
+
+        long int result = lIpsaMultiply();
+
+        mainJOB_END(0);
+
+        vIpsaPrintResult(result);
 
-        // Print the result
-        printf("Result: %ld\n", result);
+        mainTRACE_JOB_END();
+        mainLIVENESS_BEAT(2);
 
         // Wait for the specified period before running again
-        vTaskDelay(TASK3_PERIOD_MS);
+        mainWAIT_RELEASE(2, mainNEXT_PERIOD(2, TASK3_PERIOD_MS));
     }
 }
 
 void vPeriodicTask4(void *params)
 {
-    int list[50] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50};
-    int element_to_find = 25;
-    int low, high, mid;
-    int found = 0;
+    int found;
+
+    for (;;)
+    {
+        mainTRACE_JOB_START();
+        mainJOB_START(1);
+
+        // Each job searches the whole list again
+        found = xIpsaSearch(TASK4_SEARCH_KEY, mainPREEMPTION_HOOK, mainPREEMPTION_CONTEXT(1));
+
+        mainJOB_END(1);
+
+        vIpsaPrintSearch(found);
+
+        mainTRACE_JOB_END();
+        mainLIVENESS_BEAT(3);
+
+        // Wait for the specified period before running again
+        mainWAIT_RELEASE(3, mainNEXT_PERIOD(3, TASK4_PERIOD_MS));
+    }
+}
+
+void aperiodicTask1(void *params)
+{
+    while (1)
+    {
+        // Do some work that takes 100ms
+        // In this example, we use vTaskDelay() to simulate the work
+        mainWAIT_RELEASE(4, APERIODIC_TASK_DELAY_MS);
 
-    low = 0;
-    high = 49;
+        vIpsaJobAperiodic();
+        mainLIVENESS_BEAT(4);
+    }
+}
+
+#if (mainUSE_ELASTIC_SCHEDULING == 1)
+static void prvElasticManagerTask(void *params)
+{
+    TickType_t xLastWake = xTaskGetTickCount();
 
     for (;;)
     {
-        while (low <= high)
+        vTaskDelayUntil(&xLastWake, ELASTIC_MANAGER_PERIOD_MS);
+
+        // Refresh the execution time estimates and stretch periods if needed
+        vElasticSampleRunTime();
+
+#if (mainUSE_IMPRECISE_TASKS == 1)
         {
-            mid = (low + high) / 2;
+            ElasticStats_t xStats;
 
-            if (list[mid] == element_to_find)
-            {
-                found = 1;
-                break;
-            }
-            else if (list[mid] < element_to_find)
+            // Account the anytime jobs against the current load
+            vElasticGetStats(&xStats);
+            vImpreciseSetLoad(xStats.fUtilization);
+        }
+#endif
+
+    }
+}
+#endif
+
+#if (mainUSE_LIVENESS_MONITOR == 1)
+static void prvLivenessMonitorTask(void *params)
+{
+    TickType_t xLastWake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        // Only the tasks due at this tick are looked at
+        vTaskDelayUntil(&xLastWake, 1);
+        vLivenessCheck();
+    }
+}
+#endif
+
+#if (mainUSE_RELEASE_CALENDAR == 1)
+static BaseType_t prvCalendarInit(void)
+{
+    const uint32_t ulPeriods[] =
+    {
+        TASK1_PERIOD_MS, TASK2_PERIOD_MS, TASK3_PERIOD_MS, TASK4_PERIOD_MS, APERIODIC_TASK_DELAY_MS
+    };
+    const uint32_t ulTasks = sizeof(ulPeriods) / sizeof(ulPeriods[0]);
+
+    // A saved calendar is only used if it was made for this task table
+    if ((xCalendarMap(&xCalendar, mainCALENDAR_FILE) == 0) && ((xCalendar.pxHeader->ulTasks != ulTasks) ||
+        (xCalendar.pxHeader->ulHyperperiod != ulCalendarHyperperiod(ulPeriods, ulTasks))))
+    {
+        printf("Calendar: %s does not match the task table, rebuilding\n", mainCALENDAR_FILE);
+        vCalendarFree(&xCalendar);
+    }
+
+    if ((xCalendar.pxHeader == NULL) && (xCalendarBuild(&xCalendar, ulPeriods, NULL, ulTasks) != 0))
+    {
+        printf("Calendar: cannot build the release calendar, tasks are not released\n");
+        return pdFAIL;
+    }
+
+    printf("Calendar: hyperperiod=%lu ticks entries=%lu releases=%lu %s\n",
+           (unsigned long)xCalendar.pxHeader->ulHyperperiod, (unsigned long)xCalendar.pxHeader->ulEntries,
+           (unsigned long)xCalendar.pxHeader->ulReleases, xCalendar.iMapped ? "mapped" : "built");
+
+    return pdPASS;
+}
+
+static void prvCalendarDispatcherTask(void *params)
+{
+    CalendarCursor_t xCursor;
+    TickType_t xLastWake = xTaskGetTickCount();
+    const CalendarEntry_t *pxEntry;
+    uint64_t ullPrevious;
+    uint64_t ullNext;
+
+    // Every task runs its first job when created: the entry at 0 is consumed
+    vCalendarStart(&xCursor, &xCalendar, 0);
+    (void)pxCalendarNext(&xCursor, &ullPrevious);
+
+    for (;;)
+    {
+        uint32_t ulMask;
+
+        pxEntry = pxCalendarNext(&xCursor, &ullNext);
+
+        // Further words of the same instant are released without waiting
+        if (ullNext != ullPrevious)
+        {
+#if (mainUSE_PREFETCH == 1)
+            // Stop one lead short of the release to warm the tasks it releases
+            if (ullNext - ullPrevious > WARM_LEAD_TICKS)
             {
-                low = mid + 1;
+                vTaskDelayUntil(&xLastWake, (TickType_t)(ullNext - ullPrevious - WARM_LEAD_TICKS));
+
+                for (ulMask = pxEntry->ulMask; ulMask != 0; ulMask &= ulMask - 1)
+                {
+                    mainPRE_RELEASE((uint32_t)pxEntry->usWord * 32 + (uint32_t)__builtin_ctz(ulMask));
+                }
+
+                ullPrevious = ullNext - WARM_LEAD_TICKS;
             }
-            else
+#endif
+            vTaskDelayUntil(&xLastWake, (TickType_t)(ullNext - ullPrevious));
+            ullPrevious = ullNext;
+        }
+
+        for (ulMask = pxEntry->ulMask; ulMask != 0; ulMask &= ulMask - 1)
+        {
+            xTaskNotifyGive(*mainTASK_HANDLE((uint32_t)pxEntry->usWord * 32 + (uint32_t)__builtin_ctz(ulMask)));
+        }
+    }
+}
+#endif
+
+#if (mainUSE_MODE_CHANGE == 1)
+static void prvModeJob2(void)
+{
+    float fahrenheit = 100.0f;
+
+    vIpsaPrintTemperature(fahrenheit, fIpsaCelsius(fahrenheit));
+}
+
+static void prvModeJob4(void)
+{
+    vIpsaPrintSearch(xIpsaSearch(TASK4_SEARCH_KEY, NULL, NULL));
+}
+
+static void prvModeDriverTask(void *params)
+{
+    UBaseType_t uxNext = mainMODE_NOMINAL;
+
+    vTaskDelay(MODE_STARTUP_MS);
+
+    for (;;)
+    {
+        if (xModeRequest(uxNext) == pdPASS)
+        {
+            uxNext = (uxNext == mainMODE_NOMINAL) ? mainMODE_DEGRADED : mainMODE_NOMINAL;
+        }
+
+        vTaskDelay(MODE_SWITCH_PERIOD_MS);
+    }
+}
+#endif
+
+#if (mainUSE_PREFETCH == 1)
+static void prvWarmInit(void)
+{
+    const void *pvTable;
+    size_t xSize;
+
+    // TX4 reads the whole key table on every search
+    pvTable = pvIpsaSearchTable(&xSize);
+    (void)xWarmAdd(&xWarmSets[3], pvTable, xSize);
+}
+
+#if (mainUSE_RELEASE_CALENDAR == 0)
+static void prvWaitWarm(UBaseType_t uxTask, TickType_t xPeriod)
+{
+    // A task with nothing registered does not pay for the extra wake-up
+    if ((xWarmSets[uxTask].ulRanges == 0) || (xPeriod <= WARM_LEAD_TICKS))
+    {
+        vTaskDelay(xPeriod);
+        return;
+    }
+
+    vTaskDelay(xPeriod - WARM_LEAD_TICKS);
+    mainPRE_RELEASE(uxTask);
+    vTaskDelay(WARM_LEAD_TICKS);
+}
+#endif
+#endif
+
+#if (mainUSE_MESSAGE_QUEUES == 1)
+static uint64_t prvMessageNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvMessageInit(void)
+{
+    for (UBaseType_t i = 0; i < sizeof(xChannels) / sizeof(xChannels[0]); i++)
+    {
+        MessageChannel_t *pxChannel = &xChannels[i];
+
+        if (pxChannel->xLockFree)
+        {
+            pxChannel->xLockFreeQueue = xMpmcQueueCreate(MESSAGE_QUEUE_LENGTH, sizeof(IpsaMessage_t));
+        }
+        else if (pxChannel->xFifo)
+        {
+            pxChannel->xFifoQueue = xQueueCreate(MESSAGE_QUEUE_LENGTH, sizeof(IpsaMessage_t));
+        }
+        else
+        {
+            pxChannel->xOrderedQueue = xPrioQueueCreate(MESSAGE_QUEUE_LENGTH, sizeof(IpsaMessage_t), pxChannel->eOrder);
+        }
+
+        if ((pxChannel->xFifoQueue == NULL) && (pxChannel->xLockFreeQueue == NULL) &&
+            (pxChannel->xOrderedQueue == NULL))
+        {
+            printf("Messages: cannot create the %s queue\n", pxChannel->pcName);
+            continue;
+        }
+
+        xTaskCreate(prvBulkSenderTask, "Bulk", configMINIMAL_STACK_SIZE, pxChannel, MESSAGE_BULK_PRIORITY, NULL);
+        xTaskCreate(prvUrgentSenderTask, "Urgent", configMINIMAL_STACK_SIZE, pxChannel, MESSAGE_URGENT_PRIORITY, NULL);
+        xTaskCreate(prvMessageReceiverTask, "Receiver", configMINIMAL_STACK_SIZE, pxChannel, MESSAGE_RECEIVER_PRIORITY, NULL);
+    }
+}
+
+static void prvMessageSend(MessageChannel_t *pxChannel, BaseType_t xUrgent)
+{
+    IpsaMessage_t xMessage = { .xUrgent = xUrgent, .ullSentNs = prvMessageNowNs() };
+    BaseType_t xResult;
+
+    if (pxChannel->xLockFree)
+    {
+        xResult = xMpmcQueueSend(pxChannel->xLockFreeQueue, &xMessage, 0);
+    }
+    else if (pxChannel->xFifo)
+    {
+        xResult = xQueueSend(pxChannel->xFifoQueue, &xMessage, 0);
+    }
+    else if (pxChannel->eOrder == ePrioQueueByPriority)
+    {
+        xResult = xPrioQueueSend(pxChannel->xOrderedQueue, &xMessage, prioqSENDER_PRIORITY(), 0);
+    }
+    else
+    {
+        // Urgent messages are due within a couple of ticks, bulk by the next burst
+        xResult = xPrioQueueSend(pxChannel->xOrderedQueue, &xMessage, xTaskGetTickCount() +
+                                 (xUrgent ? MESSAGE_URGENT_DEADLINE_MS : MESSAGE_PERIOD_MS), 0);
+    }
+
+    if (xResult != pdPASS)
+    {
+        pxChannel->ulDropped++;
+    }
+}
+
+static void prvBulkSenderTask(void *params)
+{
+    MessageChannel_t *pxChannel = (MessageChannel_t *)params;
+    TickType_t xLastWake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&xLastWake, MESSAGE_PERIOD_MS);
+
+        for (UBaseType_t i = 0; i < MESSAGE_BURST; i++)
+        {
+            prvMessageSend(pxChannel, pdFALSE);
+        }
+    }
+}
+
+static void prvUrgentSenderTask(void *params)
+{
+    MessageChannel_t *pxChannel = (MessageChannel_t *)params;
+    TickType_t xLastWake;
+
+    // One tick after each burst, so the urgent message finds the backlog
+    vTaskDelay(1);
+    xLastWake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&xLastWake, MESSAGE_PERIOD_MS);
+        prvMessageSend(pxChannel, pdTRUE);
+    }
+}
+
+static void prvMessageReceiverTask(void *params)
+{
+    MessageChannel_t *pxChannel = (MessageChannel_t *)params;
+    IpsaMessage_t xMessage;
+
+    for (;;)
+    {
+        BaseType_t xResult;
+        uint64_t ullReceived;
+
+        if (pxChannel->xLockFree)
+        {
+            xResult = xMpmcQueueReceive(pxChannel->xLockFreeQueue, &xMessage, portMAX_DELAY);
+        }
+        else if (pxChannel->xFifo)
+        {
+            xResult = xQueueReceive(pxChannel->xFifoQueue, &xMessage, portMAX_DELAY);
+        }
+        else
+        {
+            xResult = xPrioQueueReceive(pxChannel->xOrderedQueue, &xMessage, portMAX_DELAY);
+        }
+
+        if (xResult != pdPASS)
+        {
+            continue;
+        }
+
+        ullReceived = prvMessageNowNs();
+
+        if (xMessage.xUrgent)
+        {
+            uint64_t ullLatency = ullReceived - xMessage.ullSentNs;
+
+            pxChannel->ulUrgent++;
+            pxChannel->ullUrgentTotalNs += ullLatency;
+
+            if (ullLatency > pxChannel->ullUrgentMaxNs)
             {
-                high = mid - 1;
+                pxChannel->ullUrgentMaxNs = ullLatency;
             }
         }
+        else
+        {
+            pxChannel->ulBulk++;
+        }
 
-        if (found)
+        // Handling the message
+        while (prvMessageNowNs() - ullReceived < MESSAGE_COST_US * 1000ULL)
         {
-            // Print the result
-            printf("Element found\n");
         }
-        else
+    }
+}
+#endif
+
+static void prvReportTask(void *params)
+{
+    for (;;)
+    {
+        vTaskDelay(REPORT_PERIOD_MS);
+
+#if (mainUSE_ELASTIC_SCHEDULING == 1)
+        vElasticReport();
+#endif
+#if (mainUSE_IMPRECISE_TASKS == 1)
+        vImpreciseReport(&xTask2Imprecise);
+#endif
+#if (mainUSE_TRACE == 1)
+        vTraceFlush();
+        printf("Trace: dropped=%lu\n", (unsigned long)ulTraceDropped());
+#endif
+#if (mainUSE_PREEMPTION_POINTS == 1)
+        for (UBaseType_t i = 0; i < sizeof(xPreemptTasks) / sizeof(xPreemptTasks[0]); i++)
         {
-            // Print the result
-            printf("Element not found\n");
+            vPreemptReport(&xPreemptTasks[i]);
         }
+#endif
+#if (mainUSE_LIVENESS_MONITOR == 1)
+        vLivenessReport();
+#endif
+#if (mainUSE_MODE_CHANGE == 1)
+        vModeReport();
+#endif
+#if (mainUSE_MESSAGE_QUEUES == 1)
+        for (UBaseType_t i = 0; i < sizeof(xChannels) / sizeof(xChannels[0]); i++)
+        {
+            const MessageChannel_t *pxChannel = &xChannels[i];
 
-        // Wait for the specified period before running again
-        vTaskDelay(TASK4_PERIOD_MS);
+            printf("Messages: %-8s urgent=%lu latency mean=%.1f max=%.1f us bulk=%lu dropped=%lu\n",
+                   pxChannel->pcName, (unsigned long)pxChannel->ulUrgent,
+                   (pxChannel->ulUrgent > 0) ? (double)pxChannel->ullUrgentTotalNs / pxChannel->ulUrgent / 1000.0 : 0.0,
+                   (double)pxChannel->ullUrgentMaxNs / 1000.0, (unsigned long)pxChannel->ulBulk,
+                   (unsigned long)pxChannel->ulDropped);
+        }
+#endif
+#if (mainUSE_PREFETCH == 1)
+        for (UBaseType_t i = 0; i < sizeof(xWarmSets) / sizeof(xWarmSets[0]); i++)
+        {
+            static const char *const pcNames[] = { "TX1", "TX2", "TX3", "TX4", "Aperiodic" };
+
+            if (xWarmSets[i].ulRanges > 0)
+            {
+                printf("Warm: %s ranges=%lu lines=%lu touches=%lu\n", pcNames[i],
+                       (unsigned long)xWarmSets[i].ulRanges, (unsigned long)xWarmSets[i].ulLines,
+                       (unsigned long)xWarmSets[i].ulTouches);
+            }
+        }
+#endif
+#if (mainUSE_BINARY_LOG == 1)
+        vBinlogReport();
+#endif
+#if (mainUSE_ASYNC_OUTPUT == 1)
+        vOutputReport();
+#endif
     }
 }
 
-void aperiodicTask1(void *params)
+#if (mainUSE_PREEMPTION_POINTS == 1)
+static void prvPreemptionPoint(void *pvContext)
 {
-    while (1)
+    (void)xPreemptPoint((PreemptTask_t *)pvContext);
+}
+
+static void prvAnalysePreemptionPoints(void)
+{
+    PreemptAnalysisTask_t xAnalysis[] =
     {
-        // Do some work that takes 100ms
-        // In this example, we use vTaskDelay() to simulate the work
-        vTaskDelay(APERIODIC_TASK_DELAY_MS);
+        { "TX1", TASK1_WCET_US, TASK1_PERIOD_MS * 1000, TASK1_PERIOD_MS * 1000, TASK1_PRIORITY, 0, 0 },
+        { "TX2", TASK2_WCET_US, TASK2_PERIOD_MS * 1000, TASK2_PERIOD_MS * 1000, TASK2_PRIORITY, 0, 0 },
+        { "TX3", TASK3_WCET_US, TASK3_PERIOD_MS * 1000, TASK3_PERIOD_MS * 1000, TASK3_PRIORITY, 0, 0 },
+        { "TX4", TASK4_WCET_US, TASK4_PERIOD_MS * 1000, TASK4_PERIOD_MS * 1000, TASK4_PRIORITY, 0, 0 },
+        { "Aperiodic", APERIODIC_TASK_WCET_US, APERIODIC_TASK_DELAY_MS * 1000, APERIODIC_TASK_DELAY_MS * 1000, APERIODIC_TASK_PRIORITY, 0, 0 },
+    };
+    const UBaseType_t uxCount = sizeof(xAnalysis) / sizeof(xAnalysis[0]);
+
+    if (xPreemptAnalyse(xAnalysis, uxCount) == pdFAIL)
+    {
+        printf("Preempt: task set is not schedulable under full preemption\n");
+    }
 
-        // Print a message to indicate that the task has finished executing
-        printf("Aperiodic task 1 finished\n");
+    for (UBaseType_t i = 0; i < uxCount; i++)
+    {
+        printf("Preempt: %s blocking tolerance=%ldus max region=%luus\n", xAnalysis[i].pcName,
+               (long)xAnalysis[i].lBlockingToleranceUs, (unsigned long)xAnalysis[i].ulMaxNprUs);
+
+        // Hand the bound to the tasks that run with preemption points
+        for (UBaseType_t j = 0; j < sizeof(xPreemptTasks) / sizeof(xPreemptTasks[0]); j++)
+        {
+            if (strcmp(xPreemptTasks[j].pcName, xAnalysis[i].pcName) == 0)
+            {
+                xPreemptTasks[j].ulMaxNprUs = xAnalysis[i].ulMaxNprUs;
+            }
+        }
     }
 }
+#endif
+
+#if (mainUSE_IMPRECISE_TASKS == 1)
+/* One reading of the sensor: the temperature plus uniform noise. */
+static float prvTask2Sample(TemperatureFrame_t *pxFrame)
+{
+    uint32_t ulX = pxFrame->ulNoise;
+
+    ulX ^= ulX << 13;
+    ulX ^= ulX >> 17;
+    ulX ^= ulX << 5;
+    pxFrame->ulNoise = ulX;
+
+    return pxFrame->fFahrenheit + TASK2_SENSOR_NOISE_F * ((float)ulX / 2147483648.0f - 1.0f);
+}
+
+static void prvTask2Mandatory(void *pvContext)
+{
+    TemperatureFrame_t *pxFrame = (TemperatureFrame_t *)pvContext;
+
+    // One sample is enough for a usable result
+    pxFrame->fSum = prvTask2Sample(pxFrame);
+    pxFrame->uxSamples = 1;
+    pxFrame->fCelsius = (pxFrame->fSum - 32.0f) * 5.0f / 9.0f;
+}
+
+static BaseType_t prvTask2Refine(void *pvContext, UBaseType_t uxStep)
+{
+    TemperatureFrame_t *pxFrame = (TemperatureFrame_t *)pvContext;
+    float fMean;
+
+    // Average one more sample: the error shrinks as 1/sqrt(samples)
+    pxFrame->fSum += prvTask2Sample(pxFrame);
+    pxFrame->uxSamples++;
+    fMean = pxFrame->fSum / (float)pxFrame->uxSamples;
+    pxFrame->fCelsius = (fMean - 32.0f) * 5.0f / 9.0f;
+
+    return (uxStep + 1 < TASK2_OPTIONAL_STEPS) ? pdTRUE : pdFALSE;
+}
+#endif
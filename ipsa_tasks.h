@@ -0,0 +1,63 @@
+/*
+ * Task table of the ipsa_sched task set: periods, priorities and WCET
+ * budgets.  Shared by the FreeRTOS demo (ipsa_sched.c), the native Linux
+ * backend (linux_sched.c) and the analysis tools, which read it as the single
+ * source of truth.  ipsa_check.h verifies at compile time that the table is
+ * schedulable.
+ *
+ * Outside a FreeRTOS build the tick is taken as 1 ms and the idle priority
+ * as 0.
+ */
+
+#ifndef IPSA_TASKS_H
+#define IPSA_TASKS_H
+
+#ifndef portTICK_PERIOD_MS
+    #define portTICK_PERIOD_MS     1
+#endif
+
+#ifndef tskIDLE_PRIORITY
+    #define tskIDLE_PRIORITY       0
+#endif
+
+#define TASK1_PERIOD_MS            (166 / portTICK_PERIOD_MS)
+#define TASK2_PERIOD_MS            (170 / portTICK_PERIOD_MS)
+#define TASK3_PERIOD_MS            (186/ portTICK_PERIOD_MS)
+#define TASK4_PERIOD_MS            (166 / portTICK_PERIOD_MS)
+#define APERIODIC_TASK_DELAY_MS    (50 / portTICK_PERIOD_MS)
+
+#define TASK1_PRIORITY             (tskIDLE_PRIORITY + 1)
+#define TASK2_PRIORITY             (tskIDLE_PRIORITY + 2)
+#define TASK3_PRIORITY             (tskIDLE_PRIORITY + 3)
+#define TASK4_PRIORITY             (tskIDLE_PRIORITY + 4)
+#define APERIODIC_TASK_PRIORITY    (tskIDLE_PRIORITY + 5)
+
+/* Worst-case execution time budgets used by the analyses, in microseconds.
+ * Measured budgets written by budget_gen.py to ipsa_budgets.h take
+ * precedence over these declared ones. */
+#if defined(__has_include)
+    #if __has_include("ipsa_budgets.h")
+        #include "ipsa_budgets.h"
+    #endif
+#endif
+
+#ifndef TASK1_WCET_US
+    #define TASK1_WCET_US              (50)
+#endif
+#ifndef TASK2_WCET_US
+    #define TASK2_WCET_US              (80)
+#endif
+#ifndef TASK3_WCET_US
+    #define TASK3_WCET_US              (40)
+#endif
+#ifndef TASK4_WCET_US
+    #define TASK4_WCET_US              (60)
+#endif
+#ifndef APERIODIC_TASK_WCET_US
+    #define APERIODIC_TASK_WCET_US     (30)
+#endif
+
+/* A table that is not schedulable does not build. */
+#include "ipsa_check.h"
+
+#endif /* IPSA_TASKS_H */
@@ -0,0 +1,418 @@
+/*
+ * Native Linux backend for the ipsa_sched task set.
+ *
+ * Runs the same jobs as the FreeRTOS demo (TX1..TX4 and the aperiodic task,
+ * from ipsa_jobs.c) as native threads, so that jitter and response times can
+ * be compared with the FreeRTOS Linux port on the same machine.  Two modes:
+ *
+ *   --fifo      SCHED_FIFO, with the FreeRTOS priorities mapped on top of
+ *               linuxFIFO_BASE_PRIORITY and releases driven by
+ *               clock_nanosleep(TIMER_ABSTIME).
+ *   --deadline  SCHED_DEADLINE, with runtime, deadline and period taken from
+ *               the task table in ipsa_tasks.h.  A job ends with sched_yield(),
+ *               which hands the rest of the reservation back to the kernel
+ *               until the next period.
+ *
+ * With --adaptive the execution time of every job is measured and each
+ * task's budget is adapted to a quantile of it, see adaptive.h; under
+ * --deadline the new budget becomes the SCHED_DEADLINE runtime.
+ *
+ * Both need CAP_SYS_NICE (or root); without it the threads fall back to
+ * SCHED_OTHER and the report says so.  The FreeRTOS tasks release with a
+ * relative vTaskDelay(), here releases are absolute, so any drift seen in the
+ * demo is absent from these figures.  Job output goes through output.h, so
+ * that the jobs do not block in write(), and with --binlog it is logged in
+ * binary to binlogFILE_NAME instead of stdout.
+ *
+ *     gcc -O2 -pthread linux_sched.c adaptive.c ipsa_jobs.c output.c fmt.c binlog.c -lm -o linux_sched
+ *     sudo ./linux_sched --deadline --adaptive 10 > /dev/null
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Local includes. */
+#include "ipsa_jobs.h"
+#include "ipsa_tasks.h"
+#include "output.h"
+#include "binlog.h"
+#include "adaptive.h"
+
+#define linuxFIFO_BASE_PRIORITY    ( 10 )
+#define linuxTASK4_SEARCH_KEY      ( 25 )
+
+/* SCHED_DEADLINE runtime is the WCET budget times this factor. */
+#define linuxRUNTIME_FACTOR        ( 4 )
+
+/* Share of jobs allowed to overrun an adaptive budget. */
+#define linuxADAPTIVE_TARGET       ( 0.01 )
+
+#ifndef SCHED_DEADLINE
+    #define SCHED_DEADLINE         6
+#endif
+
+/* Not exported by every libc. */
+struct LinuxSchedAttr
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+typedef enum
+{
+    eModeFifo,
+    eModeDeadline
+} LinuxMode_t;
+
+typedef struct LinuxTask
+{
+    const char *pcName;
+    void (*vJob)(void);
+    uint32_t ulPeriodMs;
+    uint32_t ulPriority;
+    uint32_t ulWcetUs;
+
+    /* Statistics. */
+    int iPolicyOk;
+    uint32_t ulJobs;
+    uint64_t ullJitterSumNs;
+    uint64_t ullJitterMaxNs;
+    uint64_t ullResponseSumNs;
+    uint64_t ullResponseMaxNs;
+} LinuxTask_t;
+
+static void prvJob2(void);
+static void prvJob4(void);
+
+static LinuxTask_t xTasks[] =
+{
+    { .pcName = "TX1", .vJob = vIpsaJob1, .ulPeriodMs = TASK1_PERIOD_MS, .ulPriority = TASK1_PRIORITY, .ulWcetUs = TASK1_WCET_US },
+    { .pcName = "TX2", .vJob = prvJob2, .ulPeriodMs = TASK2_PERIOD_MS, .ulPriority = TASK2_PRIORITY, .ulWcetUs = TASK2_WCET_US },
+    { .pcName = "TX3", .vJob = vIpsaJob3, .ulPeriodMs = TASK3_PERIOD_MS, .ulPriority = TASK3_PRIORITY, .ulWcetUs = TASK3_WCET_US },
+    { .pcName = "TX4", .vJob = prvJob4, .ulPeriodMs = TASK4_PERIOD_MS, .ulPriority = TASK4_PRIORITY, .ulWcetUs = TASK4_WCET_US },
+    { .pcName = "Aperiodic", .vJob = vIpsaJobAperiodic, .ulPeriodMs = APERIODIC_TASK_DELAY_MS,
+      .ulPriority = APERIODIC_TASK_PRIORITY, .ulWcetUs = APERIODIC_TASK_WCET_US },
+};
+
+#define linuxTASK_COUNT    (sizeof(xTasks) / sizeof(xTasks[0]))
+
+/* Adaptive reservations, indexed as xTasks. */
+static AdaptiveTask_t xAdaptiveTasks[linuxTASK_COUNT];
+
+static LinuxMode_t eMode = eModeFifo;
+static int iAdaptive = 0;
+static struct timespec xStart;
+static struct timespec xStop;
+
+/*-----------------------------------------------------------*/
+
+static void prvJob2(void)
+{
+    float fahrenheit = 100.0f; // Fixed Fahrenheit temperature value
+
+    vIpsaPrintTemperature(fahrenheit, fIpsaCelsius(fahrenheit));
+}
+
+static void prvJob4(void)
+{
+    vIpsaPrintSearch(xIpsaSearch(linuxTASK4_SEARCH_KEY, NULL, NULL));
+}
+
+static uint64_t prvNs(const struct timespec *pxTime)
+{
+    return (uint64_t)pxTime->tv_sec * 1000000000ULL + (uint64_t)pxTime->tv_nsec;
+}
+
+static void prvAddNs(struct timespec *pxTime, uint64_t ullNs)
+{
+    uint64_t ullTotal = prvNs(pxTime) + ullNs;
+
+    pxTime->tv_sec = (time_t)(ullTotal / 1000000000ULL);
+    pxTime->tv_nsec = (long)(ullTotal % 1000000000ULL);
+}
+
+static uint64_t prvThreadCpuNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &xNow);
+
+    return prvNs(&xNow);
+}
+
+static int prvSetDeadline(LinuxTask_t *pxTask, uint64_t ullRuntime)
+{
+    struct LinuxSchedAttr xAttr;
+    uint64_t ullPeriod = (uint64_t)pxTask->ulPeriodMs * 1000000ULL;
+
+    memset(&xAttr, 0, sizeof(xAttr));
+    xAttr.size = sizeof(xAttr);
+    xAttr.sched_policy = SCHED_DEADLINE;
+    xAttr.sched_runtime = ullRuntime;
+    xAttr.sched_deadline = ullPeriod;
+    xAttr.sched_period = ullPeriod;
+
+    return (int)syscall(SYS_sched_setattr, 0, &xAttr, 0);
+}
+
+static int prvSetPolicy(LinuxTask_t *pxTask)
+{
+    if (eMode == eModeDeadline)
+    {
+        return prvSetDeadline(pxTask, (uint64_t)pxTask->ulWcetUs * 1000ULL * linuxRUNTIME_FACTOR);
+    }
+    else
+    {
+        struct sched_param xParam;
+
+        xParam.sched_priority = (int)(linuxFIFO_BASE_PRIORITY + pxTask->ulPriority);
+
+        return pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam) == 0 ? 0 : -1;
+    }
+}
+
+static void *prvTaskThread(void *pvTask)
+{
+    LinuxTask_t *pxTask = (LinuxTask_t *)pvTask;
+    AdaptiveTask_t *pxAdaptive = &xAdaptiveTasks[pxTask - xTasks];
+    uint64_t ullPeriod = (uint64_t)pxTask->ulPeriodMs * 1000000ULL;
+    struct timespec xRelease = xStart;
+    uint64_t ullResponse = 0;
+    uint64_t ullPeriodCpu = 0;
+    int iNewBudget = 0;
+
+    pxTask->iPolicyOk = (prvSetPolicy(pxTask) == 0);
+
+    for (;;)
+    {
+        struct timespec xNow;
+        uint64_t ullJitter, ullCpu;
+
+        // Under SCHED_DEADLINE only the first release is a sleep: the wake-up
+        // starts the reservation, and sched_yield() waits for the next period
+        if ((eMode == eModeFifo) || !pxTask->iPolicyOk || (pxTask->ulJobs == 0))
+        {
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xRelease, NULL) == EINTR)
+            {
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &xNow);
+        ullCpu = prvThreadCpuNs();
+
+        // The previous period is over: the budget has to cover all it cost,
+        // the bookkeeping, the sched_setattr() and the yield as well as the
+        // job, so that is what is accounted
+        if (iAdaptive && (pxTask->ulJobs > 0) && xAdaptiveJobEnd(pxAdaptive, ullCpu - ullPeriodCpu, ullResponse))
+        {
+            iNewBudget = 1;
+        }
+
+        ullPeriodCpu = ullCpu;
+
+        if (prvNs(&xNow) >= prvNs(&xStop))
+        {
+            break;
+        }
+
+        // Lateness of the start of the job with respect to its release
+        ullJitter = (prvNs(&xNow) > prvNs(&xRelease)) ? (prvNs(&xNow) - prvNs(&xRelease)) : 0;
+
+        pxTask->vJob();
+
+        clock_gettime(CLOCK_MONOTONIC, &xNow);
+        ullResponse = prvNs(&xNow) - prvNs(&xRelease);
+
+        pxTask->ulJobs++;
+        pxTask->ullJitterSumNs += ullJitter;
+        pxTask->ullResponseSumNs += ullResponse;
+
+        if (ullJitter > pxTask->ullJitterMaxNs)
+        {
+            pxTask->ullJitterMaxNs = ullJitter;
+        }
+
+        if (ullResponse > pxTask->ullResponseMaxNs)
+        {
+            pxTask->ullResponseMaxNs = ullResponse;
+        }
+
+        prvAddNs(&xRelease, ullPeriod);
+
+        if (eMode == eModeDeadline && pxTask->iPolicyOk)
+        {
+            // A new budget is applied only here, with the job done: changing
+            // the runtime of a running instance can throttle it for a period
+            if (iNewBudget && (prvSetDeadline(pxTask, pxAdaptive->ullBudgetNs) != 0))
+            {
+                vAdaptiveReject(pxAdaptive);
+            }
+
+            iNewBudget = 0;
+
+            // Give back the rest of the budget: woken at the next period
+            sched_yield();
+
+            // Skip releases lost to an overrun so the statistics stay aligned
+            clock_gettime(CLOCK_MONOTONIC, &xNow);
+            while (prvNs(&xRelease) + ullPeriod <= prvNs(&xNow))
+            {
+                prvAddNs(&xRelease, ullPeriod);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    pthread_t xThreads[linuxTASK_COUNT];
+    unsigned uSeconds = 10;
+    int iBinlog = 0;
+    int iError;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--deadline") == 0)
+        {
+            eMode = eModeDeadline;
+        }
+        else if (strcmp(argv[i], "--fifo") == 0)
+        {
+            eMode = eModeFifo;
+        }
+        else if (strcmp(argv[i], "--binlog") == 0)
+        {
+            iBinlog = 1;
+        }
+        else if (strcmp(argv[i], "--adaptive") == 0)
+        {
+            iAdaptive = 1;
+        }
+        else
+        {
+            char *pcEnd;
+            unsigned long ulSeconds;
+
+            errno = 0;
+            ulSeconds = strtoul(argv[i], &pcEnd, 10);
+
+            if ((argv[i][0] == '-') || (pcEnd == argv[i]) || (*pcEnd != '\0') || (errno != 0) ||
+                (ulSeconds == 0) || (ulSeconds > 86400))
+            {
+                fprintf(stderr, "linux_sched: unknown option or bad duration %s\n"
+                                "usage: linux_sched [--fifo | --deadline] [--adaptive] [--binlog] [seconds]\n",
+                        argv[i]);
+                return 1;
+            }
+
+            uSeconds = (unsigned)ulSeconds;
+        }
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        fprintf(stderr, "linux_sched: mlockall failed, page faults may add jitter\n");
+    }
+
+    if (xOutputInit() != 0)
+    {
+        fprintf(stderr, "linux_sched: asynchronous output unavailable, using stdio\n");
+    }
+
+    if (iBinlog && (xBinlogInit(binlogFILE_NAME) != 0))
+    {
+        fprintf(stderr, "linux_sched: cannot open %s, job messages stay text\n", binlogFILE_NAME);
+    }
+
+    for (size_t i = 0; i < linuxTASK_COUNT; i++)
+    {
+        xAdaptiveTasks[i].pcName = xTasks[i].pcName;
+        xAdaptiveTasks[i].ullPeriodNs = (uint64_t)xTasks[i].ulPeriodMs * 1000000ULL;
+        xAdaptiveTasks[i].ullStaticBudgetNs = (uint64_t)xTasks[i].ulWcetUs * 1000ULL * linuxRUNTIME_FACTOR;
+        xAdaptiveTasks[i].ullWcetNs = (uint64_t)xTasks[i].ulWcetUs * 1000ULL;
+    }
+
+    vAdaptiveInit(xAdaptiveTasks, linuxTASK_COUNT, linuxADAPTIVE_TARGET);
+
+    // First releases are aligned a little in the future for every task
+    clock_gettime(CLOCK_MONOTONIC, &xStart);
+    prvAddNs(&xStart, 100000000ULL);
+    xStop = xStart;
+    prvAddNs(&xStop, (uint64_t)uSeconds * 1000000000ULL);
+
+    for (size_t i = 0; i < linuxTASK_COUNT; i++)
+    {
+        iError = pthread_create(&xThreads[i], NULL, prvTaskThread, &xTasks[i]);
+
+        if (iError != 0)
+        {
+            fprintf(stderr, "linux_sched: cannot start %s: %s\n", xTasks[i].pcName, strerror(iError));
+
+            // The others are still waiting for the first release
+            for (size_t j = 0; j < i; j++)
+            {
+                pthread_cancel(xThreads[j]);
+                pthread_join(xThreads[j], NULL);
+            }
+
+            return 1;
+        }
+    }
+
+    for (size_t i = 0; i < linuxTASK_COUNT; i++)
+    {
+        pthread_join(xThreads[i], NULL);
+    }
+
+    vOutputDrain();
+
+    fprintf(stderr, "%-10s %-9s %6s %12s %12s %14s %14s\n", "task", "policy", "jobs", "jitter avg", "jitter max",
+            "response avg", "response max");
+
+    for (size_t i = 0; i < linuxTASK_COUNT; i++)
+    {
+        LinuxTask_t *pxTask = &xTasks[i];
+        uint32_t ulJobs = (pxTask->ulJobs > 0) ? pxTask->ulJobs : 1;
+
+        fprintf(stderr, "%-10s %-9s %6u %10.1fus %10.1fus %12.1fus %12.1fus\n", pxTask->pcName,
+                pxTask->iPolicyOk ? ((eMode == eModeDeadline) ? "deadline" : "fifo") : "other",
+                (unsigned)pxTask->ulJobs, (double)pxTask->ullJitterSumNs / ulJobs / 1000.0,
+                (double)pxTask->ullJitterMaxNs / 1000.0, (double)pxTask->ullResponseSumNs / ulJobs / 1000.0,
+                (double)pxTask->ullResponseMaxNs / 1000.0);
+    }
+
+    if (iAdaptive)
+    {
+        vAdaptiveReport();
+    }
+
+    if (iBinlog)
+    {
+        vBinlogReport();
+    }
+
+    vOutputReport();
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * Per-task liveness monitor.  See liveness.h.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "liveness.h"
+
+#define livenessWHEEL_MASK    ( livenessWHEEL_SLOTS - 1 )
+
+static LivenessTask_t *pxLivenessTasks = NULL;
+static UBaseType_t uxLivenessCount = 0;
+static LivenessTask_t *pxWheel[livenessWHEEL_SLOTS];
+
+/* Next tick whose slot has to be processed. */
+static TickType_t xCursor = 0;
+
+static uint32_t ulChecks = 0;
+static uint32_t ulFaults = 0;
+static uint32_t ulMaxLagTicks = 0;
+static uint32_t ulMaxDetectTicks = 0;
+static uint64_t ullBusyNs = 0;
+static uint64_t ullStartNs = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+/* xA <= xB, with tick count overflow. */
+static BaseType_t prvNotAfter(TickType_t xA, TickType_t xB)
+{
+    return ((TickType_t)(xB - xA) <= (portMAX_DELAY >> 1)) ? pdTRUE : pdFALSE;
+}
+
+static void prvSchedule(LivenessTask_t *pxTask, TickType_t xDue)
+{
+    LivenessTask_t **ppxSlot = &pxWheel[xDue & livenessWHEEL_MASK];
+
+    pxTask->xDue = xDue;
+    pxTask->pxNext = *ppxSlot;
+    *ppxSlot = pxTask;
+}
+
+/* Ticks from the last beat to the tick the task is faulty without another. */
+static TickType_t prvWindow(const LivenessTask_t *pxTask)
+{
+    return (pxTask->xPeriod + pxTask->xDeadline > 0) ? (pxTask->xPeriod + pxTask->xDeadline) : 1;
+}
+
+static void prvCheckTask(LivenessTask_t *pxTask, TickType_t xNow)
+{
+    uint32_t ulProgress = __atomic_load_n(&pxTask->ulProgress, __ATOMIC_ACQUIRE);
+    TickType_t xEnd;
+
+    ulChecks++;
+
+    if (ulProgress != pxTask->ulLastSeen)
+    {
+        pxTask->ulLastSeen = ulProgress;
+        pxTask->xLastProgress = pxTask->xBeatTick;
+        pxTask->xFaulty = pdFALSE;
+    }
+
+    xEnd = pxTask->xLastProgress + prvWindow(pxTask);
+
+    if (pxTask->xFaulty != pdFALSE)
+    {
+        // Look for a recovery every period
+        prvSchedule(pxTask, xNow + ((pxTask->xPeriod > 0) ? pxTask->xPeriod : 1));
+    }
+    else if (prvNotAfter(xEnd, xNow) != pdFALSE)
+    {
+        // No job completed in a whole period plus deadline: hung or starved
+        uint32_t ulDetect = (uint32_t)(xNow - xEnd);
+
+        pxTask->xFaulty = pdTRUE;
+        pxTask->ulFaults++;
+        pxTask->xFaultTick = xNow;
+        pxTask->eFaultState = eTaskGetState(pxTask->xHandle);
+        pxTask->uxStackHighWater = uxTaskGetStackHighWaterMark(pxTask->xHandle);
+        ulFaults++;
+        ulMaxDetectTicks = (ulDetect > ulMaxDetectTicks) ? ulDetect : ulMaxDetectTicks;
+
+        prvSchedule(pxTask, xNow + ((pxTask->xPeriod > 0) ? pxTask->xPeriod : 1));
+    }
+    else
+    {
+        prvSchedule(pxTask, xEnd);
+    }
+}
+
+static const char *prvStateName(eTaskState eState)
+{
+    switch (eState)
+    {
+        case eRunning:
+            return "running";
+
+        case eReady:
+            return "starved";
+
+        case eBlocked:
+            return "blocked";
+
+        case eSuspended:
+            return "suspended";
+
+        case eDeleted:
+            return "deleted";
+
+        default:
+            return "invalid";
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vLivenessInit(LivenessTask_t *pxTasks, UBaseType_t uxCount)
+{
+    TickType_t xNow = xTaskGetTickCount();
+
+    pxLivenessTasks = pxTasks;
+    uxLivenessCount = uxCount;
+    xCursor = xNow + 1;
+    ullStartNs = prvNowNs();
+
+    for (UBaseType_t i = 0; i < livenessWHEEL_SLOTS; i++)
+    {
+        pxWheel[i] = NULL;
+    }
+
+    for (UBaseType_t i = 0; i < uxCount; i++)
+    {
+        pxTasks[i].ulLastSeen = pxTasks[i].ulProgress;
+        pxTasks[i].xLastProgress = xNow;
+        pxTasks[i].xFaulty = pdFALSE;
+        prvSchedule(&pxTasks[i], xNow + prvWindow(&pxTasks[i]));
+    }
+}
+
+void vLivenessCheck(void)
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint64_t ullStart = prvNowNs();
+    UBaseType_t uxBudget = livenessMAX_CHECKS_PER_CALL;
+
+    // Walk the slots of every tick up to now, stopping early at the cap
+    while (prvNotAfter(xCursor, xNow) != pdFALSE)
+    {
+        LivenessTask_t **ppxLink = &pxWheel[xCursor & livenessWHEEL_MASK];
+
+        while (*ppxLink != NULL)
+        {
+            LivenessTask_t *pxTask = *ppxLink;
+
+            // Due in a later turn of the wheel
+            if (prvNotAfter(pxTask->xDue, xCursor) == pdFALSE)
+            {
+                ppxLink = &pxTask->pxNext;
+                continue;
+            }
+
+            if (uxBudget == 0)
+            {
+                uint32_t ulLag = (uint32_t)(xNow - xCursor);
+
+                if (ulLag > ulMaxLagTicks)
+                {
+                    ulMaxLagTicks = ulLag;
+                }
+
+                ullBusyNs += prvNowNs() - ullStart;
+                return;
+            }
+
+            uxBudget--;
+            *ppxLink = pxTask->pxNext;
+            prvCheckTask(pxTask, xNow);
+        }
+
+        xCursor++;
+    }
+
+    ullBusyNs += prvNowNs() - ullStart;
+}
+
+void vLivenessGetStats(LivenessStats_t *pxStats)
+{
+    uint64_t ullElapsed = prvNowNs() - ullStartNs;
+
+    pxStats->uxTasks = uxLivenessCount;
+    pxStats->uxFaulty = 0;
+    pxStats->ulChecks = ulChecks;
+    pxStats->ulFaults = ulFaults;
+    pxStats->ulMaxLagTicks = ulMaxLagTicks;
+    pxStats->ulMaxDetectTicks = ulMaxDetectTicks;
+    pxStats->fMonitorShare = (ullElapsed > 0) ? (float)((double)ullBusyNs / (double)ullElapsed) : 0.0f;
+
+    for (UBaseType_t i = 0; i < uxLivenessCount; i++)
+    {
+        if (pxLivenessTasks[i].xFaulty != pdFALSE)
+        {
+            pxStats->uxFaulty++;
+        }
+    }
+}
+
+void vLivenessReport(void)
+{
+    LivenessStats_t xStats;
+
+    vLivenessGetStats(&xStats);
+
+    printf("Liveness: tasks=%lu faulty=%lu faults=%lu checks=%lu lag_max=%lu ticks detect_max=%lu ticks cpu=%.4f%%\n",
+           (unsigned long)xStats.uxTasks, (unsigned long)xStats.uxFaulty, (unsigned long)xStats.ulFaults,
+           (unsigned long)xStats.ulChecks, (unsigned long)xStats.ulMaxLagTicks, (unsigned long)xStats.ulMaxDetectTicks,
+           xStats.fMonitorShare * 100.0f);
+
+    for (UBaseType_t i = 0; i < uxLivenessCount; i++)
+    {
+        const LivenessTask_t *pxTask = &pxLivenessTasks[i];
+
+        if (pxTask->ulFaults == 0)
+        {
+            continue;
+        }
+
+        printf("Liveness: %s %s faults=%lu last at tick %lu state=%s stack_free=%lu words\n", pxTask->pcName,
+               (pxTask->xFaulty != pdFALSE) ? "FAULTY" : "recovered", (unsigned long)pxTask->ulFaults,
+               (unsigned long)pxTask->xFaultTick, prvStateName(pxTask->eFaultState),
+               (unsigned long)pxTask->uxStackHighWater);
+    }
+}
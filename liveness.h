@@ -0,0 +1,91 @@
+/*
+ * Per-task liveness monitor.
+ *
+ * Every monitored task bumps its progress counter with vLivenessBeat() when a
+ * job completes, recording the tick of the beat next to it.  Both live on a
+ * cache line that only the task writes, so the task pays no lock, no
+ * blocking kernel call and no cache line shared with the other tasks or the
+ * monitor.
+ *
+ * A monitor task calls vLivenessCheck() every tick.  Each task is checked
+ * through a timing wheel at the tick its window runs out, its last beat plus
+ * its period plus its deadline, so a call only touches the tasks due at that
+ * tick and never scans the whole set.  A task that shows no progress in its
+ * window is reported as faulty: blocked (hung on a kernel object), ready
+ * (starved by higher priority work) or suspended.  A faulty task is checked
+ * again every period until it recovers.  The task state and stack high
+ * water mark are recorded when the fault is noticed.
+ *
+ * The work of one call is capped at livenessMAX_CHECKS_PER_CALL; the tasks
+ * left over are checked at the next call, so the CPU share of the monitor
+ * stays bounded with thousands of tasks at the price of some detection lag.
+ * liveness_bench.c measures both with thousands of tasks.
+ *
+ * Requires INCLUDE_eTaskGetState and INCLUDE_uxTaskGetStackHighWaterMark.
+ */
+
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Slots of the timing wheel, a power of two. */
+#define livenessWHEEL_SLOTS            ( 256 )
+#define livenessMAX_CHECKS_PER_CALL    ( 64 )
+#define livenessCACHE_LINE             ( 64 )
+
+typedef struct LivenessTask
+{
+    /* Written by the task only, alone on its cache line. */
+    volatile uint32_t ulProgress __attribute__((aligned(livenessCACHE_LINE)));
+    volatile TickType_t xBeatTick;
+
+    const char *pcName __attribute__((aligned(livenessCACHE_LINE)));
+    TaskHandle_t xHandle;
+    TickType_t xPeriod;
+    TickType_t xDeadline;
+
+    /* Monitor state. */
+    struct LivenessTask *pxNext;
+    TickType_t xDue;
+    TickType_t xLastProgress;
+    uint32_t ulLastSeen;
+    BaseType_t xFaulty;
+
+    /* Last fault. */
+    uint32_t ulFaults;
+    TickType_t xFaultTick;
+    eTaskState eFaultState;
+    UBaseType_t uxStackHighWater;
+} LivenessTask_t;
+
+typedef struct LivenessStats
+{
+    UBaseType_t uxTasks;
+    UBaseType_t uxFaulty;
+    uint32_t ulChecks;
+    uint32_t ulFaults;
+    uint32_t ulMaxLagTicks;          /* Longest a due check waited for the cap. */
+    uint32_t ulMaxDetectTicks;       /* Longest from a window running out to its fault. */
+    float fMonitorShare;             /* CPU share of vLivenessCheck(). */
+} LivenessStats_t;
+
+/* Mark the end of a job.  Called by the monitored task only. */
+static inline void vLivenessBeat(LivenessTask_t *pxTask)
+{
+    pxTask->xBeatTick = xTaskGetTickCount();
+
+    // Publishes the tick with the count
+    __atomic_store_n(&pxTask->ulProgress, pxTask->ulProgress + 1, __ATOMIC_RELEASE);
+}
+
+/* The handles must be set, i.e. the tasks created, before this is called. */
+void vLivenessInit(LivenessTask_t *pxTasks, UBaseType_t uxCount);
+void vLivenessCheck(void);
+void vLivenessGetStats(LivenessStats_t *pxStats);
+
+/* Prints the totals and every task that is, or has been, faulty. */
+void vLivenessReport(void);
+
+#endif /* LIVENESS_H */
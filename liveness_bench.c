@@ -0,0 +1,159 @@
+/*
+ * Scale benchmark of the liveness monitor (liveness.h).
+ *
+ * livenessbenchTASKS progress counters, far more than the demo has tasks, are
+ * beaten by livenessbenchWORKERS worker tasks, each counter at its own period
+ * of 10 to 100 ticks; every livenessbenchHANG_EVERY-th counter stops beating
+ * half way through the run, as a hung task would.  A monitor task at the
+ * highest priority calls vLivenessCheck() every tick.  At the end the report
+ * gives the CPU share of the monitor, the longest a due check waited for the
+ * livenessMAX_CHECKS_PER_CALL cap, the longest from a window running out to
+ * its fault being noticed, and whether exactly the hung counters were
+ * reported.
+ *
+ * Call liveness_bench() from main() in place of ipsa_sched(), as for
+ * switch_bench.c, and build with liveness.c.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "liveness.h"
+
+#define livenessbenchTASKS          ( 4096 )
+#define livenessbenchWORKERS        ( 8 )
+#define livenessbenchHANG_EVERY     ( 256 )
+#define livenessbenchRUN_MS         ( 10000 )
+
+#define livenessbenchMONITOR_PRIORITY    ( tskIDLE_PRIORITY + 3 )
+#define livenessbenchWORKER_PRIORITY     ( tskIDLE_PRIORITY + 2 )
+#define livenessbenchREPORT_PRIORITY     ( tskIDLE_PRIORITY + 1 )
+
+static LivenessTask_t xTasks[livenessbenchTASKS];
+static TickType_t xNextBeat[livenessbenchTASKS];
+static TaskHandle_t xWorkers[livenessbenchWORKERS];
+static TickType_t xStart;
+static TickType_t xHangTick;
+
+static void prvWorkerTask(void *params);
+static void prvMonitorTask(void *params);
+static void prvReportTask(void *params);
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHangs(uint32_t ulIndex)
+{
+    return ((ulIndex % livenessbenchHANG_EVERY) == livenessbenchHANG_EVERY - 1) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+void liveness_bench(void)
+{
+    for (uint32_t i = 0; i < livenessbenchWORKERS; i++)
+    {
+        xTaskCreate(prvWorkerTask, "Worker", configMINIMAL_STACK_SIZE, (void *)(uintptr_t)i,
+                    livenessbenchWORKER_PRIORITY, &xWorkers[i]);
+    }
+
+    // The state of a hung counter is the state of the worker that owns it
+    for (uint32_t i = 0; i < livenessbenchTASKS; i++)
+    {
+        xTasks[i].pcName = prvHangs(i) ? "hung" : "live";
+        xTasks[i].xHandle = xWorkers[i % livenessbenchWORKERS];
+        xTasks[i].xPeriod = (TickType_t)(10 * (1 + i % 10));
+        xTasks[i].xDeadline = xTasks[i].xPeriod;
+    }
+
+    xTaskCreate(prvMonitorTask, "Monitor", configMINIMAL_STACK_SIZE, NULL, livenessbenchMONITOR_PRIORITY, NULL);
+    xTaskCreate(prvReportTask, "Report", configMINIMAL_STACK_SIZE * 2, NULL, livenessbenchREPORT_PRIORITY, NULL);
+
+    vTaskStartScheduler();
+}
+
+static void prvMonitorTask(void *params)
+{
+    TickType_t xLastWake;
+
+    xStart = xTaskGetTickCount();
+    xHangTick = xStart + pdMS_TO_TICKS(livenessbenchRUN_MS / 2);
+
+    for (uint32_t i = 0; i < livenessbenchTASKS; i++)
+    {
+        xNextBeat[i] = xStart + xTasks[i].xPeriod;
+    }
+
+    vLivenessInit(xTasks, livenessbenchTASKS);
+    xLastWake = xStart;
+
+    for (;;)
+    {
+        vTaskDelayUntil(&xLastWake, 1);
+        vLivenessCheck();
+    }
+}
+
+static void prvWorkerTask(void *params)
+{
+    uint32_t ulWorker = (uint32_t)(uintptr_t)params;
+    TickType_t xLastWake;
+
+    // Wait for the monitor to set the counters up
+    vTaskDelay(1);
+    xLastWake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        TickType_t xNow = xTaskGetTickCount();
+
+        for (uint32_t i = ulWorker; i < livenessbenchTASKS; i += livenessbenchWORKERS)
+        {
+            if (prvHangs(i) && ((TickType_t)(xNow - xHangTick) <= (portMAX_DELAY >> 1)))
+            {
+                continue;
+            }
+
+            if ((TickType_t)(xNow - xNextBeat[i]) <= (portMAX_DELAY >> 1))
+            {
+                vLivenessBeat(&xTasks[i]);
+                xNextBeat[i] += xTasks[i].xPeriod;
+            }
+        }
+
+        vTaskDelayUntil(&xLastWake, 1);
+    }
+}
+
+static void prvReportTask(void *params)
+{
+    LivenessStats_t xStats;
+    uint32_t ulHung = 0;
+    uint32_t ulReported = 0;
+    uint32_t ulWrong = 0;
+
+    vTaskDelay(pdMS_TO_TICKS(livenessbenchRUN_MS));
+    vLivenessGetStats(&xStats);
+
+    for (uint32_t i = 0; i < livenessbenchTASKS; i++)
+    {
+        ulHung += (prvHangs(i) == pdTRUE);
+        ulReported += (xTasks[i].ulFaults > 0);
+        ulWrong += ((xTasks[i].ulFaults > 0) != (prvHangs(i) == pdTRUE));
+    }
+
+    printf("Liveness bench: %u tasks, %u workers, %lu checks, monitor cpu=%.4f%%, %.2f checks/tick\n",
+           (unsigned)livenessbenchTASKS, (unsigned)livenessbenchWORKERS, (unsigned long)xStats.ulChecks,
+           xStats.fMonitorShare * 100.0f,
+           (double)xStats.ulChecks / (double)((TickType_t)(xTaskGetTickCount() - xStart)));
+    printf("Liveness bench: %u hung, %u reported, %u wrong; lag_max=%lu ticks detect_max=%lu ticks\n",
+           (unsigned)ulHung, (unsigned)ulReported, (unsigned)ulWrong, (unsigned long)xStats.ulMaxLagTicks,
+           (unsigned long)xStats.ulMaxDetectTicks);
+
+    vTaskEndScheduler();
+    vTaskDelete(NULL);
+}
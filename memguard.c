@@ -0,0 +1,443 @@
+/*
+ * MemGuard-style memory bandwidth regulation.  See memguard.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Local includes. */
+#include "memguard.h"
+
+/* How often an idle core throttle thread checks for vMemGuardStop(). */
+#define memguardPOLL_NS    ( 100000000L )
+
+typedef struct MemGuardEntity
+{
+    MemGuardStats_t xStats;
+    int iFd;
+    pid_t xOwner;                    /* Thread that receives the signal. */
+    pthread_t xThrottleThread;
+    sem_t xReady;
+    int iResult;
+    int iErrno;
+} MemGuardEntity_t;
+
+static MemGuardEntity_t xEntities[memguardMAX_ENTITIES];
+static uint32_t ulEntityCount = 0;
+static uint64_t ullPeriod = memguardDEFAULT_PERIOD_NS;
+static uint64_t ullStartNs = 0;
+static uint32_t ulEventType = PERF_TYPE_HW_CACHE;
+static uint64_t ullEventConfig = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+static pthread_t xRegulator;
+static volatile int iRunning = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static uint64_t prvNextBoundary(uint64_t ullNow)
+{
+    return ullStartNs + ((ullNow - ullStartNs) / ullPeriod + 1) * ullPeriod;
+}
+
+static void prvSleepUntil(uint64_t ullWhen)
+{
+    struct timespec xWake = { .tv_sec = (time_t)(ullWhen / 1000000000ULL), .tv_nsec = (long)(ullWhen % 1000000000ULL) };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xWake, NULL) == EINTR)
+    {
+    }
+}
+
+static MemGuardEntity_t *prvFindEntity(int iFd)
+{
+    uint32_t ulCount = __atomic_load_n(&ulEntityCount, __ATOMIC_ACQUIRE);
+
+    for (uint32_t i = 0; i < ulCount; i++)
+    {
+        if (xEntities[i].iFd == iFd)
+        {
+            return &xEntities[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvOpenCounter(pid_t xPid, int iCpu, uint64_t ullBudget, pid_t xOwner)
+{
+    struct perf_event_attr xAttr;
+    struct f_owner_ex xOwnerEx = { .type = F_OWNER_TID, .pid = xOwner };
+    int iFd;
+
+    memset(&xAttr, 0, sizeof(xAttr));
+    xAttr.size = sizeof(xAttr);
+    xAttr.type = ulEventType;
+    xAttr.config = ullEventConfig;
+    xAttr.sample_period = ullBudget;
+    xAttr.wakeup_events = 1;
+    xAttr.disabled = 1;
+
+    iFd = (int)syscall(SYS_perf_event_open, &xAttr, xPid, iCpu, -1, PERF_FLAG_FD_CLOEXEC);
+
+    if ((iFd < 0) && (errno == EACCES))
+    {
+        // Unprivileged: user space misses only
+        xAttr.exclude_kernel = 1;
+        iFd = (int)syscall(SYS_perf_event_open, &xAttr, xPid, iCpu, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    if (iFd < 0)
+    {
+        return -1;
+    }
+
+    // Overflows raise memguardSIGNAL in xOwner, with the fd in si_fd
+    if ((fcntl(iFd, F_SETSIG, memguardSIGNAL) != 0) || (fcntl(iFd, F_SETOWN_EX, &xOwnerEx) != 0) ||
+        (fcntl(iFd, F_SETFL, O_ASYNC | O_NONBLOCK) != 0) || (ioctl(iFd, PERF_EVENT_IOC_ENABLE, 0) != 0))
+    {
+        int iSaved = errno;
+
+        close(iFd);
+        errno = iSaved;
+        return -1;
+    }
+
+    return iFd;
+}
+
+/* A regulated thread ran out of budget: it sleeps here until the boundary. */
+static void prvThreadHandler(int iSignal, siginfo_t *pxInfo, void *pvContext)
+{
+    MemGuardEntity_t *pxEntity = prvFindEntity(pxInfo->si_fd);
+    uint64_t ullNow;
+    uint64_t ullBoundary;
+    int iSavedErrno = errno;
+
+    (void)iSignal;
+    (void)pvContext;
+
+    if ((pxEntity == NULL) || (pxEntity->xStats.iCore >= 0) || !iRunning)
+    {
+        return;
+    }
+
+    ullNow = prvNowNs();
+    ullBoundary = prvNextBoundary(ullNow);
+    prvSleepUntil(ullBoundary);
+
+    __atomic_add_fetch(&pxEntity->xStats.ullThrottles, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pxEntity->xStats.ullThrottledNs, prvNowNs() - ullNow, __ATOMIC_RELAXED);
+
+    errno = iSavedErrno;
+}
+
+/* Holds a core while its budget is exhausted. */
+static void *prvThrottleThread(void *pvEntity)
+{
+    MemGuardEntity_t *pxEntity = (MemGuardEntity_t *)pvEntity;
+    struct sched_param xParam = { .sched_priority = memguardTHROTTLE_PRIORITY };
+    struct timespec xPoll = { .tv_sec = 0, .tv_nsec = memguardPOLL_NS };
+    struct timespec xNoWait = { .tv_sec = 0, .tv_nsec = 0 };
+    cpu_set_t xSet;
+    sigset_t xSignals;
+    siginfo_t xInfo;
+
+    CPU_ZERO(&xSet);
+    CPU_SET(pxEntity->xStats.iCore, &xSet);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(xSet), &xSet);
+    pxEntity->xStats.iHoldsCore = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam) == 0);
+
+    // The signal is taken with sigtimedwait(), never by the handler
+    sigemptyset(&xSignals);
+    sigaddset(&xSignals, memguardSIGNAL);
+    pthread_sigmask(SIG_BLOCK, &xSignals, NULL);
+
+    pxEntity->xOwner = (pid_t)syscall(SYS_gettid);
+    pxEntity->iFd = prvOpenCounter(-1, pxEntity->xStats.iCore, pxEntity->xStats.ullBudget, pxEntity->xOwner);
+    pxEntity->iErrno = errno;
+    pxEntity->iResult = (pxEntity->iFd < 0) ? -1 : 0;
+    sem_post(&pxEntity->xReady);
+
+    if (pxEntity->iResult != 0)
+    {
+        return NULL;
+    }
+
+    while (iRunning)
+    {
+        uint64_t ullNow;
+        uint64_t ullBoundary;
+
+        if (sigtimedwait(&xSignals, &xInfo, &xPoll) < 0)
+        {
+            continue;
+        }
+
+        ullNow = prvNowNs();
+        ullBoundary = prvNextBoundary(ullNow);
+
+        // The core counter would count the spin too and queue a signal per
+        // overflow until the real-time queue fills up and SIGIO kills us
+        (void)ioctl(pxEntity->iFd, PERF_EVENT_IOC_DISABLE, 0);
+
+        while (sigtimedwait(&xSignals, &xInfo, &xNoWait) >= 0)
+        {
+        }
+
+        // Spin rather than sleep: sleeping would hand the core back
+        while (prvNowNs() < ullBoundary)
+        {
+            __asm volatile ("" ::: "memory");
+        }
+
+        (void)ioctl(pxEntity->iFd, PERF_EVENT_IOC_ENABLE, 0);
+
+        __atomic_add_fetch(&pxEntity->xStats.ullThrottles, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pxEntity->xStats.ullThrottledNs, prvNowNs() - ullNow, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static void *prvRegulatorThread(void *pvParameters)
+{
+    struct sched_param xParam = { .sched_priority = memguardREGULATOR_PRIORITY };
+    sigset_t xSignals;
+
+    (void)pvParameters;
+
+    sigemptyset(&xSignals);
+    sigaddset(&xSignals, memguardSIGNAL);
+    pthread_sigmask(SIG_BLOCK, &xSignals, NULL);
+    (void)pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam);
+
+    while (iRunning)
+    {
+        uint32_t ulCount;
+
+        prvSleepUntil(prvNextBoundary(prvNowNs()));
+        ulCount = __atomic_load_n(&ulEntityCount, __ATOMIC_ACQUIRE);
+
+        // Setting the sample period again restarts the count towards it
+        for (uint32_t i = 0; i < ulCount; i++)
+        {
+            MemGuardEntity_t *pxEntity = &xEntities[i];
+
+            if (pxEntity->iFd >= 0)
+            {
+                (void)ioctl(pxEntity->iFd, PERF_EVENT_IOC_PERIOD, &pxEntity->xStats.ullBudget);
+                __atomic_add_fetch(&pxEntity->xStats.ullPeriods, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+int xMemGuardInit(uint64_t ullPeriodNs, uint32_t ulType, uint64_t ullConfig)
+{
+    struct sigaction xAction;
+
+    if (iRunning)
+    {
+        return -1;
+    }
+
+    if (ullPeriodNs != 0)
+    {
+        ullPeriod = ullPeriodNs;
+    }
+
+    if ((ulType != 0) || (ullConfig != 0))
+    {
+        ulEventType = ulType;
+        ullEventConfig = ullConfig;
+    }
+
+    memset(&xAction, 0, sizeof(xAction));
+    xAction.sa_sigaction = prvThreadHandler;
+    xAction.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&xAction.sa_mask);
+
+    if (sigaction(memguardSIGNAL, &xAction, NULL) != 0)
+    {
+        return -1;
+    }
+
+    ullStartNs = prvNowNs();
+    iRunning = 1;
+
+    if (pthread_create(&xRegulator, NULL, prvRegulatorThread, NULL) != 0)
+    {
+        iRunning = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+int xMemGuardRegulateThread(pid_t xTid, const char *pcName, uint64_t ullBudget)
+{
+    MemGuardEntity_t *pxEntity;
+
+    if (!iRunning || (ulEntityCount >= memguardMAX_ENTITIES) || (ullBudget == 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pxEntity = &xEntities[ulEntityCount];
+    memset(pxEntity, 0, sizeof(*pxEntity));
+    pxEntity->xStats.pcName = pcName;
+    pxEntity->xStats.ullBudget = ullBudget;
+    pxEntity->xStats.iCore = -1;
+    pxEntity->xOwner = (xTid != 0) ? xTid : (pid_t)syscall(SYS_gettid);
+    pxEntity->iFd = prvOpenCounter(pxEntity->xOwner, -1, ullBudget, pxEntity->xOwner);
+
+    if (pxEntity->iFd < 0)
+    {
+        return -1;
+    }
+
+    // Published after the fd, for the handler and the regulator
+    return (int)__atomic_fetch_add(&ulEntityCount, 1, __ATOMIC_RELEASE);
+}
+
+int xMemGuardRegulateCore(int iCpu, const char *pcName, uint64_t ullBudget)
+{
+    MemGuardEntity_t *pxEntity;
+
+    if (!iRunning || (ulEntityCount >= memguardMAX_ENTITIES) || (ullBudget == 0) || (iCpu < 0))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pxEntity = &xEntities[ulEntityCount];
+    memset(pxEntity, 0, sizeof(*pxEntity));
+    pxEntity->xStats.pcName = pcName;
+    pxEntity->xStats.ullBudget = ullBudget;
+    pxEntity->xStats.iCore = iCpu;
+    pxEntity->iFd = -1;
+    sem_init(&pxEntity->xReady, 0, 0);
+
+    if (pthread_create(&pxEntity->xThrottleThread, NULL, prvThrottleThread, pxEntity) != 0)
+    {
+        return -1;
+    }
+
+    while (sem_wait(&pxEntity->xReady) != 0)
+    {
+    }
+
+    if (pxEntity->iResult != 0)
+    {
+        pthread_join(pxEntity->xThrottleThread, NULL);
+        errno = pxEntity->iErrno;
+        return -1;
+    }
+
+    return (int)__atomic_fetch_add(&ulEntityCount, 1, __ATOMIC_RELEASE);
+}
+
+void vMemGuardStop(void)
+{
+    if (!iRunning)
+    {
+        return;
+    }
+
+    iRunning = 0;
+    pthread_join(xRegulator, NULL);
+
+    for (uint32_t i = 0; i < ulEntityCount; i++)
+    {
+        MemGuardEntity_t *pxEntity = &xEntities[i];
+
+        if (pxEntity->iFd >= 0)
+        {
+            (void)ioctl(pxEntity->iFd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+
+        if (pxEntity->xStats.iCore >= 0)
+        {
+            pthread_join(pxEntity->xThrottleThread, NULL);
+        }
+
+        if (pxEntity->iFd >= 0)
+        {
+            close(pxEntity->iFd);
+            pxEntity->iFd = -1;
+        }
+    }
+}
+
+uint64_t ullMemGuardBudget(double dMegabytesPerSecond, uint64_t ullPeriodNs)
+{
+    double dEvents = dMegabytesPerSecond * 1e6 * ((double)ullPeriodNs / 1e9) / memguardLINE_SIZE;
+
+    return (dEvents < 1.0) ? 1 : (uint64_t)dEvents;
+}
+
+void vMemGuardGetStats(uint32_t ulEntity, MemGuardStats_t *pxStats)
+{
+    memset(pxStats, 0, sizeof(*pxStats));
+
+    if (ulEntity < ulEntityCount)
+    {
+        *pxStats = xEntities[ulEntity].xStats;
+    }
+}
+
+void vMemGuardReport(void)
+{
+    for (uint32_t i = 0; i < ulEntityCount; i++)
+    {
+        MemGuardStats_t xStats;
+
+        vMemGuardGetStats(i, &xStats);
+
+        if (xStats.iCore >= 0)
+        {
+            printf("MemGuard: core %d (%s) budget=%llu/period periods=%llu throttled=%llu (%.1f%%) for %.1fms%s\n",
+                   xStats.iCore, xStats.pcName, (unsigned long long)xStats.ullBudget,
+                   (unsigned long long)xStats.ullPeriods, (unsigned long long)xStats.ullThrottles,
+                   100.0 * (double)xStats.ullThrottles / (double)((xStats.ullPeriods > 0) ? xStats.ullPeriods : 1),
+                   (double)xStats.ullThrottledNs / 1e6, xStats.iHoldsCore ? "" : ", no SCHED_FIFO: core not held");
+        }
+        else
+        {
+            printf("MemGuard: thread %s budget=%llu/period periods=%llu throttled=%llu (%.1f%%) for %.1fms\n",
+                   xStats.pcName, (unsigned long long)xStats.ullBudget, (unsigned long long)xStats.ullPeriods,
+                   (unsigned long long)xStats.ullThrottles,
+                   100.0 * (double)xStats.ullThrottles / (double)((xStats.ullPeriods > 0) ? xStats.ullPeriods : 1),
+                   (double)xStats.ullThrottledNs / 1e6);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * MemGuard-style memory bandwidth regulation (Yun et al., RTAS 2013).
+ *
+ * Every regulated entity, a thread or a whole core, gets a budget of
+ * last-level cache misses per regulation period, counted by a perf_event
+ * counter whose sample period is the budget.  When the counter overflows,
+ * the kernel sends memguardSIGNAL (F_SETSIG, with the counter's fd in
+ * si_fd) and the entity is throttled until the next period:
+ *
+ *   thread  the signal goes to the thread itself (F_OWNER_TID), whose
+ *           handler sleeps until the period boundary;
+ *   core    the signal goes to a throttle thread pinned to the core, which
+ *           spins at SCHED_FIFO priority memguardTHROTTLE_PRIORITY until the
+ *           boundary, so nothing below it runs there.  Without CAP_SYS_NICE
+ *           it cannot keep the core and the report says so.
+ *
+ * A regulator thread re-arms every counter at each period boundary, which
+ * restarts the budget whether or not it was used up.  Periods are aligned
+ * on multiples of the period since xMemGuardInit().
+ *
+ * A budget is a number of events per period; ullMemGuardBudget() converts a
+ * bandwidth, counting memguardLINE_SIZE bytes per miss.  Hosts without a PMU
+ * (most VMs) cannot count cache misses; the event can be replaced, e.g. by
+ * PERF_COUNT_SW_TASK_CLOCK, to check the throttling itself.
+ *
+ * Regulated threads must not block memguardSIGNAL.  The FreeRTOS Posix port
+ * owns the signals of its task threads, so regulate native threads (as in
+ * memguard_bench.c) or whole cores.
+ */
+
+#ifndef MEMGUARD_H
+#define MEMGUARD_H
+
+#include <stdint.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#define memguardSIGNAL               ( SIGRTMIN + 4 )
+#define memguardMAX_ENTITIES         ( 16 )
+#define memguardLINE_SIZE            ( 64 )
+#define memguardDEFAULT_PERIOD_NS    ( 1000000ULL )
+#define memguardTHROTTLE_PRIORITY    ( 98 )
+#define memguardREGULATOR_PRIORITY   ( 99 )
+
+typedef struct MemGuardStats
+{
+    const char *pcName;
+    uint64_t ullBudget;              /* Events per period. */
+    uint64_t ullPeriods;
+    uint64_t ullThrottles;           /* Periods in which the budget ran out. */
+    uint64_t ullThrottledNs;
+    int iCore;                       /* -1 for a thread. */
+    int iHoldsCore;                  /* Core throttle thread got SCHED_FIFO. */
+} MemGuardStats_t;
+
+/*
+ * Start the regulator with a period in ns (0 for the default), counting the
+ * perf event ulType/ullConfig, or LLC read misses when both are 0.  Returns 0
+ * on success.
+ */
+int xMemGuardInit(uint64_t ullPeriodNs, uint32_t ulType, uint64_t ullConfig);
+
+/* Regulate one thread (a tid, 0 for the caller) or one core.  Return the
+ * entity index, or -1 with errno set by perf_event_open() and friends. */
+int xMemGuardRegulateThread(pid_t xTid, const char *pcName, uint64_t ullBudget);
+int xMemGuardRegulateCore(int iCpu, const char *pcName, uint64_t ullBudget);
+
+/* Stop the regulator and release every counter. */
+void vMemGuardStop(void);
+
+uint64_t ullMemGuardBudget(double dMegabytesPerSecond, uint64_t ullPeriodNs);
+
+void vMemGuardGetStats(uint32_t ulEntity, MemGuardStats_t *pxStats);
+void vMemGuardReport(void);
+
+#endif /* MEMGUARD_H */
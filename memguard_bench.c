@@ -0,0 +1,402 @@
+/*
+ * Execution times of TX1..TX4 next to a memory bandwidth hog, with and
+ * without MemGuard regulation (memguard.h).
+ *
+ * The jobs of ipsa_jobs.c run back to back every millisecond on CPU 0 and
+ * every job is timed.  Hog threads on the other CPUs stream through a buffer
+ * much larger than the last-level cache.  Three runs of the same length:
+ *
+ *   alone      the jobs only;
+ *   hog        the jobs and the hogs;
+ *   memguard   the same, each hog thread (or with --core, each hog core)
+ *              regulated to --budget MB/s.
+ *
+ * The report gives mean, 99th percentile and maximum execution time per
+ * task and run, and the inflation of the maximum over the run alone.
+ *
+ *     gcc -O2 -pthread memguard_bench.c memguard.c ipsa_jobs.c output.c fmt.c binlog.c -o memguard_bench
+ *     sudo ./memguard_bench 5 --budget 200 > /dev/null
+ *
+ * Hosts without a PMU (most VMs) have no cache miss counter: --software
+ * regulates the hogs on task-clock instead, memguardbenchSOFTWARE_SHARE of
+ * every period, which exercises the throttling but not the bandwidth model.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Local includes. */
+#include "ipsa_jobs.h"
+#include "output.h"
+#include "memguard.h"
+
+#define memguardbenchTASKS            ( 4 )
+#define memguardbenchMAX_HOGS         ( 3 )
+#define memguardbenchHOG_BYTES        ( 256UL * 1024 * 1024 )
+#define memguardbenchROUND_NS         ( 1000000ULL )
+#define memguardbenchMAX_SAMPLES      ( 200000 )
+#define memguardbenchSEARCH_KEY       ( 25 )
+#define memguardbenchDEFAULT_MBPS     ( 200.0 )
+#define memguardbenchSOFTWARE_SHARE   ( 0.25 )
+
+typedef enum
+{
+    eRunAlone,
+    eRunHog,
+    eRunMemGuard,
+    eRuns
+} MemGuardBenchRun_t;
+
+typedef struct MemGuardBenchTask
+{
+    const char *pcName;
+    void (*vJob)(void);
+    uint64_t *pullSamples[eRuns];
+    uint32_t ulSamples[eRuns];
+} MemGuardBenchTask_t;
+
+static void prvJob2(void);
+static void prvJob4(void);
+
+static MemGuardBenchTask_t xTasks[memguardbenchTASKS] =
+{
+    { .pcName = "TX1", .vJob = vIpsaJob1 },
+    { .pcName = "TX2", .vJob = prvJob2 },
+    { .pcName = "TX3", .vJob = vIpsaJob3 },
+    { .pcName = "TX4", .vJob = prvJob4 },
+};
+
+static const char *pcRunNames[eRuns] = { "alone", "hog", "memguard" };
+
+static volatile int iHogsRunning = 0;
+static volatile pid_t xHogTids[memguardbenchMAX_HOGS];
+static volatile uint64_t ullHogBytes[memguardbenchMAX_HOGS];
+
+/*-----------------------------------------------------------*/
+
+static void prvJob2(void)
+{
+    float fahrenheit = 100.0f; // Fixed Fahrenheit temperature value
+
+    vIpsaPrintTemperature(fahrenheit, fIpsaCelsius(fahrenheit));
+}
+
+static void prvJob4(void)
+{
+    vIpsaPrintSearch(xIpsaSearch(memguardbenchSEARCH_KEY, NULL, NULL));
+}
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvPin(int iCpu)
+{
+    cpu_set_t xSet;
+
+    CPU_ZERO(&xSet);
+    CPU_SET(iCpu, &xSet);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(xSet), &xSet);
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+/*-----------------------------------------------------------*/
+
+static void *prvHogThread(void *pvIndex)
+{
+    uint32_t ulIndex = (uint32_t)(uintptr_t)pvIndex;
+    long lOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t *pullBuffer = malloc(memguardbenchHOG_BYTES);
+    uint64_t ullSum = 0;
+
+    prvPin((lOnline > 1) ? (int)(1 + ulIndex % (uint32_t)(lOnline - 1)) : 0);
+    xHogTids[ulIndex] = (pid_t)syscall(SYS_gettid);
+
+    if (pullBuffer == NULL)
+    {
+        return NULL;
+    }
+
+    memset(pullBuffer, 1, memguardbenchHOG_BYTES);
+
+    // Read-modify-write one word per cache line: every access misses
+    while (iHogsRunning)
+    {
+        for (size_t i = 0; (i < memguardbenchHOG_BYTES / sizeof(uint64_t)) && iHogsRunning; i += 8)
+        {
+            ullSum += pullBuffer[i];
+            pullBuffer[i] = ullSum;
+        }
+
+        ullHogBytes[ulIndex] += memguardbenchHOG_BYTES;
+    }
+
+    free(pullBuffer);
+
+    return NULL;
+}
+
+static void prvMeasure(MemGuardBenchRun_t eRun, unsigned uSeconds)
+{
+    struct timespec xRelease;
+    uint64_t ullStop = prvNowNs() + (uint64_t)uSeconds * 1000000000ULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &xRelease);
+
+    while (prvNowNs() < ullStop)
+    {
+        uint64_t ullNext;
+
+        for (uint32_t t = 0; t < memguardbenchTASKS; t++)
+        {
+            MemGuardBenchTask_t *pxTask = &xTasks[t];
+            uint64_t ullStart = prvNowNs();
+
+            pxTask->vJob();
+
+            if (pxTask->ulSamples[eRun] < memguardbenchMAX_SAMPLES)
+            {
+                pxTask->pullSamples[eRun][pxTask->ulSamples[eRun]++] = prvNowNs() - ullStart;
+            }
+        }
+
+        ullNext = (uint64_t)xRelease.tv_sec * 1000000000ULL + (uint64_t)xRelease.tv_nsec + memguardbenchROUND_NS;
+        xRelease.tv_sec = (time_t)(ullNext / 1000000000ULL);
+        xRelease.tv_nsec = (long)(ullNext % 1000000000ULL);
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xRelease, NULL) == EINTR)
+        {
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    pthread_t xHogs[memguardbenchMAX_HOGS];
+    struct sched_param xParam = { .sched_priority = 50 };
+    double dBudgetMbps = memguardbenchDEFAULT_MBPS;
+    unsigned uSeconds = 5;
+    int iPerCore = 0;
+    int iSoftware = 0;
+    uint32_t ulHogs;
+    long lOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t ullBudget;
+    uint64_t ullHogBytesBefore = 0;
+    uint64_t ullHogBytesAfter = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--budget") == 0) && (i + 1 < argc))
+        {
+            dBudgetMbps = strtod(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--core") == 0)
+        {
+            iPerCore = 1;
+        }
+        else if (strcmp(argv[i], "--software") == 0)
+        {
+            iSoftware = 1;
+        }
+        else
+        {
+            uSeconds = (unsigned)strtoul(argv[i], NULL, 10);
+        }
+    }
+
+    ulHogs = (lOnline > 1) ? (uint32_t)(lOnline - 1) : 1;
+
+    if (ulHogs > memguardbenchMAX_HOGS)
+    {
+        ulHogs = memguardbenchMAX_HOGS;
+    }
+
+    if (lOnline < 2)
+    {
+        fprintf(stderr, "memguard_bench: one CPU, the hog competes for time rather than bandwidth\n");
+    }
+
+    for (uint32_t t = 0; t < memguardbenchTASKS; t++)
+    {
+        for (uint32_t r = 0; r < eRuns; r++)
+        {
+            xTasks[t].pullSamples[r] = calloc(memguardbenchMAX_SAMPLES, sizeof(uint64_t));
+
+            if (xTasks[t].pullSamples[r] == NULL)
+            {
+                fprintf(stderr, "memguard_bench: no memory for the samples\n");
+                return 1;
+            }
+        }
+    }
+
+    if (xOutputInit() != 0)
+    {
+        fprintf(stderr, "memguard_bench: asynchronous output unavailable, using stdio\n");
+    }
+
+    prvPin(0);
+
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam) != 0)
+    {
+        fprintf(stderr, "memguard_bench: SCHED_FIFO unavailable, the jobs run SCHED_OTHER\n");
+    }
+
+    prvMeasure(eRunAlone, uSeconds);
+
+    // Hogs are ordinary threads: created before any regulation
+    iHogsRunning = 1;
+    xParam.sched_priority = 0;
+
+    for (uint32_t h = 0; h < ulHogs; h++)
+    {
+        pthread_attr_t xAttr;
+
+        pthread_attr_init(&xAttr);
+        pthread_attr_setinheritsched(&xAttr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&xAttr, SCHED_OTHER);
+        pthread_attr_setschedparam(&xAttr, &xParam);
+        pthread_create(&xHogs[h], &xAttr, prvHogThread, (void *)(uintptr_t)h);
+        pthread_attr_destroy(&xAttr);
+    }
+
+    prvMeasure(eRunHog, uSeconds);
+
+    for (uint32_t h = 0; h < ulHogs; h++)
+    {
+        ullHogBytesBefore += ullHogBytes[h];
+    }
+
+    if (iSoftware)
+    {
+        ullBudget = (uint64_t)((double)memguardDEFAULT_PERIOD_NS * memguardbenchSOFTWARE_SHARE);
+        (void)xMemGuardInit(memguardDEFAULT_PERIOD_NS, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+    }
+    else
+    {
+        ullBudget = ullMemGuardBudget(dBudgetMbps, memguardDEFAULT_PERIOD_NS);
+        (void)xMemGuardInit(memguardDEFAULT_PERIOD_NS, 0, 0);
+    }
+
+    for (uint32_t h = 0; h < ulHogs; h++)
+    {
+        int iResult;
+
+        if (iPerCore)
+        {
+            iResult = xMemGuardRegulateCore((lOnline > 1) ? (int)(1 + h) : 0, "hog", ullBudget);
+        }
+        else
+        {
+            iResult = xMemGuardRegulateThread(xHogTids[h], "hog", ullBudget);
+        }
+
+        if (iResult < 0)
+        {
+            fprintf(stderr, "memguard_bench: cannot regulate hog %u: %s%s\n", (unsigned)h, strerror(errno),
+                    iSoftware ? "" : " (no PMU? try --software)");
+        }
+    }
+
+    prvMeasure(eRunMemGuard, uSeconds);
+
+    for (uint32_t h = 0; h < ulHogs; h++)
+    {
+        ullHogBytesAfter += ullHogBytes[h];
+    }
+
+    vMemGuardStop();
+    iHogsRunning = 0;
+
+    for (uint32_t h = 0; h < ulHogs; h++)
+    {
+        pthread_join(xHogs[h], NULL);
+    }
+
+    vOutputDrain();
+
+    fprintf(stderr, "%-5s %-9s %8s %10s %10s %10s %9s\n", "task", "run", "jobs", "mean", "p99", "max", "max/alone");
+
+    for (uint32_t t = 0; t < memguardbenchTASKS; t++)
+    {
+        MemGuardBenchTask_t *pxTask = &xTasks[t];
+        uint64_t ullAloneMax = 1;
+
+        for (uint32_t r = 0; r < eRuns; r++)
+        {
+            uint32_t ulCount = pxTask->ulSamples[r];
+            uint64_t ullSum = 0;
+
+            if (ulCount == 0)
+            {
+                continue;
+            }
+
+            qsort(pxTask->pullSamples[r], ulCount, sizeof(uint64_t), prvCompare);
+
+            for (uint32_t i = 0; i < ulCount; i++)
+            {
+                ullSum += pxTask->pullSamples[r][i];
+            }
+
+            if (r == eRunAlone)
+            {
+                ullAloneMax = pxTask->pullSamples[r][ulCount - 1];
+            }
+
+            fprintf(stderr, "%-5s %-9s %8u %8.2fus %8.2fus %8.2fus %9.2f\n", pxTask->pcName, pcRunNames[r],
+                    (unsigned)ulCount, (double)ullSum / ulCount / 1000.0,
+                    (double)pxTask->pullSamples[r][(uint64_t)ulCount * 99 / 100] / 1000.0,
+                    (double)pxTask->pullSamples[r][ulCount - 1] / 1000.0,
+                    (double)pxTask->pullSamples[r][ulCount - 1] / (double)ullAloneMax);
+        }
+    }
+
+    fprintf(stderr, "Hog bandwidth: %.0f MB/s unregulated, %.0f MB/s regulated (budget %llu %s per %.1fms)\n",
+            (double)ullHogBytesBefore / 1e6 / uSeconds, (double)(ullHogBytesAfter - ullHogBytesBefore) / 1e6 / uSeconds,
+            (unsigned long long)ullBudget, iSoftware ? "ns of CPU" : "LLC misses",
+            (double)memguardDEFAULT_PERIOD_NS / 1e6);
+
+    for (uint32_t h = 0; h < ulHogs; h++)
+    {
+        MemGuardStats_t xStats;
+
+        vMemGuardGetStats(h, &xStats);
+
+        if (xStats.ullPeriods > 0)
+        {
+            fprintf(stderr, "MemGuard: %s %u throttled in %llu of %llu periods, %.1fms in total%s\n", xStats.pcName,
+                    (unsigned)h, (unsigned long long)xStats.ullThrottles, (unsigned long long)xStats.ullPeriods,
+                    (double)xStats.ullThrottledNs / 1e6,
+                    ((xStats.iCore >= 0) && !xStats.iHoldsCore) ? " (core not held: no SCHED_FIFO)" : "");
+        }
+    }
+
+    return 0;
+}
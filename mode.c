@@ -0,0 +1,536 @@
+/*
+ * Operating modes and mode-change protocols.  See mode.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "mode.h"
+
+#define modeTICK_US    ( (uint64_t)portTICK_PERIOD_MS * 1000ULL )
+
+/* Transitions seen from one mode to another. */
+typedef struct ModePair
+{
+    uint32_t ulCount;
+    TickType_t xLast;
+    TickType_t xMax;
+} ModePair_t;
+
+static ModeTask_t *pxModeTasks = NULL;
+static UBaseType_t uxModeTasks = 0;
+static const Mode_t *pxModes = NULL;
+static UBaseType_t uxModes = 0;
+static ModeProtocol_t eModeProtocol = eModeIdleTime;
+
+static UBaseType_t uxCurrent = 0;
+static UBaseType_t uxTarget = 0;
+static volatile UBaseType_t uxRequested = 0;
+static volatile TickType_t xRequestTick = 0;
+static volatile BaseType_t xInTransition = pdFALSE;
+static TickType_t xOffset = 0;
+
+/* Releases from the request to xWindowEnd count as transition releases. */
+static volatile TickType_t xWindowStart = 0;
+static volatile TickType_t xWindowEnd = 0;
+
+static ModePair_t xPairs[modeMAX_MODES][modeMAX_MODES];
+static uint32_t ulRefused = 0;
+
+/*-----------------------------------------------------------*/
+
+/* xA <= xB, with tick count overflow. */
+static BaseType_t prvNotAfter(TickType_t xA, TickType_t xB)
+{
+    return ((TickType_t)(xB - xA) <= (portMAX_DELAY >> 1)) ? pdTRUE : pdFALSE;
+}
+
+/* Period of a task in a mode, 0 if it does not run there. */
+static TickType_t prvPeriodIn(UBaseType_t uxMode, UBaseType_t uxTask)
+{
+    const Mode_t *pxMode = &pxModes[uxMode];
+
+    for (UBaseType_t i = 0; i < pxMode->uxEntries; i++)
+    {
+        if (pxMode->pxEntries[i].uxTask == uxTask)
+        {
+            return pxMode->pxEntries[i].xPeriod;
+        }
+    }
+
+    return 0;
+}
+
+static TickType_t prvLongestPeriod(UBaseType_t uxMode)
+{
+    TickType_t xLongest = 0;
+
+    for (UBaseType_t i = 0; i < pxModes[uxMode].uxEntries; i++)
+    {
+        if (pxModes[uxMode].pxEntries[i].xPeriod > xLongest)
+        {
+            xLongest = pxModes[uxMode].pxEntries[i].xPeriod;
+        }
+    }
+
+    return xLongest;
+}
+
+/*
+ * Worst-case response time of a task in a mode, in microseconds, interfered
+ * with by the tasks of the mode at its priority or above.  0 if it exceeds
+ * the period.
+ */
+static uint64_t prvResponseUs(UBaseType_t uxMode, UBaseType_t uxTask)
+{
+    const Mode_t *pxMode = &pxModes[uxMode];
+    uint64_t ullPeriod = (uint64_t)prvPeriodIn(uxMode, uxTask) * modeTICK_US;
+    uint64_t ullResponse = pxModeTasks[uxTask].ulWcetUs;
+    uint64_t ullPrevious = 0;
+
+    while (ullResponse != ullPrevious)
+    {
+        ullPrevious = ullResponse;
+        ullResponse = pxModeTasks[uxTask].ulWcetUs;
+
+        for (UBaseType_t i = 0; i < pxMode->uxEntries; i++)
+        {
+            const ModeTask_t *pxOther = &pxModeTasks[pxMode->pxEntries[i].uxTask];
+            uint64_t ullOtherPeriod = (uint64_t)pxMode->pxEntries[i].xPeriod * modeTICK_US;
+
+            if ((pxMode->pxEntries[i].uxTask != uxTask) &&
+                (pxOther->uxPriority >= pxModeTasks[uxTask].uxPriority))
+            {
+                ullResponse += (ullPrevious + ullOtherPeriod - 1) / ullOtherPeriod * pxOther->ulWcetUs;
+            }
+        }
+
+        if (ullResponse > ullPeriod)
+        {
+            return 0;
+        }
+    }
+
+    return ullResponse;
+}
+
+/* Longest busy period of a mode, synchronous release.  0 if U >= 1. */
+static uint64_t prvBusyPeriodUs(UBaseType_t uxMode)
+{
+    const Mode_t *pxMode = &pxModes[uxMode];
+    uint64_t ullBusy = 0;
+    uint64_t ullPrevious = 1;
+    uint64_t ullLimit = 0;
+
+    for (UBaseType_t i = 0; i < pxMode->uxEntries; i++)
+    {
+        ullBusy += pxModeTasks[pxMode->pxEntries[i].uxTask].ulWcetUs;
+        ullLimit += (uint64_t)pxMode->pxEntries[i].xPeriod * modeTICK_US;
+    }
+
+    // With U < 1 the busy period ends within the sum of the periods
+    while ((ullBusy != ullPrevious) && (ullBusy <= ullLimit))
+    {
+        ullPrevious = ullBusy;
+        ullBusy = 0;
+
+        for (UBaseType_t i = 0; i < pxMode->uxEntries; i++)
+        {
+            uint64_t ullPeriod = (uint64_t)pxMode->pxEntries[i].xPeriod * modeTICK_US;
+
+            ullBusy += (ullPrevious + ullPeriod - 1) / ullPeriod * pxModeTasks[pxMode->pxEntries[i].uxTask].ulWcetUs;
+        }
+    }
+
+    return (ullBusy <= ullLimit) ? ullBusy : 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvJobDone(ModeTask_t *pxTask)
+{
+    TickType_t xNow = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    {
+        pxTask->ulJobs++;
+
+        if ((TickType_t)(xNow - pxTask->xReleaseTick) > pxTask->xPeriod)
+        {
+            pxTask->ulMisses++;
+
+            if ((prvNotAfter(xWindowStart, pxTask->xReleaseTick) != pdFALSE) &&
+                ((xInTransition != pdFALSE) || (prvNotAfter(pxTask->xReleaseTick, xWindowEnd) != pdFALSE)))
+            {
+                pxTask->ulTransitionMisses++;
+            }
+        }
+
+        pxTask->xPending = pdFALSE;
+    }
+    taskEXIT_CRITICAL();
+}
+
+static void prvModeTask(void *pvParameters)
+{
+    ModeTask_t *pxTask = (ModeTask_t *)pvParameters;
+
+    for (;;)
+    {
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        pxTask->vJob();
+        prvJobDone(pxTask);
+    }
+}
+
+static void prvStartTransition(void)
+{
+    uxTarget = uxRequested;
+    xWindowStart = xRequestTick;
+    xInTransition = pdTRUE;
+
+    switch (eModeProtocol)
+    {
+        case eModeIdleTime:
+            // The old mode runs on until the first idle tick
+            break;
+
+        case eModeMaxPeriodOffset:
+            xOffset = prvLongestPeriod(uxCurrent);
+
+            if (prvLongestPeriod(uxTarget) > xOffset)
+            {
+                xOffset = prvLongestPeriod(uxTarget);
+            }
+
+            for (UBaseType_t i = 0; i < uxModeTasks; i++)
+            {
+                pxModeTasks[i].xReleasing = pdFALSE;
+            }
+
+            break;
+
+        case eModeUnchangedContinuation:
+            for (UBaseType_t i = 0; i < uxModeTasks; i++)
+            {
+                if (prvPeriodIn(uxTarget, i) != pxModeTasks[i].xPeriod)
+                {
+                    pxModeTasks[i].xReleasing = pdFALSE;
+                }
+            }
+
+            break;
+    }
+}
+
+static BaseType_t prvTransitionDone(TickType_t xNow)
+{
+    if (eModeProtocol == eModeMaxPeriodOffset)
+    {
+        return ((TickType_t)(xNow - xRequestTick) >= xOffset) ? pdTRUE : pdFALSE;
+    }
+
+    // Idle time waits for every job, continuation for the stopped ones only
+    for (UBaseType_t i = 0; i < uxModeTasks; i++)
+    {
+        if ((pxModeTasks[i].xPending != pdFALSE) &&
+            ((eModeProtocol == eModeIdleTime) || (pxModeTasks[i].xReleasing == pdFALSE)))
+        {
+            return pdFALSE;
+        }
+    }
+
+    return pdTRUE;
+}
+
+static void prvCompleteTransition(TickType_t xNow)
+{
+    ModePair_t *pxPair = &xPairs[uxCurrent][uxTarget];
+    TickType_t xLatency = xNow - xRequestTick;
+
+    for (UBaseType_t i = 0; i < uxModeTasks; i++)
+    {
+        ModeTask_t *pxTask = &pxModeTasks[i];
+        TickType_t xPeriod = prvPeriodIn(uxTarget, i);
+
+        if (xPeriod == 0)
+        {
+            pxTask->xReleasing = pdFALSE;
+        }
+        else if ((eModeProtocol != eModeUnchangedContinuation) || (pxTask->xReleasing == pdFALSE))
+        {
+            // Synchronous release of the new mode
+            pxTask->xPeriod = xPeriod;
+            pxTask->xNextRelease = xNow;
+            pxTask->xReleasing = pdTRUE;
+        }
+    }
+
+    pxPair->ulCount++;
+    pxPair->xLast = xLatency;
+
+    if (xLatency > pxPair->xMax)
+    {
+        pxPair->xMax = xLatency;
+    }
+
+    uxCurrent = uxTarget;
+    xWindowEnd = xNow + prvLongestPeriod(uxCurrent);
+    xInTransition = pdFALSE;
+}
+
+static void prvRelease(TickType_t xNow)
+{
+    for (UBaseType_t i = 0; i < uxModeTasks; i++)
+    {
+        ModeTask_t *pxTask = &pxModeTasks[i];
+
+        if ((pxTask->xReleasing == pdFALSE) || (prvNotAfter(pxTask->xNextRelease, xNow) == pdFALSE))
+        {
+            continue;
+        }
+
+        if (pxTask->xPending != pdFALSE)
+        {
+            // The late job is counted as a miss when it completes
+            pxTask->ulOverruns++;
+        }
+        else
+        {
+            pxTask->xReleaseTick = pxTask->xNextRelease;
+            pxTask->xPending = pdTRUE;
+            xTaskNotifyGive(pxTask->xHandle);
+        }
+
+        pxTask->xNextRelease += pxTask->xPeriod;
+    }
+}
+
+static void prvDispatcherTask(void *pvParameters)
+{
+    TickType_t xLastWake = xTaskGetTickCount();
+
+    (void)pvParameters;
+
+    for (UBaseType_t i = 0; i < pxModes[uxCurrent].uxEntries; i++)
+    {
+        ModeTask_t *pxTask = &pxModeTasks[pxModes[uxCurrent].pxEntries[i].uxTask];
+
+        pxTask->xPeriod = pxModes[uxCurrent].pxEntries[i].xPeriod;
+        pxTask->xNextRelease = xLastWake;
+        pxTask->xReleasing = pdTRUE;
+    }
+
+    for (;;)
+    {
+        // A transition is started and completed before the releases of the tick
+        if ((xInTransition == pdFALSE) && (uxRequested != uxCurrent))
+        {
+            prvStartTransition();
+        }
+
+        if ((xInTransition != pdFALSE) && (prvTransitionDone(xLastWake) != pdFALSE))
+        {
+            prvCompleteTransition(xLastWake);
+        }
+
+        prvRelease(xLastWake);
+        vTaskDelayUntil(&xLastWake, 1);
+    }
+}
+
+static const char *prvProtocolName(ModeProtocol_t eProtocol)
+{
+    switch (eProtocol)
+    {
+        case eModeIdleTime:
+            return "idle-time";
+
+        case eModeMaxPeriodOffset:
+            return "max-period-offset";
+
+        case eModeUnchangedContinuation:
+            return "unchanged-continuation";
+
+        default:
+            return "invalid";
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xModeInit(ModeTask_t *pxTasks, UBaseType_t uxTasks, const Mode_t *pxModeTable, UBaseType_t uxModeCount,
+                     ModeProtocol_t eProtocol, UBaseType_t uxInitialMode, UBaseType_t uxDispatcherPriority)
+{
+    configASSERT(uxTasks <= modeMAX_TASKS);
+    configASSERT((uxModeCount <= modeMAX_MODES) && (uxInitialMode < uxModeCount));
+
+    pxModeTasks = pxTasks;
+    uxModeTasks = uxTasks;
+    pxModes = pxModeTable;
+    uxModes = uxModeCount;
+    eModeProtocol = eProtocol;
+    uxCurrent = uxInitialMode;
+    uxRequested = uxInitialMode;
+    xInTransition = pdFALSE;
+    memset(xPairs, 0, sizeof(xPairs));
+
+    for (UBaseType_t i = 0; i < uxTasks; i++)
+    {
+        configASSERT(pxTasks[i].uxPriority < uxDispatcherPriority);
+
+        pxTasks[i].xReleasing = pdFALSE;
+        pxTasks[i].xPending = pdFALSE;
+
+        if (xTaskCreate(prvModeTask, pxTasks[i].pcName, configMINIMAL_STACK_SIZE, &pxTasks[i],
+                        pxTasks[i].uxPriority, &pxTasks[i].xHandle) != pdPASS)
+        {
+            return pdFAIL;
+        }
+    }
+
+    return xTaskCreate(prvDispatcherTask, "Mode", configMINIMAL_STACK_SIZE, NULL, uxDispatcherPriority, NULL);
+}
+
+BaseType_t xModeRequest(UBaseType_t uxMode)
+{
+    BaseType_t xResult = pdFAIL;
+
+    taskENTER_CRITICAL();
+    {
+        if ((uxMode < uxModes) && (xInTransition == pdFALSE) && (uxRequested == uxCurrent))
+        {
+            xRequestTick = xTaskGetTickCount();
+            uxRequested = uxMode;
+            xResult = pdPASS;
+        }
+        else
+        {
+            ulRefused++;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xResult;
+}
+
+UBaseType_t uxModeCurrent(void)
+{
+    return uxCurrent;
+}
+
+TickType_t xModeLatencyBound(UBaseType_t uxFrom, UBaseType_t uxTo)
+{
+    uint64_t ullBoundUs = 0;
+    TickType_t xBound = 0;
+
+    switch (eModeProtocol)
+    {
+        case eModeIdleTime:
+            ullBoundUs = prvBusyPeriodUs(uxFrom);
+
+            if (ullBoundUs == 0)
+            {
+                return portMAX_DELAY;
+            }
+
+            break;
+
+        case eModeMaxPeriodOffset:
+            xBound = prvLongestPeriod(uxFrom);
+
+            if (prvLongestPeriod(uxTo) > xBound)
+            {
+                xBound = prvLongestPeriod(uxTo);
+            }
+
+            break;
+
+        case eModeUnchangedContinuation:
+            for (UBaseType_t i = 0; i < pxModes[uxFrom].uxEntries; i++)
+            {
+                UBaseType_t uxTask = pxModes[uxFrom].pxEntries[i].uxTask;
+                uint64_t ullResponse;
+
+                if (prvPeriodIn(uxTo, uxTask) == pxModes[uxFrom].pxEntries[i].xPeriod)
+                {
+                    continue;
+                }
+
+                ullResponse = prvResponseUs(uxFrom, uxTask);
+
+                if (ullResponse == 0)
+                {
+                    return portMAX_DELAY;
+                }
+
+                if (ullResponse > ullBoundUs)
+                {
+                    ullBoundUs = ullResponse;
+                }
+            }
+
+            break;
+    }
+
+    // Completions are seen at the next tick, the request at the next tick too
+    xBound += (TickType_t)((ullBoundUs + modeTICK_US - 1) / modeTICK_US);
+
+    return xBound + 1;
+}
+
+void vModeReport(void)
+{
+    uint32_t ulJobs = 0;
+    uint32_t ulMisses = 0;
+    uint32_t ulTransitionMisses = 0;
+
+    printf("Mode: current=%s protocol=%s in_transition=%d refused=%lu\n", pxModes[uxCurrent].pcName,
+           prvProtocolName(eModeProtocol), (int)xInTransition, (unsigned long)ulRefused);
+
+    for (UBaseType_t i = 0; i < uxModes; i++)
+    {
+        for (UBaseType_t j = 0; j < uxModes; j++)
+        {
+            const ModePair_t *pxPair = &xPairs[i][j];
+            TickType_t xBound;
+
+            if (pxPair->ulCount == 0)
+            {
+                continue;
+            }
+
+            xBound = xModeLatencyBound(i, j);
+
+            printf("Mode: %s->%s transitions=%lu latency last=%lu max=%lu bound=%lu ticks%s\n",
+                   pxModes[i].pcName, pxModes[j].pcName, (unsigned long)pxPair->ulCount,
+                   (unsigned long)pxPair->xLast, (unsigned long)pxPair->xMax, (unsigned long)xBound,
+                   (pxPair->xMax > xBound) ? " EXCEEDED" : "");
+        }
+    }
+
+    for (UBaseType_t i = 0; i < uxModeTasks; i++)
+    {
+        const ModeTask_t *pxTask = &pxModeTasks[i];
+
+        ulJobs += pxTask->ulJobs;
+        ulMisses += pxTask->ulMisses;
+        ulTransitionMisses += pxTask->ulTransitionMisses;
+
+        if ((pxTask->ulMisses > 0) || (pxTask->ulOverruns > 0))
+        {
+            printf("Mode: %s jobs=%lu misses=%lu (in transitions %lu) overruns=%lu\n", pxTask->pcName,
+                   (unsigned long)pxTask->ulJobs, (unsigned long)pxTask->ulMisses,
+                   (unsigned long)pxTask->ulTransitionMisses, (unsigned long)pxTask->ulOverruns);
+        }
+    }
+
+    printf("Mode: jobs=%lu misses=%lu in transitions=%lu\n", (unsigned long)ulJobs, (unsigned long)ulMisses,
+           (unsigned long)ulTransitionMisses);
+}
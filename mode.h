@@ -0,0 +1,104 @@
+/*
+ * Operating modes of a task set and the protocol that switches between them.
+ *
+ * Each mode (e.g. startup, nominal, degraded) has its own task table: the
+ * tasks of a shared pool that run in the mode, each with its period there.
+ * A task is unchanged by a transition if it runs in both modes with the same
+ * period, changed if its period differs, and old or new if it only runs in
+ * one of them.  The module creates one FreeRTOS task per pool entry and a
+ * dispatcher that releases the jobs of the current mode every tick by task
+ * notification, so that releases can be stopped and restarted exactly as the
+ * transition protocol says:
+ *
+ *   eModeIdleTime              old tasks keep running until the first tick
+ *                              with no pending job; every new mode task is
+ *                              released there.  Latency: at most the longest
+ *                              busy period of the old mode.
+ *   eModeMaxPeriodOffset       old releases stop at the request; every new
+ *                              mode task is released after the longest
+ *                              period of both modes.  Latency: that offset.
+ *   eModeUnchangedContinuation unchanged tasks keep their releases; old and
+ *                              changed tasks stop and finish their pending
+ *                              job, then the new and changed tasks start.
+ *                              Latency: at most the worst-case response time
+ *                              of a stopped task in the old mode.
+ *
+ * Each bound (xModeLatencyBound) is computed with fixed priority response
+ * time analysis from the WCET budgets, plus one tick for the dispatcher to
+ * see the request.  A request is refused while a transition is in progress.
+ * Measured latencies are kept per pair of modes, and deadline misses (a job
+ * completed later than one period after its release) are counted separately
+ * when the job was released during a transition or in the first period of
+ * the longest new mode task after it.
+ */
+
+#ifndef MODE_H
+#define MODE_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define modeMAX_TASKS    ( 16 )
+#define modeMAX_MODES    ( 4 )
+
+typedef enum
+{
+    eModeIdleTime = 0,
+    eModeMaxPeriodOffset,
+    eModeUnchangedContinuation
+} ModeProtocol_t;
+
+typedef struct ModeTask
+{
+    const char *pcName;
+    void (*vJob)(void);
+    UBaseType_t uxPriority;
+    uint32_t ulWcetUs;
+
+    /* Dispatcher state. */
+    TaskHandle_t xHandle;
+    TickType_t xPeriod;              /* Period in the mode that released it. */
+    TickType_t xNextRelease;
+    TickType_t xReleaseTick;         /* Release of the pending or last job. */
+    BaseType_t xReleasing;
+    volatile BaseType_t xPending;
+
+    uint32_t ulJobs;
+    uint32_t ulMisses;
+    uint32_t ulTransitionMisses;
+    uint32_t ulOverruns;             /* Releases skipped, the previous job still pending. */
+} ModeTask_t;
+
+/* A task of the pool and its period in one mode. */
+typedef struct ModeEntry
+{
+    UBaseType_t uxTask;
+    TickType_t xPeriod;
+} ModeEntry_t;
+
+typedef struct Mode
+{
+    const char *pcName;
+    const ModeEntry_t *pxEntries;
+    UBaseType_t uxEntries;
+} Mode_t;
+
+/*
+ * Create the pool tasks and the dispatcher, and start in uxInitialMode.  The
+ * dispatcher must outrank every pool task.  The tables are used in place.
+ */
+BaseType_t xModeInit(ModeTask_t *pxTasks, UBaseType_t uxTasks, const Mode_t *pxModes, UBaseType_t uxModes,
+                     ModeProtocol_t eProtocol, UBaseType_t uxInitialMode, UBaseType_t uxDispatcherPriority);
+
+/* Ask for a transition.  pdFAIL if uxMode is unknown or a transition is in progress. */
+BaseType_t xModeRequest(UBaseType_t uxMode);
+
+UBaseType_t uxModeCurrent(void);
+
+/* Worst-case transition latency in ticks, portMAX_DELAY if the old mode is not schedulable. */
+TickType_t xModeLatencyBound(UBaseType_t uxFrom, UBaseType_t uxTo);
+
+/* Prints the transitions seen against their bound, then the misses per task. */
+void vModeReport(void);
+
+#endif /* MODE_H */
@@ -0,0 +1,325 @@
+/*
+ * Lock-free MPMC ring and blocking queue.  See mpmc.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Local includes. */
+#include "mpmc.h"
+
+#if (mpmcUSE_BLOCKING == 1)
+    #include "FreeRTOS.h"
+    #include "task.h"
+#endif
+
+/* A cell is its sequence number followed by the item. */
+#define mpmcCELL(pxRing, uxPosition) \
+    ( (size_t *)&(pxRing)->pucCells[((uxPosition) & (pxRing)->uxMask) * (pxRing)->uxStride] )
+
+static size_t prvStride(size_t uxItemSize)
+{
+    return (sizeof(size_t) + uxItemSize + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+/*-----------------------------------------------------------*/
+
+size_t uxMpmcStorageSize(size_t uxLength, size_t uxItemSize)
+{
+    return uxLength * prvStride(uxItemSize);
+}
+
+int xMpmcRingInit(MpmcRing_t *pxRing, void *pvStorage, size_t uxLength, size_t uxItemSize)
+{
+    if ((uxLength < 2) || ((uxLength & (uxLength - 1)) != 0) || (uxItemSize == 0))
+    {
+        return -1;
+    }
+
+    memset(pxRing, 0, sizeof(*pxRing));
+    pxRing->pucCells = pvStorage;
+    pxRing->uxMask = uxLength - 1;
+    pxRing->uxItemSize = uxItemSize;
+    pxRing->uxStride = prvStride(uxItemSize);
+
+    for (size_t i = 0; i < uxLength; i++)
+    {
+        __atomic_store_n(mpmcCELL(pxRing, i), i, __ATOMIC_RELAXED);
+    }
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return 0;
+}
+
+int xMpmcRingPush(MpmcRing_t *pxRing, const void *pvItem)
+{
+    size_t uxPosition = __atomic_load_n(&pxRing->uxEnqueue, __ATOMIC_RELAXED);
+    size_t *puxCell;
+
+    for (;;)
+    {
+        size_t uxSequence;
+        intptr_t xDiff;
+
+        puxCell = mpmcCELL(pxRing, uxPosition);
+        uxSequence = __atomic_load_n(puxCell, __ATOMIC_ACQUIRE);
+        xDiff = (intptr_t)uxSequence - (intptr_t)uxPosition;
+
+        if (xDiff == 0)
+        {
+            // Free for this round: claim it, or retry from where the winner left
+            if (__atomic_compare_exchange_n(&pxRing->uxEnqueue, &uxPosition, uxPosition + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (xDiff < 0)
+        {
+            // Still holds the item of the previous round
+            return 0;
+        }
+        else
+        {
+            uxPosition = __atomic_load_n(&pxRing->uxEnqueue, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(puxCell + 1, pvItem, pxRing->uxItemSize);
+    __atomic_store_n(puxCell, uxPosition + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+int xMpmcRingPop(MpmcRing_t *pxRing, void *pvBuffer)
+{
+    size_t uxPosition = __atomic_load_n(&pxRing->uxDequeue, __ATOMIC_RELAXED);
+    size_t *puxCell;
+
+    for (;;)
+    {
+        size_t uxSequence;
+        intptr_t xDiff;
+
+        puxCell = mpmcCELL(pxRing, uxPosition);
+        uxSequence = __atomic_load_n(puxCell, __ATOMIC_ACQUIRE);
+        xDiff = (intptr_t)uxSequence - (intptr_t)(uxPosition + 1);
+
+        if (xDiff == 0)
+        {
+            if (__atomic_compare_exchange_n(&pxRing->uxDequeue, &uxPosition, uxPosition + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (xDiff < 0)
+        {
+            // Not published yet in this round
+            return 0;
+        }
+        else
+        {
+            uxPosition = __atomic_load_n(&pxRing->uxDequeue, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(pvBuffer, puxCell + 1, pxRing->uxItemSize);
+    __atomic_store_n(puxCell, uxPosition + pxRing->uxMask + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+size_t uxMpmcRingCount(MpmcRing_t *pxRing)
+{
+    size_t uxDequeue = __atomic_load_n(&pxRing->uxDequeue, __ATOMIC_ACQUIRE);
+    size_t uxEnqueue = __atomic_load_n(&pxRing->uxEnqueue, __ATOMIC_ACQUIRE);
+    size_t uxCount = uxEnqueue - uxDequeue;
+
+    return ((intptr_t)uxCount < 0) ? 0 : (uxCount > pxRing->uxMask + 1) ? pxRing->uxMask + 1 : uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+#if (mpmcUSE_BLOCKING == 1)
+
+typedef enum
+{
+    eMpmcSenders,                    /* Waiting for a free cell. */
+    eMpmcReceivers,                  /* Waiting for an item. */
+    eMpmcSides
+} MpmcSide_t;
+
+struct MpmcQueue
+{
+    MpmcRing_t xRing;
+    TaskHandle_t xWaiters[eMpmcSides][mpmcMAX_WAITERS];
+};
+
+/* Wake one waiter of xSide, if any. */
+static void prvWakeOne(struct MpmcQueue *pxQueue, MpmcSide_t xSide)
+{
+    TaskHandle_t *pxWaiters = pxQueue->xWaiters[xSide];
+
+    // Orders the ring update before the scan, against the waiter's
+    // registration before its last try
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (UBaseType_t i = 0; i < mpmcMAX_WAITERS; i++)
+    {
+        if (__atomic_load_n(&pxWaiters[i], __ATOMIC_RELAXED) != NULL)
+        {
+            TaskHandle_t xWaiter = __atomic_exchange_n(&pxWaiters[i], NULL, __ATOMIC_ACQ_REL);
+
+            if (xWaiter != NULL)
+            {
+                xTaskNotifyGiveIndexed(xWaiter, mpmcNOTIFY_INDEX);
+                return;
+            }
+        }
+    }
+}
+
+/* The slot the calling task now occupies, or mpmcMAX_WAITERS if all are taken. */
+static UBaseType_t prvRegister(struct MpmcQueue *pxQueue, MpmcSide_t xSide, TaskHandle_t xSelf)
+{
+    TaskHandle_t *pxWaiters = pxQueue->xWaiters[xSide];
+
+    for (UBaseType_t i = 0; i < mpmcMAX_WAITERS; i++)
+    {
+        TaskHandle_t xFree = NULL;
+
+        if (__atomic_compare_exchange_n(&pxWaiters[i], &xFree, xSelf, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            return i;
+        }
+    }
+
+    return mpmcMAX_WAITERS;
+}
+
+/* Leave the slot.  pdTRUE if a waker had already emptied it. */
+static BaseType_t prvUnregister(struct MpmcQueue *pxQueue, MpmcSide_t xSide, UBaseType_t uxSlot, TaskHandle_t xSelf)
+{
+    if (uxSlot >= mpmcMAX_WAITERS)
+    {
+        return pdFALSE;
+    }
+
+    return __atomic_compare_exchange_n(&pxQueue->xWaiters[xSide][uxSlot], &xSelf, NULL, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) ? pdFALSE : pdTRUE;
+}
+
+static int prvTry(struct MpmcQueue *pxQueue, MpmcSide_t xSide, void *pvItem)
+{
+    int iDone = (xSide == eMpmcSenders) ? xMpmcRingPush(&pxQueue->xRing, pvItem)
+                                         : xMpmcRingPop(&pxQueue->xRing, pvItem);
+
+    if (iDone)
+    {
+        prvWakeOne(pxQueue, (xSide == eMpmcSenders) ? eMpmcReceivers : eMpmcSenders);
+    }
+
+    return iDone;
+}
+
+static BaseType_t prvWait(struct MpmcQueue *pxQueue, MpmcSide_t xSide, void *pvItem, TickType_t xTicksToWait)
+{
+    TaskHandle_t xSelf = xTaskGetCurrentTaskHandle();
+    BaseType_t xResult = (xSide == eMpmcSenders) ? errQUEUE_FULL : errQUEUE_EMPTY;
+    BaseType_t xWoken = pdFALSE;
+    TimeOut_t xTimeOut;
+
+    if (prvTry(pxQueue, xSide, pvItem))
+    {
+        return pdPASS;
+    }
+
+    vTaskSetTimeOutState(&xTimeOut);
+
+    while ((xTicksToWait > 0) && (xTaskCheckForTimeOut(&xTimeOut, &xTicksToWait) == pdFALSE))
+    {
+        UBaseType_t uxSlot = prvRegister(pxQueue, xSide, xSelf);
+        int iDone;
+
+        // An operation completed before the registration is seen here
+        iDone = prvTry(pxQueue, xSide, pvItem);
+
+        if (!iDone)
+        {
+            if (uxSlot < mpmcMAX_WAITERS)
+            {
+                (void)ulTaskNotifyTakeIndexed(mpmcNOTIFY_INDEX, pdTRUE, xTicksToWait);
+            }
+            else
+            {
+                vTaskDelay(1);
+            }
+        }
+
+        xWoken = prvUnregister(pxQueue, xSide, uxSlot, xSelf);
+
+        if (iDone || prvTry(pxQueue, xSide, pvItem))
+        {
+            xResult = pdPASS;
+            break;
+        }
+    }
+
+    // The last wake-up may have been meant for another waiter: pass it on
+    if (xWoken)
+    {
+        prvWakeOne(pxQueue, xSide);
+    }
+
+    return xResult;
+}
+
+/*-----------------------------------------------------------*/
+
+MpmcQueueHandle_t xMpmcQueueCreate(UBaseType_t uxLength, UBaseType_t uxItemSize)
+{
+    struct MpmcQueue *pxQueue;
+    void *pvStorage;
+
+    configASSERT((uxLength > 1) && ((uxLength & (uxLength - 1)) == 0) && (uxItemSize > 0));
+
+    pxQueue = pvPortMalloc(sizeof(struct MpmcQueue));
+    pvStorage = pvPortMalloc(uxMpmcStorageSize(uxLength, uxItemSize));
+
+    if ((pxQueue == NULL) || (pvStorage == NULL) ||
+        (xMpmcRingInit(&pxQueue->xRing, pvStorage, uxLength, uxItemSize) != 0))
+    {
+        vPortFree(pvStorage);
+        vPortFree(pxQueue);
+        return NULL;
+    }
+
+    memset(pxQueue->xWaiters, 0, sizeof(pxQueue->xWaiters));
+
+    return pxQueue;
+}
+
+void vMpmcQueueDelete(MpmcQueueHandle_t xQueue)
+{
+    vPortFree(xQueue->xRing.pucCells);
+    vPortFree(xQueue);
+}
+
+BaseType_t xMpmcQueueSend(MpmcQueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait)
+{
+    return prvWait(xQueue, eMpmcSenders, (void *)pvItem, xTicksToWait);
+}
+
+BaseType_t xMpmcQueueReceive(MpmcQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    return prvWait(xQueue, eMpmcReceivers, pvBuffer, xTicksToWait);
+}
+
+UBaseType_t uxMpmcQueueMessagesWaiting(MpmcQueueHandle_t xQueue)
+{
+    return (UBaseType_t)uxMpmcRingCount(&xQueue->xRing);
+}
+
+#endif /* mpmcUSE_BLOCKING */
@@ -0,0 +1,96 @@
+/*
+ * Bounded lock-free multi-producer multi-consumer ring (D. Vyukov's
+ * sequence-numbered slots), with a blocking queue on top of it.
+ *
+ * On an SMP kernel every xQueueSend()/xQueueReceive() takes the kernel
+ * critical section, a lock shared by all cores, so producers and consumers
+ * of unrelated queues serialize on it.  The ring needs one compare-and-swap
+ * per operation, on the enqueue or the dequeue position only:
+ *
+ *   each cell carries a sequence number; cell i is free for the producer
+ *   holding position p when its sequence is p, and full for the consumer
+ *   holding position p when it is p + 1.  A producer claims p by advancing
+ *   the enqueue position, copies the item and publishes it by storing
+ *   p + 1; a consumer claims p by advancing the dequeue position, copies the
+ *   item out and frees the cell for the next round by storing p + length.
+ *
+ * A claimed cell is owned until published, so a producer or consumer
+ * preempted between claim and publish delays the operations that reach that
+ * cell after it: the ring is lock-free across cores, not wait-free, and is
+ * meant for senders and receivers that are not preempted for long while
+ * they copy an item.  Items are copied, as by xQueueSend(); the length must
+ * be a power of two.
+ *
+ * The ring itself does not depend on the kernel and builds on the host
+ * (mpmc_bench.c) with mpmcUSE_BLOCKING set to 0.  The blocking queue waits
+ * for an item or a free cell on a task notification (index
+ * mpmcNOTIFY_INDEX, so the job release notifications of index 0 are left
+ * alone): a waiter publishes its handle in one of mpmcMAX_WAITERS slots,
+ * tries once more, then sleeps; every successful operation wakes one waiter
+ * of the other side.  Operations that find no waiter touch no kernel state.
+ * Waiters beyond mpmcMAX_WAITERS poll every tick.
+ */
+
+#ifndef MPMC_H
+#define MPMC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef mpmcUSE_BLOCKING
+    #define mpmcUSE_BLOCKING    1
+#endif
+
+#define mpmcCACHE_LINE          ( 64 )
+#define mpmcMAX_WAITERS         ( 8 )
+#define mpmcNOTIFY_INDEX        ( 1 )
+
+typedef struct MpmcRing
+{
+    uint8_t *pucCells;
+    size_t uxMask;
+    size_t uxItemSize;
+    size_t uxStride;
+    uint8_t ucPad0[mpmcCACHE_LINE];
+    size_t uxEnqueue;
+    uint8_t ucPad1[mpmcCACHE_LINE - sizeof(size_t)];
+    size_t uxDequeue;
+    uint8_t ucPad2[mpmcCACHE_LINE - sizeof(size_t)];
+} MpmcRing_t;
+
+/* Bytes of storage for uxLength cells of uxItemSize bytes. */
+size_t uxMpmcStorageSize(size_t uxLength, size_t uxItemSize);
+
+/* Set up a ring over pvStorage, size_t aligned.  0, or -1 if uxLength is not
+ * a power of two. */
+int xMpmcRingInit(MpmcRing_t *pxRing, void *pvStorage, size_t uxLength, size_t uxItemSize);
+
+/* 1 if the item was copied in (out), 0 if the ring was full (empty). */
+int xMpmcRingPush(MpmcRing_t *pxRing, const void *pvItem);
+int xMpmcRingPop(MpmcRing_t *pxRing, void *pvBuffer);
+
+/* A snapshot, exact only when no operation is in progress. */
+size_t uxMpmcRingCount(MpmcRing_t *pxRing);
+
+#if (mpmcUSE_BLOCKING == 1)
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct MpmcQueue *MpmcQueueHandle_t;
+
+/* NULL if the memory cannot be allocated. */
+MpmcQueueHandle_t xMpmcQueueCreate(UBaseType_t uxLength, UBaseType_t uxItemSize);
+void vMpmcQueueDelete(MpmcQueueHandle_t xQueue);
+
+/* pdPASS, or errQUEUE_FULL if no cell freed up within xTicksToWait. */
+BaseType_t xMpmcQueueSend(MpmcQueueHandle_t xQueue, const void *pvItem, TickType_t xTicksToWait);
+
+/* pdPASS, or errQUEUE_EMPTY if no item arrived within xTicksToWait. */
+BaseType_t xMpmcQueueReceive(MpmcQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+
+UBaseType_t uxMpmcQueueMessagesWaiting(MpmcQueueHandle_t xQueue);
+
+#endif /* mpmcUSE_BLOCKING */
+
+#endif /* MPMC_H */
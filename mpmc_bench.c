@@ -0,0 +1,363 @@
+/*
+ * Throughput and per-operation latency of the lock-free MPMC ring (mpmc.h)
+ * against a queue serialized by one lock, at 2, 4 and 8 cores.
+ *
+ * The FreeRTOS Posix port runs one core, so the SMP kernel queue is modelled
+ * on the host: every xQueueSend()/xQueueReceive() of an SMP build runs in
+ * the kernel critical section, one lock for all cores and all queues, around
+ * a copy into a circular buffer.  The "kernel" queue here is the same ring
+ * of cells behind one mutex (the host cannot keep a lock holder from being
+ * preempted, as the critical section does, so a spinlock would measure the
+ * host scheduler).  Both queues copy mpmcbenchITEM_SIZE byte items.
+ *
+ * For each core count n, n/2 producer and n/2 consumer threads are pinned to
+ * CPUs 0..n-1 (modulo the online CPUs) and move --ops items each.  A full
+ * or empty queue is retried after sched_yield().  Every successful
+ * operation is timed; the report gives the throughput, the median, 99th,
+ * 99.9th percentile and maximum of send and receive, and the retries.
+ * Consumers check the sum of the items they received.
+ *
+ *     gcc -O2 -pthread -DmpmcUSE_BLOCKING=0 mpmc_bench.c mpmc.c -o mpmc_bench
+ *     ./mpmc_bench --cores 2,4,8 --ops 200000
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* Local includes. */
+#include "mpmc.h"
+
+#define mpmcbenchMAX_THREADS     ( 64 )
+#define mpmcbenchITEM_SIZE       ( 32 )
+#define mpmcbenchDEFAULT_OPS     ( 200000 )
+#define mpmcbenchDEFAULT_LENGTH  ( 256 )
+
+typedef enum
+{
+    eQueueRing,
+    eQueueKernel,
+    eQueues
+} MpmcBenchQueue_t;
+
+typedef struct MpmcBenchItem
+{
+    uint64_t ullValue;
+    uint8_t ucPayload[mpmcbenchITEM_SIZE - sizeof(uint64_t)];
+} MpmcBenchItem_t;
+
+/* The queue behind the kernel lock: a ring without the sequence numbers. */
+typedef struct MpmcBenchLocked
+{
+    pthread_mutex_t xLock;
+    MpmcBenchItem_t *pxItems;
+    size_t uxLength;
+    size_t uxHead;
+    size_t uxCount;
+} MpmcBenchLocked_t;
+
+typedef struct MpmcBenchThread
+{
+    pthread_t xThread;
+    uint32_t ulIndex;
+    int iProducer;
+    uint64_t *pullSamples;
+    uint64_t ullRetries;
+    uint64_t ullSum;
+} MpmcBenchThread_t;
+
+static const char *pcQueueNames[eQueues] = { "ring", "kernel" };
+
+static MpmcBenchQueue_t eQueue;
+static MpmcRing_t xRing;
+static MpmcBenchLocked_t xLocked;
+static uint32_t ulOps = mpmcbenchDEFAULT_OPS;
+static uint32_t ulProducers;
+static volatile int iGo = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvPin(int iCpu)
+{
+    cpu_set_t xSet;
+
+    CPU_ZERO(&xSet);
+    CPU_SET(iCpu, &xSet);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(xSet), &xSet);
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvLockedPush(const MpmcBenchItem_t *pxItem)
+{
+    int iDone = 0;
+
+    pthread_mutex_lock(&xLocked.xLock);
+
+    if (xLocked.uxCount < xLocked.uxLength)
+    {
+        xLocked.pxItems[(xLocked.uxHead + xLocked.uxCount++) % xLocked.uxLength] = *pxItem;
+        iDone = 1;
+    }
+
+    pthread_mutex_unlock(&xLocked.xLock);
+
+    return iDone;
+}
+
+static int prvLockedPop(MpmcBenchItem_t *pxItem)
+{
+    int iDone = 0;
+
+    pthread_mutex_lock(&xLocked.xLock);
+
+    if (xLocked.uxCount > 0)
+    {
+        *pxItem = xLocked.pxItems[xLocked.uxHead];
+        xLocked.uxHead = (xLocked.uxHead + 1) % xLocked.uxLength;
+        xLocked.uxCount--;
+        iDone = 1;
+    }
+
+    pthread_mutex_unlock(&xLocked.xLock);
+
+    return iDone;
+}
+
+static void *prvWorkerThread(void *pvThread)
+{
+    MpmcBenchThread_t *pxThread = pvThread;
+    long lOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    MpmcBenchItem_t xItem;
+
+    prvPin((int)(pxThread->ulIndex % (uint32_t)((lOnline > 0) ? lOnline : 1)));
+    memset(&xItem, 0, sizeof(xItem));
+
+    while (!__atomic_load_n(&iGo, __ATOMIC_ACQUIRE))
+    {
+    }
+
+    for (uint32_t i = 0; i < ulOps; i++)
+    {
+        for (;;)
+        {
+            uint64_t ullStart = prvNowNs();
+            int iDone;
+
+            xItem.ullValue = i + 1;
+
+            if (eQueue == eQueueRing)
+            {
+                iDone = pxThread->iProducer ? xMpmcRingPush(&xRing, &xItem) : xMpmcRingPop(&xRing, &xItem);
+            }
+            else
+            {
+                iDone = pxThread->iProducer ? prvLockedPush(&xItem) : prvLockedPop(&xItem);
+            }
+
+            if (iDone)
+            {
+                pxThread->pullSamples[i] = prvNowNs() - ullStart;
+                break;
+            }
+
+            pxThread->ullRetries++;
+            sched_yield();
+        }
+
+        if (!pxThread->iProducer)
+        {
+            pxThread->ullSum += xItem.ullValue;
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReportSide(const char *pcSide, MpmcBenchThread_t *pxThreads, uint32_t ulThreads, int iProducer)
+{
+    uint64_t *pullAll = malloc((size_t)ulOps * ulThreads * sizeof(uint64_t));
+    size_t uxCount = 0;
+    uint64_t ullRetries = 0;
+
+    if (pullAll == NULL)
+    {
+        return;
+    }
+
+    for (uint32_t t = 0; t < ulThreads; t++)
+    {
+        if (pxThreads[t].iProducer == iProducer)
+        {
+            memcpy(&pullAll[uxCount], pxThreads[t].pullSamples, (size_t)ulOps * sizeof(uint64_t));
+            uxCount += ulOps;
+            ullRetries += pxThreads[t].ullRetries;
+        }
+    }
+
+    qsort(pullAll, uxCount, sizeof(uint64_t), prvCompare);
+    fprintf(stderr, " %-7s %8lu %8lu %8lu %8lu %10lu", pcSide, (unsigned long)pullAll[uxCount / 2],
+            (unsigned long)pullAll[uxCount * 99 / 100], (unsigned long)pullAll[uxCount * 999 / 1000],
+            (unsigned long)pullAll[uxCount - 1], (unsigned long)ullRetries);
+    free(pullAll);
+}
+
+static int prvRun(MpmcBenchQueue_t eRun, uint32_t ulCores)
+{
+    MpmcBenchThread_t xThreads[mpmcbenchMAX_THREADS];
+    uint64_t ullExpected = (uint64_t)ulProducers * ulOps * (ulOps + 1ULL) / 2;
+    uint64_t ullSum = 0;
+    uint64_t ullStart;
+    uint64_t ullElapsed;
+
+    eQueue = eRun;
+    iGo = 0;
+    memset(xThreads, 0, sizeof(xThreads));
+
+    for (uint32_t t = 0; t < ulCores; t++)
+    {
+        xThreads[t].ulIndex = t;
+        xThreads[t].iProducer = (t % 2 == 0);
+        xThreads[t].pullSamples = calloc(ulOps, sizeof(uint64_t));
+
+        if (xThreads[t].pullSamples == NULL)
+        {
+            fprintf(stderr, "mpmc_bench: no memory for the samples\n");
+            return -1;
+        }
+
+        pthread_create(&xThreads[t].xThread, NULL, prvWorkerThread, &xThreads[t]);
+    }
+
+    ullStart = prvNowNs();
+    __atomic_store_n(&iGo, 1, __ATOMIC_RELEASE);
+
+    for (uint32_t t = 0; t < ulCores; t++)
+    {
+        pthread_join(xThreads[t].xThread, NULL);
+        ullSum += xThreads[t].ullSum;
+    }
+
+    ullElapsed = prvNowNs() - ullStart;
+
+    fprintf(stderr, "%5u %-7s %10.3f", (unsigned)ulCores, pcQueueNames[eRun],
+            (double)ulProducers * ulOps * 1000.0 / (double)ullElapsed);
+    prvReportSide("send", xThreads, ulCores, 1);
+    prvReportSide("receive", xThreads, ulCores, 0);
+    fprintf(stderr, "%s\n", (ullSum == ullExpected) ? "" : "  SUM MISMATCH");
+
+    for (uint32_t t = 0; t < ulCores; t++)
+    {
+        free(xThreads[t].pullSamples);
+    }
+
+    return (ullSum == ullExpected) ? 0 : -1;
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    const char *pcCores = "2,4,8";
+    size_t uxLength = mpmcbenchDEFAULT_LENGTH;
+    long lOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    void *pvStorage;
+    char *pcList;
+    int iResult = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--cores") == 0) && (i + 1 < argc))
+        {
+            pcCores = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--ops") == 0) && (i + 1 < argc))
+        {
+            ulOps = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--length") == 0) && (i + 1 < argc))
+        {
+            uxLength = (size_t)strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            fprintf(stderr, "usage: mpmc_bench [--cores 2,4,8] [--ops n] [--length power of two]\n");
+            return 1;
+        }
+    }
+
+    pvStorage = malloc(uxMpmcStorageSize(uxLength, sizeof(MpmcBenchItem_t)));
+    xLocked.pxItems = calloc(uxLength, sizeof(MpmcBenchItem_t));
+    xLocked.uxLength = uxLength;
+    pthread_mutex_init(&xLocked.xLock, NULL);
+
+    if ((ulOps == 0) || (pvStorage == NULL) || (xLocked.pxItems == NULL) ||
+        (xMpmcRingInit(&xRing, pvStorage, uxLength, sizeof(MpmcBenchItem_t)) != 0))
+    {
+        fprintf(stderr, "mpmc_bench: --length must be a power of two, --ops positive\n");
+        return 1;
+    }
+
+    fprintf(stderr, "%5s %-7s %10s %-7s %8s %8s %8s %8s %10s %-7s %8s %8s %8s %8s %10s\n", "cores", "queue",
+            "Mitems/s", "op", "p50 ns", "p99", "p99.9", "max", "retries", "op", "p50 ns", "p99", "p99.9", "max",
+            "retries");
+
+    pcList = strdup(pcCores);
+
+    for (char *pcToken = strtok(pcList, ","); pcToken != NULL; pcToken = strtok(NULL, ","))
+    {
+        uint32_t ulCores = (uint32_t)strtoul(pcToken, NULL, 10);
+
+        if ((ulCores < 2) || (ulCores > mpmcbenchMAX_THREADS) || (ulCores % 2 != 0))
+        {
+            fprintf(stderr, "mpmc_bench: %s cores: need an even count from 2 to %u\n", pcToken,
+                    (unsigned)mpmcbenchMAX_THREADS);
+            continue;
+        }
+
+        if (ulCores > (uint32_t)lOnline)
+        {
+            fprintf(stderr, "mpmc_bench: %u threads on %ld CPUs, the threads share CPUs\n", (unsigned)ulCores,
+                    lOnline);
+        }
+
+        ulProducers = ulCores / 2;
+
+        for (uint32_t q = 0; q < eQueues; q++)
+        {
+            iResult |= prvRun((MpmcBenchQueue_t)q, ulCores);
+        }
+    }
+
+    free(pcList);
+    free(xLocked.pxItems);
+    free(pvStorage);
+
+    return (iResult == 0) ? 0 : 1;
+}
@@ -0,0 +1,344 @@
+/*
+ * Platform noise detector in the style of the kernel's hwlat tracer.
+ *
+ * A thread pinned to one CPU reads the time stamp counter in a tight loop.
+ * Two consecutive reads further apart than the threshold mean that the CPU
+ * was taken away from the loop: an SMI, a hypervisor steal, a host interrupt
+ * or anything else the kernel under test does not account for.  Each such
+ * gap is written to the output as one JSON line
+ *
+ *     {"t_ns": <CLOCK_MONOTONIC at the start of the gap>, "gap_ns": <length>}
+ *
+ * flushed at once, so that a harness can match it against its own samples
+ * (wcet_time.py --noise marks the runs that overlap a gap).  The end of each
+ * spin writes the interval that was actually watched
+ *
+ *     {"spin_t_ns": <CLOCK_MONOTONIC at the start of the spin>, "spin_ns": <length>}
+ *
+ * The summary goes to stderr when the detector stops, on SIGINT/SIGTERM or
+ * after --seconds.
+ *
+ * Like hwlat, the loop spins for --width out of every --window so that a
+ * detector sharing its CPU leaves time to the rest; gaps are only seen while
+ * spinning, and the summary gives that coverage, gaps excluded.  The width is
+ * capped below the kernel's RT bandwidth limit (sched_rt_runtime_us out of
+ * sched_rt_period_us): a throttled spin would report its own throttling as
+ * noise.  Spinning at SCHED_FIFO
+ * keeps ordinary tasks out of the measurement, but unlike hwlat interrupts
+ * stay enabled, so a gap can also be a local interrupt: put the detector on
+ * a sibling or an isolated core to separate the two.
+ *
+ *     gcc -O2 -pthread noise_detect.c -o noise_detect
+ *     sudo ./noise_detect --cpu 1 --threshold 10 --output noise.jsonl
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define noiseHAS_TSC    1
+#else
+    #define noiseHAS_TSC    0
+#endif
+
+#define noiseDEFAULT_THRESHOLD_US    ( 10 )
+#define noiseDEFAULT_WINDOW_MS       ( 1000 )
+#define noiseDEFAULT_WIDTH_MS        ( 500 )
+#define noisePRIORITY                ( 90 )
+#define noiseCALIBRATION_NS          ( 100000000ULL )
+#define noiseRT_SHARE                ( 0.9 )    /* Of the RT bandwidth limit a spin may use. */
+
+typedef struct NoiseStats
+{
+    uint64_t ullEvents;
+    uint64_t ullMaxGapNs;
+    uint64_t ullNoiseNs;
+    uint64_t ullSpinNs;
+    uint64_t ullElapsedNs;
+} NoiseStats_t;
+
+static volatile sig_atomic_t iStop = 0;
+static double dNsPerTick = 1.0;
+static NoiseStats_t xStats;
+
+/*-----------------------------------------------------------*/
+
+static void prvStop(int iSignal)
+{
+    (void)iSignal;
+    iStop = 1;
+}
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+/* Raw counter of the loop: the TSC where there is one. */
+static inline uint64_t prvTicks(void)
+{
+#if (noiseHAS_TSC == 1)
+    return __rdtsc();
+#else
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+#endif
+}
+
+static void prvCalibrate(void)
+{
+    uint64_t ullStartNs = prvNowNs();
+    uint64_t ullStartTicks = prvTicks();
+    uint64_t ullNs;
+
+    while ((ullNs = prvNowNs() - ullStartNs) < noiseCALIBRATION_NS)
+    {
+    }
+
+    dNsPerTick = (double)ullNs / (double)(prvTicks() - ullStartTicks);
+}
+
+static int64_t prvReadProc(const char *pcPath)
+{
+    FILE *pxFile = fopen(pcPath, "r");
+    long long llValue = -1;
+
+    if (pxFile != NULL)
+    {
+        if (fscanf(pxFile, "%lld", &llValue) != 1)
+        {
+            llValue = -1;
+        }
+
+        fclose(pxFile);
+    }
+
+    return (int64_t)llValue;
+}
+
+/*
+ * Longest spin per window the RT throttling leaves alone, or UINT64_MAX when
+ * throttling is off.  A spin longer than the runtime, or a spin share above
+ * runtime/period, gets the task throttled.
+ */
+static uint64_t prvRtWidthLimitNs(uint64_t ullWindowNs)
+{
+    int64_t llRuntimeUs = prvReadProc("/proc/sys/kernel/sched_rt_runtime_us");
+    int64_t llPeriodUs = prvReadProc("/proc/sys/kernel/sched_rt_period_us");
+    double dLimitNs;
+
+    if ((llRuntimeUs < 0) || (llPeriodUs <= 0))
+    {
+        return UINT64_MAX;
+    }
+
+    dLimitNs = (double)ullWindowNs * (double)llRuntimeUs / (double)llPeriodUs;
+
+    if (dLimitNs > (double)llRuntimeUs * 1000.0)
+    {
+        dLimitNs = (double)llRuntimeUs * 1000.0;
+    }
+
+    return (uint64_t)(dLimitNs * noiseRT_SHARE);
+}
+
+/* Spin until ullEndNs, recording every gap above ullThresholdTicks. */
+static void prvSpin(uint64_t ullEndNs, uint64_t ullThresholdTicks, FILE *pxOutput)
+{
+    uint64_t ullNowNs = prvNowNs();
+    uint64_t ullSpinStart = prvTicks();
+    uint64_t ullLast = ullSpinStart;
+    uint64_t ullEndTicks = ullSpinStart;
+    uint64_t ullGapsNs = 0;
+    uint64_t ullSpinNs;
+
+    if (ullEndNs > ullNowNs)
+    {
+        ullEndTicks += (uint64_t)((double)(ullEndNs - ullNowNs) / dNsPerTick);
+    }
+
+    while ((ullLast < ullEndTicks) && !iStop)
+    {
+        uint64_t ullNow = prvTicks();
+        uint64_t ullGap = ullNow - ullLast;
+
+        if (ullGap > ullThresholdTicks)
+        {
+            uint64_t ullGapNs = (uint64_t)((double)ullGap * dNsPerTick);
+            uint64_t ullAtNs = prvNowNs() - ullGapNs;
+
+            xStats.ullEvents++;
+            xStats.ullNoiseNs += ullGapNs;
+            ullGapsNs += ullGapNs;
+            xStats.ullMaxGapNs = (ullGapNs > xStats.ullMaxGapNs) ? ullGapNs : xStats.ullMaxGapNs;
+
+            fprintf(pxOutput, "{\"t_ns\": %llu, \"gap_ns\": %llu}\n", (unsigned long long)ullAtNs,
+                    (unsigned long long)ullGapNs);
+            fflush(pxOutput);
+
+            // Writing the event is not noise: start again from here
+            ullNow = prvTicks();
+        }
+
+        ullLast = ullNow;
+    }
+
+    // The CPU was not watched during the gaps
+    ullSpinNs = (uint64_t)((double)(ullLast - ullSpinStart) * dNsPerTick);
+    xStats.ullSpinNs += (ullSpinNs > ullGapsNs) ? (ullSpinNs - ullGapsNs) : 0;
+
+    fprintf(pxOutput, "{\"spin_t_ns\": %llu, \"spin_ns\": %llu}\n", (unsigned long long)ullNowNs,
+            (unsigned long long)ullSpinNs);
+    fflush(pxOutput);
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    struct sched_param xParam = { .sched_priority = noisePRIORITY };
+    struct sigaction xAction;
+    cpu_set_t xSet;
+    FILE *pxOutput = stdout;
+    int iCpu = -1;
+    uint64_t ullThresholdUs = noiseDEFAULT_THRESHOLD_US;
+    uint64_t ullWindowNs = noiseDEFAULT_WINDOW_MS * 1000000ULL;
+    uint64_t ullWidthNs = noiseDEFAULT_WIDTH_MS * 1000000ULL;
+    uint64_t ullStopNs = UINT64_MAX;
+    uint64_t ullStartNs;
+    int iFifo;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--cpu") == 0)
+        {
+            iCpu = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--threshold") == 0)
+        {
+            ullThresholdUs = strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--window") == 0)
+        {
+            ullWindowNs = strtoull(argv[i + 1], NULL, 10) * 1000000ULL;
+        }
+        else if (strcmp(argv[i], "--width") == 0)
+        {
+            ullWidthNs = strtoull(argv[i + 1], NULL, 10) * 1000000ULL;
+        }
+        else if (strcmp(argv[i], "--seconds") == 0)
+        {
+            ullStopNs = strtoull(argv[i + 1], NULL, 10) * 1000000000ULL;
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            pxOutput = fopen(argv[i + 1], "w");
+
+            if (pxOutput == NULL)
+            {
+                fprintf(stderr, "noise_detect: cannot open %s: %s\n", argv[i + 1], strerror(errno));
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "noise_detect: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if ((ullWidthNs == 0) || (ullWidthNs > ullWindowNs))
+    {
+        ullWidthNs = ullWindowNs;
+    }
+
+    memset(&xAction, 0, sizeof(xAction));
+    xAction.sa_handler = prvStop;
+    sigaction(SIGINT, &xAction, NULL);
+    sigaction(SIGTERM, &xAction, NULL);
+
+    if (iCpu >= 0)
+    {
+        CPU_ZERO(&xSet);
+        CPU_SET(iCpu, &xSet);
+
+        if (sched_setaffinity(0, sizeof(xSet), &xSet) != 0)
+        {
+            fprintf(stderr, "noise_detect: cannot pin to CPU %d: %s\n", iCpu, strerror(errno));
+        }
+    }
+
+    prvCalibrate();
+
+    // Calibrated before SCHED_FIFO: the calibration spin holds nothing up
+    iFifo = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam) == 0);
+
+    if (!iFifo)
+    {
+        fprintf(stderr, "noise_detect: SCHED_FIFO unavailable, preemptions will show up as noise\n");
+    }
+    else if (ullWidthNs > prvRtWidthLimitNs(ullWindowNs))
+    {
+        ullWidthNs = prvRtWidthLimitNs(ullWindowNs);
+        fprintf(stderr, "noise_detect: width capped to %.1fms by the RT bandwidth limit\n", (double)ullWidthNs / 1e6);
+    }
+
+    ullStartNs = prvNowNs();
+
+    if (ullStopNs != UINT64_MAX)
+    {
+        ullStopNs += ullStartNs;
+    }
+
+    while (!iStop && (prvNowNs() < ullStopNs))
+    {
+        uint64_t ullWindowStart = prvNowNs();
+        uint64_t ullSpinEnd = ullWindowStart + ullWidthNs;
+        struct timespec xWake;
+
+        prvSpin((ullSpinEnd < ullStopNs) ? ullSpinEnd : ullStopNs,
+                (uint64_t)((double)(ullThresholdUs * 1000ULL) / dNsPerTick), pxOutput);
+
+        if (ullWidthNs < ullWindowNs)
+        {
+            uint64_t ullWake = ullWindowStart + ullWindowNs;
+
+            xWake.tv_sec = (time_t)(ullWake / 1000000000ULL);
+            xWake.tv_nsec = (long)(ullWake % 1000000000ULL);
+            (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xWake, NULL);
+        }
+    }
+
+    xStats.ullElapsedNs = prvNowNs() - ullStartNs;
+
+    if (pxOutput != stdout)
+    {
+        fclose(pxOutput);
+    }
+
+    fprintf(stderr, "Noise: cpu=%d threshold=%lluus %s events=%llu max gap=%.1fus noise=%.3fms coverage=%.1f%% of %.1fs\n",
+            iCpu, (unsigned long long)ullThresholdUs, noiseHAS_TSC ? "tsc" : "clock", (unsigned long long)xStats.ullEvents,
+            (double)xStats.ullMaxGapNs / 1000.0, (double)xStats.ullNoiseNs / 1e6,
+            (xStats.ullElapsedNs > 0) ? 100.0 * (double)xStats.ullSpinNs / (double)xStats.ullElapsedNs : 0.0,
+            (double)xStats.ullElapsedNs / 1e9);
+
+    return 0;
+}
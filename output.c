@@ -0,0 +1,820 @@
+/*
+ * Asynchronous output backend for logs and traces.  See output.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/* Local includes. */
+#include "output.h"
+
+typedef enum
+{
+    eBufferFree,
+    eBufferFilling,                  /* Taken by a producer, installed or sealed. */
+    eBufferInFlight
+} OutputBufferState_t;
+
+/*
+ * A filling buffer is described by one word, updated by compare-and-swap:
+ * the bytes reserved so far, the producers still copying into their
+ * reservation, the sealed bit and the ticket the buffer was installed with.
+ * The ticket orders the buffers of a stream and tells a producer holding a
+ * stale index that the buffer has been reused since.
+ */
+#define outputWORD_BYTES_MASK       ( 0xFFFFFULL )
+#define outputWORD_WRITER           ( 1ULL << 32 )
+#define outputWORD_WRITERS_MASK     ( 0xFFFULL << 32 )
+#define outputWORD_SEALED           ( 1ULL << 44 )
+#define outputWORD_TICKET_SHIFT     ( 45 )
+#define outputWORD_TICKET_MASK      ( ( 1ULL << ( 64 - outputWORD_TICKET_SHIFT ) ) - 1 )
+
+/* The current buffer of a stream: install ticket << 8 | buffer + 1. */
+#define outputCURRENT_BUFFER(x)     ( (int)( (x) & 0xFFU ) - 1 )
+#define outputCURRENT_TICKET(x)     ( (x) >> 8 )
+
+struct OutputStream
+{
+    int iFd;
+    uint64_t ullCurrent;             /* Buffer being filled, 0 in the low byte if none. */
+    uint32_t ulState[outputBUFFERS_PER_STREAM];
+    uint64_t ullWord[outputBUFFERS_PER_STREAM];
+    uint64_t ullOpenedNs[outputBUFFERS_PER_STREAM];
+    uint64_t ullSealedNs[outputBUFFERS_PER_STREAM];
+
+    /* Drainer and writer side only. */
+    size_t xFill[outputBUFFERS_PER_STREAM];
+    size_t xWritten[outputBUFFERS_PER_STREAM];
+    uint64_t ullNextTicket;          /* Ticket of the next buffer to write. */
+    int iInFlight;                   /* Buffer being written, -1 if none. */
+};
+
+/* The io_uring rings, mapped from the kernel. */
+typedef struct OutputRing
+{
+    int iFd;
+    unsigned *puSqHead;
+    unsigned *puSqTail;
+    unsigned *puSqMask;
+    unsigned *puSqArray;
+    struct io_uring_sqe *pxSqes;
+    unsigned *puCqHead;
+    unsigned *puCqTail;
+    unsigned *puCqMask;
+    struct io_uring_cqe *pxCqes;
+} OutputRing_t;
+
+static char cPool[outputMAX_STREAMS][outputBUFFERS_PER_STREAM][outputBUFFER_SIZE] __attribute__((aligned(4096)));
+static OutputStream_t xStreams[outputMAX_STREAMS];
+static int iStreamCount = 0;
+static OutputRing_t xRing;
+static int iUseRing = 0;
+static int iStarted = 0;
+static volatile int iDraining = 0;
+static uint64_t ullStartNs;
+
+static pthread_t xDrainer;
+static pthread_t xWriters[outputWRITER_THREADS];
+static int iWakeFd = -1;
+
+/* Fallback writer queue: at most one entry per stream. */
+static pthread_mutex_t xPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xPoolCond = PTHREAD_COND_INITIALIZER;
+static OutputStream_t *pxPoolQueue[outputMAX_STREAMS];
+static unsigned uPoolHead = 0;
+static unsigned uPoolCount = 0;
+
+static OutputStats_t xStats;
+
+OutputStream_t *pxOutputStdout = NULL;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvAtomicMax(uint64_t *pullTarget, uint64_t ullValue)
+{
+    uint64_t ullSeen = __atomic_load_n(pullTarget, __ATOMIC_RELAXED);
+
+    while ((ullValue > ullSeen) &&
+           !__atomic_compare_exchange_n(pullTarget, &ullSeen, ullValue, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+/* Non-blocking: producers may be FreeRTOS tasks, which must not wait on a lock. */
+static void prvWakeDrainer(void)
+{
+    uint64_t ullOne = 1;
+
+    (void)!write(iWakeFd, &ullOne, sizeof(ullOne));
+}
+
+/* Set the sealed bit of buffer b.  pdTRUE-like 1 for the caller that set it. */
+static int prvSeal(OutputStream_t *pxStream, int b, uint64_t ullWord, uint64_t ullNow)
+{
+    pxStream->ullSealedNs[b] = ullNow;
+
+    return __atomic_compare_exchange_n(&pxStream->ullWord[b], &ullWord, ullWord | outputWORD_SEALED, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+/* Any caller may retire a sealed current buffer, so none waits for the sealer. */
+static void prvUninstall(OutputStream_t *pxStream, uint64_t ullCurrent)
+{
+    (void)__atomic_compare_exchange_n(&pxStream->ullCurrent, &ullCurrent, ullCurrent & ~0xFFULL, 0,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+/* Install a free buffer as the current one.  -1 if every buffer is busy. */
+static int prvInstall(OutputStream_t *pxStream, uint64_t ullCurrent, uint64_t ullNow)
+{
+    uint64_t ullTicket = outputCURRENT_TICKET(ullCurrent) + 1;
+
+    for (int b = 0; b < outputBUFFERS_PER_STREAM; b++)
+    {
+        uint32_t ulFree = eBufferFree;
+
+        if (__atomic_compare_exchange_n(&pxStream->ulState[b], &ulFree, eBufferFilling, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+        {
+            pxStream->ullOpenedNs[b] = ullNow;
+            __atomic_store_n(&pxStream->ullWord[b], (ullTicket & outputWORD_TICKET_MASK) << outputWORD_TICKET_SHIFT,
+                             __ATOMIC_RELAXED);
+
+            // Losing the race to another producer hands the buffer back unused
+            if (!__atomic_compare_exchange_n(&pxStream->ullCurrent, &ullCurrent, (ullTicket << 8) | (uint64_t)(b + 1),
+                                             0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&pxStream->ulState[b], eBufferFree, __ATOMIC_RELEASE);
+            }
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* Buffer iBuffer of a stream has been fully written (or failed). */
+static void prvComplete(OutputStream_t *pxStream, int iBuffer, int iFailed)
+{
+    uint64_t ullLatency = prvNowNs() - pxStream->ullSealedNs[iBuffer];
+
+    if (iFailed)
+    {
+        __atomic_fetch_add(&xStats.ullDroppedBytes, pxStream->xFill[iBuffer] - pxStream->xWritten[iBuffer],
+                           __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_fetch_add(&xStats.ullBytes, pxStream->xFill[iBuffer], __ATOMIC_RELAXED);
+    }
+
+    __atomic_fetch_add(&xStats.ullBuffers, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&xStats.ullFlushLatencySumNs, ullLatency, __ATOMIC_RELAXED);
+    prvAtomicMax(&xStats.ullFlushLatencyMaxNs, ullLatency);
+
+    __atomic_store_n(&pxStream->ulState[iBuffer], eBufferFree, __ATOMIC_RELEASE);
+    __atomic_store_n(&pxStream->iInFlight, -1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Seal current buffers that are old enough and pick the next buffer to write
+ * for every idle stream.  Returns the number of streams with a new write.
+ */
+static int prvCollect(OutputStream_t **ppxReady)
+{
+    uint64_t ullNow = prvNowNs();
+    int iReady = 0;
+
+    for (int s = 0; s < iStreamCount; s++)
+    {
+        OutputStream_t *pxStream = &xStreams[s];
+        uint64_t ullCurrent = __atomic_load_n(&pxStream->ullCurrent, __ATOMIC_ACQUIRE);
+        int b = outputCURRENT_BUFFER(ullCurrent);
+
+        if (b >= 0)
+        {
+            uint64_t ullWord = __atomic_load_n(&pxStream->ullWord[b], __ATOMIC_ACQUIRE);
+
+            if (((ullWord >> outputWORD_TICKET_SHIFT) == (outputCURRENT_TICKET(ullCurrent) & outputWORD_TICKET_MASK)) &&
+                ((ullWord & outputWORD_BYTES_MASK) > 0) &&
+                (iDraining || (ullNow - pxStream->ullOpenedNs[b] >= outputFLUSH_INTERVAL_US * 1000ULL)))
+            {
+                if ((ullWord & outputWORD_SEALED) || prvSeal(pxStream, b, ullWord, ullNow))
+                {
+                    prvUninstall(pxStream, ullCurrent);
+                }
+            }
+        }
+
+        if (__atomic_load_n(&pxStream->iInFlight, __ATOMIC_ACQUIRE) >= 0)
+        {
+            continue;
+        }
+
+        // The next buffer in ticket order, once sealed and every copy into it is done
+        for (b = 0; b < outputBUFFERS_PER_STREAM; b++)
+        {
+            uint64_t ullWord = __atomic_load_n(&pxStream->ullWord[b], __ATOMIC_ACQUIRE);
+
+            if ((__atomic_load_n(&pxStream->ulState[b], __ATOMIC_ACQUIRE) == eBufferFilling) &&
+                ((ullWord >> outputWORD_TICKET_SHIFT) == (pxStream->ullNextTicket & outputWORD_TICKET_MASK)) &&
+                (ullWord & outputWORD_SEALED) && ((ullWord & outputWORD_WRITERS_MASK) == 0))
+            {
+                pxStream->xFill[b] = (size_t)(ullWord & outputWORD_BYTES_MASK);
+                pxStream->xWritten[b] = 0;
+                pxStream->ullNextTicket++;
+                __atomic_store_n(&pxStream->ulState[b], eBufferInFlight, __ATOMIC_RELAXED);
+                __atomic_store_n(&pxStream->iInFlight, b, __ATOMIC_RELEASE);
+                ppxReady[iReady++] = pxStream;
+                break;
+            }
+        }
+    }
+
+    return iReady;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvRingSetup(void)
+{
+    struct io_uring_params xParams;
+    struct iovec xVectors[outputMAX_STREAMS * outputBUFFERS_PER_STREAM];
+    size_t xSqSize, xCqSize;
+    char *pcSq, *pcCq;
+
+    memset(&xParams, 0, sizeof(xParams));
+    xRing.iFd = (int)syscall(__NR_io_uring_setup, outputRING_ENTRIES, &xParams);
+
+    if (xRing.iFd < 0)
+    {
+        return -1;
+    }
+
+    xSqSize = xParams.sq_off.array + xParams.sq_entries * sizeof(unsigned);
+    xCqSize = xParams.cq_off.cqes + xParams.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (xParams.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        xSqSize = (xCqSize > xSqSize) ? xCqSize : xSqSize;
+    }
+
+    pcSq = mmap(NULL, xSqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xRing.iFd, IORING_OFF_SQ_RING);
+    pcCq = pcSq;
+
+    if ((pcSq != MAP_FAILED) && !(xParams.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        pcCq = mmap(NULL, xCqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xRing.iFd, IORING_OFF_CQ_RING);
+    }
+
+    xRing.pxSqes = mmap(NULL, xParams.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, xRing.iFd, IORING_OFF_SQES);
+
+    // Writes at the current file position are needed for pipes and terminals
+    if ((pcSq == MAP_FAILED) || (pcCq == MAP_FAILED) || (xRing.pxSqes == MAP_FAILED) ||
+        !(xParams.features & IORING_FEAT_RW_CUR_POS))
+    {
+        close(xRing.iFd);
+        return -1;
+    }
+
+    xRing.puSqHead = (unsigned *)(pcSq + xParams.sq_off.head);
+    xRing.puSqTail = (unsigned *)(pcSq + xParams.sq_off.tail);
+    xRing.puSqMask = (unsigned *)(pcSq + xParams.sq_off.ring_mask);
+    xRing.puSqArray = (unsigned *)(pcSq + xParams.sq_off.array);
+    xRing.puCqHead = (unsigned *)(pcCq + xParams.cq_off.head);
+    xRing.puCqTail = (unsigned *)(pcCq + xParams.cq_off.tail);
+    xRing.puCqMask = (unsigned *)(pcCq + xParams.cq_off.ring_mask);
+    xRing.pxCqes = (struct io_uring_cqe *)(pcCq + xParams.cq_off.cqes);
+
+    // Register every buffer once so the kernel does not pin pages per write
+    for (int s = 0; s < outputMAX_STREAMS; s++)
+    {
+        for (int b = 0; b < outputBUFFERS_PER_STREAM; b++)
+        {
+            xVectors[s * outputBUFFERS_PER_STREAM + b].iov_base = cPool[s][b];
+            xVectors[s * outputBUFFERS_PER_STREAM + b].iov_len = outputBUFFER_SIZE;
+        }
+    }
+
+    if (syscall(__NR_io_uring_register, xRing.iFd, IORING_REGISTER_BUFFERS, xVectors,
+                outputMAX_STREAMS * outputBUFFERS_PER_STREAM) < 0)
+    {
+        close(xRing.iFd);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void prvRingQueue(OutputStream_t *pxStream)
+{
+    int s = (int)(pxStream - xStreams);
+    int b = pxStream->iInFlight;
+    unsigned uTail = *xRing.puSqTail;
+    unsigned uIndex = uTail & *xRing.puSqMask;
+    struct io_uring_sqe *pxSqe = &xRing.pxSqes[uIndex];
+
+    memset(pxSqe, 0, sizeof(*pxSqe));
+    pxSqe->opcode = IORING_OP_WRITE_FIXED;
+    pxSqe->fd = pxStream->iFd;
+    pxSqe->off = (uint64_t)-1;
+    pxSqe->addr = (uint64_t)(uintptr_t)(cPool[s][b] + pxStream->xWritten[b]);
+    pxSqe->len = (uint32_t)(pxStream->xFill[b] - pxStream->xWritten[b]);
+    pxSqe->buf_index = (uint16_t)(s * outputBUFFERS_PER_STREAM + b);
+    pxSqe->user_data = (uint64_t)s;
+
+    xRing.puSqArray[uIndex] = uIndex;
+    __atomic_store_n(xRing.puSqTail, uTail + 1, __ATOMIC_RELEASE);
+}
+
+/* Reap completions straight from the ring.  Returns streams to resubmit. */
+static int prvRingReap(OutputStream_t **ppxRetry)
+{
+    unsigned uHead = *xRing.puCqHead;
+    unsigned uTail = __atomic_load_n(xRing.puCqTail, __ATOMIC_ACQUIRE);
+    int iRetry = 0;
+
+    while (uHead != uTail)
+    {
+        struct io_uring_cqe *pxCqe = &xRing.pxCqes[uHead & *xRing.puCqMask];
+        OutputStream_t *pxStream = &xStreams[pxCqe->user_data];
+        int b = pxStream->iInFlight;
+
+        if (pxCqe->res < 0)
+        {
+            prvComplete(pxStream, b, 1);
+        }
+        else
+        {
+            pxStream->xWritten[b] += (size_t)pxCqe->res;
+
+            if ((pxStream->xWritten[b] < pxStream->xFill[b]) && (pxCqe->res > 0))
+            {
+                // Short write to a pipe or terminal: send the rest
+                ppxRetry[iRetry++] = pxStream;
+            }
+            else
+            {
+                prvComplete(pxStream, b, pxStream->xWritten[b] < pxStream->xFill[b]);
+            }
+        }
+
+        uHead++;
+    }
+
+    __atomic_store_n(xRing.puCqHead, uHead, __ATOMIC_RELEASE);
+
+    return iRetry;
+}
+
+/* Give back the queued writes the kernel has not taken, as failed. */
+static void prvRingRetract(void)
+{
+    unsigned uHead = __atomic_load_n(xRing.puSqHead, __ATOMIC_ACQUIRE);
+    unsigned uTail = *xRing.puSqTail;
+
+    for (unsigned u = uHead; u != uTail; u++)
+    {
+        struct io_uring_sqe *pxSqe = &xRing.pxSqes[xRing.puSqArray[u & *xRing.puSqMask]];
+        OutputStream_t *pxStream = &xStreams[pxSqe->user_data];
+
+        prvComplete(pxStream, pxStream->iInFlight, 1);
+    }
+
+    // Without SQPOLL the kernel only reads the ring inside io_uring_enter()
+    __atomic_store_n(xRing.puSqTail, uHead, __ATOMIC_RELEASE);
+}
+
+/*
+ * Queue the new writes and submit everything the kernel has not taken yet,
+ * without waiting for any completion: each stream is handed back when its
+ * own write completes, so a slow stream does not hold up the others.
+ */
+static void prvRingSubmit(OutputStream_t **ppxReady, int iReady)
+{
+    unsigned uPending;
+    long lSubmitted;
+
+    for (int i = 0; i < iReady; i++)
+    {
+        prvRingQueue(ppxReady[i]);
+    }
+
+    uPending = *xRing.puSqTail - __atomic_load_n(xRing.puSqHead, __ATOMIC_ACQUIRE);
+
+    if (uPending == 0)
+    {
+        return;
+    }
+
+    lSubmitted = syscall(__NR_io_uring_enter, xRing.iFd, uPending, 0, 0, NULL, 0);
+    __atomic_fetch_add(&xStats.ullSyscalls, 1, __ATOMIC_RELAXED);
+
+    // A short or busy submit leaves the rest in the ring for the next round
+    if ((lSubmitted < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+    {
+        prvRingRetract();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void *prvWriterThread(void *pvUnused)
+{
+    (void)pvUnused;
+
+    for (;;)
+    {
+        OutputStream_t *pxStream;
+        int b;
+        int iFailed = 0;
+
+        pthread_mutex_lock(&xPoolMutex);
+        while (uPoolCount == 0)
+        {
+            pthread_cond_wait(&xPoolCond, &xPoolMutex);
+        }
+        pxStream = pxPoolQueue[uPoolHead];
+        uPoolHead = (uPoolHead + 1) % outputMAX_STREAMS;
+        uPoolCount--;
+        pthread_mutex_unlock(&xPoolMutex);
+
+        b = pxStream->iInFlight;
+
+        while (pxStream->xWritten[b] < pxStream->xFill[b])
+        {
+            ssize_t xDone = write(pxStream->iFd, cPool[pxStream - xStreams][b] + pxStream->xWritten[b],
+                                  pxStream->xFill[b] - pxStream->xWritten[b]);
+
+            __atomic_fetch_add(&xStats.ullSyscalls, 1, __ATOMIC_RELAXED);
+
+            if (xDone < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (xDone <= 0)
+            {
+                iFailed = 1;
+                break;
+            }
+
+            pxStream->xWritten[b] += (size_t)xDone;
+        }
+
+        prvComplete(pxStream, b, iFailed);
+
+        // The stream may have more sealed buffers waiting
+        prvWakeDrainer();
+    }
+
+    return NULL;
+}
+
+static void prvPoolFlush(OutputStream_t **ppxReady, int iReady)
+{
+    pthread_mutex_lock(&xPoolMutex);
+
+    for (int i = 0; i < iReady; i++)
+    {
+        pxPoolQueue[(uPoolHead + uPoolCount) % outputMAX_STREAMS] = ppxReady[i];
+        uPoolCount++;
+    }
+
+    pthread_cond_broadcast(&xPoolCond);
+    pthread_mutex_unlock(&xPoolMutex);
+}
+
+static void *prvDrainerThread(void *pvUnused)
+{
+    OutputStream_t *pxReady[outputMAX_STREAMS];
+    OutputStream_t *pxRetry[outputMAX_STREAMS];
+
+    (void)pvUnused;
+
+    for (;;)
+    {
+        struct pollfd xWake[2] = { { .fd = iWakeFd, .events = POLLIN }, { .fd = xRing.iFd, .events = POLLIN } };
+        struct timespec xInterval = { 0, outputFLUSH_INTERVAL_US * 1000L };
+        uint64_t ullCount;
+        int iRetry = 0;
+        int iReady;
+
+        // Woken by a full buffer, a completion, or the flush interval
+        if ((ppoll(xWake, iUseRing ? 2 : 1, &xInterval, NULL) > 0) && (xWake[0].revents & POLLIN))
+        {
+            (void)!read(iWakeFd, &ullCount, sizeof(ullCount));
+        }
+
+        if (iUseRing)
+        {
+            iRetry = prvRingReap(pxRetry);
+        }
+
+        iReady = prvCollect(pxReady);
+
+        if (iUseRing)
+        {
+            memcpy(&pxReady[iReady], pxRetry, (size_t)iRetry * sizeof(pxRetry[0]));
+            prvRingSubmit(pxReady, iReady + iRetry);
+        }
+        else if (iReady > 0)
+        {
+            prvPoolFlush(pxReady, iReady);
+        }
+    }
+
+    return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+int xOutputInit(void)
+{
+    sigset_t xAll, xPrevious;
+    int iWriters = 0;
+
+    if (iStarted)
+    {
+        return 0;
+    }
+
+    iWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (iWakeFd < 0)
+    {
+        return -1;
+    }
+
+    ullStartNs = prvNowNs();
+    iUseRing = (outputUSE_IO_URING == 1) && (prvRingSetup() == 0);
+    xStats.iUsingIoUring = iUseRing;
+
+    // The new threads inherit this mask and so never take the port's signals
+    sigfillset(&xAll);
+    pthread_sigmask(SIG_SETMASK, &xAll, &xPrevious);
+
+    if (!iUseRing)
+    {
+        for (iWriters = 0; iWriters < outputWRITER_THREADS; iWriters++)
+        {
+            if (pthread_create(&xWriters[iWriters], NULL, prvWriterThread, NULL) != 0)
+            {
+                break;
+            }
+        }
+    }
+
+    if ((iUseRing || (iWriters > 0)) && (pthread_create(&xDrainer, NULL, prvDrainerThread, NULL) == 0))
+    {
+        iStarted = 1;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &xPrevious, NULL);
+
+    if (!iStarted)
+    {
+        // Writers wait on a condition variable, a cancellation point
+        for (int i = 0; i < iWriters; i++)
+        {
+            pthread_cancel(xWriters[i]);
+            pthread_join(xWriters[i], NULL);
+        }
+
+        if (iUseRing)
+        {
+            close(xRing.iFd);
+        }
+
+        close(iWakeFd);
+        iWakeFd = -1;
+        return -1;
+    }
+
+    pxOutputStdout = pxOutputOpen(STDOUT_FILENO);
+
+    return 0;
+}
+
+OutputStream_t *pxOutputOpen(int iFd)
+{
+    OutputStream_t *pxStream;
+
+    if (!iStarted || (iStreamCount >= outputMAX_STREAMS))
+    {
+        return NULL;
+    }
+
+    pxStream = &xStreams[iStreamCount];
+    memset(pxStream, 0, sizeof(*pxStream));
+    pxStream->iFd = iFd;
+    pxStream->ullNextTicket = 1;
+    pxStream->iInFlight = -1;
+
+    // Publish the stream only once it is fully set up
+    __atomic_store_n(&iStreamCount, iStreamCount + 1, __ATOMIC_RELEASE);
+
+    return pxStream;
+}
+
+void vOutputWrite(OutputStream_t *pxStream, const char *pcData, size_t xLength)
+{
+    uint64_t ullStart;
+    int iSealed = 0;
+
+    if (pxStream == NULL)
+    {
+        fwrite(pcData, 1, xLength, stdout);
+        return;
+    }
+
+    ullStart = prvNowNs();
+
+    // Every step either makes progress or retries after another producer did
+    while (xLength > 0)
+    {
+        uint64_t ullCurrent = __atomic_load_n(&pxStream->ullCurrent, __ATOMIC_ACQUIRE);
+        int b = outputCURRENT_BUFFER(ullCurrent);
+        uint64_t ullWord;
+        size_t xOffset;
+        size_t xChunk;
+
+        if (b < 0)
+        {
+            if (prvInstall(pxStream, ullCurrent, ullStart) != 0)
+            {
+                // Every buffer is busy: drop rather than block the caller
+                __atomic_fetch_add(&xStats.ullDroppedBytes, xLength, __ATOMIC_RELAXED);
+                break;
+            }
+
+            continue;
+        }
+
+        ullWord = __atomic_load_n(&pxStream->ullWord[b], __ATOMIC_ACQUIRE);
+
+        if ((ullWord >> outputWORD_TICKET_SHIFT) != (outputCURRENT_TICKET(ullCurrent) & outputWORD_TICKET_MASK))
+        {
+            // Stale index: the buffer was retired and reused meanwhile
+            continue;
+        }
+
+        if (ullWord & outputWORD_SEALED)
+        {
+            prvUninstall(pxStream, ullCurrent);
+            continue;
+        }
+
+        xOffset = (size_t)(ullWord & outputWORD_BYTES_MASK);
+
+        // Keep a write in one buffer unless it is larger than a buffer
+        if ((xOffset > 0) && (xOffset + xLength > outputBUFFER_SIZE))
+        {
+            iSealed |= prvSeal(pxStream, b, ullWord, ullStart);
+            continue;
+        }
+
+        xChunk = outputBUFFER_SIZE - xOffset;
+        xChunk = (xChunk < xLength) ? xChunk : xLength;
+
+        if (!__atomic_compare_exchange_n(&pxStream->ullWord[b], &ullWord, ullWord + outputWORD_WRITER + xChunk, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            continue;
+        }
+
+        memcpy(cPool[pxStream - xStreams][b] + xOffset, pcData, xChunk);
+        ullWord = __atomic_sub_fetch(&pxStream->ullWord[b], outputWORD_WRITER, __ATOMIC_RELEASE);
+        pcData += xChunk;
+        xLength -= xChunk;
+
+        if (xOffset + xChunk == outputBUFFER_SIZE)
+        {
+            // Only the reservation that filled the buffer gets here
+            pxStream->ullSealedNs[b] = ullStart;
+            __atomic_fetch_or(&pxStream->ullWord[b], outputWORD_SEALED, __ATOMIC_ACQ_REL);
+            prvUninstall(pxStream, ullCurrent);
+            iSealed = 1;
+        }
+    }
+
+    if (iSealed)
+    {
+        prvWakeDrainer();
+    }
+
+    prvAtomicMax(&xStats.ullProducerStallMaxNs, prvNowNs() - ullStart);
+}
+
+void vOutputPrintf(OutputStream_t *pxStream, const char *pcFormat, ...)
+{
+    char cLine[256];
+    va_list xArgs;
+    int iLength;
+
+    va_start(xArgs, pcFormat);
+
+    if (pxStream == NULL)
+    {
+        vprintf(pcFormat, xArgs);
+        va_end(xArgs);
+        return;
+    }
+
+    iLength = vsnprintf(cLine, sizeof(cLine), pcFormat, xArgs);
+    va_end(xArgs);
+
+    if (iLength > 0)
+    {
+        vOutputWrite(pxStream, cLine, ((size_t)iLength < sizeof(cLine)) ? (size_t)iLength : sizeof(cLine) - 1);
+    }
+}
+
+void vOutputDrain(void)
+{
+    int iBusy = 1;
+
+    if (!iStarted)
+    {
+        return;
+    }
+
+    iDraining = 1;
+
+    while (iBusy)
+    {
+        struct timespec xPause = { 0, 1000000L };
+
+        prvWakeDrainer();
+        nanosleep(&xPause, NULL);
+        iBusy = 0;
+
+        for (int s = 0; s < iStreamCount; s++)
+        {
+            OutputStream_t *pxStream = &xStreams[s];
+
+            iBusy |= (__atomic_load_n(&pxStream->iInFlight, __ATOMIC_ACQUIRE) >= 0);
+
+            for (int b = 0; b < outputBUFFERS_PER_STREAM; b++)
+            {
+                uint64_t ullWord = __atomic_load_n(&pxStream->ullWord[b], __ATOMIC_ACQUIRE);
+
+                iBusy |= (__atomic_load_n(&pxStream->ulState[b], __ATOMIC_ACQUIRE) == eBufferFilling) &&
+                         (((ullWord & outputWORD_BYTES_MASK) > 0) || (ullWord & outputWORD_SEALED));
+            }
+        }
+    }
+
+    iDraining = 0;
+}
+
+void vOutputGetStats(OutputStats_t *pxStats)
+{
+    *pxStats = xStats;
+    pxStats->dElapsedSeconds = (double)(prvNowNs() - ullStartNs) * 1e-9;
+}
+
+void vOutputReport(void)
+{
+    OutputStats_t xReport;
+    double dSeconds;
+
+    vOutputGetStats(&xReport);
+
+    // On stderr: the statistics describe stdout itself
+    dSeconds = (xReport.dElapsedSeconds > 0.0) ? xReport.dElapsedSeconds : 1.0;
+
+    fprintf(stderr, "Output: backend=%s bytes=%llu buffers=%llu dropped=%llu syscalls/s=%.1f\n",
+            xReport.iUsingIoUring ? "io_uring" : "threads", (unsigned long long)xReport.ullBytes,
+            (unsigned long long)xReport.ullBuffers, (unsigned long long)xReport.ullDroppedBytes,
+            (double)xReport.ullSyscalls / dSeconds);
+    fprintf(stderr, "Output: flush latency avg=%.1fus max=%.1fus, producer stall max=%.1fus\n",
+            (xReport.ullBuffers > 0) ? (double)xReport.ullFlushLatencySumNs / (double)xReport.ullBuffers / 1000.0 : 0.0,
+            (double)xReport.ullFlushLatencyMaxNs / 1000.0, (double)xReport.ullProducerStallMaxNs / 1000.0);
+}
@@ -0,0 +1,88 @@
+/*
+ * Asynchronous output backend for logs and traces.
+ *
+ * Producers (task jobs, the trace flusher) copy their bytes into the current
+ * buffer of a stream and return.  They take no lock: a producer reserves its
+ * bytes in the current buffer by compare-and-swap and copies them outside any
+ * critical section, and a sealed buffer can be retired by any producer, so a
+ * FreeRTOS task preempted on a tick in the middle of a write never holds up
+ * another task.  The only system call on the producer side is a non-blocking
+ * eventfd write for each buffer a producer fills up.  A drainer
+ * thread seals buffers that are full or older than outputFLUSH_INTERVAL_US
+ * and submits them through io_uring as IORING_OP_WRITE_FIXED requests on
+ * registered buffers.  All streams are batched into one io_uring_enter() per
+ * flush, and completions are reaped from the completion ring without a
+ * system call, which hands the buffers back to the producers.
+ *
+ * When io_uring is not available (old kernel, seccomp, container policy) the
+ * sealed buffers go to a small pool of writer threads doing plain write().
+ * Either way a stream has at most one write in flight, so its output stays in
+ * order.
+ *
+ * The drainer and writer threads are native pthreads that never call the
+ * FreeRTOS API, and they block every signal so they cannot disturb the Linux
+ * port's scheduler.  Producers never block: if every buffer of a stream is in
+ * use the bytes are dropped and counted.  A write of at most
+ * outputBUFFER_SIZE bytes is never split across buffers, so concurrent lines
+ * do not interleave.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define outputMAX_STREAMS          ( 4 )
+#define outputBUFFERS_PER_STREAM   ( 8 )
+#define outputBUFFER_SIZE          ( 16384 )
+#define outputFLUSH_INTERVAL_US    ( 5000 )
+#define outputRING_ENTRIES         ( 32 )
+#define outputWRITER_THREADS       ( 2 )
+
+/* Set to 0 to always use the writer threads, e.g. to compare the two. */
+#ifndef outputUSE_IO_URING
+    #define outputUSE_IO_URING     1
+#endif
+
+typedef struct OutputStream OutputStream_t;
+
+typedef struct OutputStats
+{
+    int iUsingIoUring;
+    uint64_t ullBytes;
+    uint64_t ullBuffers;
+    uint64_t ullSyscalls;
+    uint64_t ullDroppedBytes;
+    uint64_t ullFlushLatencyMaxNs;
+    uint64_t ullFlushLatencySumNs;
+    uint64_t ullProducerStallMaxNs;
+    double dElapsedSeconds;
+} OutputStats_t;
+
+/*
+ * Start the drainer.  Must be called before the FreeRTOS scheduler starts,
+ * so that the new threads do not inherit a task's signal state.  Returns 0 on
+ * success.
+ */
+int xOutputInit(void);
+
+/* Returns NULL if every stream slot is taken or xOutputInit() was not called. */
+OutputStream_t *pxOutputOpen(int iFd);
+
+/* A NULL stream writes straight to stdout, here and in vOutputPrintf(). */
+void vOutputWrite(OutputStream_t *pxStream, const char *pcData, size_t xLength);
+
+/* printf() into a stream. */
+void vOutputPrintf(OutputStream_t *pxStream, const char *pcFormat, ...) __attribute__((format(printf, 2, 3)));
+
+/* Write out everything buffered so far and wait for it.  Not for tasks. */
+void vOutputDrain(void);
+
+void vOutputGetStats(OutputStats_t *pxStats);
+void vOutputReport(void);
+
+/* Stream on stdout opened by xOutputInit(), NULL before. */
+extern OutputStream_t *pxOutputStdout;
+
+#endif /* OUTPUT_H */
@@ -0,0 +1,410 @@
+/*
+ * Single-thread user-context port of FreeRTOS for Linux hosts.  See
+ * portmacro.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if (portUSE_SWAPCONTEXT == 1)
+    #include <ucontext.h>
+#endif
+
+/* Saved context of a task, at the top of its stack.  With the assembly switch
+ * it is the callee-saved registers pushed by vPortSwitchStack() and the
+ * address of the TCB's pxTopOfStack is all that is needed; with swapcontext()
+ * it is a ucontext_t that pxTopOfStack points to for the life of the task. */
+#if (portUSE_SWAPCONTEXT == 1)
+typedef struct PortContext
+{
+    ucontext_t xContext;
+    TaskFunction_t pxCode;
+    void *pvParameters;
+} PortContext_t;
+#endif
+
+static int iTickFd = -1;
+static uint64_t ullTickPeriodNs = 0;
+static uint64_t ullNextTickNs = 0;
+
+static UBaseType_t uxCriticalNesting = 0;
+static BaseType_t xInterruptsEnabled = pdFALSE;
+static BaseType_t xPortYieldPending = pdFALSE;
+static BaseType_t xSchedulerRunning = pdFALSE;
+static uint64_t ullSwitches = 0;
+
+#if (portUSE_SWAPCONTEXT == 1)
+static ucontext_t xSchedulerContext;
+#else
+static StackType_t *pxSchedulerTop = NULL;
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if (portUSE_SWAPCONTEXT == 0)
+
+/* Defined in assembly below. */
+extern void vPortSwitchStack(StackType_t **ppxSaveTop, StackType_t *pxNewTop) __attribute__((visibility("hidden")));
+extern void vPortTaskEntry(void) __attribute__((visibility("hidden")));
+void vPortTaskExitError(void) __attribute__((visibility("hidden"), used, noreturn));
+
+/*
+ * vPortSwitchStack(ppxSaveTop, pxNewTop): push the callee-saved registers and
+ * the SSE and x87 control words, store the stack pointer in *ppxSaveTop, load
+ * pxNewTop and pop the same frame from there.  Everything else is
+ * caller-saved in the System V ABI and already spilled by the C caller.
+ *
+ * vPortTaskEntry: where a new task's first switch returns to, with the task
+ * function in r12 and its parameter in r13.
+ */
+__asm__ (
+    "    .text\n"
+    "    .p2align 4\n"
+    "    .globl vPortSwitchStack\n"
+    "    .hidden vPortSwitchStack\n"
+    "    .type vPortSwitchStack, @function\n"
+    "vPortSwitchStack:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    "    .size vPortSwitchStack, .-vPortSwitchStack\n"
+    "\n"
+    "    .p2align 4\n"
+    "    .globl vPortTaskEntry\n"
+    "    .hidden vPortTaskEntry\n"
+    "    .type vPortTaskEntry, @function\n"
+    "vPortTaskEntry:\n"
+    "    movq %r13, %rdi\n"
+    "    callq *%r12\n"
+    "    callq vPortTaskExitError\n"
+    "    .size vPortTaskEntry, .-vPortTaskEntry\n"
+);
+
+#endif /* portUSE_SWAPCONTEXT */
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static StackType_t **prvTopOfStack(TaskHandle_t xTask)
+{
+    // pxTopOfStack is the first member of the TCB
+    return (StackType_t **)xTask;
+}
+
+static void prvSwitch(TaskHandle_t xFrom, TaskHandle_t xTo)
+{
+    ullSwitches++;
+
+#if (portUSE_SWAPCONTEXT == 1)
+    swapcontext(&((PortContext_t *)*prvTopOfStack(xFrom))->xContext, &((PortContext_t *)*prvTopOfStack(xTo))->xContext);
+#else
+    vPortSwitchStack(prvTopOfStack(xFrom), *prvTopOfStack(xTo));
+#endif
+}
+
+static void prvSwitchContext(void)
+{
+    TaskHandle_t xFrom = xTaskGetCurrentTaskHandle();
+    TaskHandle_t xTo;
+
+    vTaskSwitchContext();
+    xTo = xTaskGetCurrentTaskHandle();
+
+    if (xTo != xFrom)
+    {
+        // Returns when xFrom is switched back in
+        prvSwitch(xFrom, xTo);
+    }
+}
+
+/* Run the ticks that expired since the last call, as the tick interrupt
+ * would have.  Cheap when none did: one vDSO clock read, no system call. */
+static void prvCollectTicks(void)
+{
+    uint64_t ullExpirations = 0;
+
+    if (prvNowNs() < ullNextTickNs)
+    {
+        return;
+    }
+
+    if (read(iTickFd, &ullExpirations, sizeof(ullExpirations)) != (ssize_t)sizeof(ullExpirations))
+    {
+        return;
+    }
+
+    ullNextTickNs += ullExpirations * ullTickPeriodNs;
+    xInterruptsEnabled = pdFALSE;
+
+    while (ullExpirations-- > 0)
+    {
+        if (xTaskIncrementTick() != pdFALSE)
+        {
+            xPortYieldPending = pdTRUE;
+        }
+    }
+
+    xInterruptsEnabled = pdTRUE;
+}
+
+/* Where the tick and pended yields take effect: outside any critical section
+ * with interrupts enabled. */
+static void prvPreemptionPoint(BaseType_t xYield)
+{
+    if ((xSchedulerRunning == pdFALSE) || (uxCriticalNesting > 0) || (xInterruptsEnabled == pdFALSE))
+    {
+        if (xYield != pdFALSE)
+        {
+            xPortYieldPending = pdTRUE;
+        }
+
+        return;
+    }
+
+    prvCollectTicks();
+
+    if ((xYield != pdFALSE) || (xPortYieldPending != pdFALSE))
+    {
+        xPortYieldPending = pdFALSE;
+        prvSwitchContext();
+    }
+}
+
+#if (portUSE_SWAPCONTEXT == 0)
+void vPortTaskExitError(void)
+#else
+static void vPortTaskExitError(void)
+#endif
+{
+    // A task function must never return: delete the task instead
+    fprintf(stderr, "FreeRTOS: a task returned from its function\n");
+    configASSERT(pdFALSE);
+    vTaskDelete(NULL);
+
+    for (;;)
+    {
+        abort();
+    }
+}
+
+#if (portUSE_SWAPCONTEXT == 1)
+static void prvTaskEntry(void)
+{
+    PortContext_t *pxContext = (PortContext_t *)*prvTopOfStack(xTaskGetCurrentTaskHandle());
+
+    pxContext->pxCode(pxContext->pvParameters);
+    vPortTaskExitError();
+}
+#endif
+
+static void prvSetupTickTimer(void)
+{
+    struct itimerspec xTimer;
+
+    ullTickPeriodNs = 1000000000ULL / configTICK_RATE_HZ;
+    iTickFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (iTickFd < 0)
+    {
+        fprintf(stderr, "FreeRTOS: timerfd_create failed: %s\n", strerror(errno));
+        abort();
+    }
+
+    xTimer.it_interval.tv_sec = 0;
+    xTimer.it_interval.tv_nsec = (long)ullTickPeriodNs;
+    xTimer.it_value = xTimer.it_interval;
+    ullNextTickNs = prvNowNs() + ullTickPeriodNs;
+    timerfd_settime(iTickFd, 0, &xTimer, NULL);
+}
+
+/*-----------------------------------------------------------*/
+
+#if (portUSE_SWAPCONTEXT == 1)
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, StackType_t *pxEndOfStack, TaskFunction_t pxCode,
+                                   void *pvParameters)
+{
+    PortContext_t *pxContext;
+
+    // The context sits at the top of the stack, the task runs below it
+    pxContext = (PortContext_t *)(((uintptr_t)(pxTopOfStack + 1) - sizeof(PortContext_t)) & ~(uintptr_t)portBYTE_ALIGNMENT_MASK);
+    memset(pxContext, 0, sizeof(*pxContext));
+    pxContext->pxCode = pxCode;
+    pxContext->pvParameters = pvParameters;
+
+    getcontext(&pxContext->xContext);
+    pxContext->xContext.uc_stack.ss_sp = pxEndOfStack;
+    pxContext->xContext.uc_stack.ss_size = (size_t)((uintptr_t)pxContext - (uintptr_t)pxEndOfStack);
+    pxContext->xContext.uc_link = NULL;
+    makecontext(&pxContext->xContext, prvTaskEntry, 0);
+
+    return (StackType_t *)pxContext;
+}
+#else
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters)
+{
+    StackType_t *pxTop = (StackType_t *)((uintptr_t)pxTopOfStack & ~(uintptr_t)portBYTE_ALIGNMENT_MASK);
+    uint32_t ulMxcsr;
+    uint16_t usFpuControl;
+
+    // New tasks start with the control words of the creating thread
+    __asm__ volatile ("stmxcsr %0" : "=m" (ulMxcsr));
+    __asm__ volatile ("fnstcw %0" : "=m" (usFpuControl));
+
+    // The frame vPortSwitchStack() pops, returning into vPortTaskEntry
+    *--pxTop = (StackType_t)vPortTaskEntry;
+    *--pxTop = 0;                               /* rbp */
+    *--pxTop = 0;                               /* rbx */
+    *--pxTop = (StackType_t)pxCode;             /* r12 */
+    *--pxTop = (StackType_t)pvParameters;       /* r13 */
+    *--pxTop = 0;                               /* r14 */
+    *--pxTop = 0;                               /* r15 */
+    *--pxTop = (StackType_t)ulMxcsr | ((StackType_t)usFpuControl << 32);
+
+    return pxTop;
+}
+#endif
+
+BaseType_t xPortStartScheduler(void)
+{
+    TaskHandle_t xFirst = xTaskGetCurrentTaskHandle();
+
+    prvSetupTickTimer();
+
+    uxCriticalNesting = 0;
+    xSchedulerRunning = pdTRUE;
+    xInterruptsEnabled = pdTRUE;
+
+    // Leave the thread's own stack for the first task; vPortEndScheduler()
+    // comes back here
+#if (portUSE_SWAPCONTEXT == 1)
+    swapcontext(&xSchedulerContext, &((PortContext_t *)*prvTopOfStack(xFirst))->xContext);
+#else
+    vPortSwitchStack(&pxSchedulerTop, *prvTopOfStack(xFirst));
+#endif
+
+    close(iTickFd);
+    iTickFd = -1;
+
+    return 0;
+}
+
+void vPortEndScheduler(void)
+{
+    TaskHandle_t xCurrent = xTaskGetCurrentTaskHandle();
+
+    xSchedulerRunning = pdFALSE;
+    xInterruptsEnabled = pdFALSE;
+
+#if (portUSE_SWAPCONTEXT == 1)
+    swapcontext(&((PortContext_t *)*prvTopOfStack(xCurrent))->xContext, &xSchedulerContext);
+#else
+    vPortSwitchStack(prvTopOfStack(xCurrent), pxSchedulerTop);
+#endif
+}
+
+void vPortYield(void)
+{
+    prvPreemptionPoint(pdTRUE);
+}
+
+void vPortDisableInterrupts(void)
+{
+    xInterruptsEnabled = pdFALSE;
+}
+
+void vPortEnableInterrupts(void)
+{
+    xInterruptsEnabled = pdTRUE;
+    prvPreemptionPoint(pdFALSE);
+}
+
+UBaseType_t xPortSetInterruptMask(void)
+{
+    UBaseType_t uxWasEnabled = (UBaseType_t)xInterruptsEnabled;
+
+    xInterruptsEnabled = pdFALSE;
+
+    return uxWasEnabled;
+}
+
+void vPortClearInterruptMask(UBaseType_t uxMask)
+{
+    // Only ever called from "ISR" context, i.e. the tick: no preemption here
+    xInterruptsEnabled = (BaseType_t)uxMask;
+}
+
+void vPortEnterCritical(void)
+{
+    xInterruptsEnabled = pdFALSE;
+    uxCriticalNesting++;
+}
+
+void vPortExitCritical(void)
+{
+    if (uxCriticalNesting > 0)
+    {
+        uxCriticalNesting--;
+
+        if (uxCriticalNesting == 0)
+        {
+            xInterruptsEnabled = pdTRUE;
+            prvPreemptionPoint(pdFALSE);
+        }
+    }
+}
+
+void vPortIdleHook(void)
+{
+    struct pollfd xTick = { .fd = iTickFd, .events = POLLIN, .revents = 0 };
+
+    prvPreemptionPoint(pdFALSE);
+
+    // Nothing else to run: sleep until the next tick
+    if ((xSchedulerRunning != pdFALSE) && (poll(&xTick, 1, -1) > 0))
+    {
+        prvPreemptionPoint(pdFALSE);
+    }
+}
+
+uint64_t ullPortContextSwitches(void)
+{
+    return ullSwitches;
+}
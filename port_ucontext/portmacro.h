@@ -0,0 +1,125 @@
+/*
+ * Single-thread user-context port of FreeRTOS for Linux hosts.
+ *
+ * Drop-in alternative to the stock Posix port (portable/ThirdParty/GCC/Posix):
+ * put this directory on the include path and build port.c instead of the
+ * Posix port.c and utils/wait_for_event.c.
+ *
+ * Every task runs on its own FreeRTOS-allocated stack inside the one thread
+ * that called vTaskStartScheduler().  A context switch is a call to a short
+ * assembly routine that saves the callee-saved registers and swaps stack
+ * pointers (or swapcontext() on hosts other than x86-64), so no signal, no
+ * condition variable and no host scheduler is involved.
+ *
+ * There are no interrupts either.  The tick comes from a timerfd whose
+ * expirations are collected at the port's "preemption points": every kernel
+ * call that leaves a critical section or yields.  A task that computes for a
+ * long time without calling the kernel is therefore not preempted by the
+ * tick.  The idle task must call vPortIdleHook() from vApplicationIdleHook()
+ * (configUSE_IDLE_HOOK 1), where the thread sleeps on the timerfd.
+ */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <limits.h>
+#include <stdint.h>
+
+/* Type definitions. */
+#define portCHAR                  char
+#define portFLOAT                 float
+#define portDOUBLE                double
+#define portLONG                  long
+#define portSHORT                 short
+#define portSTACK_TYPE            unsigned long
+#define portBASE_TYPE             long
+#define portPOINTER_SIZE_TYPE     intptr_t
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#if defined(configUSE_16_BIT_TICKS) && (configUSE_16_BIT_TICKS == 1)
+    typedef uint16_t TickType_t;
+    #define portMAX_DELAY              ( TickType_t ) 0xffff
+#else
+    typedef unsigned long TickType_t;
+    #define portMAX_DELAY              ( TickType_t ) ULONG_MAX
+
+    /* A tick count read is one load: no critical section needed. */
+    #define portTICK_TYPE_IS_ATOMIC    1
+#endif
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH          ( -1 )
+#define portTICK_PERIOD_MS        ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT        16
+#define portNOP()                 __asm volatile ( "NOP" )
+
+/* Use the hand-written stack switch where there is one. */
+#ifndef portUSE_SWAPCONTEXT
+    #if defined(__x86_64__)
+        #define portUSE_SWAPCONTEXT    0
+    #else
+        #define portUSE_SWAPCONTEXT    1
+    #endif
+#endif
+
+/* makecontext() needs the low end of the stack, which the kernel only passes
+ * to ports that check stack overflows. */
+#define portHAS_STACK_OVERFLOW_CHECKING    portUSE_SWAPCONTEXT
+
+/* Scheduler utilities. */
+extern void vPortYield(void);
+
+#define portYIELD()                                    vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired)         if (xSwitchRequired) vPortYield()
+#define portYIELD_FROM_ISR(x)                          portEND_SWITCHING_ISR(x)
+
+/* Critical section management.  "Interrupts" are the tick only. */
+extern void vPortDisableInterrupts(void);
+extern void vPortEnableInterrupts(void);
+extern UBaseType_t xPortSetInterruptMask(void);
+extern void vPortClearInterruptMask(UBaseType_t uxMask);
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()              xPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)           vPortClearInterruptMask(x)
+#define portDISABLE_INTERRUPTS()                       vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()                        vPortEnableInterrupts()
+#define portENTER_CRITICAL()                           vPortEnterCritical()
+#define portEXIT_CRITICAL()                            vPortExitCritical()
+
+/* Task function macros as described on the FreeRTOS.org WEB site. */
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters)    void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters)          void vFunction(void *pvParameters)
+
+/* Tasks run on kernel-allocated stacks: nothing to release with the TCB. */
+#define portCLEAN_UP_TCB(pxTCB)                        (void)pxTCB
+
+/* Architecture specific optimisations. */
+#if (configUSE_PORT_OPTIMISED_TASK_SELECTION == 1)
+
+    #define portRECORD_READY_PRIORITY(uxPriority, uxReadyPriorities)    (uxReadyPriorities) |= (1UL << (uxPriority))
+    #define portRESET_READY_PRIORITY(uxPriority, uxReadyPriorities)     (uxReadyPriorities) &= ~(1UL << (uxPriority))
+    #define portGET_HIGHEST_PRIORITY(uxTopPriority, uxReadyPriorities) \
+        uxTopPriority = (63UL - (UBaseType_t)__builtin_clzl(uxReadyPriorities))
+
+#endif
+
+/* Sleep on the tick timer until something is ready.  Idle task only. */
+extern void vPortIdleHook(void);
+
+/* Number of context switches performed, for benchmarks. */
+extern uint64_t ullPortContextSwitches(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PORTMACRO_H */
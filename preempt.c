@@ -0,0 +1,200 @@
+/*
+ * Limited-preemption scheduling with fixed preemption points.  See preempt.h.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "preempt.h"
+
+static volatile uint32_t ulContextSwitches = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowUs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000ULL + (uint64_t)xNow.tv_nsec / 1000ULL;
+}
+
+static void prvCloseRegion(PreemptTask_t *pxTask, uint64_t ullNow)
+{
+    uint32_t ulRegion = (uint32_t)(ullNow - pxTask->ullRegionStartUs);
+
+    if (ulRegion > pxTask->ulLongestRegionUs)
+    {
+        pxTask->ulLongestRegionUs = ulRegion;
+    }
+
+    if ((pxTask->ulMaxNprUs != 0) && (ulRegion > pxTask->ulMaxNprUs))
+    {
+        pxTask->ulRegionOverruns++;
+    }
+}
+
+static uint32_t prvCeilDiv(uint32_t ulA, uint32_t ulB)
+{
+    return (ulA + ulB - 1) / ulB;
+}
+
+/* t - W_i(t) for task i at time t. */
+static int32_t prvSlackAt(const PreemptAnalysisTask_t *pxTasks, UBaseType_t uxCount, UBaseType_t i, uint32_t t)
+{
+    uint32_t ulWork = pxTasks[i].ulWcetUs;
+
+    for (UBaseType_t k = 0; k < uxCount; k++)
+    {
+        if (pxTasks[k].uxPriority > pxTasks[i].uxPriority)
+        {
+            ulWork += prvCeilDiv(t, pxTasks[k].ulPeriodUs) * pxTasks[k].ulWcetUs;
+        }
+    }
+
+    return (int32_t)t - (int32_t)ulWork;
+}
+
+/*-----------------------------------------------------------*/
+
+void vPreemptJobStart(PreemptTask_t *pxTask)
+{
+    pxTask->ullJobStartUs = prvNowUs();
+    pxTask->ullRegionStartUs = pxTask->ullJobStartUs;
+
+#if (preemptUSE_LIMITED_PREEMPTION == 1)
+    vTaskSuspendAll();
+#endif
+}
+
+BaseType_t xPreemptPoint(PreemptTask_t *pxTask)
+{
+    BaseType_t xYielded = pdFALSE;
+
+    pxTask->ulPoints++;
+    prvCloseRegion(pxTask, prvNowUs());
+
+#if (preemptUSE_LIMITED_PREEMPTION == 1)
+    // Resuming performs the yield the kernel deferred while the region ran
+    xYielded = xTaskResumeAll();
+    vTaskSuspendAll();
+
+    if (xYielded != pdFALSE)
+    {
+        pxTask->ulDeferredYields++;
+    }
+#endif
+
+    pxTask->ullRegionStartUs = prvNowUs();
+
+    return xYielded;
+}
+
+void vPreemptJobEnd(PreemptTask_t *pxTask)
+{
+    uint64_t ullNow = prvNowUs();
+    uint32_t ulSpan = (uint32_t)(ullNow - pxTask->ullJobStartUs);
+
+    prvCloseRegion(pxTask, ullNow);
+
+#if (preemptUSE_LIMITED_PREEMPTION == 1)
+    if (xTaskResumeAll() != pdFALSE)
+    {
+        pxTask->ulDeferredYields++;
+    }
+#endif
+
+    pxTask->ulJobs++;
+    pxTask->ullTotalSpanUs += ulSpan;
+
+    if (ulSpan > pxTask->ulMaxSpanUs)
+    {
+        pxTask->ulMaxSpanUs = ulSpan;
+    }
+}
+
+BaseType_t xPreemptAnalyse(PreemptAnalysisTask_t *pxTasks, UBaseType_t uxCount)
+{
+    BaseType_t xResult = pdPASS;
+
+    /*
+     * beta_i = max over the scheduling points t in (0, D_i] of t - W_i(t),
+     * with W_i(t) the level-i workload released in [0, t).  The scheduling
+     * points are D_i and the releases of higher priority tasks before it.
+     */
+    for (UBaseType_t i = 0; i < uxCount; i++)
+    {
+        int32_t lBest = prvSlackAt(pxTasks, uxCount, i, pxTasks[i].ulDeadlineUs);
+
+        for (UBaseType_t j = 0; j < uxCount; j++)
+        {
+            if (pxTasks[j].uxPriority <= pxTasks[i].uxPriority)
+            {
+                continue;
+            }
+
+            for (uint32_t t = pxTasks[j].ulPeriodUs; t < pxTasks[i].ulDeadlineUs; t += pxTasks[j].ulPeriodUs)
+            {
+                int32_t lSlack = prvSlackAt(pxTasks, uxCount, i, t);
+
+                if (lSlack > lBest)
+                {
+                    lBest = lSlack;
+                }
+            }
+        }
+
+        pxTasks[i].lBlockingToleranceUs = lBest;
+
+        if (lBest < 0)
+        {
+            xResult = pdFAIL;
+        }
+    }
+
+    // A region may block every task of higher priority, so take the minimum
+    for (UBaseType_t i = 0; i < uxCount; i++)
+    {
+        int32_t lMax = (int32_t)pxTasks[i].ulWcetUs;
+
+        for (UBaseType_t k = 0; k < uxCount; k++)
+        {
+            if ((pxTasks[k].uxPriority > pxTasks[i].uxPriority) && (pxTasks[k].lBlockingToleranceUs < lMax))
+            {
+                lMax = pxTasks[k].lBlockingToleranceUs;
+            }
+        }
+
+        pxTasks[i].ulMaxNprUs = (lMax > 0) ? (uint32_t)lMax : 0;
+    }
+
+    return xResult;
+}
+
+void vPreemptTraceSwitchedIn(void)
+{
+    ulContextSwitches++;
+}
+
+uint32_t ulPreemptContextSwitches(void)
+{
+    return ulContextSwitches;
+}
+
+void vPreemptReport(const PreemptTask_t *pxTask)
+{
+    printf("Preempt: %s mode=%s jobs=%lu points=%lu deferred=%lu\n", pxTask->pcName,
+           (preemptUSE_LIMITED_PREEMPTION == 1) ? "limited" : "full", (unsigned long)pxTask->ulJobs,
+           (unsigned long)pxTask->ulPoints, (unsigned long)pxTask->ulDeferredYields);
+    printf("Preempt: %s longest_region=%luus allowed=%luus overruns=%lu span avg=%luus max=%luus switches=%lu\n",
+           pxTask->pcName, (unsigned long)pxTask->ulLongestRegionUs, (unsigned long)pxTask->ulMaxNprUs,
+           (unsigned long)pxTask->ulRegionOverruns,
+           (unsigned long)((pxTask->ulJobs > 0) ? (pxTask->ullTotalSpanUs / pxTask->ulJobs) : 0),
+           (unsigned long)pxTask->ulMaxSpanUs, (unsigned long)ulContextSwitches);
+}
@@ -0,0 +1,81 @@
+/*
+ * Limited-preemption scheduling with fixed preemption points.
+ *
+ * A job runs non-preemptively between vPreemptJobStart() and
+ * vPreemptJobEnd(), except at the preemption points it marks with
+ * xPreemptPoint().  The non-preemptive region is implemented by suspending
+ * the scheduler: a higher priority task released inside the region is held
+ * back by the kernel's yield-pending flag and the deferred yield happens at
+ * the next preemption point.  With preemptUSE_LIMITED_PREEMPTION set to 0 the
+ * calls only collect statistics, so the same build measures full preemption.
+ *
+ * Jobs must not call blocking kernel functions between two preemption points,
+ * nor stdio or anything else that takes a host lock: on the Linux port
+ * another task's thread may be stopped while holding it, and the scheduler
+ * cannot run that task until the region ends.
+ *
+ * Context switches are counted when traceTASK_SWITCHED_IN() calls
+ * vPreemptTraceSwitchedIn().  FreeRTOSConfig.h has room for one definition
+ * of the hook, which trace.h needs too, so the demo chains both in
+ * vIpsaTaskSwitchedIn() (ipsa_sched.c):
+ *     void vIpsaTaskSwitchedIn(void);
+ *     void vIpsaTaskSwitchedOut(void);
+ *     #define traceTASK_SWITCHED_IN()    vIpsaTaskSwitchedIn()
+ *     #define traceTASK_SWITCHED_OUT()   vIpsaTaskSwitchedOut()
+ */
+
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+#include "FreeRTOS.h"
+
+#ifndef preemptUSE_LIMITED_PREEMPTION
+    #define preemptUSE_LIMITED_PREEMPTION    1
+#endif
+
+typedef struct PreemptTask
+{
+    const char *pcName;
+    uint32_t ulMaxNprUs;             /* Longest region the analysis allows, 0 if unknown. */
+
+    /* Statistics. */
+    uint64_t ullJobStartUs;
+    uint64_t ullRegionStartUs;
+    uint32_t ulLongestRegionUs;
+    uint32_t ulJobs;
+    uint32_t ulPoints;
+    uint32_t ulDeferredYields;
+    uint32_t ulRegionOverruns;
+    uint64_t ullTotalSpanUs;
+    uint32_t ulMaxSpanUs;
+} PreemptTask_t;
+
+/* Task parameters for the analysis, all times in microseconds. */
+typedef struct PreemptAnalysisTask
+{
+    const char *pcName;
+    uint32_t ulWcetUs;
+    uint32_t ulPeriodUs;
+    uint32_t ulDeadlineUs;
+    UBaseType_t uxPriority;
+    int32_t lBlockingToleranceUs;    /* Out: slack the task can give to lower priority regions. */
+    uint32_t ulMaxNprUs;             /* Out: longest non-preemptive region the task may use. */
+} PreemptAnalysisTask_t;
+
+void vPreemptJobStart(PreemptTask_t *pxTask);
+BaseType_t xPreemptPoint(PreemptTask_t *pxTask);
+void vPreemptJobEnd(PreemptTask_t *pxTask);
+
+/*
+ * Compute, for fixed priority scheduling, the blocking tolerance of each task
+ * and from it the longest non-preemptive region each task can use without
+ * making a higher priority task miss its deadline.  Returns pdFAIL if some
+ * task is unschedulable even under full preemption.
+ */
+BaseType_t xPreemptAnalyse(PreemptAnalysisTask_t *pxTasks, UBaseType_t uxCount);
+
+void vPreemptTraceSwitchedIn(void);
+uint32_t ulPreemptContextSwitches(void);
+void vPreemptReport(const PreemptTask_t *pxTask);
+
+#endif /* PREEMPT_H */
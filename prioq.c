@@ -0,0 +1,247 @@
+/*
+ * Priority and deadline ordered message queues.  See prioq.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Local includes. */
+#include "prioq.h"
+
+/* A queued message: its order and the slot holding its copy. */
+typedef struct PrioQueueNode
+{
+    TickType_t xKey;
+    uint32_t ulSequence;
+    UBaseType_t uxSlot;
+} PrioQueueNode_t;
+
+struct PrioQueue
+{
+    PrioQueueOrder_t eOrder;
+    UBaseType_t uxLength;
+    UBaseType_t uxItemSize;
+    UBaseType_t uxCount;
+    uint32_t ulSequence;
+    PrioQueueNode_t *pxHeap;
+    UBaseType_t *puxFree;            /* Stack of free slots, uxLength - uxCount deep. */
+    uint8_t *pucStorage;
+    SemaphoreHandle_t xItems;
+    SemaphoreHandle_t xSpaces;
+};
+
+/*-----------------------------------------------------------*/
+
+/* pdTRUE if pxA is handed out before pxB. */
+static BaseType_t prvBefore(const struct PrioQueue *pxQueue, const PrioQueueNode_t *pxA, const PrioQueueNode_t *pxB)
+{
+    if (pxA->xKey != pxB->xKey)
+    {
+        if (pxQueue->eOrder == ePrioQueueByPriority)
+        {
+            return (pxA->xKey > pxB->xKey) ? pdTRUE : pdFALSE;
+        }
+
+        // Earlier deadline, with tick count overflow
+        return ((TickType_t)(pxB->xKey - pxA->xKey) <= (portMAX_DELAY >> 1)) ? pdTRUE : pdFALSE;
+    }
+
+    return ((uint32_t)(pxB->ulSequence - pxA->ulSequence) <= (UINT32_MAX >> 1)) ? pdTRUE : pdFALSE;
+}
+
+static void prvSwap(PrioQueueNode_t *pxHeap, UBaseType_t uxA, UBaseType_t uxB)
+{
+    PrioQueueNode_t xNode = pxHeap[uxA];
+
+    pxHeap[uxA] = pxHeap[uxB];
+    pxHeap[uxB] = xNode;
+}
+
+/* Called in a critical section, with a free slot. */
+static void prvInsert(struct PrioQueue *pxQueue, const void *pvItem, TickType_t xKey)
+{
+    UBaseType_t uxSlot = pxQueue->puxFree[pxQueue->uxLength - pxQueue->uxCount - 1];
+    UBaseType_t uxIndex = pxQueue->uxCount++;
+
+    memcpy(&pxQueue->pucStorage[uxSlot * pxQueue->uxItemSize], pvItem, pxQueue->uxItemSize);
+
+    pxQueue->pxHeap[uxIndex].xKey = xKey;
+    pxQueue->pxHeap[uxIndex].ulSequence = pxQueue->ulSequence++;
+    pxQueue->pxHeap[uxIndex].uxSlot = uxSlot;
+
+    while ((uxIndex > 0) && prvBefore(pxQueue, &pxQueue->pxHeap[uxIndex], &pxQueue->pxHeap[(uxIndex - 1) / 2]))
+    {
+        prvSwap(pxQueue->pxHeap, uxIndex, (uxIndex - 1) / 2);
+        uxIndex = (uxIndex - 1) / 2;
+    }
+}
+
+/* Called in a critical section, with at least one message. */
+static void prvRemove(struct PrioQueue *pxQueue, void *pvBuffer)
+{
+    PrioQueueNode_t *pxHeap = pxQueue->pxHeap;
+    UBaseType_t uxSlot = pxHeap[0].uxSlot;
+    UBaseType_t uxIndex = 0;
+
+    memcpy(pvBuffer, &pxQueue->pucStorage[uxSlot * pxQueue->uxItemSize], pxQueue->uxItemSize);
+
+    pxHeap[0] = pxHeap[--pxQueue->uxCount];
+    pxQueue->puxFree[pxQueue->uxLength - pxQueue->uxCount - 1] = uxSlot;
+
+    for (;;)
+    {
+        UBaseType_t uxLeft = 2 * uxIndex + 1;
+        UBaseType_t uxFirst = uxIndex;
+
+        if ((uxLeft < pxQueue->uxCount) && prvBefore(pxQueue, &pxHeap[uxLeft], &pxHeap[uxFirst]))
+        {
+            uxFirst = uxLeft;
+        }
+
+        if ((uxLeft + 1 < pxQueue->uxCount) && prvBefore(pxQueue, &pxHeap[uxLeft + 1], &pxHeap[uxFirst]))
+        {
+            uxFirst = uxLeft + 1;
+        }
+
+        if (uxFirst == uxIndex)
+        {
+            break;
+        }
+
+        prvSwap(pxHeap, uxIndex, uxFirst);
+        uxIndex = uxFirst;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+PrioQueueHandle_t xPrioQueueCreate(UBaseType_t uxLength, UBaseType_t uxItemSize, PrioQueueOrder_t eOrder)
+{
+    struct PrioQueue *pxQueue;
+
+    configASSERT((uxLength > 0) && (uxItemSize > 0));
+
+    pxQueue = pvPortMalloc(sizeof(struct PrioQueue));
+
+    if (pxQueue == NULL)
+    {
+        return NULL;
+    }
+
+    memset(pxQueue, 0, sizeof(struct PrioQueue));
+    pxQueue->eOrder = eOrder;
+    pxQueue->uxLength = uxLength;
+    pxQueue->uxItemSize = uxItemSize;
+    pxQueue->pxHeap = pvPortMalloc(sizeof(PrioQueueNode_t) * uxLength);
+    pxQueue->puxFree = pvPortMalloc(sizeof(UBaseType_t) * uxLength);
+    pxQueue->pucStorage = pvPortMalloc(uxItemSize * uxLength);
+    pxQueue->xItems = xSemaphoreCreateCounting(uxLength, 0);
+    pxQueue->xSpaces = xSemaphoreCreateCounting(uxLength, uxLength);
+
+    if ((pxQueue->pxHeap == NULL) || (pxQueue->puxFree == NULL) || (pxQueue->pucStorage == NULL) ||
+        (pxQueue->xItems == NULL) || (pxQueue->xSpaces == NULL))
+    {
+        vPrioQueueDelete(pxQueue);
+        return NULL;
+    }
+
+    for (UBaseType_t i = 0; i < uxLength; i++)
+    {
+        pxQueue->puxFree[i] = i;
+    }
+
+    return pxQueue;
+}
+
+void vPrioQueueDelete(PrioQueueHandle_t xQueue)
+{
+    if (xQueue->xItems != NULL)
+    {
+        vSemaphoreDelete(xQueue->xItems);
+    }
+
+    if (xQueue->xSpaces != NULL)
+    {
+        vSemaphoreDelete(xQueue->xSpaces);
+    }
+
+    vPortFree(xQueue->pxHeap);
+    vPortFree(xQueue->puxFree);
+    vPortFree(xQueue->pucStorage);
+    vPortFree(xQueue);
+}
+
+BaseType_t xPrioQueueSend(PrioQueueHandle_t xQueue, const void *pvItem, TickType_t xKey, TickType_t xTicksToWait)
+{
+    if (xSemaphoreTake(xQueue->xSpaces, xTicksToWait) != pdPASS)
+    {
+        return errQUEUE_FULL;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        prvInsert(xQueue, pvItem, xKey);
+    }
+    taskEXIT_CRITICAL();
+
+    (void)xSemaphoreGive(xQueue->xItems);
+
+    return pdPASS;
+}
+
+BaseType_t xPrioQueueSendFromISR(PrioQueueHandle_t xQueue, const void *pvItem, TickType_t xKey,
+                                 BaseType_t *pxHigherPriorityTaskWoken)
+{
+    UBaseType_t uxSavedInterruptStatus;
+
+    if (xSemaphoreTakeFromISR(xQueue->xSpaces, NULL) != pdPASS)
+    {
+        return errQUEUE_FULL;
+    }
+
+    uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    {
+        prvInsert(xQueue, pvItem, xKey);
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+
+    (void)xSemaphoreGiveFromISR(xQueue->xItems, pxHigherPriorityTaskWoken);
+
+    return pdPASS;
+}
+
+BaseType_t xPrioQueueReceive(PrioQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    if (xSemaphoreTake(xQueue->xItems, xTicksToWait) != pdPASS)
+    {
+        return errQUEUE_EMPTY;
+    }
+
+    taskENTER_CRITICAL();
+    {
+        prvRemove(xQueue, pvBuffer);
+    }
+    taskEXIT_CRITICAL();
+
+    (void)xSemaphoreGive(xQueue->xSpaces);
+
+    return pdPASS;
+}
+
+UBaseType_t uxPrioQueueMessagesWaiting(PrioQueueHandle_t xQueue)
+{
+    UBaseType_t uxCount;
+
+    taskENTER_CRITICAL();
+    {
+        uxCount = xQueue->uxCount;
+    }
+    taskEXIT_CRITICAL();
+
+    return uxCount;
+}
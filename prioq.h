@@ -0,0 +1,53 @@
+/*
+ * Message queues ordered by urgency instead of arrival.
+ *
+ * A FreeRTOS queue is FIFO: an urgent message sent behind a burst of bulk
+ * messages waits for all of them to be handled.  A PrioQueue hands out the
+ * most urgent message first, by one of two orders fixed at creation:
+ *
+ *   ePrioQueueByPriority  the highest key first, typically the priority of
+ *                         the sender (prioqSENDER_PRIORITY());
+ *   ePrioQueueByDeadline  the earliest key first, an absolute deadline in
+ *                         ticks, compared modulo the tick count overflow.
+ *
+ * Messages with equal keys keep their arrival order.  The messages are
+ * copied into a fixed pool of uxLength slots, as xQueueSend() copies them,
+ * and ordered by a bounded binary heap of (key, sequence, slot): insert and
+ * remove are O(log n) under a short critical section.  Blocking follows the
+ * FreeRTOS queue: a receiver waits up to xTicksToWait for a message and a
+ * sender up to xTicksToWait for a free slot, through two counting
+ * semaphores, so the highest priority waiter is woken first.
+ */
+
+#ifndef PRIOQ_H
+#define PRIOQ_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef enum
+{
+    ePrioQueueByPriority,
+    ePrioQueueByDeadline
+} PrioQueueOrder_t;
+
+typedef struct PrioQueue *PrioQueueHandle_t;
+
+/* The key of a message ordered by the priority of the task sending it. */
+#define prioqSENDER_PRIORITY()    ( (TickType_t)uxTaskPriorityGet(NULL) )
+
+/* NULL if the memory cannot be allocated. */
+PrioQueueHandle_t xPrioQueueCreate(UBaseType_t uxLength, UBaseType_t uxItemSize, PrioQueueOrder_t eOrder);
+void vPrioQueueDelete(PrioQueueHandle_t xQueue);
+
+/* pdPASS, or errQUEUE_FULL if no slot freed up within xTicksToWait. */
+BaseType_t xPrioQueueSend(PrioQueueHandle_t xQueue, const void *pvItem, TickType_t xKey, TickType_t xTicksToWait);
+BaseType_t xPrioQueueSendFromISR(PrioQueueHandle_t xQueue, const void *pvItem, TickType_t xKey,
+                                 BaseType_t *pxHigherPriorityTaskWoken);
+
+/* pdPASS, or errQUEUE_EMPTY if no message arrived within xTicksToWait. */
+BaseType_t xPrioQueueReceive(PrioQueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait);
+
+UBaseType_t uxPrioQueueMessagesWaiting(PrioQueueHandle_t xQueue);
+
+#endif /* PRIOQ_H */
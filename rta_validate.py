@@ -0,0 +1,210 @@
+"""Compare response-time analysis bounds with observed response times.
+
+The task set (periods, priorities, WCET budgets) is read from ipsa_tasks.h,
+with the budgets of ipsa_budgets.h (budget_gen.py) when it exists.
+For every task the fixed-priority response-time analysis is evaluated with
+three pessimism terms:
+
+  - overhead: two context switches charged to every job,
+  - blocking: the longest non-preemptive region of a lower priority task,
+  - jitter:   release jitter of one tick, since vTaskDelay() releases are
+              quantized to the tick.
+
+Observed worst response times come only from a trace of the demo
+(insitu_wcet.json written by trace_jobs.py, --insitu), measured from the
+traced release of each job.  The report gives the
+bound/observed ratio per task and how much of the bound each term accounts
+for, largest first, so over-provisioning can be attacked where it is worst.
+
+The simulated column replays the analysis' own model (budgets as execution
+times, the same overhead, blocking and jitter) under adversarial phasing.
+It is a sanity check of the RTA arithmetic, a simulation above its bound
+being a bug in the analysis, and says nothing about the pessimism of the
+bound against the real system.
+"""
+
+import argparse
+import json
+import math
+import os
+import re
+
+
+def read_task_set(path):
+    source = open(path).read()
+
+    # Generated budgets take precedence, as in the C build
+    budgets = os.path.join(os.path.dirname(path), "ipsa_budgets.h")
+    if os.path.exists(budgets):
+        source = open(budgets).read() + source
+
+    def value(name):
+        match = re.search(r"#define\s+" + name + r"\s+\((.*)\)", source)
+        if match is None:
+            raise SystemExit(f"{name} not found in {path}")
+        expression = match.group(1)
+        expression = expression.replace("portTICK_PERIOD_MS", "1").replace("tskIDLE_PRIORITY", "0")
+        return int(eval(expression, {"__builtins__": {}}))
+
+    tasks = []
+    for prefix, name in (("TASK1", "TX1"), ("TASK2", "TX2"), ("TASK3", "TX3"), ("TASK4", "TX4")):
+        tasks.append({
+            "name": name,
+            "period_us": value(prefix + "_PERIOD_MS") * 1000,
+            "priority": value(prefix + "_PRIORITY"),
+            "wcet_us": value(prefix + "_WCET_US"),
+        })
+    tasks.append({
+        "name": "Aperiodic",
+        "period_us": value("APERIODIC_TASK_DELAY_MS") * 1000,
+        "priority": value("APERIODIC_TASK_PRIORITY"),
+        "wcet_us": value("APERIODIC_TASK_WCET_US"),
+    })
+
+    for task in tasks:
+        task["deadline_us"] = task["period_us"]
+
+    return tasks
+
+
+def response_time(task, tasks, overhead_us, blocking_us, jitter_us):
+    """Classic RTA with release jitter, blocking and context-switch overhead."""
+    higher = [other for other in tasks if other["priority"] > task["priority"]]
+    cost = task["wcet_us"] + 2 * overhead_us
+    response = cost + blocking_us
+
+    while True:
+        interference = sum(math.ceil((response + jitter_us) / other["period_us"]) *
+                           (other["wcet_us"] + 2 * overhead_us) for other in higher)
+        updated = cost + blocking_us + interference
+        if updated == response or updated + jitter_us > 10 * task["deadline_us"]:
+            break
+        response = updated
+
+    return response + jitter_us
+
+
+def blocking(task, tasks, region_us):
+    lower = [other for other in tasks if other["priority"] < task["priority"]]
+    return max((min(region_us, other["wcet_us"]) for other in lower), default=0)
+
+
+def simulate(tasks, target, overhead_us, region_us, jitter_us):
+    """Worst response of target's first job under an adversarial phasing.
+
+    A check of response_time(), not an observation: the jobs run for exactly
+    their budgets under the analysis' own assumptions.
+
+    Every higher priority task is released together with the target and its
+    second release is pulled in by the jitter; the target itself is released
+    a full jitter after its arrival, and the lower priority task with the
+    longest region starts just before, non-preemptively.
+    """
+    higher = [task for task in tasks if task["priority"] > target["priority"]]
+    lower = [task for task in tasks if task["priority"] < target["priority"]]
+    horizon = 10 * target["deadline_us"]
+
+    releases = []
+    for task in higher:
+        releases.append((0, task))
+        time = task["period_us"] - jitter_us
+        while time < horizon:
+            releases.append((time, task))
+            time += task["period_us"]
+    # The target arrived a jitter earlier but is only released now
+    releases.append((0, target))
+    releases.sort(key=lambda release: (release[0], -release[1]["priority"]))
+
+    time = 0
+    if lower:
+        # A lower priority region that started just before the critical instant
+        time = max(min(region_us, task["wcet_us"]) for task in lower)
+
+    ready = []
+    running = None
+    index = 0
+    while index < len(releases) or ready:
+        while index < len(releases) and releases[index][0] <= time:
+            release_time, task = releases[index]
+            ready.append({"task": task, "left": task["wcet_us"], "release": release_time})
+            index += 1
+
+        if not ready:
+            time = releases[index][0]
+            continue
+
+        job = max(ready, key=lambda job: job["task"]["priority"])
+        if job is not running:
+            time += overhead_us
+            running = job
+
+        next_release = releases[index][0] if index < len(releases) else math.inf
+        run = min(job["left"], next_release - time) if next_release > time else 0
+        time += run
+        job["left"] -= run
+
+        if job["left"] <= 0:
+            ready.remove(job)
+            running = None
+            if job["task"] is target:
+                return time + overhead_us - job["release"] + jitter_us
+
+        if time > horizon:
+            break
+
+    return math.inf
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--source", default="ipsa_tasks.h")
+    parser.add_argument("--insitu", help="insitu_wcet.json from trace_jobs.py, for the observed column")
+    parser.add_argument("--overhead-us", type=float, default=5.0, help="cost of one context switch")
+    parser.add_argument("--region-us", type=float, default=50.0, help="longest non-preemptive region")
+    parser.add_argument("--jitter-us", type=float, default=1000.0, help="release jitter (one tick)")
+    args = parser.parse_args()
+
+    tasks = read_task_set(args.source)
+    observed = {}
+
+    if args.insitu:
+        with open(args.insitu) as insitu_file:
+            insitu = json.load(insitu_file)
+        for name, stats in insitu.items():
+            observed[name] = stats["max_response_us"]
+    else:
+        print("No --insitu trace: nothing observed, the simulated column only checks the RTA arithmetic")
+
+    print(f"{'task':>10} {'bound':>10} {'observed':>10} {'ratio':>7} {'simulated':>10}  largest pessimism terms")
+
+    for task in sorted(tasks, key=lambda task: -task["priority"]):
+        block = blocking(task, tasks, args.region_us)
+        bound = response_time(task, tasks, args.overhead_us, block, args.jitter_us)
+
+        # Share of the bound due to each term: drop it and see what is left
+        terms = {
+            "overhead": bound - response_time(task, tasks, 0, block, args.jitter_us),
+            "blocking": bound - response_time(task, tasks, args.overhead_us, 0, args.jitter_us),
+            "jitter": bound - response_time(task, tasks, args.overhead_us, block, 0),
+        }
+        ranked = sorted(terms.items(), key=lambda term: -term[1])
+        detail = ", ".join(f"{name} {amount:.0f}us" for name, amount in ranked)
+
+        simulated = simulate(tasks, task, args.overhead_us, args.region_us, args.jitter_us)
+        shown = f"{simulated:>10.0f}" if simulated != math.inf else f"{'-':>10}"
+
+        seen = observed.get(task["name"])
+        if seen is None or seen == math.inf:
+            print(f"{task['name']:>10} {bound:>10.0f} {'-':>10} {'-':>7} {shown}  {detail}")
+        else:
+            print(f"{task['name']:>10} {bound:>10.0f} {seen:>10.0f} {bound / max(seen, 1e-9):>7.2f} {shown}  {detail}")
+
+        if simulated != math.inf and simulated > bound:
+            print(f"{task['name']:>10} simulation above the bound: the analysis is wrong")
+
+        if bound > task["deadline_us"]:
+            print(f"{task['name']:>10} bound exceeds the deadline of {task['deadline_us']}us")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+/*
+ * Context-switch benchmark for the FreeRTOS Linux ports.
+ *
+ * Only uses the kernel API, so it builds against either the stock Posix port
+ * or the single-thread port of port_ucontext/; the figures it prints are for
+ * the port it was linked with.  It measures:
+ *
+ *   latency  A low priority task stamps the time and notifies a higher
+ *            priority task, which preempts it and takes the difference.
+ *            This is the full path from the API call to the other task
+ *            running: a critical section, the switch, and the return.
+ *   rate     Two tasks of equal priority yield to each other as fast as they
+ *            can for switchRATE_SECONDS; every yield is one switch.
+ *
+ * Call switch_bench() from main() in place of ipsa_sched().  With
+ * port_ucontext, vApplicationIdleHook() must call vPortIdleHook(), see
+ * port_ucontext/portmacro.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define switchLATENCY_SAMPLES    ( 100000 )
+#define switchRATE_SECONDS       ( 2 )
+#define switchCHECK_EVERY        ( 1024 )
+
+#define switchHIGH_PRIORITY      ( tskIDLE_PRIORITY + 3 )
+#define switchLOW_PRIORITY       ( tskIDLE_PRIORITY + 2 )
+#define switchRATE_PRIORITY      ( tskIDLE_PRIORITY + 1 )
+
+static TaskHandle_t xReceiver = NULL;
+static volatile uint64_t ullSentNs = 0;
+static uint64_t *pullLatencies = NULL;
+static volatile uint32_t ulYields[2] = { 0, 0 };
+static volatile BaseType_t xRateDone = pdFALSE;
+static uint64_t ullRateElapsedNs = 0;
+
+static void prvReceiverTask(void *params);
+static void prvSenderTask(void *params);
+static void prvYieldTask(void *params);
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+/*-----------------------------------------------------------*/
+
+void switch_bench(void)
+{
+    pullLatencies = malloc(switchLATENCY_SAMPLES * sizeof(uint64_t));
+
+    if (pullLatencies == NULL)
+    {
+        fprintf(stderr, "switch_bench: cannot allocate %u latency samples\n", (unsigned)switchLATENCY_SAMPLES);
+        return;
+    }
+
+    xTaskCreate(prvReceiverTask, "Receiver", configMINIMAL_STACK_SIZE, NULL, switchHIGH_PRIORITY, &xReceiver);
+    xTaskCreate(prvSenderTask, "Sender", configMINIMAL_STACK_SIZE * 2, NULL, switchLOW_PRIORITY, NULL);
+
+    vTaskStartScheduler();
+
+    // Back here after vTaskEndScheduler(), or at once if the heap was too
+    // small for the idle task: either way there is nothing left to measure
+}
+
+static void prvReceiverTask(void *params)
+{
+    for (uint32_t i = 0; i < switchLATENCY_SAMPLES; i++)
+    {
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        pullLatencies[i] = prvNowNs() - ullSentNs;
+    }
+
+    vTaskDelete(NULL);
+}
+
+static void prvSenderTask(void *params)
+{
+    uint32_t ulTotal;
+
+    // Latency: each notification preempts this task
+    for (uint32_t i = 0; i < switchLATENCY_SAMPLES; i++)
+    {
+        ullSentNs = prvNowNs();
+        xTaskNotifyGive(xReceiver);
+    }
+
+    qsort(pullLatencies, switchLATENCY_SAMPLES, sizeof(pullLatencies[0]), prvCompare);
+    printf("Switch latency: median=%.2fus p99=%.2fus p99.9=%.2fus max=%.2fus (%u samples)\n",
+           (double)pullLatencies[switchLATENCY_SAMPLES / 2] / 1000.0,
+           (double)pullLatencies[switchLATENCY_SAMPLES * 99 / 100] / 1000.0,
+           (double)pullLatencies[switchLATENCY_SAMPLES * 999 / 1000] / 1000.0,
+           (double)pullLatencies[switchLATENCY_SAMPLES - 1] / 1000.0, (unsigned)switchLATENCY_SAMPLES);
+
+    // Rate: two equal priority tasks yielding to each other
+    xTaskCreate(prvYieldTask, "Yield0", configMINIMAL_STACK_SIZE, (void *)0, switchRATE_PRIORITY, NULL);
+    xTaskCreate(prvYieldTask, "Yield1", configMINIMAL_STACK_SIZE, (void *)1, switchRATE_PRIORITY, NULL);
+
+    while (xRateDone == pdFALSE)
+    {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    ulTotal = ulYields[0] + ulYields[1];
+    printf("Switch rate: %lu switches in %.2fs, %.0f switches/s, %.2fus per switch\n", (unsigned long)ulTotal,
+           (double)ullRateElapsedNs / 1e9, (double)ulTotal * 1e9 / (double)ullRateElapsedNs,
+           (double)ullRateElapsedNs / 1000.0 / (double)((ulTotal > 0) ? ulTotal : 1));
+
+    free(pullLatencies);
+    vTaskEndScheduler();
+    vTaskDelete(NULL);
+}
+
+static void prvYieldTask(void *params)
+{
+    uint32_t ulIndex = (uint32_t)(uintptr_t)params;
+    uint64_t ullStart = prvNowNs();
+
+    // Task 0 keeps the time, task 1 follows it
+    while (xRateDone == pdFALSE)
+    {
+        ulYields[ulIndex]++;
+        taskYIELD();
+
+        if ((ulIndex == 0) && ((ulYields[0] % switchCHECK_EVERY) == 0) &&
+            (prvNowNs() - ullStart >= (uint64_t)switchRATE_SECONDS * 1000000000ULL))
+        {
+            ullRateElapsedNs = prvNowNs() - ullStart;
+            xRateDone = pdTRUE;
+        }
+    }
+
+    vTaskDelete(NULL);
+}
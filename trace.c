@@ -0,0 +1,237 @@
+/*
+ * Context-switch and job trace.  See trace.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Local includes. */
+#include "trace.h"
+#include "output.h"
+
+#if (traceUSE_CACHE_COUNTERS == 1)
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+#endif
+
+typedef enum
+{
+    eTraceIn,
+    eTraceOut,
+    eTraceStart,
+    eTraceEnd,
+    eTraceRelease
+} TraceEventType_t;
+
+typedef struct TraceEvent
+{
+    uint64_t ullTimeNs;
+    const char *pcTask;
+    uint64_t ullCacheMisses;
+    TraceEventType_t eType;
+} TraceEvent_t;
+
+static const char * const pcEventNames[] = { "IN", "OUT", "START", "END", "RELEASE" };
+
+static TraceEvent_t xBuffers[2][traceBUFFER_EVENTS];
+static volatile UBaseType_t uxActive = 0;
+static volatile UBaseType_t uxFill = 0;
+static volatile uint32_t ulDropped = 0;
+static OutputStream_t *pxTraceStream = NULL;
+static FILE *pxTraceFile = NULL;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+#if (traceUSE_CACHE_COUNTERS == 1)
+
+/* One counter per thread: each FreeRTOS task is a pthread in the Linux port. */
+static __thread int iCounterFd = -2;
+
+static uint64_t prvCacheMisses(void)
+{
+    uint64_t ullCount = 0;
+
+    if (iCounterFd == -2)
+    {
+        struct perf_event_attr xAttr;
+
+        memset(&xAttr, 0, sizeof(xAttr));
+        xAttr.size = sizeof(xAttr);
+        xAttr.type = PERF_TYPE_HARDWARE;
+        xAttr.config = PERF_COUNT_HW_CACHE_MISSES;
+        xAttr.exclude_kernel = 1;
+        xAttr.exclude_hv = 1;
+
+        // Counts only while this thread runs, so preemptions are excluded
+        iCounterFd = (int)syscall(SYS_perf_event_open, &xAttr, 0, -1, -1, 0);
+    }
+
+    if ((iCounterFd < 0) || (read(iCounterFd, &ullCount, sizeof(ullCount)) != sizeof(ullCount)))
+    {
+        return 0;
+    }
+
+    return ullCount;
+}
+#endif
+
+/* Append an event.  The caller makes sure no other event is being added. */
+static void prvAppend(TraceEventType_t eType, const char *pcTask, uint64_t ullCacheMisses)
+{
+    if (uxFill < traceBUFFER_EVENTS)
+    {
+        TraceEvent_t *pxEvent = &xBuffers[uxActive][uxFill];
+
+        pxEvent->ullTimeNs = prvNowNs();
+        pxEvent->pcTask = pcTask;
+        pxEvent->ullCacheMisses = ullCacheMisses;
+        pxEvent->eType = eType;
+        uxFill++;
+    }
+    else
+    {
+        ulDropped++;
+    }
+}
+
+static void prvRecordJob(TraceEventType_t eType)
+{
+    uint64_t ullMisses = 0;
+
+#if (traceUSE_CACHE_COUNTERS == 1)
+    ullMisses = prvCacheMisses();
+#endif
+
+    taskENTER_CRITICAL();
+    {
+        prvAppend(eType, pcTaskGetName(NULL), ullMisses);
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void vTraceSwitchedIn(TaskHandle_t xTask)
+{
+    // Called from inside the kernel, which already excludes other events
+    prvAppend(eTraceIn, pcTaskGetName(xTask), 0);
+}
+
+void vTraceSwitchedOut(TaskHandle_t xTask)
+{
+    prvAppend(eTraceOut, pcTaskGetName(xTask), 0);
+}
+
+void vTraceReleased(TaskHandle_t xTask)
+{
+    // Called from inside the kernel too, often from the tick
+    prvAppend(eTraceRelease, pcTaskGetName(xTask), 0);
+}
+
+void vTraceJobStart(void)
+{
+    prvRecordJob(eTraceStart);
+}
+
+void vTraceJobEnd(void)
+{
+    prvRecordJob(eTraceEnd);
+}
+
+void vTraceFlush(void)
+{
+    UBaseType_t uxFull;
+    UBaseType_t uxCount;
+
+    // Swap halves so that tasks keep recording while the full one is written
+    taskENTER_CRITICAL();
+    {
+        uxFull = uxActive;
+        uxCount = uxFill;
+        uxActive = 1 - uxActive;
+        uxFill = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    // Through the asynchronous backend when it runs, plain stdio otherwise
+    if ((pxTraceStream == NULL) && (pxTraceFile == NULL))
+    {
+        int iFd = open(traceFILE_NAME, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (iFd < 0)
+        {
+            return;
+        }
+
+        pxTraceStream = pxOutputOpen(iFd);
+
+        if (pxTraceStream == NULL)
+        {
+            pxTraceFile = fdopen(iFd, "w");
+
+            if (pxTraceFile == NULL)
+            {
+                close(iFd);
+                return;
+            }
+        }
+    }
+
+    for (UBaseType_t i = 0; i < uxCount; i++)
+    {
+        const TraceEvent_t *pxEvent = &xBuffers[uxFull][i];
+        char cLine[128];
+        int iLength;
+
+        if ((pxEvent->eType == eTraceEnd) || (pxEvent->eType == eTraceStart))
+        {
+            iLength = snprintf(cLine, sizeof(cLine), "%llu %s %s %llu\n", (unsigned long long)pxEvent->ullTimeNs,
+                               pcEventNames[pxEvent->eType], pxEvent->pcTask, (unsigned long long)pxEvent->ullCacheMisses);
+        }
+        else
+        {
+            iLength = snprintf(cLine, sizeof(cLine), "%llu %s %s\n", (unsigned long long)pxEvent->ullTimeNs,
+                               pcEventNames[pxEvent->eType], pxEvent->pcTask);
+        }
+
+        if ((iLength <= 0) || ((size_t)iLength >= sizeof(cLine)))
+        {
+            continue;
+        }
+
+        if (pxTraceStream != NULL)
+        {
+            vOutputWrite(pxTraceStream, cLine, (size_t)iLength);
+        }
+        else
+        {
+            fwrite(cLine, 1, (size_t)iLength, pxTraceFile);
+        }
+    }
+
+    if (pxTraceFile != NULL)
+    {
+        fflush(pxTraceFile);
+    }
+}
+
+uint32_t ulTraceDropped(void)
+{
+    return ulDropped;
+}
@@ -0,0 +1,54 @@
+/*
+ * Context-switch and job trace for the ipsa_sched task set.
+ *
+ * Events are timestamped with CLOCK_MONOTONIC and kept in a double buffer in
+ * memory; vTraceFlush() swaps the buffers and writes the full one out as text
+ * (through output.h when xOutputInit() has been called), one event per line:
+ *
+ *     <ns> <event> <task> [<cache misses>]
+ *
+ * where <event> is one of RELEASE, IN, OUT, START or END.  trace_jobs.py
+ * rebuilds the per-job execution and response times from this file.
+ *
+ * Context switches are recorded once the kernel's switch hooks call
+ * vTraceSwitchedIn() and vTraceSwitchedOut() with the current task.  The
+ * demo wires them, together with the counter of preempt.h, through the
+ * single pair of hooks described there.  Releases are the instants a task
+ * wakes from its vTaskDelay() and is made ready, recorded by vTraceReleased()
+ * from the ready-list hook:
+ *     void vIpsaTaskReady(void *pvTask);
+ *     #define traceMOVED_TASK_TO_READY_STATE(pxTCB)    vIpsaTaskReady(pxTCB)
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Events held by each half of the double buffer. */
+#ifndef traceBUFFER_EVENTS
+    #define traceBUFFER_EVENTS       ( 16384 )
+#endif
+
+/* Set to 1 to read a per-thread cache-miss counter at job start and end
+ * through perf_event_open(). */
+#ifndef traceUSE_CACHE_COUNTERS
+    #define traceUSE_CACHE_COUNTERS  1
+#endif
+
+#define traceFILE_NAME               "ipsa_trace.txt"
+
+void vTraceSwitchedIn(TaskHandle_t xTask);
+void vTraceSwitchedOut(TaskHandle_t xTask);
+void vTraceReleased(TaskHandle_t xTask);
+void vTraceJobStart(void);
+void vTraceJobEnd(void);
+
+/* Write the buffered events to traceFILE_NAME.  Called from a task. */
+void vTraceFlush(void);
+
+/* Number of events lost because the buffer filled before a flush. */
+uint32_t ulTraceDropped(void);
+
+#endif /* TRACE_H */
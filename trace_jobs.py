@@ -0,0 +1,123 @@
+"""Rebuild per-job execution times from an ipsa_sched trace.
+
+Reads the file written by vTraceFlush() (see trace.h) and, for every job
+between a START and an END event, subtracts the time the task spent switched
+out.  The result is the net, in-situ execution time of each job, together
+with the number of times it was preempted and the cache misses it took if
+the trace carries counter values.  Response times run from the RELEASE
+event before the job, the wake-up from its release wait, so they include
+the time the job waited to start; a trace without releases falls back on
+the START event.
+
+The per-task distributions are printed and saved as JSON so that
+wcet_time.py --insitu can report them next to the standalone measurements.
+"""
+
+import argparse
+import json
+
+
+def percentile(samples, fraction):
+    ordered = sorted(samples)
+    index = min(len(ordered) - 1, int(fraction * len(ordered)))
+    return ordered[index]
+
+
+def parse_trace(path):
+    jobs = {}
+    open_jobs = {}
+    switched_out = {}
+    released = {}
+
+    with open(path) as trace:
+        for line in trace:
+            fields = line.split()
+            if len(fields) < 3:
+                continue
+
+            time_ns = int(fields[0])
+            event = fields[1]
+            task = fields[2]
+            job = open_jobs.get(task)
+
+            if event == "RELEASE":
+                # The first wake-up since the last job; a priority change
+                # also goes through the ready list and is not a release
+                if job is None:
+                    released.setdefault(task, time_ns)
+            elif event == "START":
+                open_jobs[task] = {
+                    "start": time_ns,
+                    "release": released.pop(task, time_ns),
+                    "misses": int(fields[3]) if len(fields) > 3 else 0,
+                    "preempted": 0,
+                    "preemptions": 0,
+                }
+                switched_out.pop(task, None)
+            elif event == "OUT" and job is not None:
+                # Switched out in the middle of a job: preempted
+                switched_out[task] = time_ns
+                job["preemptions"] += 1
+            elif event == "IN" and task in switched_out:
+                out_time = switched_out.pop(task)
+                if job is not None:
+                    job["preempted"] += time_ns - out_time
+            elif event == "END" and job is not None:
+                misses = int(fields[3]) if len(fields) > 3 else 0
+                jobs.setdefault(task, []).append({
+                    "net_us": (time_ns - job["start"] - job["preempted"]) / 1000.0,
+                    "response_us": (time_ns - job["release"]) / 1000.0,
+                    "preemptions": job["preemptions"],
+                    "cache_misses": max(0, misses - job["misses"]),
+                })
+                del open_jobs[task]
+
+    return jobs
+
+
+def summarize(jobs):
+    summary = {}
+
+    for task, samples in sorted(jobs.items()):
+        net = [job["net_us"] for job in samples]
+        misses = [job["cache_misses"] for job in samples]
+        summary[task] = {
+            "jobs": len(samples),
+            "net_us": {
+                "min": min(net),
+                "mean": sum(net) / len(net),
+                "p50": percentile(net, 0.50),
+                "p99": percentile(net, 0.99),
+                "max": max(net),
+            },
+            "max_response_us": max(job["response_us"] for job in samples),
+            "mean_preemptions": sum(job["preemptions"] for job in samples) / len(samples),
+            "max_cache_misses": max(misses),
+            "mean_cache_misses": sum(misses) / len(misses),
+            "samples_us": net,
+        }
+
+    return summary
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("trace", nargs="?", default="ipsa_trace.txt")
+    parser.add_argument("-o", "--output", default="insitu_wcet.json")
+    args = parser.parse_args()
+
+    summary = summarize(parse_trace(args.trace))
+
+    for task, stats in summary.items():
+        net = stats["net_us"]
+        print(f"{task}: jobs={stats['jobs']} net min={net['min']:.1f}us mean={net['mean']:.1f}us "
+              f"p99={net['p99']:.1f}us max={net['max']:.1f}us "
+              f"preemptions/job={stats['mean_preemptions']:.2f} "
+              f"cache misses mean={stats['mean_cache_misses']:.0f} max={stats['max_cache_misses']}")
+
+    with open(args.output, "w") as output:
+        json.dump(summary, output, indent=1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,55 @@
+/*
+ * Working-set warming.  See warm.h.
+ */
+
+#include <stdint.h>
+
+/* Local includes. */
+#include "warm.h"
+
+/*-----------------------------------------------------------*/
+
+int xWarmAdd(WarmSet_t *pxSet, const void *pvStart, size_t xSize)
+{
+    uintptr_t uxFirst = (uintptr_t)pvStart & ~(uintptr_t)(warmLINE_SIZE - 1);
+    uintptr_t uxEnd = (uintptr_t)pvStart + xSize;
+
+    if ((pxSet->ulRanges == warmMAX_RANGES) || (xSize == 0))
+    {
+        return -1;
+    }
+
+    pxSet->xRanges[pxSet->ulRanges].pvStart = pvStart;
+    pxSet->xRanges[pxSet->ulRanges].xSize = xSize;
+    pxSet->ulRanges++;
+    pxSet->ulLines += (uint32_t)((uxEnd - uxFirst + warmLINE_SIZE - 1) / warmLINE_SIZE);
+
+    return 0;
+}
+
+void vWarmTouch(WarmSet_t *pxSet)
+{
+    for (uint32_t r = 0; r < pxSet->ulRanges; r++)
+    {
+        const char *pcStart = pxSet->xRanges[r].pvStart;
+        const char *pcEnd = pcStart + pxSet->xRanges[r].xSize;
+        uintptr_t uxLine = (uintptr_t)pcStart & ~(uintptr_t)(warmLINE_SIZE - 1);
+        uintptr_t uxPage = (uintptr_t)-1;
+
+        for (; uxLine < (uintptr_t)pcEnd; uxLine += warmLINE_SIZE)
+        {
+            // A load per page fills the TLB entry the prefetches need
+            if ((uxLine & ~(uintptr_t)(warmPAGE_SIZE - 1)) != uxPage)
+            {
+                const char *pcByte = (uxLine < (uintptr_t)pcStart) ? pcStart : (const char *)uxLine;
+
+                uxPage = uxLine & ~(uintptr_t)(warmPAGE_SIZE - 1);
+                (void)*(const volatile char *)pcByte;
+            }
+
+            __builtin_prefetch((const void *)uxLine, 0, 3);
+        }
+    }
+
+    pxSet->ulTouches++;
+}
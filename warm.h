@@ -0,0 +1,50 @@
+/*
+ * Working-set warming before a job is released.
+ *
+ * A periodic job that slept for a whole period finds its data evicted by
+ * whatever ran in between: its first accesses miss in the caches and in the
+ * TLB.  A task registers the address ranges it reads in a WarmSet_t, and a
+ * pre-release hook calls vWarmTouch() shortly before the release.  Every
+ * cache line of a range is prefetched for reading, and one byte of each page
+ * is loaded, since a prefetch that misses in the TLB may be dropped rather
+ * than walk the page tables.  Run on the task's core this warms L1, L2 and
+ * the TLB; run by a helper on another core it can only warm the shared last
+ * level cache.
+ *
+ * The hook must run late enough that nothing evicts the lines again before
+ * the release, and early enough to finish before it: in ipsa_sched.c it is
+ * one tick ahead.  Kernel-free, like ipsa_jobs.c, so that warm_bench.c
+ * measures the same code.
+ */
+
+#ifndef WARM_H
+#define WARM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define warmMAX_RANGES     ( 8 )
+#define warmLINE_SIZE      ( 64 )
+#define warmPAGE_SIZE      ( 4096 )
+
+typedef struct WarmRange
+{
+    const void *pvStart;
+    size_t xSize;
+} WarmRange_t;
+
+typedef struct WarmSet
+{
+    WarmRange_t xRanges[warmMAX_RANGES];
+    uint32_t ulRanges;
+    uint32_t ulLines;                /* Cache lines covered by the ranges. */
+    uint32_t ulTouches;              /* Calls to vWarmTouch(). */
+} WarmSet_t;
+
+/* Add a range to the set.  0, or -1 if the set is full. */
+int xWarmAdd(WarmSet_t *pxSet, const void *pvStart, size_t xSize);
+
+/* Prefetch every line of the set and load one byte per page. */
+void vWarmTouch(WarmSet_t *pxSet);
+
+#endif /* WARM_H */
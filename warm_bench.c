@@ -0,0 +1,352 @@
+/*
+ * First-access latency and execution time of TX4 jobs with and without
+ * working-set warming before the release (warm.h).
+ *
+ * TX4 registers the key table of ipsa_jobs.c as its working set.  Jobs are
+ * released every --period on CPU 0; between two releases the CPU streams
+ * through --pollute MB, the way the other tasks' work does during the sleep
+ * of a FreeRTOS task, which evicts the table from the caches and its page
+ * from the TLB.  Even releases time the first load of every line of the
+ * table, odd releases time the job (search alone, and search plus output).
+ * Runs of the same length:
+ *
+ *   cold      no warming;
+ *   warm      the job thread wakes --lead before the release and warms the
+ *             set, as the ipsa_sched pre-release hook does;
+ *   helper    with --helper CPU, a thread on that CPU warms the set --lead
+ *             before the release; it can only reach the shared cache levels.
+ *
+ * The report gives median, 99th percentile and maximum per run, and the
+ * releases at which the pollution had not finished --lead before the next
+ * release.
+ *
+ *     gcc -O2 -pthread warm_bench.c warm.c ipsa_jobs.c output.c fmt.c binlog.c -o warm_bench
+ *     sudo ./warm_bench --jobs 1000 --pollute 32 > /dev/null
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* Local includes. */
+#include "ipsa_jobs.h"
+#include "output.h"
+#include "warm.h"
+
+#define warmbenchSEARCH_KEY      ( 25 )
+#define warmbenchDEFAULT_JOBS    ( 500 )
+
+typedef enum
+{
+    eRunCold,
+    eRunWarm,
+    eRunHelper,
+    eRuns
+} WarmBenchRun_t;
+
+typedef struct WarmBenchResult
+{
+    uint64_t *pullProbe;
+    uint64_t *pullSearch;
+    uint64_t *pullJob;
+    uint32_t ulProbes;
+    uint32_t ulJobs;
+    uint32_t ulLate;
+} WarmBenchResult_t;
+
+static const char *pcRunNames[eRuns] = { "cold", "warm", "helper" };
+
+static WarmBenchResult_t xResults[eRuns];
+static WarmSet_t xSet;
+static WarmSet_t xHelperSet;
+static const char *pcTable;
+static size_t xTableSize;
+
+static uint8_t *pucPollute;
+static size_t xPolluteBytes = 16UL * 1024 * 1024;
+static uint64_t ullPeriodNs = 10000000ULL;
+static uint64_t ullLeadNs = 100000ULL;
+static uint32_t ulJobs = warmbenchDEFAULT_JOBS;
+static int iHelperCpu = -1;
+
+/* Release schedule shared with the helper. */
+static volatile uint64_t ullHelperBase;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static void prvSleepUntil(uint64_t ullNs)
+{
+    struct timespec xWake = { .tv_sec = (time_t)(ullNs / 1000000000ULL), .tv_nsec = (long)(ullNs % 1000000000ULL) };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &xWake, NULL) == EINTR)
+    {
+    }
+}
+
+static void prvPin(int iCpu)
+{
+    cpu_set_t xCpus;
+
+    CPU_ZERO(&xCpus);
+    CPU_SET(iCpu, &xCpus);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(xCpus), &xCpus);
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+/* Sorts the samples. */
+static uint64_t prvPercentile(uint64_t *pullSamples, uint32_t ulCount, double dShare)
+{
+    if (ulCount == 0)
+    {
+        return 0;
+    }
+
+    qsort(pullSamples, ulCount, sizeof(uint64_t), prvCompare);
+
+    return pullSamples[(uint32_t)(dShare * (double)(ulCount - 1))];
+}
+
+/*-----------------------------------------------------------*/
+
+/* The other tasks' work: one write per line of a buffer larger than the caches. */
+static void prvPollute(void)
+{
+    for (size_t i = 0; i < xPolluteBytes; i += warmLINE_SIZE)
+    {
+        pucPollute[i]++;
+    }
+}
+
+static uint64_t prvProbe(void)
+{
+    uintptr_t uxLine = (uintptr_t)pcTable & ~(uintptr_t)(warmLINE_SIZE - 1);
+    uint64_t ullStart = prvNowNs();
+
+    for (; uxLine < (uintptr_t)pcTable + xTableSize; uxLine += warmLINE_SIZE)
+    {
+        const char *pcByte = (uxLine < (uintptr_t)pcTable) ? pcTable : (const char *)uxLine;
+
+        (void)*(const volatile char *)pcByte;
+    }
+
+    return prvNowNs() - ullStart;
+}
+
+static void *prvHelperThread(void *pvUnused)
+{
+    (void)pvUnused;
+    prvPin(iHelperCpu);
+
+    for (uint32_t k = 0; k < ulJobs; k++)
+    {
+        prvSleepUntil(ullHelperBase + k * ullPeriodNs - ullLeadNs);
+        vWarmTouch(&xHelperSet);
+    }
+
+    return NULL;
+}
+
+static void prvMeasure(WarmBenchRun_t eRun)
+{
+    WarmBenchResult_t *pxResult = &xResults[eRun];
+    uint64_t ullBase = prvNowNs() + ullPeriodNs;
+    pthread_t xHelper;
+
+    if (eRun == eRunHelper)
+    {
+        ullHelperBase = ullBase;
+
+        if (pthread_create(&xHelper, NULL, prvHelperThread, NULL) != 0)
+        {
+            fprintf(stderr, "warm_bench: no helper thread\n");
+            return;
+        }
+    }
+
+    prvPollute();
+
+    for (uint32_t k = 0; k < ulJobs; k++)
+    {
+        uint64_t ullRelease = ullBase + k * ullPeriodNs;
+
+        if (eRun == eRunWarm)
+        {
+            prvSleepUntil(ullRelease - ullLeadNs);
+            vWarmTouch(&xSet);
+        }
+
+        prvSleepUntil(ullRelease);
+
+        if ((k & 1) == 0)
+        {
+            pxResult->pullProbe[pxResult->ulProbes++] = prvProbe();
+        }
+        else
+        {
+            uint64_t ullStart = prvNowNs();
+            uint64_t ullSearched;
+            int iFound;
+
+            iFound = xIpsaSearch(warmbenchSEARCH_KEY, NULL, NULL);
+            ullSearched = prvNowNs();
+            vIpsaPrintSearch(iFound);
+
+            pxResult->pullSearch[pxResult->ulJobs] = ullSearched - ullStart;
+            pxResult->pullJob[pxResult->ulJobs++] = prvNowNs() - ullStart;
+        }
+
+        prvPollute();
+
+        // A warming that starts before the pollution ends is wasted
+        if (prvNowNs() + ullLeadNs > ullRelease + ullPeriodNs)
+        {
+            pxResult->ulLate++;
+        }
+    }
+
+    if (eRun == eRunHelper)
+    {
+        pthread_join(xHelper, NULL);
+    }
+}
+
+static void prvReport(WarmBenchRun_t eRun)
+{
+    WarmBenchResult_t *pxResult = &xResults[eRun];
+
+    fprintf(stderr, "%-7s first access p50=%6llu p99=%6llu max=%6llu ns  search p50=%6llu p99=%6llu ns  "
+            "job p50=%7llu p99=%7llu max=%7llu ns  late=%u\n", pcRunNames[eRun],
+            (unsigned long long)prvPercentile(pxResult->pullProbe, pxResult->ulProbes, 0.5),
+            (unsigned long long)prvPercentile(pxResult->pullProbe, pxResult->ulProbes, 0.99),
+            (unsigned long long)prvPercentile(pxResult->pullProbe, pxResult->ulProbes, 1.0),
+            (unsigned long long)prvPercentile(pxResult->pullSearch, pxResult->ulJobs, 0.5),
+            (unsigned long long)prvPercentile(pxResult->pullSearch, pxResult->ulJobs, 0.99),
+            (unsigned long long)prvPercentile(pxResult->pullJob, pxResult->ulJobs, 0.5),
+            (unsigned long long)prvPercentile(pxResult->pullJob, pxResult->ulJobs, 0.99),
+            (unsigned long long)prvPercentile(pxResult->pullJob, pxResult->ulJobs, 1.0),
+            (unsigned)pxResult->ulLate);
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    struct sched_param xParam = { .sched_priority = 50 };
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--jobs") == 0)
+        {
+            ulJobs = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--period") == 0)
+        {
+            ullPeriodNs = strtoull(argv[i + 1], NULL, 10) * 1000ULL;
+        }
+        else if (strcmp(argv[i], "--lead") == 0)
+        {
+            ullLeadNs = strtoull(argv[i + 1], NULL, 10) * 1000ULL;
+        }
+        else if (strcmp(argv[i], "--pollute") == 0)
+        {
+            xPolluteBytes = (size_t)strtoul(argv[i + 1], NULL, 10) * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--helper") == 0)
+        {
+            iHelperCpu = atoi(argv[i + 1]);
+        }
+    }
+
+    if ((ulJobs < 2) || (ullLeadNs >= ullPeriodNs))
+    {
+        fprintf(stderr, "warm_bench: needs --jobs >= 2 and --lead (us) below --period (us)\n");
+        return 1;
+    }
+
+    pcTable = pvIpsaSearchTable(&xTableSize);
+    (void)xWarmAdd(&xSet, pcTable, xTableSize);
+    xHelperSet = xSet;
+
+    pucPollute = malloc(xPolluteBytes + 1);
+
+    for (WarmBenchRun_t r = eRunCold; r < eRuns; r++)
+    {
+        xResults[r].pullProbe = calloc(ulJobs, sizeof(uint64_t));
+        xResults[r].pullSearch = calloc(ulJobs, sizeof(uint64_t));
+        xResults[r].pullJob = calloc(ulJobs, sizeof(uint64_t));
+
+        if ((xResults[r].pullProbe == NULL) || (xResults[r].pullSearch == NULL) || (xResults[r].pullJob == NULL))
+        {
+            fprintf(stderr, "warm_bench: no memory for the samples\n");
+            return 1;
+        }
+    }
+
+    if (pucPollute == NULL)
+    {
+        fprintf(stderr, "warm_bench: no memory for the pollution buffer\n");
+        return 1;
+    }
+
+    memset(pucPollute, 0, xPolluteBytes + 1);
+
+    if (xOutputInit() != 0)
+    {
+        fprintf(stderr, "warm_bench: asynchronous output unavailable, using stdio\n");
+    }
+
+    prvPin(0);
+
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &xParam) != 0)
+    {
+        fprintf(stderr, "warm_bench: SCHED_FIFO unavailable, the jobs run SCHED_OTHER\n");
+    }
+
+    fprintf(stderr, "warm_bench: working set %zu bytes, %u lines; period %llu us, lead %llu us, pollution %zu MB\n",
+            xTableSize, (unsigned)xSet.ulLines, (unsigned long long)(ullPeriodNs / 1000),
+            (unsigned long long)(ullLeadNs / 1000), xPolluteBytes / (1024 * 1024));
+
+    prvMeasure(eRunCold);
+    prvMeasure(eRunWarm);
+
+    if (iHelperCpu >= 0)
+    {
+        prvMeasure(eRunHelper);
+    }
+
+    vOutputDrain();
+
+    prvReport(eRunCold);
+    prvReport(eRunWarm);
+
+    if (iHelperCpu >= 0)
+    {
+        prvReport(eRunHelper);
+    }
+
+    return 0;
+}
@@ -0,0 +1,537 @@
+/*
+ * Per-sample outlier attribution for execution time measurements.
+ *
+ * Runs one ipsa job (TX1..TX4) many times on the calling thread and times
+ * every sample.  A perf_event group attached to the thread counts, over each
+ * sample window, the tracepoints that explain a long sample:
+ *
+ *   sched:sched_switch        the thread was switched out (preempted or
+ *                             blocked), else PERF_COUNT_SW_CONTEXT_SWITCHES;
+ *   irq:irq_handler_entry     a hard interrupt ran on top of the thread;
+ *   irq:softirq_entry         a softirq ran on top of it;
+ *   page faults               PERF_COUNT_SW_PAGE_FAULTS.
+ *
+ * Each sample is labelled preempted, interrupted, page-faulted or clean, in
+ * that order of precedence.  The report gives the distribution per label and
+ * the WCET over all samples and over the clean ones only.  Tracepoints need
+ * tracefs and perf_event_paranoid <= 1 (or root); a counter that cannot be
+ * opened is reported as such and its label never shows up.
+ *
+ * Switches, interrupts and softirqs happen in the kernel: when the counters
+ * can only be opened with exclude_kernel (perf_event_paranoid 2) they always
+ * read 0, so they are treated as unavailable.  Without all three a sample
+ * with no event is "unattributed" rather than clean, and no clean WCET is
+ * given.
+ *
+ * The timed window is the counted window: it runs from before the first
+ * group read to after the second one, less the cost of the two reads
+ * measured on empty windows beforehand, so an event during a read shows up
+ * in the time of the sample it is counted in.
+ *
+ *     gcc -O2 -pthread wcet_attr.c ipsa_jobs.c output.c fmt.c binlog.c -o wcet_attr
+ *     sudo ./wcet_attr TX4 100000 --json samples.json > /dev/null
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* Local includes. */
+#include "ipsa_jobs.h"
+#include "output.h"
+
+#define attrSEARCH_KEY        ( 25 )
+#define attrDEFAULT_SAMPLES   ( 10000 )
+#define attrCALIBRATION_RUNS  ( 1000 )
+#define attrUSAGE             "usage: wcet_attr [TX1 | TX2 | TX3 | TX4] [samples] [--json file]\n"
+
+typedef enum
+{
+    eCounterSwitch,
+    eCounterIrq,
+    eCounterSoftirq,
+    eCounterFault,
+    eCounters
+} AttrCounter_t;
+
+typedef enum
+{
+    eLabelClean,
+    eLabelPreempted,
+    eLabelInterrupted,
+    eLabelPageFaulted,
+    eLabels
+} AttrLabel_t;
+
+typedef struct AttrSample
+{
+    uint64_t ullNs;
+    uint64_t ullCounts[eCounters];
+    AttrLabel_t eLabel;
+} AttrSample_t;
+
+typedef struct AttrJob
+{
+    const char *pcName;
+    void (*vJob)(void);
+} AttrJob_t;
+
+static void prvJob2(void);
+static void prvJob4(void);
+
+static const AttrJob_t xJobs[] =
+{
+    { "TX1", vIpsaJob1 },
+    { "TX2", prvJob2 },
+    { "TX3", vIpsaJob3 },
+    { "TX4", prvJob4 },
+};
+
+static const char *pcCounterNames[eCounters] = { "switches", "irqs", "softirqs", "faults" };
+static const char *pcLabelNames[eLabels] = { "clean", "preempted", "interrupted", "page-faulted" };
+
+/* Counters that must all work for a sample without events to be clean. */
+static const AttrCounter_t xKernelCounters[] = { eCounterSwitch, eCounterIrq, eCounterSoftirq };
+
+/* Group member behind each counter, -1 if it could not be opened. */
+static int iSlots[eCounters];
+static const char *pcSources[eCounters];
+
+/*-----------------------------------------------------------*/
+
+static void prvJob2(void)
+{
+    float fahrenheit = 100.0f; // Fixed Fahrenheit temperature value
+
+    vIpsaPrintTemperature(fahrenheit, fIpsaCelsius(fahrenheit));
+}
+
+static void prvJob4(void)
+{
+    vIpsaPrintSearch(xIpsaSearch(attrSEARCH_KEY, NULL, NULL));
+}
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &xNow);
+
+    return (uint64_t)xNow.tv_sec * 1000000000ULL + (uint64_t)xNow.tv_nsec;
+}
+
+static int prvCompare(const void *pvA, const void *pvB)
+{
+    uint64_t ullA = *(const uint64_t *)pvA;
+    uint64_t ullB = *(const uint64_t *)pvB;
+
+    return (ullA > ullB) - (ullA < ullB);
+}
+
+/* Id of a tracepoint, from tracefs wherever it is mounted; 0 if absent. */
+static uint64_t prvTracepointId(const char *pcEvent)
+{
+    static const char *pcRoots[] = { "/sys/kernel/tracing", "/sys/kernel/debug/tracing" };
+    char cPath[256];
+
+    for (size_t i = 0; i < sizeof(pcRoots) / sizeof(pcRoots[0]); i++)
+    {
+        unsigned long long ullId;
+        FILE *pxFile;
+
+        snprintf(cPath, sizeof(cPath), "%s/events/%s/id", pcRoots[i], pcEvent);
+        pxFile = fopen(cPath, "r");
+
+        if (pxFile == NULL)
+        {
+            continue;
+        }
+
+        if (fscanf(pxFile, "%llu", &ullId) == 1)
+        {
+            fclose(pxFile);
+            return ullId;
+        }
+
+        fclose(pxFile);
+    }
+
+    return 0;
+}
+
+/* *piUserOnly is set when the counter only counts in user space. */
+static int prvOpen(uint32_t ulType, uint64_t ullConfig, int iGroup, int *piUserOnly)
+{
+    struct perf_event_attr xAttr;
+    int iFd;
+
+    memset(&xAttr, 0, sizeof(xAttr));
+    xAttr.size = sizeof(xAttr);
+    xAttr.type = ulType;
+    xAttr.config = ullConfig;
+    xAttr.read_format = PERF_FORMAT_GROUP;
+    xAttr.disabled = (iGroup < 0);
+
+    iFd = (int)syscall(SYS_perf_event_open, &xAttr, 0, -1, iGroup, PERF_FLAG_FD_CLOEXEC);
+    *piUserOnly = 0;
+
+    if ((iFd < 0) && (errno == EACCES))
+    {
+        // Unprivileged: what happens in the kernel on our behalf is hidden
+        xAttr.exclude_kernel = 1;
+        iFd = (int)syscall(SYS_perf_event_open, &xAttr, 0, -1, iGroup, PERF_FLAG_FD_CLOEXEC);
+        *piUserOnly = 1;
+    }
+
+    return iFd;
+}
+
+/* Opens the group, the task clock as leader.  Returns the leader or -1. */
+static int prvOpenGroup(uint32_t *pulMembers)
+{
+    static const char *pcTracepoints[eCounters] = { "sched/sched_switch", "irq/irq_handler_entry", "irq/softirq_entry", NULL };
+    int iUserOnly;
+    int iLeader = prvOpen(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1, &iUserOnly);
+
+    *pulMembers = 1;
+
+    if (iLeader < 0)
+    {
+        return -1;
+    }
+
+    for (uint32_t c = 0; c < eCounters; c++)
+    {
+        uint64_t ullId = (pcTracepoints[c] != NULL) ? prvTracepointId(pcTracepoints[c]) : 0;
+        int iFd = -1;
+
+        iSlots[c] = -1;
+        pcSources[c] = "unavailable";
+
+        if (ullId != 0)
+        {
+            iFd = prvOpen(PERF_TYPE_TRACEPOINT, ullId, iLeader, &iUserOnly);
+            pcSources[c] = pcTracepoints[c];
+        }
+
+        // Software fallbacks where there is one
+        if ((iFd < 0) && (c == eCounterSwitch))
+        {
+            iFd = prvOpen(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, iLeader, &iUserOnly);
+            pcSources[c] = "sw context-switches";
+        }
+        else if ((iFd < 0) && (c == eCounterFault))
+        {
+            iFd = prvOpen(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, iLeader, &iUserOnly);
+            pcSources[c] = "sw page-faults";
+        }
+
+        // A kernel event counted in user space only would always read 0
+        if ((iFd >= 0) && iUserOnly && (c != eCounterFault))
+        {
+            close(iFd);
+            iFd = -1;
+            pcSources[c] = "unavailable (kernel events need perf_event_paranoid <= 1)";
+        }
+        else if (iFd < 0)
+        {
+            pcSources[c] = "unavailable";
+        }
+
+        if (iFd >= 0)
+        {
+            iSlots[c] = (int)(*pulMembers)++;
+        }
+    }
+
+    return iLeader;
+}
+
+static void prvReadGroup(int iLeader, uint64_t *pullValues, uint32_t ulMembers)
+{
+    uint64_t ullBuffer[1 + 1 + eCounters];
+
+    if (read(iLeader, ullBuffer, sizeof(uint64_t) * (1 + ulMembers)) > 0)
+    {
+        memcpy(pullValues, &ullBuffer[1], sizeof(uint64_t) * ulMembers);
+    }
+}
+
+static AttrLabel_t prvLabel(const AttrSample_t *pxSample)
+{
+    if (pxSample->ullCounts[eCounterSwitch] > 0)
+    {
+        return eLabelPreempted;
+    }
+
+    if ((pxSample->ullCounts[eCounterIrq] > 0) || (pxSample->ullCounts[eCounterSoftirq] > 0))
+    {
+        return eLabelInterrupted;
+    }
+
+    if (pxSample->ullCounts[eCounterFault] > 0)
+    {
+        return eLabelPageFaulted;
+    }
+
+    return eLabelClean;
+}
+
+static void prvReportSet(const char *pcName, uint64_t *pullNs, uint32_t ulCount, uint32_t ulTotal)
+{
+    uint64_t ullSum = 0;
+
+    if (ulCount == 0)
+    {
+        fprintf(stderr, "%-14s %8u\n", pcName, 0U);
+        return;
+    }
+
+    qsort(pullNs, ulCount, sizeof(uint64_t), prvCompare);
+
+    for (uint32_t i = 0; i < ulCount; i++)
+    {
+        ullSum += pullNs[i];
+    }
+
+    fprintf(stderr, "%-14s %8u %6.2f%% %9.2fus %9.2fus %9.2fus %9.2fus\n", pcName, (unsigned)ulCount,
+            100.0 * ulCount / ulTotal, (double)pullNs[0] / 1000.0, (double)ullSum / ulCount / 1000.0,
+            (double)pullNs[(uint64_t)ulCount * 99 / 100] / 1000.0, (double)pullNs[ulCount - 1] / 1000.0);
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    const AttrJob_t *pxJob = &xJobs[3];
+    const char *pcJson = NULL;
+    uint32_t ulSamples = attrDEFAULT_SAMPLES;
+    uint32_t ulMembers;
+    uint32_t ulLabelCounts[eLabels] = { 0 };
+    uint64_t ullBefore[1 + eCounters] = { 0 };
+    uint64_t ullAfter[1 + eCounters] = { 0 };
+    AttrSample_t *pxSamples;
+    uint64_t *pullNs;
+    uint64_t ullReadNs = UINT64_MAX;
+    int iAttributed = 1;
+    int iLeader;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--json") == 0) && (i + 1 < argc))
+        {
+            pcJson = argv[++i];
+        }
+        else if ((argv[i][0] == 'T') && (argv[i][1] == 'X'))
+        {
+            pxJob = NULL;
+
+            for (size_t j = 0; j < sizeof(xJobs) / sizeof(xJobs[0]); j++)
+            {
+                if (strcmp(argv[i], xJobs[j].pcName) == 0)
+                {
+                    pxJob = &xJobs[j];
+                }
+            }
+
+            if (pxJob == NULL)
+            {
+                fprintf(stderr, "wcet_attr: unknown job %s\n" attrUSAGE, argv[i]);
+                return 1;
+            }
+        }
+        else
+        {
+            char *pcEnd;
+            unsigned long ulCount;
+
+            errno = 0;
+            ulCount = strtoul(argv[i], &pcEnd, 10);
+
+            if ((argv[i][0] == '-') || (pcEnd == argv[i]) || (*pcEnd != '\0') || (errno != 0) ||
+                (ulCount == 0) || (ulCount > UINT32_MAX))
+            {
+                fprintf(stderr, "wcet_attr: unknown option or bad sample count %s\n" attrUSAGE, argv[i]);
+                return 1;
+            }
+
+            ulSamples = (uint32_t)ulCount;
+        }
+    }
+
+    pxSamples = calloc(ulSamples, sizeof(AttrSample_t));
+    pullNs = calloc(ulSamples, sizeof(uint64_t));
+
+    if ((pxSamples == NULL) || (pullNs == NULL))
+    {
+        fprintf(stderr, "wcet_attr: no memory for %u samples\n", (unsigned)ulSamples);
+        return 1;
+    }
+
+    if (xOutputInit() != 0)
+    {
+        fprintf(stderr, "wcet_attr: asynchronous output unavailable, using stdio\n");
+    }
+
+    iLeader = prvOpenGroup(&ulMembers);
+
+    if (iLeader < 0)
+    {
+        fprintf(stderr, "wcet_attr: perf_event_open failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    for (size_t k = 0; k < sizeof(xKernelCounters) / sizeof(xKernelCounters[0]); k++)
+    {
+        iAttributed &= (iSlots[xKernelCounters[k]] >= 0);
+    }
+
+    if (!iAttributed)
+    {
+        pcLabelNames[eLabelClean] = "unattributed";
+    }
+
+    (void)ioctl(iLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    // Cost of the two reads around an empty window, taken off every sample
+    for (uint32_t r = 0; r < attrCALIBRATION_RUNS; r++)
+    {
+        uint64_t ullStart = prvNowNs();
+        uint64_t ullNs;
+
+        prvReadGroup(iLeader, ullBefore, ulMembers);
+        prvReadGroup(iLeader, ullAfter, ulMembers);
+        ullNs = prvNowNs() - ullStart;
+
+        ullReadNs = (ullNs < ullReadNs) ? ullNs : ullReadNs;
+    }
+
+    for (uint32_t s = 0; s < ulSamples; s++)
+    {
+        AttrSample_t *pxSample = &pxSamples[s];
+        uint64_t ullStart;
+        uint64_t ullNs;
+
+        // The timed window encloses the counted one, reads included
+        ullStart = prvNowNs();
+        prvReadGroup(iLeader, ullBefore, ulMembers);
+
+        pxJob->vJob();
+
+        prvReadGroup(iLeader, ullAfter, ulMembers);
+        ullNs = prvNowNs() - ullStart;
+        pxSample->ullNs = (ullNs > ullReadNs) ? ullNs - ullReadNs : 0;
+
+        for (uint32_t c = 0; c < eCounters; c++)
+        {
+            if (iSlots[c] >= 0)
+            {
+                pxSample->ullCounts[c] = ullAfter[iSlots[c]] - ullBefore[iSlots[c]];
+            }
+        }
+
+        pxSample->eLabel = prvLabel(pxSample);
+        ulLabelCounts[pxSample->eLabel]++;
+    }
+
+    (void)ioctl(iLeader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    vOutputDrain();
+
+    if (pcJson != NULL)
+    {
+        FILE *pxFile = fopen(pcJson, "w");
+
+        if (pxFile == NULL)
+        {
+            fprintf(stderr, "wcet_attr: cannot open %s: %s\n", pcJson, strerror(errno));
+        }
+        else
+        {
+            fprintf(pxFile, "{\"task\": \"%s\", \"samples\": [\n", pxJob->pcName);
+
+            for (uint32_t s = 0; s < ulSamples; s++)
+            {
+                const AttrSample_t *pxSample = &pxSamples[s];
+
+                fprintf(pxFile, "  {\"ns\": %llu, \"label\": \"%s\", \"switches\": %llu, \"irqs\": %llu, "
+                        "\"softirqs\": %llu, \"faults\": %llu}%s\n", (unsigned long long)pxSample->ullNs,
+                        pcLabelNames[pxSample->eLabel], (unsigned long long)pxSample->ullCounts[eCounterSwitch],
+                        (unsigned long long)pxSample->ullCounts[eCounterIrq],
+                        (unsigned long long)pxSample->ullCounts[eCounterSoftirq],
+                        (unsigned long long)pxSample->ullCounts[eCounterFault], (s + 1 < ulSamples) ? "," : "");
+            }
+
+            fprintf(pxFile, "]}\n");
+            fclose(pxFile);
+        }
+    }
+
+    for (uint32_t c = 0; c < eCounters; c++)
+    {
+        fprintf(stderr, "Attribution: %-8s from %s\n", pcCounterNames[c], pcSources[c]);
+    }
+
+    fprintf(stderr, "Attribution: %.2fus of group reads taken off every sample\n", (double)ullReadNs / 1000.0);
+
+    fprintf(stderr, "%-14s %8s %7s %11s %11s %11s %11s\n", pxJob->pcName, "samples", "share", "min", "mean", "p99", "max");
+
+    for (uint32_t l = 0; l < eLabels; l++)
+    {
+        uint32_t ulCount = 0;
+
+        for (uint32_t s = 0; s < ulSamples; s++)
+        {
+            if (pxSamples[s].eLabel == (AttrLabel_t)l)
+            {
+                pullNs[ulCount++] = pxSamples[s].ullNs;
+            }
+        }
+
+        prvReportSet(pcLabelNames[l], pullNs, ulCount, ulSamples);
+    }
+
+    for (uint32_t s = 0; s < ulSamples; s++)
+    {
+        pullNs[s] = pxSamples[s].ullNs;
+    }
+
+    prvReportSet("all", pullNs, ulSamples, ulSamples);
+
+    {
+        uint64_t ullAllMax = pullNs[ulSamples - 1];
+        uint64_t ullCleanMax = 0;
+
+        for (uint32_t s = 0; s < ulSamples; s++)
+        {
+            if ((pxSamples[s].eLabel == eLabelClean) && (pxSamples[s].ullNs > ullCleanMax))
+            {
+                ullCleanMax = pxSamples[s].ullNs;
+            }
+        }
+
+        if (!iAttributed)
+        {
+            fprintf(stderr, "WCET: %.2fus over all samples; no clean WCET, switches, irqs and softirqs are not all "
+                    "counted\n", (double)ullAllMax / 1000.0);
+        }
+        else
+        {
+            fprintf(stderr, "WCET: %.2fus over all samples, %.2fus over the %u clean ones (%.2fx)\n",
+                    (double)ullAllMax / 1000.0, (double)ullCleanMax / 1000.0, (unsigned)ulLabelCounts[eLabelClean],
+                    (ullCleanMax > 0) ? (double)ullAllMax / (double)ullCleanMax : 0.0);
+        }
+    }
+
+    close(iLeader);
+
+    return 0;
+}
@@ -0,0 +1,357 @@
+/*
+ * Trace-driven cache and TLB analysis of the ipsa_sched job kernels.
+ *
+ * The kernels (ipsa_jobs.c, and fmt.c which formats their output) are
+ * compiled with GCC's outline address sanitizer instrumentation, which calls
+ * __asan_loadN_noabort() / __asan_storeN_noabort() before every load and
+ * store, const data included.  This file provides those hooks in place of
+ * the sanitizer runtime: while a job runs they record its data accesses.
+ * Each recorded job is then replayed through the cache configurations of
+ * cachesim.h, cold (every level and the TLB invalidated, as after a long
+ * sleep) and warm (replayed again straight after), so the figures depend on
+ * the target hierarchy only, not on the host's caches or its noise.
+ *
+ * The inputs of each kernel are explored: every search key of TX4 in and
+ * around the table, a range of temperatures for TX2 (the number of digits
+ * printed changes the work).  The report gives, per task and configuration,
+ * the worst miss count of each level and the worst cycle estimate over the
+ * inputs, with the input that produced it.  Instruction fetches, libc calls
+ * (memcpy, strlen) and the output path are not traced: the cycles are the
+ * memory cycles of the kernels' data accesses.
+ *
+ *     gcc -O2 -fsanitize=kernel-address --param asan-instrumentation-with-call-threshold=0 \
+ *         --param asan-stack=0 --param asan-globals=0 -c ipsa_jobs.c fmt.c
+ *     gcc -O2 wcet_cache.c cachesim.c ipsa_jobs.o fmt.o output.c binlog.c -o wcet_cache
+ *     ./wcet_cache > /dev/null
+ *     ./wcet_cache --task TX4 --config "m4,L1=8K:2:32:lru:1,MEM=20" > /dev/null
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Local includes. */
+#include "ipsa_jobs.h"
+#include "cachesim.h"
+
+#define wcetcacheMAX_ACCESSES    ( 65536 )
+#define wcetcacheMAX_CONFIGS     ( 8 )
+#define wcetcacheLABEL_LENGTH    ( 32 )
+
+/* One traced access. */
+typedef struct WcetAccess
+{
+    uintptr_t uxAddress;
+    uint32_t ulSize;
+} WcetAccess_t;
+
+/* A kernel and the inputs it is explored over. */
+typedef struct WcetTask
+{
+    const char *pcName;
+    uint32_t ulInputs;
+    void (*vRun)(uint32_t ulInput, char *pcLabel);
+} WcetTask_t;
+
+/* Worst case of one task on one configuration. */
+typedef struct WcetWorst
+{
+    uint64_t ullAccesses;
+    uint64_t ullMisses[cachesimMAX_LEVELS];
+    uint64_t ullTlbMisses;
+    uint64_t ullColdCycles;
+    uint64_t ullWarmCycles;
+    char cColdInput[wcetcacheLABEL_LENGTH];
+} WcetWorst_t;
+
+static const char *pcPresets[] =
+{
+    "m7,L1=16K:4:32:lru:1,MEM=40",
+    "a53,L1=32K:4:64:lru:3,L2=512K:16:64:plru:15,TLB=512:4:4K:20,MEM=150",
+    "x86,L1=48K:12:64:plru:5,L2=1280K:10:64:plru:14,L3=8M:16:64:plru:45,TLB=1536:12:4K:30,MEM=250",
+};
+
+static WcetAccess_t xTrace[wcetcacheMAX_ACCESSES];
+static uint32_t ulTraced = 0;
+static uint32_t ulDropped = 0;
+static volatile int iTracing = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvRecord(uintptr_t uxAddress, uint32_t ulSize)
+{
+    if (!iTracing)
+    {
+        return;
+    }
+
+    if (ulTraced < wcetcacheMAX_ACCESSES)
+    {
+        xTrace[ulTraced].uxAddress = uxAddress;
+        xTrace[ulTraced].ulSize = ulSize;
+        ulTraced++;
+    }
+    else
+    {
+        ulDropped++;
+    }
+}
+
+/* The instrumentation hooks; loads and stores are looked up alike. */
+#define wcetcacheHOOKS(n)                                                      \
+    void __asan_load##n##_noabort(uintptr_t uxAddress)                         \
+    {                                                                          \
+        prvRecord(uxAddress, n);                                               \
+    }                                                                          \
+    void __asan_store##n##_noabort(uintptr_t uxAddress)                        \
+    {                                                                          \
+        prvRecord(uxAddress, n);                                               \
+    }
+
+wcetcacheHOOKS(1)
+wcetcacheHOOKS(2)
+wcetcacheHOOKS(4)
+wcetcacheHOOKS(8)
+wcetcacheHOOKS(16)
+
+void __asan_loadN_noabort(uintptr_t uxAddress, size_t xSize)
+{
+    prvRecord(uxAddress, (uint32_t)xSize);
+}
+
+void __asan_storeN_noabort(uintptr_t uxAddress, size_t xSize)
+{
+    prvRecord(uxAddress, (uint32_t)xSize);
+}
+
+void __asan_handle_no_return(void)
+{
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRunJob1(uint32_t ulInput, char *pcLabel)
+{
+    (void)ulInput;
+    snprintf(pcLabel, wcetcacheLABEL_LENGTH, "-");
+    vIpsaJob1();
+}
+
+/* -40 F to 212 F in steps of 4, then a large value with more digits. */
+static void prvRunJob2(uint32_t ulInput, char *pcLabel)
+{
+    float fFahrenheit = (ulInput < 64) ? -40.0f + 4.0f * (float)ulInput : 98765.4321f;
+
+    snprintf(pcLabel, wcetcacheLABEL_LENGTH, "%.4f F", fFahrenheit);
+    vIpsaPrintTemperature(fFahrenheit, fIpsaCelsius(fFahrenheit));
+}
+
+static void prvRunJob3(uint32_t ulInput, char *pcLabel)
+{
+    (void)ulInput;
+    snprintf(pcLabel, wcetcacheLABEL_LENGTH, "-");
+    vIpsaJob3();
+}
+
+/* Keys -1 to 51: every hit, and misses below, above and between. */
+static void prvRunJob4(uint32_t ulInput, char *pcLabel)
+{
+    int iKey = (int)ulInput - 1;
+
+    snprintf(pcLabel, wcetcacheLABEL_LENGTH, "key %d", iKey);
+    vIpsaPrintSearch(xIpsaSearch(iKey, NULL, NULL));
+}
+
+static void prvRunAperiodic(uint32_t ulInput, char *pcLabel)
+{
+    (void)ulInput;
+    snprintf(pcLabel, wcetcacheLABEL_LENGTH, "-");
+    vIpsaJobAperiodic();
+}
+
+static const WcetTask_t xTasks[] =
+{
+    { "TX1", 1, prvRunJob1 },
+    { "TX2", 65, prvRunJob2 },
+    { "TX3", 1, prvRunJob3 },
+    { "TX4", 53, prvRunJob4 },
+    { "Aperiodic", 1, prvRunAperiodic },
+};
+
+/*-----------------------------------------------------------*/
+
+static void prvReplay(CacheSim_t *pxSim)
+{
+    vCacheSimClearStats(pxSim);
+
+    for (uint32_t i = 0; i < ulTraced; i++)
+    {
+        vCacheSimAccess(pxSim, xTrace[i].uxAddress, xTrace[i].ulSize);
+    }
+}
+
+static void prvAnalyse(const WcetTask_t *pxTask, CacheSim_t *pxSims, uint32_t ulSims)
+{
+    WcetWorst_t xWorst[wcetcacheMAX_CONFIGS];
+
+    memset(xWorst, 0, sizeof(xWorst));
+
+    for (uint32_t ulInput = 0; ulInput < pxTask->ulInputs; ulInput++)
+    {
+        char cLabel[wcetcacheLABEL_LENGTH];
+
+        // Record once, the trace of an input does not depend on the cache
+        ulTraced = 0;
+        iTracing = 1;
+        pxTask->vRun(ulInput, cLabel);
+        iTracing = 0;
+
+        for (uint32_t c = 0; c < ulSims; c++)
+        {
+            CacheSim_t *pxSim = &pxSims[c];
+            WcetWorst_t *pxWorst = &xWorst[c];
+
+            vCacheSimFlush(pxSim);
+            prvReplay(pxSim);
+
+            if (pxSim->ullAccesses > pxWorst->ullAccesses)
+            {
+                pxWorst->ullAccesses = pxSim->ullAccesses;
+            }
+
+            for (uint32_t l = 0; l < pxSim->ulLevels; l++)
+            {
+                if (pxSim->xLevels[l].ullMisses > pxWorst->ullMisses[l])
+                {
+                    pxWorst->ullMisses[l] = pxSim->xLevels[l].ullMisses;
+                }
+            }
+
+            if (pxSim->xTlb.ullMisses > pxWorst->ullTlbMisses)
+            {
+                pxWorst->ullTlbMisses = pxSim->xTlb.ullMisses;
+            }
+
+            if ((ulInput == 0) || (pxSim->ullCycles > pxWorst->ullColdCycles))
+            {
+                pxWorst->ullColdCycles = pxSim->ullCycles;
+                memcpy(pxWorst->cColdInput, cLabel, sizeof(cLabel));
+            }
+
+            // The same job again, with what the first run left in the caches
+            prvReplay(pxSim);
+
+            if (pxSim->ullCycles > pxWorst->ullWarmCycles)
+            {
+                pxWorst->ullWarmCycles = pxSim->ullCycles;
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < ulSims; c++)
+    {
+        char cMisses[128];
+        size_t xLength = 0;
+
+        for (uint32_t l = 0; l < pxSims[c].ulLevels; l++)
+        {
+            xLength += (size_t)snprintf(cMisses + xLength, sizeof(cMisses) - xLength, "%s=%llu ",
+                                        pxSims[c].xLevels[l].cName, (unsigned long long)xWorst[c].ullMisses[l]);
+        }
+
+        if (pxSims[c].iHasTlb)
+        {
+            snprintf(cMisses + xLength, sizeof(cMisses) - xLength, "TLB=%llu ",
+                     (unsigned long long)xWorst[c].ullTlbMisses);
+        }
+
+        fprintf(stderr, "%-9s %-6s inputs=%-3u accesses<=%-5llu worst misses %s cold<=%llu cycles (%s) warm<=%llu cycles\n",
+                pxTask->pcName, pxSims[c].cName, (unsigned)pxTask->ulInputs, (unsigned long long)xWorst[c].ullAccesses,
+                cMisses, (unsigned long long)xWorst[c].ullColdCycles, xWorst[c].cColdInput,
+                (unsigned long long)xWorst[c].ullWarmCycles);
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    CacheSim_t xSims[wcetcacheMAX_CONFIGS];
+    uint32_t ulSims = 0;
+    const char *pcTask = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if ((strcmp(argv[i], "--config") == 0) && (ulSims < wcetcacheMAX_CONFIGS))
+        {
+            if (xCacheSimParse(&xSims[ulSims], argv[i + 1]) != 0)
+            {
+                fprintf(stderr, "wcet_cache: bad configuration %s\n", argv[i + 1]);
+                return 1;
+            }
+
+            ulSims++;
+        }
+        else if (strcmp(argv[i], "--task") == 0)
+        {
+            pcTask = argv[i + 1];
+        }
+    }
+
+    // The presets unless configurations were given
+    if (ulSims == 0)
+    {
+        for (uint32_t i = 0; i < sizeof(pcPresets) / sizeof(pcPresets[0]); i++)
+        {
+            if (xCacheSimParse(&xSims[ulSims++], pcPresets[i]) != 0)
+            {
+                fprintf(stderr, "wcet_cache: bad preset %s\n", pcPresets[i]);
+                return 1;
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < ulSims; c++)
+    {
+        fprintf(stderr, "wcet_cache: %s:", xSims[c].cName);
+
+        for (uint32_t l = 0; l < xSims[c].ulLevels; l++)
+        {
+            const CacheLevel_t *pxLevel = &xSims[c].xLevels[l];
+
+            fprintf(stderr, " %s %uB %u-way %uB %s %u cy,", pxLevel->cName, (unsigned)pxLevel->ulSize,
+                    (unsigned)pxLevel->ulWays, (unsigned)pxLevel->ulLine,
+                    (pxLevel->ePolicy == eCacheLru) ? "lru" : "plru", (unsigned)pxLevel->ulLatency);
+        }
+
+        if (xSims[c].iHasTlb)
+        {
+            fprintf(stderr, " TLB %u entries %u-way %uB pages +%u cy,",
+                    (unsigned)(xSims[c].xTlb.ulSize / xSims[c].xTlb.ulLine), (unsigned)xSims[c].xTlb.ulWays,
+                    (unsigned)xSims[c].xTlb.ulLine, (unsigned)xSims[c].xTlb.ulLatency);
+        }
+
+        fprintf(stderr, " memory %u cy\n", (unsigned)xSims[c].ulMemoryLatency);
+    }
+
+    for (uint32_t t = 0; t < sizeof(xTasks) / sizeof(xTasks[0]); t++)
+    {
+        if ((pcTask == NULL) || (strcmp(pcTask, xTasks[t].pcName) == 0))
+        {
+            prvAnalyse(&xTasks[t], xSims, ulSims);
+        }
+    }
+
+    if (ulDropped > 0)
+    {
+        fprintf(stderr, "wcet_cache: %u accesses beyond the trace buffer were dropped\n", (unsigned)ulDropped);
+    }
+
+    for (uint32_t c = 0; c < ulSims; c++)
+    {
+        vCacheSimFree(&xSims[c]);
+    }
+
+    return 0;
+}
@@ -1,17 +1,123 @@
 import subprocess
 import os
-import time 
+import signal
+import time
+import json
+import argparse
 import tqdm
 
-time_max=0
+parser = argparse.ArgumentParser(description="Standalone WCET measurement of a task binary")
+parser.add_argument("binary", nargs="?", default="./task2")
+parser.add_argument("--runs", type=int, default=1000)
+parser.add_argument("--cpu", type=int, help="CPU the binary is pinned to, required with --noise")
+parser.add_argument("--insitu", help="JSON written by trace_jobs.py, reported next to the standalone result")
+parser.add_argument("--task", default="TX2", help="task name to look up in the --insitu file")
+parser.add_argument("--noise", metavar="FILE",
+                    help="run noise_detect alongside, writing its gaps to FILE, and mark the runs they overlap")
+parser.add_argument("--noise-detector", default="./noise_detect", help="noise_detect binary")
+parser.add_argument("--noise-cpu", type=int,
+                    help="CPU for the detector, required with --noise and different from --cpu: "
+                         "ideally a sibling or an isolated core")
+parser.add_argument("--noise-threshold", type=int, default=10, help="gap threshold in microseconds")
+parser.add_argument("--discard-noisy", action="store_true",
+                    help="leave the runs that overlap a noise event out of the maximum")
+args = parser.parse_args()
 
-for i in tqdm.trange(1000):
-    start_time=time.time()
+if args.noise:
+    # The detector spins at SCHED_FIFO: on the workload's CPU it would delay
+    # the runs it is meant to watch
+    if args.noise_cpu is None or args.cpu is None:
+        parser.error("--noise needs --cpu and --noise-cpu")
+    if args.noise_cpu == args.cpu:
+        parser.error(f"--noise-cpu must differ from the workload CPU {args.cpu}")
+elif args.discard_noisy:
+    parser.error("--discard-noisy needs --noise")
 
-    os.system("./task2>/dev/null")
-    end_time=time.time()
+detector = None
+if args.noise:
+    # Half of every second, well below the RT throttling limit: a throttled
+    # detector reports its own throttling as noise.  Runs outside its spins
+    # are counted as unobserved rather than clean
+    command = [args.noise_detector, "--output", args.noise, "--threshold", str(args.noise_threshold),
+               "--cpu", str(args.noise_cpu), "--window", "1000", "--width", "500"]
+    detector = subprocess.Popen(command, stderr=subprocess.PIPE, text=True)
+    # Let it calibrate before the first run
+    time.sleep(0.2)
+
+# Pinned once here and inherited by every run, instead of a taskset per run
+if args.cpu is not None:
+    os.sched_setaffinity(0, {args.cpu})
+
+runs = []
+
+for i in tqdm.trange(args.runs):
+    # CLOCK_MONOTONIC, the clock of the noise events
+    start_ns = time.monotonic_ns()
+
+    os.system(f"{args.binary}>/dev/null")
+    end_ns = time.monotonic_ns()
+
+    runs.append((start_ns, end_ns))
+
+noisy = set()
+unobserved = set()
+if detector:
+    detector.send_signal(signal.SIGINT)
+    _, summary = detector.communicate()
+
+    with open(args.noise) as noise_file:
+        lines = [json.loads(line) for line in noise_file if line.strip()]
+    events = [line for line in lines if "gap_ns" in line]
+    spins = [line for line in lines if "spin_ns" in line]
+
+    # A run is observed only if it lies within one spin of the detector
+    for index, (start_ns, end_ns) in enumerate(runs):
+        if not any(spin["spin_t_ns"] <= start_ns and end_ns <= spin["spin_t_ns"] + spin["spin_ns"]
+                   for spin in spins):
+            unobserved.add(index)
+
+    # A run is noisy if any gap overlaps [start, end]
+    for index, (start_ns, end_ns) in enumerate(runs):
+        for event in events:
+            if event["t_ns"] <= end_ns and event["t_ns"] + event["gap_ns"] >= start_ns:
+                noisy.add(index)
+                break
+
+    print(summary.strip())
+    overlapping = [e for e in events if e["t_ns"] <= runs[-1][1] and e["t_ns"] + e["gap_ns"] >= runs[0][0]]
+    if overlapping:
+        print(f"Noise report: {len(overlapping)} events during the campaign, "
+              f"max gap {max(e['gap_ns'] for e in overlapping) / 1000:,.1f} us, "
+              f"{sum(e['gap_ns'] for e in overlapping) / 1e6:,.3f} ms lost; "
+              f"{len(noisy)} of {len(runs)} runs overlap an event")
+    else:
+        print(f"Noise report: no event above {args.noise_threshold} us during the campaign")
+    print(f"Noise report: {len(unobserved)} of {len(runs)} runs fell outside the detector's sampling")
+
+spent = [(end_ns - start_ns) / 1e9 for start_ns, end_ns in runs]
+# Clean means watched by the detector and clear of every gap
+clean = [s for i, s in enumerate(spent) if i not in noisy and i not in unobserved]
+kept = [s for i, s in enumerate(spent) if i not in noisy]
+time_max = max(kept if args.discard_noisy and kept else spent)
 
-    time_spent=end_time- start_time
-    if   time_spent>time_max:
-         time_max=time_spent
 print(f"Maximum time is {time_max:,.3f} seconds")
+if noisy:
+    noisy_max = max(spent[i] for i in noisy)
+    print(f"Maximum over the {len(clean)} clean runs is {max(clean) if clean else 0:,.3f} seconds, "
+          f"over the {len(noisy)} noisy runs {noisy_max:,.3f} seconds"
+          + (" (noisy runs discarded)" if args.discard_noisy else ""))
+
+if args.insitu:
+    with open(args.insitu) as insitu_file:
+        insitu = json.load(insitu_file)
+
+    # Net execution times measured inside the scheduler, preemptions removed
+    if args.task in insitu:
+        stats = insitu[args.task]
+        net = stats["net_us"]
+        print(f"In-situ {args.task}: {stats['jobs']} jobs, net max {net['max']:,.1f} us, "
+              f"p99 {net['p99']:,.1f} us, mean {net['mean']:,.1f} us, "
+              f"{stats['mean_preemptions']:.2f} preemptions/job, "
+              f"max cache misses {stats['max_cache_misses']}")
+    else:
+        print(f"In-situ: no jobs of {args.task} in {args.insitu}")